@@ -0,0 +1,725 @@
+/*  -*- c-basic-offset: 4 -*- */
+/*
+  Copyright (C) 2016 D. Caliste
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+/**
+ * @file escdf_bench.c
+ * @brief write and read benchmark of grid scalarfields
+ *
+ * A gaussian density is written on a grid, sliced among the MPI ranks, then
+ * read back, several times. The timings of each repetition (the slowest rank
+ * of each repetition) are reported as JSON, with bandwidths and latency
+ * percentiles. Run with --help for the list of parameters.
+ */
+
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "escdf_error.h"
+#include "escdf_handle.h"
+#include "escdf_grid_scalarfields.h"
+#include "escdf_info.h"
+
+typedef enum {
+    BENCH_ORDERING_DEFAULT = 0,
+    BENCH_ORDERING_TABLE,
+    BENCH_ORDERING_RANDOM
+} bench_ordering;
+
+typedef enum {
+    BENCH_FILE_SHARED = 0,
+    BENCH_FILE_PER_RANK
+} bench_file_mode;
+
+static const char *bench_ordering_names[] = {"default", "table", "random"};
+static const char *bench_file_mode_names[] = {"shared", "per-rank"};
+
+typedef struct {
+    unsigned int grid[3];
+    unsigned int ncomp;
+    escdf_real_or_complex real_or_complex;
+    bench_ordering ordering;
+    bench_file_mode file_mode;
+    hsize_t chunk_size;
+    unsigned int deflate_level;
+    int direct;
+    unsigned int repeat;
+    unsigned int warmup;
+    unsigned long seed;
+    const char *prefix;
+    const char *output;
+    int keep;
+} bench_params_t;
+
+typedef struct {
+    int iproc, nproc;
+    unsigned int fgrid[3]; /* the grid stored in the file */
+    hsize_t start, len; /* first and number of local grid points */
+    unsigned int *tbl; /* local to zyx lookup table, NULL for default ordering */
+    double *dens, *back;
+    size_t nvals; /* number of local values */
+    char *filename;
+} bench_data_t;
+
+typedef struct {
+    double min, mean, p50, p90, p99, max;
+} bench_summary_t;
+
+
+/******************************************************************************
+ * Command line                                                               *
+ ******************************************************************************/
+
+static void _usage(FILE *f, const char *prog)
+{
+    fprintf(f,
+            "Usage: %s [OPTIONS]\n"
+            "\n"
+            "Write and read back a grid scalarfield, and report timings as JSON.\n"
+            "\n"
+            "  -g, --grid=NX[xNYxNZ]      grid size (default 64x64x64)\n"
+            "  -c, --components=N         number of components, 1 to 4 (default 1)\n"
+            "  -x, --complex              complex values (default real)\n"
+            "  -o, --ordering=MODE        default, table or random (default default)\n"
+            "  -f, --file-mode=MODE       shared or per-rank (default shared)\n"
+            "  -k, --chunk=N              chunk size in grid points, 0 for contiguous\n"
+            "  -z, --deflate=L            deflate level, 0 to 9 (default 0)\n"
+            "  -d, --direct               use the chunk-level API (default ordering only)\n"
+            "  -r, --repeat=N             number of timed repetitions (default 10)\n"
+            "  -w, --warmup=N             number of untimed repetitions (default 1)\n"
+            "  -s, --seed=N               seed of the random ordering (default 1)\n"
+            "  -p, --prefix=NAME          prefix of the HDF5 files (default escdf-bench)\n"
+            "  -O, --output=FILE          write the JSON report to FILE (default stdout)\n"
+            "      --keep                 do not remove the HDF5 files\n"
+            "  -h, --help                 show this help\n", prog);
+}
+
+static int _parse_grid(const char *arg, unsigned int *grid)
+{
+    int n;
+
+    n = sscanf(arg, "%ux%ux%u", grid, grid + 1, grid + 2);
+    if (n == 1) {
+        grid[1] = grid[0];
+        grid[2] = grid[0];
+    } else if (n != 3) {
+        return -1;
+    }
+    return (grid[0] > 0 && grid[1] > 0 && grid[2] > 0) ? 0 : -1;
+}
+
+static int _parse_enum(const char *arg, const char **names, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (strcmp(arg, names[i]) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static int _parse_args(int argc, char **argv, bench_params_t *params)
+{
+    static struct option options[] = {
+        {"grid", required_argument, NULL, 'g'},
+        {"components", required_argument, NULL, 'c'},
+        {"complex", no_argument, NULL, 'x'},
+        {"ordering", required_argument, NULL, 'o'},
+        {"file-mode", required_argument, NULL, 'f'},
+        {"chunk", required_argument, NULL, 'k'},
+        {"deflate", required_argument, NULL, 'z'},
+        {"direct", no_argument, NULL, 'd'},
+        {"repeat", required_argument, NULL, 'r'},
+        {"warmup", required_argument, NULL, 'w'},
+        {"seed", required_argument, NULL, 's'},
+        {"prefix", required_argument, NULL, 'p'},
+        {"output", required_argument, NULL, 'O'},
+        {"keep", no_argument, NULL, 'K'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    int c, val;
+
+    params->grid[0] = 64;
+    params->grid[1] = 64;
+    params->grid[2] = 64;
+    params->ncomp = 1;
+    params->real_or_complex = ESCDF_REAL;
+    params->ordering = BENCH_ORDERING_DEFAULT;
+    params->file_mode = BENCH_FILE_SHARED;
+    params->chunk_size = 0;
+    params->deflate_level = 0;
+    params->direct = 0;
+    params->repeat = 10;
+    params->warmup = 1;
+    params->seed = 1;
+    params->prefix = "escdf-bench";
+    params->output = NULL;
+    params->keep = 0;
+
+    while ((c = getopt_long(argc, argv, "g:c:xo:f:k:z:dr:w:s:p:O:h",
+                            options, NULL)) != -1) {
+        switch (c) {
+        case 'g':
+            if (_parse_grid(optarg, params->grid) < 0)
+                return -1;
+            break;
+        case 'c':
+            params->ncomp = (unsigned int)atoi(optarg);
+            if (params->ncomp < 1 || params->ncomp > 4)
+                return -1;
+            break;
+        case 'x':
+            params->real_or_complex = ESCDF_COMPLEX;
+            break;
+        case 'o':
+            if ((val = _parse_enum(optarg, bench_ordering_names, 3)) < 0)
+                return -1;
+            params->ordering = (bench_ordering)val;
+            break;
+        case 'f':
+            if ((val = _parse_enum(optarg, bench_file_mode_names, 2)) < 0)
+                return -1;
+            params->file_mode = (bench_file_mode)val;
+            break;
+        case 'k':
+            params->chunk_size = (hsize_t)strtoull(optarg, NULL, 10);
+            break;
+        case 'z':
+            val = atoi(optarg);
+            if (val < 0 || val > 9)
+                return -1;
+            params->deflate_level = (unsigned int)val;
+            break;
+        case 'd':
+            params->direct = 1;
+            break;
+        case 'r':
+            val = atoi(optarg);
+            if (val < 1)
+                return -1;
+            params->repeat = (unsigned int)val;
+            break;
+        case 'w':
+            val = atoi(optarg);
+            if (val < 0)
+                return -1;
+            params->warmup = (unsigned int)val;
+            break;
+        case 's':
+            params->seed = strtoul(optarg, NULL, 10);
+            break;
+        case 'p':
+            params->prefix = optarg;
+            break;
+        case 'O':
+            params->output = optarg;
+            break;
+        case 'K':
+            params->keep = 1;
+            break;
+        case 'h':
+            return 1;
+        default:
+            return -1;
+        }
+    }
+
+    if (params->direct && params->ordering != BENCH_ORDERING_DEFAULT)
+        return -1;
+
+    return (optind == argc) ? 0 : -1;
+}
+
+
+/******************************************************************************
+ * Data                                                                       *
+ ******************************************************************************/
+
+static double _wtime(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + 1e-9 * (double)ts.tv_nsec;
+}
+
+/* Split n among nproc, giving the first ranks one more element. */
+static void _split(hsize_t n, int nproc, int iproc, hsize_t *start, hsize_t *len)
+{
+    hsize_t q, r;
+
+    q = n / nproc;
+    r = n % nproc;
+    *len = q + ((hsize_t)iproc < r);
+    *start = q * iproc + (((hsize_t)iproc < r) ? (hsize_t)iproc : r);
+}
+
+/* Centred gaussian, with a sign per component. */
+static double _value(const unsigned int *grid, unsigned int g,
+                     unsigned int icomp, unsigned int k)
+{
+    double rx, ry, rz, fac;
+
+    rx = ((double)(g % grid[0]) / grid[0] - 0.5) * 5.;
+    ry = ((double)((g / grid[0]) % grid[1]) / grid[1] - 0.5) * 5.;
+    rz = ((double)(g / grid[0] / grid[1]) / grid[2] - 0.5) * 5.;
+    fac = (icomp % 2) ? +1. : -1.;
+    fac *= (k == 0) ? 1. : 0.5;
+
+    return fac * exp(-(rx * rx + ry * ry + rz * rz)) + icomp;
+}
+
+/* xorshift64*, good enough to shuffle the lookup table. */
+static unsigned long long _random(unsigned long long *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ULL;
+}
+
+static int _setup_data(const bench_params_t *params, bench_data_t *data)
+{
+    int nproc_file, iproc_file;
+    hsize_t start = 0, len, x0, nx, i, j;
+    unsigned int x, y, z, g, c, k, rc;
+    unsigned long long state;
+    size_t size;
+
+    nproc_file = (params->file_mode == BENCH_FILE_PER_RANK) ? 1 : data->nproc;
+    iproc_file = (params->file_mode == BENCH_FILE_PER_RANK) ? 0 : data->iproc;
+
+    /* In per-rank mode, each file stores a slab of x planes of the grid. */
+    data->fgrid[0] = params->grid[0];
+    data->fgrid[1] = params->grid[1];
+    data->fgrid[2] = params->grid[2];
+    if (params->file_mode == BENCH_FILE_PER_RANK) {
+        _split(params->grid[0], data->nproc, data->iproc, &start, &len);
+        if (len == 0)
+            return -1;
+        data->fgrid[0] = (unsigned int)len;
+    }
+
+    data->tbl = NULL;
+    if (params->ordering == BENCH_ORDERING_DEFAULT) {
+        /* Contiguous range of points in zyx ordering. */
+        _split((hsize_t)data->fgrid[0] * data->fgrid[1] * data->fgrid[2],
+               nproc_file, iproc_file, &start, &data->len);
+    } else {
+        /* Slab of x planes, stored z first, with a lookup table to zyx. */
+        _split(data->fgrid[0], nproc_file, iproc_file, &x0, &nx);
+        data->len = nx * data->fgrid[1] * data->fgrid[2];
+        data->tbl = malloc(sizeof(unsigned int) * (data->len + 1));
+        if (data->tbl == NULL)
+            return -1;
+        i = 0;
+        for (x = (unsigned int)x0; x < x0 + nx; x++) {
+            for (y = 0; y < data->fgrid[1]; y++) {
+                for (z = 0; z < data->fgrid[2]; z++) {
+                    data->tbl[i++] = (z * data->fgrid[1] + y) * data->fgrid[0] + x;
+                }
+            }
+        }
+        if (params->ordering == BENCH_ORDERING_RANDOM) {
+            state = 0x9E3779B97F4A7C15ULL ^ (params->seed + (unsigned long long)data->iproc);
+            for (i = data->len; i > 1; i--) {
+                j = _random(&state) % i;
+                g = data->tbl[i - 1];
+                data->tbl[i - 1] = data->tbl[j];
+                data->tbl[j] = g;
+            }
+        }
+    }
+
+    data->start = start;
+
+    rc = (unsigned int)params->real_or_complex;
+    data->nvals = (size_t)data->len * params->ncomp * rc;
+    size = sizeof(double) * (data->nvals + 1);
+    data->dens = malloc(size);
+    data->back = malloc(size);
+    if (data->dens == NULL || data->back == NULL)
+        return -1;
+    for (c = 0; c < params->ncomp; c++) {
+        for (i = 0; i < data->len; i++) {
+            g = (data->tbl) ? data->tbl[i] : (unsigned int)(start + i);
+            for (k = 0; k < rc; k++) {
+                data->dens[(c * data->len + i) * rc + k] = _value(data->fgrid, g, c, k);
+            }
+        }
+    }
+
+    if (params->file_mode == BENCH_FILE_PER_RANK) {
+        size = snprintf(NULL, 0, "%s.%04d.h5", params->prefix, data->iproc) + 1;
+        data->filename = malloc(size);
+        snprintf(data->filename, size, "%s.%04d.h5", params->prefix, data->iproc);
+    } else {
+        size = strlen(params->prefix) + 4;
+        data->filename = malloc(size);
+        snprintf(data->filename, size, "%s.h5", params->prefix);
+    }
+
+    return 0;
+}
+
+static void _free_data(bench_data_t *data)
+{
+    free(data->tbl);
+    free(data->dens);
+    free(data->back);
+    free(data->filename);
+}
+
+
+/******************************************************************************
+ * Timings                                                                    *
+ ******************************************************************************/
+
+static void _barrier(void)
+{
+#ifdef HAVE_MPI
+    MPI_Barrier(MPI_COMM_WORLD);
+#endif
+}
+
+/* Time of the slowest rank, on rank 0. */
+static double _max_time(double t)
+{
+#ifdef HAVE_MPI
+    double tmax;
+
+    MPI_Reduce(&t, &tmax, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    return tmax;
+#else
+    return t;
+#endif
+}
+
+static int _all_true(int ok)
+{
+#ifdef HAVE_MPI
+    int all;
+
+    MPI_Allreduce(&ok, &all, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+    return all;
+#else
+    return ok;
+#endif
+}
+
+static escdf_handle_t * _open(const bench_params_t *params, const bench_data_t *data,
+                              int create)
+{
+#ifdef HAVE_MPI
+    if (params->file_mode == BENCH_FILE_SHARED) {
+        return (create) ?
+            escdf_create_mpi(data->filename, NULL, MPI_COMM_WORLD) :
+            escdf_open_mpi(data->filename, NULL, MPI_COMM_WORLD);
+    }
+#else
+    (void)params;
+#endif
+    return (create) ?
+        escdf_create(data->filename, NULL) :
+        escdf_open(data->filename, NULL);
+}
+
+static int _compare(const void *a, const void *b)
+{
+    double da = *(const double*)a, db = *(const double*)b;
+
+    return (da > db) - (da < db);
+}
+
+/* Nearest-rank percentile of sorted samples. */
+static double _percentile(const double *samples, unsigned int n, double p)
+{
+    unsigned int i;
+
+    i = (unsigned int)ceil(p / 100. * n);
+    return samples[(i > 0) ? i - 1 : 0];
+}
+
+static void _summarise(double *samples, unsigned int n, bench_summary_t *summary)
+{
+    unsigned int i;
+
+    qsort(samples, n, sizeof(double), _compare);
+    summary->min = samples[0];
+    summary->max = samples[n - 1];
+    summary->mean = 0.;
+    for (i = 0; i < n; i++) {
+        summary->mean += samples[i];
+    }
+    summary->mean /= n;
+    summary->p50 = _percentile(samples, n, 50.);
+    summary->p90 = _percentile(samples, n, 90.);
+    summary->p99 = _percentile(samples, n, 99.);
+}
+
+static void _print_summary(FILE *f, const char *name, const bench_summary_t *summary,
+                           double bytes, int last)
+{
+    fprintf(f, "  \"%s\": {\n", name);
+    fprintf(f, "    \"bandwidth_mb_s\": {\"mean\": %.6g, \"best\": %.6g},\n",
+            bytes / summary->mean / 1e6, bytes / summary->min / 1e6);
+    fprintf(f, "    \"latency_s\": {\"min\": %.6g, \"mean\": %.6g, \"p50\": %.6g, "
+            "\"p90\": %.6g, \"p99\": %.6g, \"max\": %.6g}\n",
+            summary->min, summary->mean, summary->p50, summary->p90,
+            summary->p99, summary->max);
+    fprintf(f, "  }%s\n", (last) ? "" : ",");
+}
+
+static void _report(FILE *f, const bench_params_t *params, const bench_data_t *data,
+                    double bytes, const bench_summary_t *write,
+                    const bench_summary_t *read, int verified)
+{
+    int major, minor, micro;
+
+    escdf_info_version(&major, &minor, &micro);
+
+    fprintf(f, "{\n");
+    fprintf(f, "  \"benchmark\": \"grid_scalarfield\",\n");
+    fprintf(f, "  \"version\": \"%d.%d.%d\",\n", major, minor, micro);
+    fprintf(f, "  \"ranks\": %d,\n", data->nproc);
+    fprintf(f, "  \"parameters\": {\n");
+    fprintf(f, "    \"grid\": [%u, %u, %u],\n",
+            params->grid[0], params->grid[1], params->grid[2]);
+    fprintf(f, "    \"components\": %u,\n", params->ncomp);
+    fprintf(f, "    \"values\": \"%s\",\n",
+            (params->real_or_complex == ESCDF_COMPLEX) ? "complex" : "real");
+    fprintf(f, "    \"ordering\": \"%s\",\n", bench_ordering_names[params->ordering]);
+    fprintf(f, "    \"file_mode\": \"%s\",\n", bench_file_mode_names[params->file_mode]);
+    fprintf(f, "    \"chunk_size\": %llu,\n", (unsigned long long)params->chunk_size);
+    fprintf(f, "    \"deflate_level\": %u,\n", params->deflate_level);
+    fprintf(f, "    \"direct\": %s,\n", (params->direct) ? "true" : "false");
+    fprintf(f, "    \"repeat\": %u,\n", params->repeat);
+    fprintf(f, "    \"warmup\": %u\n", params->warmup);
+    fprintf(f, "  },\n");
+    fprintf(f, "  \"bytes\": %.0f,\n", bytes);
+    _print_summary(f, "write", write, bytes, 0);
+    _print_summary(f, "read", read, bytes, 0);
+    fprintf(f, "  \"verified\": %s\n", (verified) ? "true" : "false");
+    fprintf(f, "}\n");
+}
+
+
+/******************************************************************************
+ * Benchmark                                                                  *
+ ******************************************************************************/
+
+static escdf_grid_scalarfield_t * _new_scalarfield(const bench_params_t *params,
+                                                   const bench_data_t *data)
+{
+    escdf_grid_scalarfield_t *scalarfield;
+    escdf_direction_type dirarr[3];
+    double lattice[9];
+    unsigned int i;
+
+    for (i = 0; i < 9; i++) {
+        lattice[i] = 0.;
+    }
+    for (i = 0; i < 3; i++) {
+        lattice[i * 3 + i] = 5.;
+        dirarr[i] = ESCDF_DIRECTION_PERIODIC;
+    }
+
+    scalarfield = escdf_grid_scalarfield_new(NULL);
+    escdf_grid_scalarfield_set_number_of_physical_dimensions(scalarfield, 3);
+    escdf_grid_scalarfield_set_dimension_types(scalarfield, dirarr, 3);
+    escdf_grid_scalarfield_set_lattice_vectors(scalarfield, lattice, 9);
+    escdf_grid_scalarfield_set_number_of_grid_points(scalarfield, data->fgrid, 3);
+    escdf_grid_scalarfield_set_number_of_components(scalarfield, params->ncomp);
+    escdf_grid_scalarfield_set_real_or_complex(scalarfield, params->real_or_complex);
+    escdf_grid_scalarfield_set_use_default_ordering
+        (scalarfield, params->ordering == BENCH_ORDERING_DEFAULT);
+    escdf_grid_scalarfield_set_chunk_size(scalarfield, params->chunk_size);
+    escdf_grid_scalarfield_set_deflate_level(scalarfield, params->deflate_level);
+
+    return scalarfield;
+}
+
+static escdf_errno_t _write(const bench_params_t *params, const bench_data_t *data,
+                            const escdf_grid_scalarfield_t *scalarfield)
+{
+    escdf_handle_t *file_id;
+    escdf_errno_t err;
+
+    if ((file_id = _open(params, data, 1)) == NULL)
+        return ESCDF_ERROR;
+    err = escdf_grid_scalarfield_write_metadata(scalarfield, file_id);
+    if (err == ESCDF_SUCCESS && params->direct) {
+        err = escdf_grid_scalarfield_write_values_on_grid_chunks
+            (scalarfield, file_id, data->dens, data->start, data->len);
+    } else if (err == ESCDF_SUCCESS) {
+        err = escdf_grid_scalarfield_write_values_on_grid_sliced
+            (scalarfield, file_id, data->dens, data->tbl, data->len);
+    }
+    escdf_close(file_id);
+
+    return err;
+}
+
+static escdf_errno_t _read(const bench_params_t *params, bench_data_t *data)
+{
+    escdf_handle_t *file_id;
+    escdf_grid_scalarfield_t *scalarfield;
+    escdf_errno_t err;
+
+    if ((file_id = _open(params, data, 0)) == NULL)
+        return ESCDF_ERROR;
+    scalarfield = escdf_grid_scalarfield_new(NULL);
+    err = escdf_grid_scalarfield_read_metadata(scalarfield, file_id);
+    if (err == ESCDF_SUCCESS && params->direct) {
+        err = escdf_grid_scalarfield_read_values_on_grid_chunks
+            (scalarfield, file_id, data->back, data->start, data->len);
+    } else if (err == ESCDF_SUCCESS) {
+        err = escdf_grid_scalarfield_read_values_on_grid_sliced
+            (scalarfield, file_id, data->back, data->tbl, data->len);
+    }
+    escdf_grid_scalarfield_free(scalarfield);
+    escdf_close(file_id);
+
+    return err;
+}
+
+int main(int argc, char **argv)
+{
+    bench_params_t params;
+    bench_data_t data;
+    escdf_grid_scalarfield_t *scalarfield;
+    escdf_errno_t err;
+    bench_summary_t write, read;
+    double *wsamples, *rsamples, t0, bytes;
+    unsigned int i, n;
+    int ret, ok;
+    size_t k;
+    FILE *f;
+
+#ifdef HAVE_MPI
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &data.iproc);
+    MPI_Comm_size(MPI_COMM_WORLD, &data.nproc);
+#else
+    data.iproc = 0;
+    data.nproc = 1;
+#endif
+
+    ret = _parse_args(argc, argv, &params);
+    if (ret != 0) {
+        if (data.iproc == 0)
+            _usage((ret < 0) ? stderr : stdout, argv[0]);
+#ifdef HAVE_MPI
+        MPI_Finalize();
+#endif
+        return (ret < 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    ok = _all_true(_setup_data(&params, &data) == 0);
+    if (!ok) {
+        if (data.iproc == 0)
+            fprintf(stderr, "escdf-bench: cannot set up the data (too many ranks?)\n");
+#ifdef HAVE_MPI
+        MPI_Finalize();
+#endif
+        return EXIT_FAILURE;
+    }
+    bytes = sizeof(double) * (double)params.grid[0] * params.grid[1] * params.grid[2] *
+        params.ncomp * params.real_or_complex;
+
+    scalarfield = _new_scalarfield(&params, &data);
+    wsamples = malloc(sizeof(double) * params.repeat);
+    rsamples = malloc(sizeof(double) * params.repeat);
+
+    /* Write, then read back, warmup + repeat times. */
+    err = ESCDF_SUCCESS;
+    for (i = 0, n = 0; i < params.warmup + params.repeat && err == ESCDF_SUCCESS; i++) {
+        _barrier();
+        t0 = _wtime();
+        err = _write(&params, &data, scalarfield);
+        t0 = _max_time(_wtime() - t0);
+        if (i >= params.warmup)
+            wsamples[n] = t0;
+        if (!_all_true(err == ESCDF_SUCCESS))
+            break;
+
+        _barrier();
+        t0 = _wtime();
+        err = _read(&params, &data);
+        t0 = _max_time(_wtime() - t0);
+        if (i >= params.warmup)
+            rsamples[n++] = t0;
+        if (!_all_true(err == ESCDF_SUCCESS))
+            break;
+    }
+    if (!_all_true(err == ESCDF_SUCCESS)) {
+        escdf_error_flush(stderr);
+        ret = EXIT_FAILURE;
+        goto cleanup;
+    }
+
+    /* Check the last read. */
+    ok = 1;
+    for (k = 0; k < data.nvals; k++) {
+        ok = ok && (data.back[k] == data.dens[k]);
+    }
+    ok = _all_true(ok);
+
+    if (data.iproc == 0) {
+        _summarise(wsamples, n, &write);
+        _summarise(rsamples, n, &read);
+        f = (params.output) ? fopen(params.output, "w") : stdout;
+        if (f == NULL) {
+            fprintf(stderr, "escdf-bench: cannot open %s\n", params.output);
+            ret = EXIT_FAILURE;
+        } else {
+            _report(f, &params, &data, bytes, &write, &read, ok);
+            if (f != stdout)
+                fclose(f);
+            ret = (ok) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    } else {
+        ret = (ok) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+  cleanup:
+    if (!params.keep && (params.file_mode == BENCH_FILE_PER_RANK || data.iproc == 0))
+        unlink(data.filename);
+    free(wsamples);
+    free(rsamples);
+    escdf_grid_scalarfield_free(scalarfield);
+    _free_data(&data);
+
+#ifdef HAVE_MPI
+    MPI_Finalize();
+#endif
+
+    return ret;
+}
@@ -0,0 +1,573 @@
+/*  -*- c-basic-offset: 4 -*- */
+/*
+  Copyright (C) 2016 D. Caliste
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+/**
+ * @file escdf_bench_metadata.c
+ * @brief scaling benchmark of the metadata operations
+ *
+ * For each requested number of groups N, rank 0 writes a file holding N
+ * grid scalarfield groups and N geometry groups, with their metadata
+ * attributes. All the ranks then open the file, read the metadata of every
+ * group and close the file, several times. The timings of each phase (the
+ * slowest rank of each repetition) are reported as JSON, one entry per N,
+ * so that running with increasing N and increasing number of ranks gives
+ * the scaling curves. The default parameters are small enough for
+ * "make check". Run with --help for the list of parameters.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "escdf_error.h"
+#include "escdf_handle.h"
+#include "escdf_geometry.h"
+#include "escdf_grid_scalarfields.h"
+#include "escdf_info.h"
+
+#define BENCH_MAX_SERIES 32
+
+typedef enum {
+    BENCH_PHASE_OPEN = 0,
+    BENCH_PHASE_SCALARFIELDS,
+    BENCH_PHASE_GEOMETRIES,
+    BENCH_PHASE_CLOSE,
+    BENCH_N_PHASES
+} bench_phase;
+
+static const char *bench_phase_names[] = {"open", "scalarfields", "geometries", "close"};
+
+typedef struct {
+    unsigned int groups[BENCH_MAX_SERIES];
+    unsigned int nseries;
+    unsigned int repeat;
+    int packed;
+    const char *root;
+    const char *prefix;
+    const char *output;
+    int keep;
+} bench_params_t;
+
+typedef struct {
+    double min, median, max;
+} bench_summary_t;
+
+typedef struct {
+    unsigned int groups;
+    bench_summary_t phases[BENCH_N_PHASES];
+    int verified;
+} bench_series_t;
+
+static const unsigned int bench_grid[3] = {4, 4, 4};
+
+
+/******************************************************************************
+ * Command line                                                               *
+ ******************************************************************************/
+
+static void _usage(FILE *f, const char *prog)
+{
+    fprintf(f,
+            "Usage: %s [OPTIONS]\n"
+            "\n"
+            "Time the opening, metadata reading and closing of files with\n"
+            "a growing number of groups, and report timings as JSON.\n"
+            "\n"
+            "  -n, --groups=N[,N...]      numbers of groups (default 1,4,16)\n"
+            "  -r, --repeat=N             number of timed repetitions (default 3)\n"
+            "  -P, --packed               write the scalarfield metadata packed\n"
+            "  -R, --root=PATH            group holding the data (default runs/0000)\n"
+            "  -p, --prefix=NAME          prefix of the HDF5 file (default escdf-bench-metadata)\n"
+            "  -O, --output=FILE          write the JSON report to FILE (default stdout)\n"
+            "      --keep                 do not remove the HDF5 file\n"
+            "  -h, --help                 show this help\n", prog);
+}
+
+static int _parse_groups(const char *arg, bench_params_t *params)
+{
+    char *end;
+    unsigned long n;
+
+    params->nseries = 0;
+    do {
+        n = strtoul(arg, &end, 10);
+        if (end == arg || n < 1 || n > 100000 || params->nseries == BENCH_MAX_SERIES)
+            return -1;
+        params->groups[params->nseries++] = (unsigned int)n;
+        arg = end + 1;
+    } while (*end == ',');
+
+    return (*end == '\0') ? 0 : -1;
+}
+
+static int _parse_args(int argc, char **argv, bench_params_t *params)
+{
+    static struct option options[] = {
+        {"groups", required_argument, NULL, 'n'},
+        {"repeat", required_argument, NULL, 'r'},
+        {"packed", no_argument, NULL, 'P'},
+        {"root", required_argument, NULL, 'R'},
+        {"prefix", required_argument, NULL, 'p'},
+        {"output", required_argument, NULL, 'O'},
+        {"keep", no_argument, NULL, 'K'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    int c, val;
+
+    _parse_groups("1,4,16", params);
+    params->repeat = 3;
+    params->packed = 0;
+    params->root = "runs/0000";
+    params->prefix = "escdf-bench-metadata";
+    params->output = NULL;
+    params->keep = 0;
+
+    while ((c = getopt_long(argc, argv, "n:r:PR:p:O:h", options, NULL)) != -1) {
+        switch (c) {
+        case 'n':
+            if (_parse_groups(optarg, params) < 0)
+                return -1;
+            break;
+        case 'r':
+            val = atoi(optarg);
+            if (val < 1)
+                return -1;
+            params->repeat = (unsigned int)val;
+            break;
+        case 'P':
+            params->packed = 1;
+            break;
+        case 'R':
+            params->root = optarg;
+            break;
+        case 'p':
+            params->prefix = optarg;
+            break;
+        case 'O':
+            params->output = optarg;
+            break;
+        case 'K':
+            params->keep = 1;
+            break;
+        case 'h':
+            return 1;
+        default:
+            return -1;
+        }
+    }
+
+    return (optind == argc) ? 0 : -1;
+}
+
+
+/******************************************************************************
+ * Timings                                                                    *
+ ******************************************************************************/
+
+static double _wtime(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + 1e-9 * (double)ts.tv_nsec;
+}
+
+static void _barrier(void)
+{
+#ifdef HAVE_MPI
+    MPI_Barrier(MPI_COMM_WORLD);
+#endif
+}
+
+/* Time of the slowest rank, on rank 0. */
+static double _max_time(double t)
+{
+#ifdef HAVE_MPI
+    double tmax;
+
+    MPI_Reduce(&t, &tmax, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    return tmax;
+#else
+    return t;
+#endif
+}
+
+static int _all_true(int ok)
+{
+#ifdef HAVE_MPI
+    int all;
+
+    MPI_Allreduce(&ok, &all, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+    return all;
+#else
+    return ok;
+#endif
+}
+
+static int _compare(const void *a, const void *b)
+{
+    double da = *(const double*)a, db = *(const double*)b;
+
+    return (da > db) - (da < db);
+}
+
+static void _summarise(double *samples, unsigned int n, bench_summary_t *summary)
+{
+    qsort(samples, n, sizeof(double), _compare);
+    summary->min = samples[0];
+    summary->max = samples[n - 1];
+    summary->median = (n % 2) ? samples[n / 2] :
+        0.5 * (samples[n / 2 - 1] + samples[n / 2]);
+}
+
+static void _report(FILE *f, const bench_params_t *params, int nproc,
+                    const bench_series_t *series)
+{
+    int major, minor, micro;
+    unsigned int i, j;
+    const bench_summary_t *s;
+
+    escdf_info_version(&major, &minor, &micro);
+
+    fprintf(f, "{\n");
+    fprintf(f, "  \"benchmark\": \"metadata\",\n");
+    fprintf(f, "  \"version\": \"%d.%d.%d\",\n", major, minor, micro);
+    fprintf(f, "  \"ranks\": %d,\n", nproc);
+    fprintf(f, "  \"parameters\": {\n");
+    fprintf(f, "    \"root\": \"%s\",\n", params->root);
+    fprintf(f, "    \"packed\": %s,\n", (params->packed) ? "true" : "false");
+    fprintf(f, "    \"repeat\": %u\n", params->repeat);
+    fprintf(f, "  },\n");
+    fprintf(f, "  \"series\": [\n");
+    for (i = 0; i < params->nseries; i++) {
+        fprintf(f, "    {\n");
+        fprintf(f, "      \"groups\": %u,\n", series[i].groups);
+        for (j = 0; j < BENCH_N_PHASES; j++) {
+            s = series[i].phases + j;
+            fprintf(f, "      \"%s_s\": {\"min\": %.6g, \"median\": %.6g, \"max\": %.6g},\n",
+                    bench_phase_names[j], s->min, s->median, s->max);
+        }
+        fprintf(f, "      \"per_group_us\": {\"scalarfields\": %.6g, \"geometries\": %.6g},\n",
+                1e6 * series[i].phases[BENCH_PHASE_SCALARFIELDS].median / series[i].groups,
+                1e6 * series[i].phases[BENCH_PHASE_GEOMETRIES].median / series[i].groups);
+        fprintf(f, "      \"verified\": %s\n", (series[i].verified) ? "true" : "false");
+        fprintf(f, "    }%s\n", (i + 1 < params->nseries) ? "," : "");
+    }
+    fprintf(f, "  ]\n");
+    fprintf(f, "}\n");
+}
+
+
+/******************************************************************************
+ * Benchmark                                                                  *
+ ******************************************************************************/
+
+static void _scalarfield_path(char *path, size_t len, unsigned int i)
+{
+    snprintf(path, len, "field_%05u", i);
+}
+
+static void _geometry_name(char *name, size_t len, unsigned int i)
+{
+    snprintf(name, len, "geometry_%05u", i);
+}
+
+static escdf_errno_t _write_scalarfield(const bench_params_t *params,
+                                        escdf_handle_t *file_id, unsigned int i)
+{
+    escdf_grid_scalarfield_t *scalarfield;
+    escdf_direction_type dirarr[3];
+    double lattice[9];
+    char path[32];
+    unsigned int k;
+    escdf_errno_t err;
+
+    for (k = 0; k < 9; k++) {
+        lattice[k] = 0.;
+    }
+    for (k = 0; k < 3; k++) {
+        lattice[k * 3 + k] = 5.;
+        dirarr[k] = ESCDF_DIRECTION_PERIODIC;
+    }
+
+    _scalarfield_path(path, sizeof(path), i);
+    scalarfield = escdf_grid_scalarfield_new(path);
+    escdf_grid_scalarfield_set_number_of_physical_dimensions(scalarfield, 3);
+    escdf_grid_scalarfield_set_dimension_types(scalarfield, dirarr, 3);
+    escdf_grid_scalarfield_set_lattice_vectors(scalarfield, lattice, 9);
+    escdf_grid_scalarfield_set_number_of_grid_points(scalarfield, bench_grid, 3);
+    escdf_grid_scalarfield_set_number_of_components(scalarfield, 1 + i % 2);
+    escdf_grid_scalarfield_set_real_or_complex(scalarfield, ESCDF_REAL);
+    escdf_grid_scalarfield_set_use_default_ordering(scalarfield, true);
+    escdf_grid_scalarfield_set_packed_metadata(scalarfield, params->packed);
+    err = escdf_grid_scalarfield_write_metadata(scalarfield, file_id);
+    escdf_grid_scalarfield_free(scalarfield);
+
+    return err;
+}
+
+static escdf_errno_t _write_geometry(escdf_handle_t *file_id, unsigned int i)
+{
+    escdf_geometry_t *geometry;
+    int dimension_types[3] = {1, 1, 1};
+    char name[32];
+    escdf_errno_t err;
+
+    _geometry_name(name, sizeof(name), i);
+    if ((geometry = escdf_geometry_new(file_id, name)) == NULL)
+        return ESCDF_ERROR;
+    escdf_geometry_set_number_of_physical_dimensions(geometry, 3);
+    escdf_geometry_set_dimension_types(geometry, dimension_types, 3);
+    escdf_geometry_set_embedded_system(geometry, false);
+    escdf_geometry_set_number_of_species(geometry, 1 + i % 4);
+    escdf_geometry_set_number_of_sites(geometry, 1 + i % 64);
+    escdf_geometry_set_absolute_or_reduced_coordinates(geometry, 1);
+    escdf_geometry_set_number_of_symmetry_operations(geometry, 1);
+    err = escdf_geometry_write_metadata(geometry);
+    escdf_geometry_free(geometry);
+
+    return err;
+}
+
+static escdf_errno_t _create_file(const bench_params_t *params, const char *filename,
+                                  unsigned int ngroups)
+{
+    escdf_handle_t *file_id;
+    escdf_errno_t err;
+    unsigned int i;
+
+    if ((file_id = escdf_create(filename, params->root)) == NULL)
+        return ESCDF_ERROR;
+    err = ESCDF_SUCCESS;
+    for (i = 0; i < ngroups && err == ESCDF_SUCCESS; i++) {
+        err = _write_scalarfield(params, file_id, i);
+        if (err == ESCDF_SUCCESS)
+            err = _write_geometry(file_id, i);
+    }
+    escdf_close(file_id);
+
+    return err;
+}
+
+static escdf_handle_t * _open(const bench_params_t *params, const char *filename)
+{
+#ifdef HAVE_MPI
+    return escdf_open_mpi(filename, params->root, MPI_COMM_WORLD);
+#else
+    return escdf_open(filename, params->root);
+#endif
+}
+
+static escdf_errno_t _read_scalarfields(escdf_handle_t *file_id, unsigned int ngroups,
+                                        int *ok)
+{
+    escdf_grid_scalarfield_t *scalarfield;
+    char path[32];
+    unsigned int i, grid[3];
+    escdf_errno_t err;
+
+    err = ESCDF_SUCCESS;
+    for (i = 0; i < ngroups && err == ESCDF_SUCCESS; i++) {
+        _scalarfield_path(path, sizeof(path), i);
+        scalarfield = escdf_grid_scalarfield_new(path);
+        err = escdf_grid_scalarfield_read_metadata(scalarfield, file_id);
+        if (err == ESCDF_SUCCESS) {
+            escdf_grid_scalarfield_get_number_of_grid_points(scalarfield, grid, 3);
+            *ok = *ok && grid[0] == bench_grid[0] && grid[1] == bench_grid[1] &&
+                grid[2] == bench_grid[2] &&
+                escdf_grid_scalarfield_get_number_of_components(scalarfield) == 1 + i % 2;
+        }
+        escdf_grid_scalarfield_free(scalarfield);
+    }
+
+    return err;
+}
+
+static escdf_errno_t _read_geometries(escdf_handle_t *file_id, unsigned int ngroups,
+                                      int *ok)
+{
+    escdf_geometry_t *geometry;
+    char name[32];
+    unsigned int i;
+    escdf_errno_t err;
+
+    err = ESCDF_SUCCESS;
+    for (i = 0; i < ngroups && err == ESCDF_SUCCESS; i++) {
+        _geometry_name(name, sizeof(name), i);
+        if ((geometry = escdf_geometry_new(file_id, name)) == NULL)
+            return ESCDF_ERROR;
+        err = escdf_geometry_read_metadata(geometry);
+        if (err == ESCDF_SUCCESS) {
+            *ok = *ok &&
+                escdf_geometry_get_number_of_species(geometry) == (int)(1 + i % 4) &&
+                escdf_geometry_get_number_of_sites(geometry) == (int)(1 + i % 64);
+        }
+        escdf_geometry_free(geometry);
+    }
+
+    return err;
+}
+
+/* Open, read all the metadata and close, timing each phase. */
+static escdf_errno_t _run(const bench_params_t *params, const char *filename,
+                          unsigned int ngroups, double *times, int *ok)
+{
+    escdf_handle_t *file_id;
+    escdf_errno_t err;
+    double t0;
+
+    _barrier();
+    t0 = _wtime();
+    file_id = _open(params, filename);
+    times[BENCH_PHASE_OPEN] = _max_time(_wtime() - t0);
+    if (!_all_true(file_id != NULL)) {
+        if (file_id != NULL)
+            escdf_close(file_id);
+        return ESCDF_ERROR;
+    }
+
+    _barrier();
+    t0 = _wtime();
+    err = _read_scalarfields(file_id, ngroups, ok);
+    times[BENCH_PHASE_SCALARFIELDS] = _max_time(_wtime() - t0);
+
+    _barrier();
+    t0 = _wtime();
+    if (err == ESCDF_SUCCESS)
+        err = _read_geometries(file_id, ngroups, ok);
+    times[BENCH_PHASE_GEOMETRIES] = _max_time(_wtime() - t0);
+
+    _barrier();
+    t0 = _wtime();
+    escdf_close(file_id);
+    times[BENCH_PHASE_CLOSE] = _max_time(_wtime() - t0);
+
+    return err;
+}
+
+int main(int argc, char **argv)
+{
+    bench_params_t params;
+    bench_series_t series[BENCH_MAX_SERIES];
+    escdf_errno_t err;
+    double *samples, times[BENCH_N_PHASES];
+    unsigned int i, j, k;
+    int iproc, nproc, ret, ok;
+    char *filename;
+    size_t size;
+    FILE *f;
+
+#ifdef HAVE_MPI
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &iproc);
+    MPI_Comm_size(MPI_COMM_WORLD, &nproc);
+#else
+    iproc = 0;
+    nproc = 1;
+#endif
+
+    ret = _parse_args(argc, argv, &params);
+    if (ret != 0) {
+        if (iproc == 0)
+            _usage((ret < 0) ? stderr : stdout, argv[0]);
+#ifdef HAVE_MPI
+        MPI_Finalize();
+#endif
+        return (ret < 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    size = strlen(params.prefix) + 4;
+    filename = malloc(size);
+    snprintf(filename, size, "%s.h5", params.prefix);
+    samples = malloc(sizeof(double) * BENCH_N_PHASES * params.repeat);
+
+    err = ESCDF_SUCCESS;
+    for (i = 0; i < params.nseries && err == ESCDF_SUCCESS; i++) {
+        series[i].groups = params.groups[i];
+
+        /* The file is written once, by a single rank. */
+        if (iproc == 0)
+            err = _create_file(&params, filename, params.groups[i]);
+        if (!_all_true(err == ESCDF_SUCCESS)) {
+            err = ESCDF_ERROR;
+            break;
+        }
+
+        ok = 1;
+        for (j = 0; j < params.repeat && err == ESCDF_SUCCESS; j++) {
+            err = _run(&params, filename, params.groups[i], times, &ok);
+            for (k = 0; k < BENCH_N_PHASES; k++) {
+                samples[k * params.repeat + j] = times[k];
+            }
+            if (!_all_true(err == ESCDF_SUCCESS))
+                err = ESCDF_ERROR;
+        }
+        series[i].verified = _all_true(ok);
+
+        if (err == ESCDF_SUCCESS && iproc == 0) {
+            for (k = 0; k < BENCH_N_PHASES; k++) {
+                _summarise(samples + k * params.repeat, params.repeat, series[i].phases + k);
+            }
+        }
+    }
+    if (err != ESCDF_SUCCESS) {
+        escdf_error_flush(stderr);
+        ret = EXIT_FAILURE;
+        goto cleanup;
+    }
+
+    ok = 1;
+    for (i = 0; i < params.nseries; i++) {
+        ok = ok && series[i].verified;
+    }
+    ret = (ok) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    if (iproc == 0) {
+        f = (params.output) ? fopen(params.output, "w") : stdout;
+        if (f == NULL) {
+            fprintf(stderr, "escdf-bench-metadata: cannot open %s\n", params.output);
+            ret = EXIT_FAILURE;
+        } else {
+            _report(f, &params, nproc, series);
+            if (f != stdout)
+                fclose(f);
+        }
+    }
+
+  cleanup:
+    if (!params.keep && iproc == 0)
+        unlink(filename);
+    free(samples);
+    free(filename);
+
+#ifdef HAVE_MPI
+    MPI_Finalize();
+#endif
+
+    return ret;
+}
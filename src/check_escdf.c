@@ -32,7 +32,10 @@ int main(void)
     srunner_add_suite(sr, make_error_suite());
     srunner_add_suite(sr, make_utils_suite());
     srunner_add_suite(sr, make_handle_suite());
+    srunner_add_suite(sr, make_geometry_suite());
     srunner_add_suite(sr, make_grid_scalarfield_suite());
+    srunner_add_suite(sr, make_densities_suite());
+    srunner_add_suite(sr, make_stats_suite());
 
     srunner_run_all(sr, CK_VERBOSE);
     number_failed = srunner_ntests_failed(sr);
@@ -29,6 +29,9 @@ Suite *make_info_suite(void);
 Suite *make_error_suite(void);
 Suite *make_utils_suite(void);
 Suite *make_handle_suite(void);
+Suite *make_geometry_suite(void);
+Suite *make_densities_suite(void);
 Suite *make_grid_scalarfield_suite(void);
+Suite *make_stats_suite(void);
 
 #endif
@@ -0,0 +1,310 @@
+/*
+ Copyright (C) 2016 D. Caliste, F. Corsetti, M. Oliveira, Y. Pouillon, and D. Strubbe
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+/**
+ * @file check_escdf_densities.c
+ * @brief checks escdf_densities.c and escdf_densities.h
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <check.h>
+
+#include "escdf_densities.h"
+#include "escdf_stats.h"
+
+#if defined HAVE_CONFIG_H
+#include "config.h"
+#else
+#define ESCDF_CHK_DATADIR "."
+#endif
+
+#define FILE_DENSITIES "tmp_densities.h5"
+
+static void write_density(escdf_handle_t *file_id, const char *path)
+{
+    escdf_grid_scalarfield_t *scalarfield;
+    escdf_direction_type dirarr[1] = {ESCDF_DIRECTION_PERIODIC};
+    unsigned int npoints = 8;
+    double cell = 2.;
+
+    scalarfield = escdf_grid_scalarfield_new(path);
+    ck_assert(escdf_grid_scalarfield_set_number_of_physical_dimensions(scalarfield, 1) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_set_dimension_types(scalarfield, dirarr, 1) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_set_lattice_vectors(scalarfield, &cell, 1) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_set_number_of_grid_points(scalarfield, &npoints, 1) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_set_number_of_components(scalarfield, 1) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_set_real_or_complex(scalarfield, ESCDF_REAL) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_set_use_default_ordering(scalarfield, true) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_write_metadata(scalarfield, file_id) == ESCDF_SUCCESS);
+    escdf_grid_scalarfield_free(scalarfield);
+}
+
+/* Density of the species 1, vanishing at 2, and of the species 2, linear. */
+static double radial_density(int species, double r)
+{
+    if (species == 1) {
+        return (r <= 2.) ? exp(-r * r) : 0.;
+    }
+    return (r < 1.5) ? 1. - r / 1.5 : 0.;
+}
+
+static escdf_radial_densities_t* new_radial_densities(const char *path)
+{
+    escdf_radial_densities_t *radial;
+    double grid[201], values[201], linear_grid[2] = {0., 1.5}, linear_values[2] = {1., 0.};
+    int p;
+
+    for (p = 0; p < 201; p++) {
+        grid[p] = 0.01 * p;
+        values[p] = radial_density(1, grid[p]);
+    }
+    radial = escdf_radial_densities_new(path);
+    ck_assert(radial != NULL);
+    ck_assert(escdf_radial_densities_set_species(radial, 1, 201, grid, values, 0.) == ESCDF_ERANGE);
+    ck_assert(escdf_radial_densities_set_number_of_species(radial, 2) == ESCDF_SUCCESS);
+    ck_assert(escdf_radial_densities_set_species(radial, 1, 201, grid, values, 0.) == ESCDF_SUCCESS);
+    ck_assert(escdf_radial_densities_set_species(radial, 2, 2, linear_grid, linear_values, 0.) == ESCDF_SUCCESS);
+    ck_assert(escdf_radial_densities_set_species(radial, 3, 2, linear_grid, linear_values, 0.) == ESCDF_ERANGE);
+    ck_assert(escdf_radial_densities_set_species(radial, 2, 1, linear_grid, linear_values, 0.) == ESCDF_ERANGE);
+
+    return radial;
+}
+
+START_TEST(test_densities_read_metadata)
+{
+    escdf_handle_t *file_id;
+    escdf_densities_t *densities;
+    escdf_grid_scalarfield_t *scalarfield;
+
+    file_id = escdf_open(ESCDF_CHK_DATADIR "/grid_scalarfield_read.h5", NULL);
+    ck_assert(file_id != NULL);
+
+    densities = escdf_densities_new(NULL);
+    ck_assert(escdf_densities_get_number_of_densities(densities) == 0);
+    ck_assert(escdf_densities_read_metadata(densities, file_id) == ESCDF_SUCCESS);
+    ck_assert(escdf_densities_get_number_of_densities(densities) == 1);
+    ck_assert(strcmp(escdf_densities_get_name(densities, 0), "pseudo_density") == 0);
+    ck_assert(escdf_densities_get_type(densities, 0) == ESCDF_DENSITY_GRID_PSEUDO);
+    ck_assert(escdf_densities_get_type(densities, 1) == ESCDF_DENSITY_UNKNOWN);
+    ck_assert(escdf_densities_has_type(densities, ESCDF_DENSITY_GRID_PSEUDO));
+    ck_assert(!escdf_densities_has_type(densities, ESCDF_DENSITY_GRID_CORE));
+
+    scalarfield = escdf_densities_get_grid_scalarfield_from_type(densities, ESCDF_DENSITY_GRID_PSEUDO);
+    ck_assert(scalarfield != NULL);
+    ck_assert(escdf_grid_scalarfield_get_number_of_physical_dimensions(scalarfield) > 0);
+    ck_assert(escdf_densities_get_grid_scalarfield(densities, 0) == scalarfield);
+    ck_assert(escdf_densities_get_grid_scalarfield_from_type(densities, ESCDF_DENSITY_GRID_CORE) == NULL);
+    ck_assert(escdf_densities_get_grid_scalarfield(densities, 1) == NULL);
+
+    escdf_densities_free(densities);
+    escdf_close(file_id);
+}
+END_TEST
+
+START_TEST(test_densities_lazy)
+{
+    escdf_handle_t *file_id;
+    escdf_densities_t *densities;
+    escdf_grid_scalarfield_t *scalarfield;
+    escdf_stats_t stats;
+    hid_t gid;
+
+    file_id = escdf_create(FILE_DENSITIES, NULL);
+    ck_assert(file_id != NULL);
+    write_density(file_id, "densities/other_density");
+    write_density(file_id, "densities/core_density");
+    gid = H5Gcreate(file_id->group_id, "densities/atom_core_density",
+                    H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    ck_assert(gid >= 0);
+    H5Gclose(gid);
+    escdf_close(file_id);
+
+    file_id = escdf_open(FILE_DENSITIES, NULL);
+    ck_assert(file_id != NULL);
+    ck_assert(escdf_stats_enable(file_id, false) == ESCDF_SUCCESS);
+
+    /* The densities are listed by name, without reading their metadata. */
+    densities = escdf_densities_new("densities");
+    ck_assert(escdf_densities_read_metadata(densities, file_id) == ESCDF_SUCCESS);
+    ck_assert(escdf_stats_get(file_id, &stats) == ESCDF_SUCCESS);
+    ck_assert(stats.calls[ESCDF_STATS_READ_METADATA] == 1);
+    ck_assert(escdf_densities_get_number_of_densities(densities) == 3);
+    ck_assert(escdf_densities_get_type(densities, 0) == ESCDF_DENSITY_ATOM_CORE);
+    ck_assert(escdf_densities_get_type(densities, 1) == ESCDF_DENSITY_GRID_CORE);
+    ck_assert(escdf_densities_get_type(densities, 2) == ESCDF_DENSITY_UNKNOWN);
+
+    /* Loaded on first access only. */
+    scalarfield = escdf_densities_get_grid_scalarfield_from_type(densities, ESCDF_DENSITY_GRID_CORE);
+    ck_assert(scalarfield != NULL);
+    ck_assert(escdf_grid_scalarfield_get_number_of_physical_dimensions(scalarfield) == 1);
+    ck_assert(escdf_densities_get_grid_scalarfield(densities, 1) == scalarfield);
+    ck_assert(escdf_stats_get(file_id, &stats) == ESCDF_SUCCESS);
+    ck_assert(stats.calls[ESCDF_STATS_READ_METADATA] == 2);
+
+    /* Densities of unknown types are still on a grid, atom centered ones not. */
+    ck_assert(escdf_densities_get_grid_scalarfield(densities, 2) != NULL);
+    ck_assert(escdf_densities_get_grid_scalarfield(densities, 0) == NULL);
+    ck_assert(escdf_densities_get_grid_scalarfield_from_type(densities, ESCDF_DENSITY_ATOM_CORE) == NULL);
+
+    /* Reading again starts from scratch. */
+    ck_assert(escdf_densities_read_metadata(densities, file_id) == ESCDF_SUCCESS);
+    ck_assert(escdf_densities_get_number_of_densities(densities) == 3);
+
+    escdf_densities_free(densities);
+
+    densities = escdf_densities_new("no_densities");
+    ck_assert(escdf_densities_read_metadata(densities, file_id) != ESCDF_SUCCESS);
+    ck_assert(escdf_densities_get_number_of_densities(densities) == 0);
+    escdf_densities_free(densities);
+
+    escdf_close(file_id);
+}
+END_TEST
+
+START_TEST(test_densities_radial)
+{
+    escdf_handle_t *file_id;
+    escdf_densities_t *densities;
+    escdf_radial_densities_t *radial, *read;
+
+    file_id = escdf_create(FILE_DENSITIES, NULL);
+    ck_assert(file_id != NULL);
+    radial = new_radial_densities(NULL);
+    ck_assert(escdf_radial_densities_write(radial, file_id) == ESCDF_SUCCESS);
+    escdf_radial_densities_free(radial);
+    write_density(file_id, "densities/core_density");
+    escdf_close(file_id);
+
+    file_id = escdf_open(FILE_DENSITIES, NULL);
+    ck_assert(file_id != NULL);
+    densities = escdf_densities_new(NULL);
+    ck_assert(escdf_densities_read_metadata(densities, file_id) == ESCDF_SUCCESS);
+    ck_assert(escdf_densities_get_number_of_densities(densities) == 2);
+    ck_assert(escdf_densities_get_radial_densities(densities, 1) == NULL);
+    read = escdf_densities_get_radial_densities_from_type(densities, ESCDF_DENSITY_ATOM_CORE);
+    ck_assert(read != NULL);
+    ck_assert(escdf_densities_get_radial_densities(densities, 0) == read);
+    ck_assert(escdf_densities_get_grid_scalarfield(densities, 0) == NULL);
+
+    ck_assert(escdf_radial_densities_get_number_of_species(read) == 2);
+    ck_assert(escdf_radial_densities_get_number_of_radial_points(read, 1) == 201);
+    ck_assert(escdf_radial_densities_get_number_of_radial_points(read, 2) == 2);
+    ck_assert(escdf_radial_densities_get_cutoff_radius(read, 1) == 2.);
+    ck_assert(escdf_radial_densities_get_cutoff_radius(read, 2) == 1.5);
+    ck_assert(escdf_radial_densities_ptr_radial_grid(read, 1)[100] == 1.);
+    ck_assert(escdf_radial_densities_ptr_radial_values(read, 1)[100] == exp(-1.));
+    ck_assert(escdf_radial_densities_ptr_radial_values(read, 2)[0] == 1.);
+    ck_assert(escdf_radial_densities_ptr_radial_grid(read, 3) == NULL);
+
+    escdf_densities_free(densities);
+    escdf_close(file_id);
+}
+END_TEST
+
+START_TEST(test_densities_radial_projection)
+{
+    escdf_radial_densities_t *radial;
+    escdf_grid_scalarfield_t *scalarfield;
+    escdf_direction_type dirarr[3] = {ESCDF_DIRECTION_PERIODIC, ESCDF_DIRECTION_PERIODIC,
+                                      ESCDF_DIRECTION_PERIODIC};
+    double cell[9] = {4., 0., 0., 1., 4., 0., 0., 0.5, 5.};
+    double positions[6] = {0.1, 0.2, 0.3, 4.9, 3.9, 4.9};
+    int species[2] = {2, 1};
+    unsigned int ngrid[3] = {10, 11, 12};
+    double *values, *on_scalarfield, p[3], r[3], expected, error;
+    int i, j, k, a, n1, n2, n3, d;
+
+    radial = new_radial_densities(NULL);
+    values = malloc(sizeof(double) * 10 * 11 * 12);
+    on_scalarfield = malloc(sizeof(double) * 10 * 11 * 12);
+    ck_assert(escdf_radial_densities_project(radial, cell, ngrid, 2, positions, species,
+                                             values) == ESCDF_SUCCESS);
+
+    /* Direct sum over the periodic images. */
+    error = 0.;
+    for (k = 0; k < 12; k++) {
+        for (j = 0; j < 11; j++) {
+            for (i = 0; i < 10; i++) {
+                for (d = 0; d < 3; d++) {
+                    p[d] = i / 10. * cell[d] + j / 11. * cell[3 + d] + k / 12. * cell[6 + d];
+                }
+                expected = 0.;
+                for (a = 0; a < 2; a++) {
+                    for (n1 = -2; n1 <= 2; n1++) {
+                        for (n2 = -2; n2 <= 2; n2++) {
+                            for (n3 = -2; n3 <= 2; n3++) {
+                                for (d = 0; d < 3; d++) {
+                                    r[d] = p[d] - positions[3 * a + d] + n1 * cell[d] +
+                                        n2 * cell[3 + d] + n3 * cell[6 + d];
+                                }
+                                expected += radial_density(species[a],
+                                                           sqrt(r[0] * r[0] + r[1] * r[1] + r[2] * r[2]));
+                            }
+                        }
+                    }
+                }
+                error = fmax(error, fabs(values[i + 10 * (j + 11 * k)] - expected));
+            }
+        }
+    }
+    ck_assert(error < 1e-4);
+
+    scalarfield = escdf_grid_scalarfield_new(NULL);
+    ck_assert(escdf_radial_densities_project_on_scalarfield(radial, scalarfield, 2, positions, species,
+                                                            on_scalarfield) != ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_set_number_of_physical_dimensions(scalarfield, 3) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_set_dimension_types(scalarfield, dirarr, 3) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_set_lattice_vectors(scalarfield, cell, 9) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_set_number_of_grid_points(scalarfield, ngrid, 3) == ESCDF_SUCCESS);
+    ck_assert(escdf_radial_densities_project_on_scalarfield(radial, scalarfield, 2, positions, species,
+                                                            on_scalarfield) == ESCDF_SUCCESS);
+    ck_assert(memcmp(values, on_scalarfield, sizeof(double) * 10 * 11 * 12) == 0);
+
+    species[1] = 3;
+    ck_assert(escdf_radial_densities_project(radial, cell, ngrid, 2, positions, species,
+                                             values) == ESCDF_ERANGE);
+
+    escdf_grid_scalarfield_free(scalarfield);
+    free(values);
+    free(on_scalarfield);
+    escdf_radial_densities_free(radial);
+}
+END_TEST
+
+Suite * make_densities_suite(void)
+{
+    Suite *s;
+    TCase *tc_densities, *tc_radial;
+
+    s = suite_create("Densities");
+
+    tc_densities = tcase_create("Container");
+    tcase_add_test(tc_densities, test_densities_read_metadata);
+    tcase_add_test(tc_densities, test_densities_lazy);
+    suite_add_tcase(s, tc_densities);
+
+    tc_radial = tcase_create("Radial");
+    tcase_add_test(tc_radial, test_densities_radial);
+    tcase_add_test(tc_radial, test_densities_radial_projection);
+    suite_add_tcase(s, tc_radial);
+
+    return s;
+}
@@ -24,8 +24,17 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include <check.h>
 
+#if defined HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
 #include "escdf_error.h"
 
 static char *err_str;
@@ -154,11 +163,91 @@ START_TEST(test_error_get_last)
 }
 END_TEST
 
+START_TEST(test_error_pop)
+{
+  escdf_error_t error;
+
+  ck_assert(escdf_error_pop(&error) == ESCDF_SUCCESS);
+  ck_assert(escdf_error_add(ESCDF_EVALUE, "test_5_1.c", 511, "dummy51") == ESCDF_EVALUE);
+  ck_assert(escdf_error_add(ESCDF_ENOFILE, "test_5_2.c", 522, "dummy52") == ESCDF_ENOFILE);
+
+  ck_assert(escdf_error_pop(&error) == ESCDF_EVALUE);
+  ck_assert_int_eq(error.id, ESCDF_EVALUE);
+  ck_assert_int_eq(error.line, 511);
+  ck_assert_str_eq(error.filename, "test_5_1.c");
+  ck_assert_str_eq(error.routine, "dummy51");
+  ck_assert(escdf_error_len() == 1);
+
+  ck_assert(escdf_error_pop(NULL) == ESCDF_ENOFILE);
+  ck_assert(escdf_error_len() == 0);
+  ck_assert(escdf_error_get_last(NULL) == ESCDF_SUCCESS);
+}
+END_TEST
+
+START_TEST(test_error_overflow)
+{
+  int i;
+
+  for (i = 0; i < ESCDF_ERROR_CHAIN_SIZE + 2; i++) {
+    ck_assert(escdf_error_add((i < 2) ? ESCDF_ENOFILE : ESCDF_EVALUE,
+                              "test_6_1.c", i, "dummy61") != ESCDF_SUCCESS);
+  }
+  ck_assert_int_eq(escdf_error_len(), ESCDF_ERROR_CHAIN_SIZE);
+  ck_assert(escdf_error_add(ESCDF_ERROR, "test_6_2.c", 622, "dummy62") == ESCDF_ERROR);
+  ck_assert_int_eq(escdf_error_len(), ESCDF_ERROR_CHAIN_SIZE);
+
+  ck_assert(escdf_error_get_last(NULL) == ESCDF_ERROR);
+  ck_assert(escdf_error_get_last("dummy61") == ESCDF_EVALUE);
+
+  escdf_error_fetchall(&err_str);
+  ck_assert(strncmp(err_str, "libescdf: ERROR:\n"
+                    "  * 3 earlier error(s) dropped\n"
+                    "  * in test_6_1.c(dummy61):3:\n", 78) == 0);
+  free(err_str);
+  ck_assert(escdf_error_len() == 0);
+}
+END_TEST
+
+#ifdef HAVE_PTHREAD
+static void *error_thread(void *arg)
+{
+  int *len = (int*)arg;
+
+  escdf_error_add(ESCDF_ERROR, "test_5_2.c", 522, "dummy52");
+  escdf_error_add(ESCDF_ERROR, "test_5_3.c", 533, "dummy53");
+  *len = escdf_error_len();
+  escdf_error_free();
+
+  return NULL;
+}
+
+START_TEST(test_error_threads)
+{
+  pthread_t thread;
+  int len = 0;
+
+  ck_assert(escdf_error_add(ESCDF_EVALUE, "test_5_1.c", 511, "dummy51") == ESCDF_EVALUE);
+
+  ck_assert(pthread_create(&thread, NULL, error_thread, &len) == 0);
+  ck_assert(pthread_join(thread, NULL) == 0);
+
+  ck_assert_int_eq(len, 2);
+  ck_assert_int_eq(escdf_error_len(), 1);
+  ck_assert(escdf_error_get_last("dummy51") == ESCDF_EVALUE);
+  ck_assert(escdf_error_get_last("dummy52") == ESCDF_SUCCESS);
+}
+END_TEST
+#endif
+
 
 Suite * make_error_suite(void)
 {
   Suite *s;
   TCase *tc_fetch, *tc_empty, *tc_single, *tc_double, *tc_triple, *tc_last;
+  TCase *tc_pop, *tc_overflow;
+#ifdef HAVE_PTHREAD
+  TCase *tc_threads;
+#endif
 
   s = suite_create("Error");
 
@@ -192,5 +281,22 @@ Suite * make_error_suite(void)
   tcase_add_test(tc_last, test_error_get_last);
   suite_add_tcase(s, tc_last);
 
+  tc_pop = tcase_create("Pop");
+  tcase_add_checked_fixture(tc_pop, error_setup, error_teardown);
+  tcase_add_test(tc_pop, test_error_pop);
+  suite_add_tcase(s, tc_pop);
+
+  tc_overflow = tcase_create("Full chain");
+  tcase_add_checked_fixture(tc_overflow, error_setup, error_teardown);
+  tcase_add_test(tc_overflow, test_error_overflow);
+  suite_add_tcase(s, tc_overflow);
+
+#ifdef HAVE_PTHREAD
+  tc_threads = tcase_create("Per-thread chains");
+  tcase_add_checked_fixture(tc_threads, error_setup, error_teardown);
+  tcase_add_test(tc_threads, test_error_threads);
+  suite_add_tcase(s, tc_threads);
+#endif
+
   return s;
 }
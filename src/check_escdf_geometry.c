@@ -1,5 +1,22 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <math.h>
+#include <check.h>
+
 #include "escdf_geometry.h"
 #define FILE "check_escdf_geometry.h5"
+#define FILE_SITES "tmp_geometry_sites.h5"
+#define FILE_TRAJECTORY "tmp_geometry_trajectory.h5"
+#define FILE_QUANTISED "tmp_geometry_quantised.h5"
+#define FILE_DISTRIBUTED "tmp_geometry_distributed.h5"
+#define FILE_INDEX "tmp_geometry_index.h5"
+#define FILE_SORTED "tmp_geometry_sorted.h5"
+#define NGRID 8
+#define PRECISION 1e-6
+#define NSITES 5
+#define NFRAMES 10
+#define LARGE_SITES 200000
 
 void geometry_setup(void) {
 
@@ -8,7 +25,6 @@ void geometry_setup(void) {
     hid_t file_id, escdf_root_id, geom_root_id, silicon_geom_id;
     hid_t dataspace_id, attribute_id, dataset_id, string_len_3;
     hsize_t dims_1D, dims_2D[2];
-    herr_t status;
 
     /* set some data to write */
     uint number_of_physical_dimensions = 3;
@@ -47,44 +63,44 @@ void geometry_setup(void) {
     dataspace_id = H5Screate_simple(1, &dims_1D, NULL);
     attribute_id = H5Acreate2(silicon_geom_id, "number_of_physical_dimensions", H5T_NATIVE_UINT,
                               dataspace_id, H5P_DEFAULT, H5P_DEFAULT);
-    status = H5Awrite(attribute_id, H5T_NATIVE_UINT, &number_of_physical_dimensions);
+    H5Awrite(attribute_id, H5T_NATIVE_UINT, &number_of_physical_dimensions);
 
     /* --dimension_types */
     dims_1D = 3;
     dataspace_id = H5Screate_simple(1, &dims_1D, NULL);
     attribute_id = H5Acreate2(silicon_geom_id, "dimension_types", H5T_NATIVE_INT,
                               dataspace_id, H5P_DEFAULT, H5P_DEFAULT);
-    status = H5Awrite(attribute_id, H5T_NATIVE_INT, &dimension_types);
+    H5Awrite(attribute_id, H5T_NATIVE_INT, &dimension_types);
 
     /* --embedded_system */
     dims_1D = 1;
     dataspace_id = H5Screate_simple(1, &dims_1D, NULL);
     string_len_3 = H5Tcopy(H5T_C_S1);
-    status = H5Tset_size(string_len_3, 3);
+    H5Tset_size(string_len_3, 3);
     attribute_id = H5Acreate2(silicon_geom_id, "embedded_system", string_len_3,
                               dataspace_id, H5P_DEFAULT, H5P_DEFAULT);
-    status = H5Awrite(attribute_id, string_len_3, embedded_system);
+    H5Awrite(attribute_id, string_len_3, embedded_system);
 
     /* --number_of_physical_dimensions */
     dims_1D = 1;
     dataspace_id = H5Screate_simple(1, &dims_1D, NULL);
     attribute_id = H5Acreate2(silicon_geom_id, "number_of_species", H5T_NATIVE_UINT,
                               dataspace_id, H5P_DEFAULT, H5P_DEFAULT);
-    status = H5Awrite(attribute_id, H5T_NATIVE_UINT, &number_of_species);
+    H5Awrite(attribute_id, H5T_NATIVE_UINT, &number_of_species);
 
     /* --number_of_sites */
     dims_1D = 1;
     dataspace_id = H5Screate_simple(1, &dims_1D, NULL);
     attribute_id = H5Acreate2(silicon_geom_id, "number_of_sites", H5T_NATIVE_UINT,
                               dataspace_id, H5P_DEFAULT, H5P_DEFAULT);
-    status = H5Awrite(attribute_id, H5T_NATIVE_UINT, &number_of_sites);
+    H5Awrite(attribute_id, H5T_NATIVE_UINT, &number_of_sites);
 
     /* --absolute_or_reduced_coordinates */
     dims_1D = 1;
     dataspace_id = H5Screate_simple(1, &dims_1D, NULL);
     attribute_id = H5Acreate2(silicon_geom_id, "absolute_or_reduced_coordinates", H5T_NATIVE_INT,
                               dataspace_id, H5P_DEFAULT, H5P_DEFAULT);
-    status = H5Awrite(attribute_id, H5T_NATIVE_INT, &absolute_or_reduced_coordinates);
+    H5Awrite(attribute_id, H5T_NATIVE_INT, &absolute_or_reduced_coordinates);
 
     /* write datasets of the group: */
 
@@ -94,7 +110,7 @@ void geometry_setup(void) {
     dataspace_id = H5Screate_simple(2, dims_2D, NULL);
     dataset_id = H5Dcreate2(silicon_geom_id, "lattice_vectors", H5T_NATIVE_DOUBLE,
                             dataspace_id, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
-    status = H5Dwrite(dataset_id, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, &lattice_vectors);
+    H5Dwrite(dataset_id, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, &lattice_vectors);
 
     /* --site_positions */
     dims_2D[0] = 2;
@@ -102,7 +118,7 @@ void geometry_setup(void) {
     dataspace_id = H5Screate_simple(2, dims_2D, NULL);
     dataset_id = H5Dcreate2(silicon_geom_id, "site_positions", H5T_NATIVE_DOUBLE,
                             dataspace_id, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
-    status = H5Dwrite(dataset_id, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, &site_positions);
+    H5Dwrite(dataset_id, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, &site_positions);
 
     /* --species_at_sites */
     dims_2D[0] = 2;
@@ -110,24 +126,24 @@ void geometry_setup(void) {
     dataspace_id = H5Screate_simple(2, dims_2D, NULL);
     dataset_id = H5Dcreate2(silicon_geom_id, "species_at_sites", H5T_NATIVE_UINT,
                             dataspace_id, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
-    status = H5Dwrite(dataset_id, H5T_NATIVE_UINT, H5S_ALL, H5S_ALL, H5P_DEFAULT, &species_at_sites);
+    H5Dwrite(dataset_id, H5T_NATIVE_UINT, H5S_ALL, H5S_ALL, H5P_DEFAULT, &species_at_sites);
 
     /* --atomic_numbers */
     dims_1D = 1;
     dataspace_id = H5Screate_simple(1, &dims_1D, NULL);
     dataset_id = H5Dcreate2(silicon_geom_id, "atomic_numbers", H5T_NATIVE_DOUBLE,
                             dataspace_id, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
-    status = H5Dwrite(dataset_id, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, &atomic_numbers);
+    H5Dwrite(dataset_id, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, &atomic_numbers);
 
     /* close everything */
-    status = H5Tclose(string_len_3);
-    status = H5Dclose(dataset_id);
-    status = H5Aclose(attribute_id);
-    status = H5Sclose(dataspace_id);
-    status = H5Gclose(silicon_geom_id);
-    status = H5Gclose(geom_root_id);
-    status = H5Gclose(escdf_root_id);
-    status = H5Fclose(file_id);
+    H5Tclose(string_len_3);
+    H5Dclose(dataset_id);
+    H5Aclose(attribute_id);
+    H5Sclose(dataspace_id);
+    H5Gclose(silicon_geom_id);
+    H5Gclose(geom_root_id);
+    H5Gclose(escdf_root_id);
+    H5Fclose(file_id);
 }
 
 void geometry_teardown(void)
@@ -140,16 +156,505 @@ START_TEST(test_geometry_new)
     escdf_handle_t *handle;
     escdf_geometry_t *geometry;
 
-    ck_assert((handle = escdf_create(FILE, NULL)) != NULL);
+    ck_assert((handle = escdf_open(FILE, NULL)) != NULL);
     ck_assert((geometry = escdf_geometry_new(handle, ".")) != NULL);
     ck_assert(escdf_geometry_free(geometry) == ESCDF_SUCCESS);
+    ck_assert(escdf_close(handle) == ESCDF_SUCCESS);
+}
+END_TEST
+
+START_TEST(test_geometry_site_data)
+{
+    escdf_handle_t *handle;
+    escdf_geometry_t *geometry;
+    double positions[NSITES][3], records[NSITES][7], check[3 * NSITES];
+    int species[NSITES], species_check[3 * NSITES];
+    unsigned int start[2] = {1, 0}, count[2] = {3, 3}, map[2];
+    unsigned int i, j;
+
+    for (i = 0; i < NSITES; i++) {
+        species[i] = i % 2 + 1;
+        for (j = 0; j < 3; j++) {
+            positions[i][j] = i + 0.1 * j;
+        }
+        for (j = 0; j < 7; j++) {
+            records[i][j] = -1. * (i * 7 + j);
+        }
+    }
+
+    ck_assert((handle = escdf_create(FILE_SITES, NULL)) != NULL);
+    ck_assert((geometry = escdf_geometry_new(handle, "sites")) != NULL);
+    ck_assert(escdf_geometry_write_site_positions(geometry, positions[0], NULL, NULL, NULL) ==
+              ESCDF_EUNINIT);
+    ck_assert(escdf_geometry_set_number_of_physical_dimensions(geometry, 3) == ESCDF_SUCCESS);
+    ck_assert(escdf_geometry_set_number_of_sites(geometry, NSITES) == ESCDF_SUCCESS);
+
+    /* Contiguous, then forces stored in records of 7 values. */
+    ck_assert(escdf_geometry_write_site_positions(geometry, positions[0], NULL, NULL, NULL) ==
+              ESCDF_SUCCESS);
+    map[0] = 7;
+    map[1] = 1;
+    ck_assert(escdf_geometry_write_site_forces(geometry, records[0] + 2, NULL, NULL, map) ==
+              ESCDF_SUCCESS);
+    ck_assert(escdf_geometry_write_species_at_sites(geometry, species, NULL, NULL, NULL) ==
+              ESCDF_SUCCESS);
+
+    /* A slab of positions, transposed in memory. */
+    map[0] = 1;
+    map[1] = NSITES;
+    ck_assert(escdf_geometry_read_site_positions(geometry, check, start, count, map) ==
+              ESCDF_SUCCESS);
+    for (i = 0; i < count[0]; i++) {
+        for (j = 0; j < 3; j++) {
+            ck_assert(check[j * NSITES + i] == positions[start[0] + i][j]);
+        }
+    }
+    ck_assert(escdf_geometry_read_site_forces(geometry, check, NULL, NULL, NULL) ==
+              ESCDF_SUCCESS);
+    for (i = 0; i < NSITES * 3; i++) {
+        ck_assert(check[i] == records[i / 3][2 + i % 3]);
+    }
+
+    /* Every other integer. */
+    map[0] = 2;
+    map[1] = 1;
+    ck_assert(escdf_geometry_read_species_at_sites(geometry, species_check, NULL, NULL, map) ==
+              ESCDF_SUCCESS);
+    for (i = 0; i < NSITES; i++) {
+        ck_assert(species_check[2 * i] == species[i]);
+    }
+
+    /* A single column with a row stride: not contiguous. */
+    memset(species_check, 0, sizeof(species_check));
+    map[0] = 3;
+    map[1] = 3;
+    ck_assert(escdf_geometry_read_species_at_sites(geometry, species_check, NULL, NULL, map) ==
+              ESCDF_SUCCESS);
+    for (i = 0; i < NSITES; i++) {
+        ck_assert(species_check[3 * i] == species[i]);
+        ck_assert(species_check[3 * i + 1] == 0);
+    }
+
+    /* Out of the data set, or not written. */
+    count[0] = NSITES;
+    ck_assert(escdf_geometry_read_site_positions(geometry, check, start, count, NULL) ==
+              ESCDF_ERANGE);
+    start[0] = NSITES + 1;
+    ck_assert(escdf_geometry_read_site_positions(geometry, check, start, NULL, NULL) ==
+              ESCDF_ERANGE);
+    ck_assert(escdf_geometry_read_site_velocities(geometry, check, NULL, NULL, NULL) !=
+              ESCDF_SUCCESS);
+
+    ck_assert(escdf_geometry_free(geometry) == ESCDF_SUCCESS);
+    ck_assert(escdf_close(handle) == ESCDF_SUCCESS);
+}
+END_TEST
+
+START_TEST(test_geometry_trajectory)
+{
+    escdf_handle_t *handle;
+    escdf_geometry_t *geometry;
+    escdf_trajectory_t *trajectory;
+    double positions[NSITES * 3], cell[9], check[4 * NSITES * 3], times[4], *large;
+    hid_t dtset_id, dcpl_id;
+    hsize_t chunk[3];
+    unsigned int i, n;
+
+    ck_assert((handle = escdf_create(FILE_TRAJECTORY, NULL)) != NULL);
+    ck_assert((geometry = escdf_geometry_new(handle, "md")) != NULL);
+    ck_assert(escdf_geometry_set_number_of_physical_dimensions(geometry, 3) == ESCDF_SUCCESS);
+    ck_assert(escdf_geometry_set_number_of_sites(geometry, NSITES) == ESCDF_SUCCESS);
+
+    /* Frames are written 4 by 4, the last 2 at close. */
+    ck_assert((trajectory = escdf_geometry_open_trajectory
+               (geometry, (1 << ESCDF_TRAJECTORY_POSITIONS) |
+                (1 << ESCDF_TRAJECTORY_LATTICE_VECTORS), 4)) != NULL);
+    ck_assert(escdf_trajectory_has_field(trajectory, ESCDF_TRAJECTORY_POSITIONS));
+    ck_assert(!escdf_trajectory_has_field(trajectory, ESCDF_TRAJECTORY_FORCES));
+    ck_assert(escdf_trajectory_append(trajectory, 0., positions, NULL, NULL) == ESCDF_EVALUE);
+    for (n = 0; n < NFRAMES; n++) {
+        for (i = 0; i < NSITES * 3; i++) {
+            positions[i] = n * 100. + i;
+        }
+        for (i = 0; i < 9; i++) {
+            cell[i] = n + 0.5;
+        }
+        ck_assert(escdf_trajectory_append(trajectory, 0.25 * n, positions, cell, NULL) ==
+                  ESCDF_SUCCESS);
+    }
+    ck_assert(escdf_trajectory_get_number_of_frames(trajectory) == NFRAMES);
+    ck_assert(escdf_trajectory_close(trajectory) == ESCDF_SUCCESS);
+
+    /* Every 3rd frame, from an existing trajectory. */
+    ck_assert((trajectory = escdf_geometry_open_trajectory(geometry, 0, 2)) != NULL);
+    ck_assert(escdf_trajectory_get_number_of_frames(trajectory) == NFRAMES);
+    ck_assert(escdf_trajectory_has_field(trajectory, ESCDF_TRAJECTORY_LATTICE_VECTORS));
+    ck_assert(escdf_trajectory_read_frames(trajectory, ESCDF_TRAJECTORY_POSITIONS,
+                                           0, 4, 3, check) == ESCDF_SUCCESS);
+    for (n = 0; n < 4; n++) {
+        for (i = 0; i < NSITES * 3; i++) {
+            ck_assert(check[n * NSITES * 3 + i] == n * 300. + i);
+        }
+    }
+    ck_assert(escdf_trajectory_read_frames(trajectory, ESCDF_TRAJECTORY_TIMES,
+                                           1, 4, 3, times) == ESCDF_ERANGE);
+
+    /* Appended frames are read back, even when still buffered. */
+    ck_assert(escdf_trajectory_append(trajectory, 99., positions, cell, NULL) == ESCDF_SUCCESS);
+    ck_assert(escdf_trajectory_read_frames(trajectory, ESCDF_TRAJECTORY_TIMES,
+                                           NFRAMES - 2, 3, 1, times) == ESCDF_SUCCESS);
+    ck_assert(times[0] == 0.25 * (NFRAMES - 2) && times[1] == 0.25 * (NFRAMES - 1));
+    ck_assert(times[2] == 99.);
+    ck_assert(escdf_trajectory_read_frames(trajectory, ESCDF_TRAJECTORY_LATTICE_VECTORS,
+                                           NFRAMES, 1, 0, check) == ESCDF_SUCCESS);
+    ck_assert(check[8] == NFRAMES - 0.5);
+    ck_assert(escdf_trajectory_close(trajectory) == ESCDF_SUCCESS);
+    ck_assert(escdf_geometry_free(geometry) == ESCDF_SUCCESS);
+
+    /* Frames above the chunk bound are split along the sites. */
+    large = malloc(sizeof(double) * 2 * LARGE_SITES * 3);
+    for (i = 0; i < LARGE_SITES * 3; i++) {
+        large[i] = 0.5 * i;
+    }
+    ck_assert((geometry = escdf_geometry_new(handle, "large")) != NULL);
+    ck_assert(escdf_geometry_set_number_of_physical_dimensions(geometry, 3) == ESCDF_SUCCESS);
+    ck_assert(escdf_geometry_set_number_of_sites(geometry, LARGE_SITES) == ESCDF_SUCCESS);
+    ck_assert((trajectory = escdf_geometry_open_trajectory
+               (geometry, 1 << ESCDF_TRAJECTORY_POSITIONS, 4)) != NULL);
+    ck_assert(escdf_trajectory_append(trajectory, 0., large, NULL, NULL) == ESCDF_SUCCESS);
+    ck_assert(escdf_trajectory_flush(trajectory) == ESCDF_SUCCESS);
+    ck_assert(escdf_trajectory_read_frames(trajectory, ESCDF_TRAJECTORY_POSITIONS,
+                                           0, 1, 1, large + LARGE_SITES * 3) == ESCDF_SUCCESS);
+    for (i = 0; i < LARGE_SITES * 3; i++) {
+        ck_assert(large[LARGE_SITES * 3 + i] == large[i]);
+    }
+    ck_assert(escdf_trajectory_close(trajectory) == ESCDF_SUCCESS);
+    ck_assert((dtset_id = H5Dopen(handle->group_id, "geometries/large/trajectory/site_positions",
+                                  H5P_DEFAULT)) >= 0);
+    ck_assert((dcpl_id = H5Dget_create_plist(dtset_id)) >= 0);
+    ck_assert(H5Pget_chunk(dcpl_id, 3, chunk) == 3);
+    ck_assert(chunk[0] == 1 && chunk[1] < LARGE_SITES && chunk[2] == 3);
+    ck_assert(chunk[1] * chunk[2] * sizeof(double) <= 4 * 1024 * 1024);
+    H5Pclose(dcpl_id);
+    H5Dclose(dtset_id);
+    free(large);
+
+    ck_assert(escdf_geometry_free(geometry) == ESCDF_SUCCESS);
+    ck_assert(escdf_close(handle) == ESCDF_SUCCESS);
+}
+END_TEST
+
+START_TEST(test_geometry_site_distributed)
+{
+    escdf_handle_t *handle;
+    escdf_geometry_t *geometry;
+    double positions[NSITES * 3], check[NSITES * 3];
+    double lower[3] = {1., 0., 0.}, upper[3] = {3., 100., 100.};
+    int species[NSITES], species_check[NSITES];
+    unsigned int i, first, count, nsites, *sites;
+
+    ck_assert((handle = escdf_create(FILE_DISTRIBUTED, NULL)) != NULL);
+    ck_assert((geometry = escdf_geometry_new(handle, NULL)) != NULL);
+    ck_assert(escdf_geometry_get_site_block(geometry, &first, &count) == ESCDF_EUNINIT);
+    ck_assert(escdf_geometry_set_number_of_physical_dimensions(geometry, 3) == ESCDF_SUCCESS);
+    ck_assert(escdf_geometry_set_number_of_sites(geometry, NSITES) == ESCDF_SUCCESS);
+
+    /* A single rank owns all the sites. */
+    ck_assert(escdf_geometry_get_site_block(geometry, &first, &count) == ESCDF_SUCCESS);
+    ck_assert(first == 0 && count == NSITES);
+    for (i = 0; i < NSITES * 3; i++) {
+        positions[i] = (i % 3 == 0) ? i / 3 : 0.5 * i;
+    }
+    for (i = 0; i < NSITES; i++) {
+        species[i] = 10 + i;
+    }
+    ck_assert(escdf_geometry_write_site_data_distributed(geometry, ESCDF_SITE_POSITIONS,
+                                                         positions, NSITES - 1) == ESCDF_ESIZE);
+    ck_assert(escdf_geometry_write_site_data_distributed(geometry, ESCDF_SITE_POSITIONS,
+                                                         positions, NSITES) == ESCDF_SUCCESS);
+    ck_assert(escdf_geometry_write_site_data_distributed(geometry, ESCDF_SITE_SPECIES,
+                                                         species, NSITES) == ESCDF_SUCCESS);
+    ck_assert(escdf_geometry_read_site_data_distributed(geometry, ESCDF_SITE_POSITIONS,
+                                                        check) == ESCDF_SUCCESS);
+    for (i = 0; i < NSITES * 3; i++) {
+        ck_assert(check[i] == positions[i]);
+    }
+
+    /* Sites 1 and 2, by their first coordinate. */
+    ck_assert(escdf_geometry_find_sites_in_region(geometry, lower, upper,
+                                                  &sites, &nsites) == ESCDF_SUCCESS);
+    ck_assert(nsites == 2 && sites[0] == 1 && sites[1] == 2);
+    ck_assert(escdf_geometry_read_site_data_at(geometry, ESCDF_SITE_SPECIES,
+                                               sites, nsites, species_check) == ESCDF_SUCCESS);
+    ck_assert(species_check[0] == 11 && species_check[1] == 12);
+    ck_assert(escdf_geometry_read_site_data_at(geometry, ESCDF_SITE_POSITIONS,
+                                               sites, nsites, check) == ESCDF_SUCCESS);
+    for (i = 0; i < 6; i++) {
+        ck_assert(check[i] == positions[3 + i]);
+    }
+    free(sites);
+    sites = NULL;
+    ck_assert(escdf_geometry_read_site_data_at(geometry, ESCDF_SITE_SPECIES,
+                                               &nsites, 1, species_check) == ESCDF_SUCCESS);
+    ck_assert(species_check[0] == 12);
+    nsites = NSITES;
+    ck_assert(escdf_geometry_read_site_data_at(geometry, ESCDF_SITE_SPECIES,
+                                               &nsites, 1, species_check) == ESCDF_ERANGE);
+    ck_assert(escdf_geometry_read_site_data_at(geometry, ESCDF_SITE_VELOCITIES,
+                                               sites, 0, NULL) != ESCDF_SUCCESS);
+
+    ck_assert(escdf_geometry_free(geometry) == ESCDF_SUCCESS);
+    ck_assert(escdf_close(handle) == ESCDF_SUCCESS);
+}
+END_TEST
+
+START_TEST(test_geometry_site_index)
+{
+    escdf_handle_t *handle;
+    escdf_geometry_t *geometry;
+    double positions[NGRID * NGRID * NGRID * 3];
+    double lower[3] = {1.5, 2., -1.}, upper[3] = {3., 4., 0.5}, center[3] = {4., 4., 4.};
+    unsigned int ncells[3] = {3, 2, 4}, i, nsites, nscan, *sites, *scan;
+
+    ck_assert((handle = escdf_create(FILE_INDEX, NULL)) != NULL);
+    ck_assert((geometry = escdf_geometry_new(handle, NULL)) != NULL);
+    ck_assert(escdf_geometry_set_number_of_physical_dimensions(geometry, 3) == ESCDF_SUCCESS);
+    ck_assert(escdf_geometry_set_number_of_sites(geometry, NGRID * NGRID * NGRID) == ESCDF_SUCCESS);
+    /* A cubic lattice, site i at (i / 64, i / 8 % 8, i % 8). */
+    for (i = 0; i < NGRID * NGRID * NGRID; i++) {
+        positions[3 * i] = i / (NGRID * NGRID);
+        positions[3 * i + 1] = (i / NGRID) % NGRID;
+        positions[3 * i + 2] = i % NGRID;
+    }
+    ck_assert(escdf_geometry_write_site_positions(geometry, positions, NULL, NULL, NULL) ==
+              ESCDF_SUCCESS);
+    ck_assert(!escdf_geometry_has_site_index(geometry));
+    ck_assert(escdf_geometry_find_sites_within(geometry, center, 1.,
+                                               &scan, &nscan) == ESCDF_SUCCESS);
+    ck_assert(nscan == 7);
+
+    /* The same sites are found with the index, in the same order. */
+    ck_assert(escdf_geometry_write_site_index(geometry, ncells) == ESCDF_SUCCESS);
+    ck_assert(escdf_geometry_has_site_index(geometry));
+    ck_assert(escdf_geometry_find_sites_within(geometry, center, 1.,
+                                               &sites, &nsites) == ESCDF_SUCCESS);
+    ck_assert(nsites == nscan);
+    for (i = 0; i < nsites; i++) {
+        ck_assert(sites[i] == scan[i]);
+    }
+    free(sites);
+    free(scan);
+    ck_assert(escdf_geometry_find_sites_in_region(geometry, lower, upper,
+                                                  &sites, &nsites) == ESCDF_SUCCESS);
+    ck_assert(nsites == 2 && sites[0] == 2 * 64 + 2 * 8 && sites[1] == 2 * 64 + 3 * 8);
+    free(sites);
+    lower[0] = 10.;
+    upper[0] = 12.;
+    ck_assert(escdf_geometry_find_sites_in_region(geometry, lower, upper,
+                                                  &sites, &nsites) == ESCDF_SUCCESS);
+    ck_assert(nsites == 0 && sites == NULL);
+
+    /* With the default cells, and removed by a new write of the positions. */
+    ck_assert(escdf_geometry_write_site_index(geometry, NULL) == ESCDF_SUCCESS);
+    ck_assert(escdf_geometry_find_sites_within(geometry, center, 1.5,
+                                               &sites, &nsites) == ESCDF_SUCCESS);
+    ck_assert(nsites == 19);
+    free(sites);
+    ck_assert(escdf_geometry_write_site_positions(geometry, positions, NULL, NULL, NULL) ==
+              ESCDF_SUCCESS);
+    ck_assert(!escdf_geometry_has_site_index(geometry));
+
+    ck_assert(escdf_geometry_free(geometry) == ESCDF_SUCCESS);
+    ck_assert(escdf_close(handle) == ESCDF_SUCCESS);
+}
+END_TEST
+
+START_TEST(test_geometry_sort_sites)
+{
+    escdf_handle_t *handle;
+    escdf_geometry_t *geometry;
+    double positions[NGRID * NGRID * NGRID * 3], sorted[NGRID * NGRID * NGRID * 3];
+    double center[3] = {2., 2., 2.};
+    escdf_trajectory_t *trajectory;
+    int species[NGRID * NGRID * NGRID];
+    unsigned int permutation[NGRID * NGRID * NGRID], i, j, nsites, *sites;
+
+    ck_assert((handle = escdf_create(FILE_SORTED, NULL)) != NULL);
+    ck_assert((geometry = escdf_geometry_new(handle, NULL)) != NULL);
+    ck_assert(escdf_geometry_set_number_of_physical_dimensions(geometry, 3) == ESCDF_SUCCESS);
+    ck_assert(escdf_geometry_set_number_of_sites(geometry, NGRID * NGRID * NGRID) == ESCDF_SUCCESS);
+    /* The cubic lattice, in reverse order. */
+    for (i = 0; i < NGRID * NGRID * NGRID; i++) {
+        j = NGRID * NGRID * NGRID - 1 - i;
+        positions[3 * i] = j / (NGRID * NGRID);
+        positions[3 * i + 1] = (j / NGRID) % NGRID;
+        positions[3 * i + 2] = j % NGRID;
+        species[i] = i;
+    }
+    ck_assert(escdf_geometry_write_site_positions(geometry, positions, NULL, NULL, NULL) ==
+              ESCDF_SUCCESS);
+    ck_assert(escdf_geometry_write_species_at_sites(geometry, species, NULL, NULL, NULL) ==
+              ESCDF_SUCCESS);
+    ck_assert(escdf_geometry_read_site_permutation(geometry, permutation) == ESCDF_SUCCESS);
+    ck_assert(permutation[0] == 0 && permutation[NGRID - 1] == NGRID - 1);
+
+    ck_assert(escdf_geometry_sort_sites(geometry) == ESCDF_SUCCESS);
+    ck_assert(escdf_geometry_read_site_permutation(geometry, permutation) == ESCDF_SUCCESS);
+    ck_assert(escdf_geometry_read_site_positions(geometry, sorted, NULL, NULL, NULL) ==
+              ESCDF_SUCCESS);
+    ck_assert(escdf_geometry_read_species_at_sites(geometry, species, NULL, NULL, NULL) ==
+              ESCDF_SUCCESS);
+    for (i = 0; i < NGRID * NGRID * NGRID; i++) {
+        ck_assert(species[i] == (int)permutation[i]);
+        for (j = 0; j < 3; j++) {
+            ck_assert(sorted[3 * i + j] == positions[3 * permutation[i] + j]);
+        }
+    }
+    /* Along the curve, the first 8 sites make the first 2x2x2 cube. */
+    for (i = 0; i < 8; i++) {
+        ck_assert(sorted[3 * i] <= 1. && sorted[3 * i + 1] <= 1. && sorted[3 * i + 2] <= 1.);
+    }
+
+    /* Sorting again keeps the order, and the original indices. */
+    ck_assert(escdf_geometry_sort_sites(geometry) == ESCDF_SUCCESS);
+    ck_assert(escdf_geometry_read_species_at_sites(geometry, species, NULL, NULL, NULL) ==
+              ESCDF_SUCCESS);
+    ck_assert(escdf_geometry_read_site_permutation(geometry, permutation) == ESCDF_SUCCESS);
+    for (i = 0; i < NGRID * NGRID * NGRID; i++) {
+        ck_assert(species[i] == (int)permutation[i]);
+    }
+
+    /* A cube of sites is read in a few ranges. */
+    ck_assert(escdf_geometry_write_site_index(geometry, NULL) == ESCDF_SUCCESS);
+    ck_assert(escdf_geometry_find_sites_within(geometry, center, 1.8,
+                                               &sites, &nsites) == ESCDF_SUCCESS);
+    ck_assert(nsites == 27);
+    ck_assert(escdf_geometry_read_site_data_at(geometry, ESCDF_SITE_POSITIONS,
+                                               sites, nsites, positions) == ESCDF_SUCCESS);
+    for (i = 0; i < nsites; i++) {
+        for (j = 0; j < 3; j++) {
+            ck_assert(positions[3 * i + j] == sorted[3 * sites[i] + j]);
+        }
+    }
+    free(sites);
+
+    /* The frames of a trajectory would not follow the sites. */
+    ck_assert((trajectory = escdf_geometry_open_trajectory
+               (geometry, 1 << ESCDF_TRAJECTORY_POSITIONS, 2)) != NULL);
+    ck_assert(escdf_trajectory_append(trajectory, 0., sorted, NULL, NULL) == ESCDF_SUCCESS);
+    ck_assert(escdf_trajectory_close(trajectory) == ESCDF_SUCCESS);
+    ck_assert(escdf_geometry_read_site_permutation(geometry, permutation) == ESCDF_SUCCESS);
+    j = permutation[0];
+    ck_assert(escdf_geometry_sort_sites(geometry) == ESCDF_ENOSUPPORT);
+    ck_assert(escdf_geometry_read_site_permutation(geometry, permutation) == ESCDF_SUCCESS);
+    ck_assert(permutation[0] == j);
+
+    ck_assert(escdf_geometry_free(geometry) == ESCDF_SUCCESS);
+    ck_assert(escdf_close(handle) == ESCDF_SUCCESS);
+}
+END_TEST
+
+static double quantised_position(unsigned int frame, unsigned int i)
+{
+    return 10. * sin(0.1 * i) + 0.001234567 * frame * i;
+}
+
+START_TEST(test_geometry_trajectory_quantised)
+{
+    escdf_handle_t *handle;
+    escdf_geometry_t *geometry;
+    escdf_trajectory_t *trajectory;
+    double positions[NSITES * 3], check[5 * NSITES * 3];
+    unsigned int i, n;
+
+    ck_assert((handle = escdf_create(FILE_QUANTISED, NULL)) != NULL);
+    ck_assert((geometry = escdf_geometry_new(handle, "md")) != NULL);
+    ck_assert(escdf_geometry_set_number_of_physical_dimensions(geometry, 3) == ESCDF_SUCCESS);
+    ck_assert(escdf_geometry_set_number_of_sites(geometry, NSITES) == ESCDF_SUCCESS);
+
+    ck_assert(escdf_geometry_open_trajectory_quantised
+              (geometry, 1 << ESCDF_TRAJECTORY_POSITIONS, 3, 0.) == NULL);
+    /* Keyframes every 3 frames, the chunk size. */
+    ck_assert((trajectory = escdf_geometry_open_trajectory_quantised
+               (geometry, 1 << ESCDF_TRAJECTORY_POSITIONS, 3, PRECISION)) != NULL);
+    ck_assert(escdf_trajectory_get_precision(trajectory) == PRECISION);
+    for (n = 0; n < NFRAMES; n++) {
+        for (i = 0; i < NSITES * 3; i++) {
+            positions[i] = quantised_position(n, i);
+        }
+        ck_assert(escdf_trajectory_append(trajectory, 0., positions, NULL, NULL) ==
+                  ESCDF_SUCCESS);
+    }
+    ck_assert(escdf_trajectory_close(trajectory) == ESCDF_SUCCESS);
+
+    /* The encoding of the file is kept, and frames are appended after a
+       delta frame. */
+    ck_assert((trajectory = escdf_geometry_open_trajectory(geometry, 0, 3)) != NULL);
+    ck_assert(escdf_trajectory_get_precision(trajectory) == PRECISION);
+    for (n = NFRAMES; n < NFRAMES + 4; n++) {
+        for (i = 0; i < NSITES * 3; i++) {
+            positions[i] = quantised_position(n, i);
+        }
+        ck_assert(escdf_trajectory_append(trajectory, 0., positions, NULL, NULL) ==
+                  ESCDF_SUCCESS);
+    }
+    ck_assert(escdf_trajectory_flush(trajectory) == ESCDF_SUCCESS);
+    /* Out of the range of the quantised positions, or not a number: the
+       frame is rejected, and never buffered. */
+    positions[0] = 1e4;
+    ck_assert(escdf_trajectory_append(trajectory, 0., positions, NULL, NULL) == ESCDF_ERANGE);
+    positions[0] = NAN;
+    ck_assert(escdf_trajectory_append(trajectory, 0., positions, NULL, NULL) == ESCDF_EVALUE);
+    ck_assert(escdf_trajectory_get_number_of_frames(trajectory) == NFRAMES + 4);
+    ck_assert(escdf_trajectory_flush(trajectory) == ESCDF_SUCCESS);
+    ck_assert(escdf_trajectory_close(trajectory) == ESCDF_SUCCESS);
+    /* Appending goes on after a rejected frame, with a full buffer. */
+    ck_assert((trajectory = escdf_geometry_open_trajectory(geometry, 0, 2)) != NULL);
+    for (n = NFRAMES + 4; n < NFRAMES + 7; n++) {
+        for (i = 0; i < NSITES * 3; i++) {
+            positions[i] = quantised_position(n, i);
+        }
+        ck_assert(escdf_trajectory_append(trajectory, 0., positions, NULL, NULL) ==
+                  ESCDF_SUCCESS);
+        if (n == NFRAMES + 4) {
+            positions[0] = NAN;
+            ck_assert(escdf_trajectory_append(trajectory, 0., positions, NULL, NULL) ==
+                      ESCDF_EVALUE);
+        }
+    }
+    ck_assert(escdf_trajectory_get_number_of_frames(trajectory) == NFRAMES + 7);
+    ck_assert(escdf_trajectory_close(trajectory) == ESCDF_SUCCESS);
+
+    ck_assert((trajectory = escdf_geometry_open_trajectory(geometry, 0, 3)) != NULL);
+    ck_assert(escdf_trajectory_get_number_of_frames(trajectory) == NFRAMES + 7);
+    /* Every 3rd frame from the 2nd one, across keyframes. */
+    ck_assert(escdf_trajectory_read_frames(trajectory, ESCDF_TRAJECTORY_POSITIONS,
+                                           1, 5, 3, check) == ESCDF_SUCCESS);
+    for (n = 0; n < 5; n++) {
+        for (i = 0; i < NSITES * 3; i++) {
+            ck_assert(fabs(check[n * NSITES * 3 + i] - quantised_position(1 + 3 * n, i)) <=
+                      0.5 * PRECISION + 1e-12);
+        }
+    }
+    ck_assert(escdf_trajectory_read_frames(trajectory, ESCDF_TRAJECTORY_POSITIONS,
+                                           NFRAMES - 1, 5, 1, check) == ESCDF_SUCCESS);
+    for (n = 0; n < 5; n++) {
+        for (i = 0; i < NSITES * 3; i++) {
+            ck_assert(fabs(check[n * NSITES * 3 + i] - quantised_position(NFRAMES - 1 + n, i)) <=
+                      0.5 * PRECISION + 1e-12);
+        }
+    }
+    ck_assert(escdf_trajectory_close(trajectory) == ESCDF_SUCCESS);
+
+    ck_assert(escdf_geometry_free(geometry) == ESCDF_SUCCESS);
+    ck_assert(escdf_close(handle) == ESCDF_SUCCESS);
 }
 END_TEST
 
 Suite * make_geometry_suite(void)
 {
     Suite *s;
-    TCase *tc_geometry;
+    TCase *tc_geometry, *tc_geometry_data;
 
     s = suite_create("Geometry");
 
@@ -157,5 +662,14 @@ Suite * make_geometry_suite(void)
     tcase_add_checked_fixture(tc_geometry, geometry_setup, geometry_teardown);
     tcase_add_test(tc_geometry, test_geometry_new);
     suite_add_tcase(s, tc_geometry);
+
+    tc_geometry_data = tcase_create("Site data");
+    tcase_add_test(tc_geometry_data, test_geometry_site_data);
+    tcase_add_test(tc_geometry_data, test_geometry_site_distributed);
+    tcase_add_test(tc_geometry_data, test_geometry_site_index);
+    tcase_add_test(tc_geometry_data, test_geometry_sort_sites);
+    tcase_add_test(tc_geometry_data, test_geometry_trajectory);
+    tcase_add_test(tc_geometry_data, test_geometry_trajectory_quantised);
+    suite_add_tcase(s, tc_geometry_data);
     return s;
 }
\ No newline at end of file
@@ -22,9 +22,11 @@
  * @brief checks escdf_grid_scalarfields.c and escdf_grid_scalarfields.h
  */
 
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <unistd.h>
 #include <check.h>
 
 #include "escdf_grid_scalarfields.h"
@@ -35,6 +37,12 @@
 #define ESCDF_CHK_DATADIR "."
 #endif
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+
+#define N_READ_THREADS 4
+#endif
+
 START_TEST(test_read_metadata)
 {
     escdf_handle_t *file_id;
@@ -132,6 +140,79 @@ START_TEST(test_write_metadata)
 }
 END_TEST
 
+START_TEST(test_write_packed_metadata)
+{
+    escdf_handle_t *file_id;
+    escdf_errno_t err;
+    escdf_grid_scalarfield_t *scalarfield;
+    escdf_direction_type dirarr[2];
+    unsigned int uarr[2];
+    double darr[4];
+    hid_t gid;
+
+    scalarfield = escdf_grid_scalarfield_new(NULL);
+    ck_assert(!escdf_grid_scalarfield_get_packed_metadata(scalarfield));
+    err = escdf_grid_scalarfield_set_packed_metadata(scalarfield, true);
+    ck_assert(err == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_get_packed_metadata(scalarfield));
+
+    escdf_grid_scalarfield_set_number_of_physical_dimensions(scalarfield, 2);
+    dirarr[0] = ESCDF_DIRECTION_PERIODIC;
+    dirarr[1] = ESCDF_DIRECTION_SEMI_INFINITE;
+    escdf_grid_scalarfield_set_dimension_types(scalarfield, dirarr, 2);
+    darr[0] = 1.;
+    darr[1] = 2.;
+    darr[2] = 3.;
+    darr[3] = 4.;
+    escdf_grid_scalarfield_set_lattice_vectors(scalarfield, darr, 4);
+    uarr[0] = 6;
+    uarr[1] = 4;
+    escdf_grid_scalarfield_set_number_of_grid_points(scalarfield, uarr, 2);
+    escdf_grid_scalarfield_set_number_of_components(scalarfield, 3);
+    escdf_grid_scalarfield_set_real_or_complex(scalarfield, ESCDF_COMPLEX);
+    escdf_grid_scalarfield_set_use_default_ordering(scalarfield, true);
+
+    file_id = escdf_create("tmp_grid_scalarfield_packed.h5", NULL);
+    ck_assert(file_id != NULL);
+    err = escdf_grid_scalarfield_write_metadata(scalarfield, file_id);
+    ck_assert(err == ESCDF_SUCCESS);
+    escdf_grid_scalarfield_free(scalarfield);
+    escdf_close(file_id);
+
+    file_id = escdf_open("tmp_grid_scalarfield_packed.h5", NULL);
+    ck_assert(file_id != NULL);
+
+    /* A single attribute holds all the metadata. */
+    gid = H5Gopen(file_id->group_id, "density", H5P_DEFAULT);
+    ck_assert(gid >= 0);
+    ck_assert(H5Aexists(gid, "metadata") > 0);
+    ck_assert(H5Aexists(gid, "number_of_components") == 0);
+    H5Gclose(gid);
+
+    scalarfield = escdf_grid_scalarfield_new("density");
+    err = escdf_grid_scalarfield_read_metadata(scalarfield, file_id);
+    ck_assert(err == ESCDF_SUCCESS);
+
+    ck_assert(escdf_grid_scalarfield_get_number_of_physical_dimensions(scalarfield) == 2);
+    err = escdf_grid_scalarfield_get_dimension_types(scalarfield, dirarr, 2);
+    ck_assert(err == ESCDF_SUCCESS);
+    ck_assert(dirarr[0] == ESCDF_DIRECTION_PERIODIC &&
+              dirarr[1] == ESCDF_DIRECTION_SEMI_INFINITE);
+    err = escdf_grid_scalarfield_get_lattice_vectors(scalarfield, darr, 4);
+    ck_assert(err == ESCDF_SUCCESS);
+    ck_assert(darr[0] == 1. && darr[1] == 2. && darr[2] == 3. && darr[3] == 4.);
+    err = escdf_grid_scalarfield_get_number_of_grid_points(scalarfield, uarr, 2);
+    ck_assert(err == ESCDF_SUCCESS);
+    ck_assert(uarr[0] == 6 && uarr[1] == 4);
+    ck_assert(escdf_grid_scalarfield_get_number_of_components(scalarfield) == 3);
+    ck_assert(escdf_grid_scalarfield_get_real_or_complex(scalarfield) == ESCDF_COMPLEX);
+    ck_assert(escdf_grid_scalarfield_get_use_default_ordering(scalarfield));
+
+    escdf_grid_scalarfield_free(scalarfield);
+    escdf_close(file_id);
+}
+END_TEST
+
 START_TEST(test_getters)
 {
     escdf_handle_t *file_id;
@@ -352,6 +433,162 @@ START_TEST(test_set_use_default_ordering)
 }
 END_TEST
 
+START_TEST(test_set_storage)
+{
+    escdf_handle_t *file_id;
+    escdf_errno_t err;
+    escdf_grid_scalarfield_t *scalarfield;
+    escdf_direction_type dirarr[2];
+    unsigned int uarr[2];
+    double darr[4];
+    double dens[48], back[48];
+    unsigned int i;
+
+    scalarfield = escdf_grid_scalarfield_new(NULL);
+
+    ck_assert(escdf_grid_scalarfield_get_chunk_size(scalarfield) == 0);
+    ck_assert(escdf_grid_scalarfield_get_deflate_level(scalarfield) == 0);
+    err = escdf_grid_scalarfield_set_deflate_level(scalarfield, 10);
+    ck_assert(err == ESCDF_ERANGE);
+    err = escdf_grid_scalarfield_set_chunk_size(scalarfield, 5);
+    ck_assert(err == ESCDF_SUCCESS);
+    err = escdf_grid_scalarfield_set_deflate_level(scalarfield, 6);
+    ck_assert(err == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_get_chunk_size(scalarfield) == 5);
+    ck_assert(escdf_grid_scalarfield_get_deflate_level(scalarfield) == 6);
+
+    escdf_grid_scalarfield_set_number_of_physical_dimensions(scalarfield, 2);
+    dirarr[0] = ESCDF_DIRECTION_FREE;
+    dirarr[1] = ESCDF_DIRECTION_FREE;
+    escdf_grid_scalarfield_set_dimension_types(scalarfield, dirarr, 2);
+    darr[0] = 1.;
+    darr[1] = 0.;
+    darr[2] = 0.;
+    darr[3] = 1.;
+    escdf_grid_scalarfield_set_lattice_vectors(scalarfield, darr, 4);
+    uarr[0] = 6;
+    uarr[1] = 4;
+    escdf_grid_scalarfield_set_number_of_grid_points(scalarfield, uarr, 2);
+    escdf_grid_scalarfield_set_number_of_components(scalarfield, 2);
+    escdf_grid_scalarfield_set_real_or_complex(scalarfield, ESCDF_REAL);
+    escdf_grid_scalarfield_set_use_default_ordering(scalarfield, true);
+
+    /* Chunked and compressed data sets must read back unchanged. */
+    file_id = escdf_create("tmp_grid_scalarfield_chunked.h5", NULL);
+    ck_assert(file_id != NULL);
+    err = escdf_grid_scalarfield_write_metadata(scalarfield, file_id);
+    ck_assert(err == ESCDF_SUCCESS);
+    for (i = 0; i < 48; i++) {
+        dens[i] = (double)i * 0.5;
+    }
+    err = escdf_grid_scalarfield_write_values_on_grid_ordered(scalarfield, file_id, dens,
+                                                              NULL, NULL, NULL);
+    ck_assert(err == ESCDF_SUCCESS);
+    err = escdf_grid_scalarfield_read_values_on_grid(scalarfield, file_id, back,
+                                                     NULL, NULL, NULL);
+    ck_assert(err == ESCDF_SUCCESS);
+    for (i = 0; i < 48; i++) {
+        ck_assert(back[i] == dens[i]);
+    }
+    escdf_close(file_id);
+
+    escdf_grid_scalarfield_free(scalarfield);
+}
+END_TEST
+
+START_TEST(test_values_on_grid_chunks)
+{
+    escdf_handle_t *file_id;
+    escdf_errno_t err;
+    escdf_grid_scalarfield_t *scalarfield;
+    escdf_direction_type dirarr[2];
+    unsigned int uarr[2];
+    double darr[4];
+    double dens[48], part[48], back[48];
+    unsigned int i, j, level;
+
+    scalarfield = escdf_grid_scalarfield_new(NULL);
+    escdf_grid_scalarfield_set_number_of_physical_dimensions(scalarfield, 2);
+    dirarr[0] = ESCDF_DIRECTION_FREE;
+    dirarr[1] = ESCDF_DIRECTION_FREE;
+    escdf_grid_scalarfield_set_dimension_types(scalarfield, dirarr, 2);
+    darr[0] = 1.;
+    darr[1] = 0.;
+    darr[2] = 0.;
+    darr[3] = 1.;
+    escdf_grid_scalarfield_set_lattice_vectors(scalarfield, darr, 4);
+    uarr[0] = 6;
+    uarr[1] = 4;
+    escdf_grid_scalarfield_set_number_of_grid_points(scalarfield, uarr, 2);
+    escdf_grid_scalarfield_set_number_of_components(scalarfield, 2);
+    escdf_grid_scalarfield_set_real_or_complex(scalarfield, ESCDF_REAL);
+    escdf_grid_scalarfield_set_use_default_ordering(scalarfield, true);
+    escdf_grid_scalarfield_set_chunk_size(scalarfield, 5);
+    for (i = 0; i < 48; i++) {
+        dens[i] = (double)i * 0.25 - 3.;
+    }
+
+    /* With and without compression, the chunks written directly must be
+       read back through the HDF5 filter pipeline, and the other way round. */
+    for (level = 0; level < 10; level += 6) {
+        escdf_grid_scalarfield_set_deflate_level(scalarfield, level);
+        file_id = escdf_create("tmp_grid_scalarfield_chunks.h5", NULL);
+        ck_assert(file_id != NULL);
+        err = escdf_grid_scalarfield_write_metadata(scalarfield, file_id);
+        ck_assert(err == ESCDF_SUCCESS);
+
+        /* Points [0, 10), then [10, 24) ending with a partial chunk. */
+        for (j = 0; j < 2; j++) {
+            for (i = 0; i < 10; i++) {
+                part[j * 10 + i] = dens[j * 24 + i];
+            }
+        }
+        err = escdf_grid_scalarfield_write_values_on_grid_chunks(scalarfield, file_id,
+                                                                 part, 0, 10);
+        ck_assert(err == ESCDF_SUCCESS);
+        for (j = 0; j < 2; j++) {
+            for (i = 0; i < 14; i++) {
+                part[j * 14 + i] = dens[j * 24 + 10 + i];
+            }
+        }
+        err = escdf_grid_scalarfield_write_values_on_grid_chunks(scalarfield, file_id,
+                                                                 part, 10, 14);
+        ck_assert(err == ESCDF_SUCCESS);
+
+        err = escdf_grid_scalarfield_read_values_on_grid(scalarfield, file_id, back,
+                                                         NULL, NULL, NULL);
+        ck_assert(err == ESCDF_SUCCESS);
+        for (i = 0; i < 48; i++) {
+            ck_assert(back[i] == dens[i]);
+        }
+
+        err = escdf_grid_scalarfield_read_values_on_grid_chunks(scalarfield, file_id,
+                                                                back, 0, 24);
+        ck_assert(err == ESCDF_SUCCESS);
+        for (i = 0; i < 48; i++) {
+            ck_assert(back[i] == dens[i]);
+        }
+
+        /* A range not made of whole chunks is read the regular way. */
+        err = escdf_grid_scalarfield_read_values_on_grid_chunks(scalarfield, file_id,
+                                                                back, 3, 4);
+        ck_assert(err == ESCDF_SUCCESS);
+        for (j = 0; j < 2; j++) {
+            for (i = 0; i < 4; i++) {
+                ck_assert(back[j * 4 + i] == dens[j * 24 + 3 + i]);
+            }
+        }
+
+        err = escdf_grid_scalarfield_read_values_on_grid_chunks(scalarfield, file_id,
+                                                                back, 20, 5);
+        ck_assert(err == ESCDF_ESIZE);
+        escdf_close(file_id);
+    }
+
+    escdf_grid_scalarfield_free(scalarfield);
+}
+END_TEST
+
 START_TEST(test_read_values_on_grid)
 {
     escdf_handle_t *file_id;
@@ -399,6 +636,91 @@ START_TEST(test_read_values_on_grid)
 }
 END_TEST
 
+#ifdef HAVE_PTHREAD
+typedef struct {
+    escdf_handle_t *file_id;
+    const escdf_grid_scalarfield_t *scalarfield;
+    unsigned int rank;
+    escdf_errno_t err;
+    double dens[116];
+} read_thread_t;
+
+static void *read_values_thread(void *arg)
+{
+    read_thread_t *t = (read_thread_t*)arg;
+    unsigned int tbl[4];
+    unsigned int i;
+
+    /* Each thread reads a different disordered subset of the same group,
+       then the full group. */
+    for (i = 0; i < 4; i++) {
+        tbl[i] = t->rank + 9 * i;
+    }
+    t->err = escdf_grid_scalarfield_read_values_on_grid_sliced
+        (t->scalarfield, t->file_id, t->dens, tbl, 4);
+    if (t->err == ESCDF_SUCCESS) {
+        t->err = escdf_grid_scalarfield_read_values_on_grid
+            (t->scalarfield, t->file_id, t->dens + 8, NULL, NULL, NULL);
+    }
+    escdf_error_free();
+
+    return NULL;
+}
+#endif
+
+START_TEST(test_read_values_on_grid_threads)
+{
+#ifdef HAVE_PTHREAD
+    escdf_handle_t *file_id;
+    escdf_errno_t err;
+    escdf_grid_scalarfield_t *scalarfield;
+    pthread_t threads[N_READ_THREADS];
+    read_thread_t ref[N_READ_THREADS], args[N_READ_THREADS];
+    unsigned int i, j;
+
+    file_id = escdf_open(ESCDF_CHK_DATADIR "/grid_scalarfield_read.h5", NULL);
+    ck_assert(file_id != NULL);
+
+    scalarfield = escdf_grid_scalarfield_new("densities/pseudo_density");
+    err = escdf_grid_scalarfield_read_metadata(scalarfield, file_id);
+    ck_assert(err == ESCDF_SUCCESS);
+
+    /* Serial reference. */
+    for (i = 0; i < N_READ_THREADS; i++) {
+        ref[i].file_id = file_id;
+        ref[i].scalarfield = scalarfield;
+        ref[i].rank = i;
+        read_values_thread(ref + i);
+        ck_assert(ref[i].err == ESCDF_SUCCESS);
+    }
+
+    /* The handle and the metadata are shared read-only by all threads. */
+    for (i = 0; i < N_READ_THREADS; i++) {
+        args[i].file_id = file_id;
+        args[i].scalarfield = scalarfield;
+        args[i].rank = i;
+        args[i].err = ESCDF_ERROR;
+        ck_assert(pthread_create(threads + i, NULL, read_values_thread, args + i) == 0);
+    }
+    for (i = 0; i < N_READ_THREADS; i++) {
+        ck_assert(pthread_join(threads[i], NULL) == 0);
+    }
+
+    for (i = 0; i < N_READ_THREADS; i++) {
+        ck_assert(args[i].err == ESCDF_SUCCESS);
+        for (j = 0; j < 116; j++) {
+            ck_assert(args[i].dens[j] == ref[i].dens[j]);
+        }
+    }
+    ck_assert(ref[0].dens[8 + 1] == 1.);
+
+    escdf_grid_scalarfield_free(scalarfield);
+
+    escdf_close(file_id);
+#endif
+}
+END_TEST
+
 START_TEST(test_write_values_on_grid)
 {
     escdf_handle_t *file_id;
@@ -461,6 +783,91 @@ START_TEST(test_write_values_on_grid)
 }
 END_TEST
 
+START_TEST(test_write_values_on_grid_multi)
+{
+    escdf_handle_t *file_id;
+    escdf_errno_t err;
+    escdf_grid_scalarfield_t *fields[2];
+    escdf_grid_scalarfield_write_t writes[2];
+    escdf_direction_type dirarr[2];
+    unsigned int uarr[2], tbl[24], back_tbl[24];
+    double darr[4];
+    double dens[2][48], back[48];
+    unsigned int i, k;
+    hid_t gid, dtset_id;
+
+    dirarr[0] = ESCDF_DIRECTION_FREE;
+    dirarr[1] = ESCDF_DIRECTION_FREE;
+    darr[0] = 1.;
+    darr[1] = 0.;
+    darr[2] = 0.;
+    darr[3] = 1.;
+    uarr[0] = 6;
+    uarr[1] = 4;
+
+    /* A density in default ordering, and one with a lookup table. */
+    file_id = escdf_create("tmp_grid_scalarfield_multi.h5", NULL);
+    ck_assert(file_id != NULL);
+    for (k = 0; k < 2; k++) {
+        fields[k] = escdf_grid_scalarfield_new((k == 0) ? "density" : "core_density");
+        escdf_grid_scalarfield_set_number_of_physical_dimensions(fields[k], 2);
+        escdf_grid_scalarfield_set_dimension_types(fields[k], dirarr, 2);
+        escdf_grid_scalarfield_set_lattice_vectors(fields[k], darr, 4);
+        escdf_grid_scalarfield_set_number_of_grid_points(fields[k], uarr, 2);
+        escdf_grid_scalarfield_set_number_of_components(fields[k], 2);
+        escdf_grid_scalarfield_set_real_or_complex(fields[k], ESCDF_REAL);
+        escdf_grid_scalarfield_set_use_default_ordering(fields[k], k == 0);
+        err = escdf_grid_scalarfield_write_metadata(fields[k], file_id);
+        ck_assert(err == ESCDF_SUCCESS);
+        for (i = 0; i < 48; i++) {
+            dens[k][i] = (double)(i + 100 * k);
+        }
+        writes[k].scalarfield = fields[k];
+        writes[k].buf = dens[k];
+        writes[k].tbl = (k == 0) ? NULL : tbl;
+        writes[k].start = NULL;
+        writes[k].count = NULL;
+        writes[k].stride = NULL;
+    }
+    for (i = 0; i < 24; i++) {
+        tbl[i] = 23 - i;
+    }
+
+    /* Mismatching ordering and lookup table. */
+    writes[0].tbl = tbl;
+    err = escdf_grid_scalarfield_write_values_on_grid_multi(file_id, writes, 2);
+    ck_assert(err == ESCDF_EUNINIT);
+    writes[0].tbl = NULL;
+
+    err = escdf_grid_scalarfield_write_values_on_grid_multi(file_id, writes, 2);
+    ck_assert(err == ESCDF_SUCCESS);
+
+    for (k = 0; k < 2; k++) {
+        err = escdf_grid_scalarfield_read_values_on_grid(fields[k], file_id, back,
+                                                         NULL, NULL, NULL);
+        ck_assert(err == ESCDF_SUCCESS);
+        for (i = 0; i < 48; i++) {
+            ck_assert(back[i] == dens[k][i]);
+        }
+    }
+    gid = H5Gopen(file_id->group_id, "core_density", H5P_DEFAULT);
+    ck_assert(gid >= 0);
+    dtset_id = H5Dopen(gid, "grid_ordering", H5P_DEFAULT);
+    ck_assert(dtset_id >= 0);
+    ck_assert(H5Dread(dtset_id, H5T_NATIVE_UINT, H5S_ALL, H5S_ALL, H5P_DEFAULT, back_tbl) >= 0);
+    for (i = 0; i < 24; i++) {
+        ck_assert(back_tbl[i] == tbl[i]);
+    }
+    H5Dclose(dtset_id);
+    H5Gclose(gid);
+
+    for (k = 0; k < 2; k++) {
+        escdf_grid_scalarfield_free(fields[k]);
+    }
+    escdf_close(file_id);
+}
+END_TEST
+
 START_TEST(test_read_values_on_grid_sliced)
 {
     escdf_handle_t *file_id;
@@ -591,6 +998,684 @@ START_TEST(test_read_values_on_grid_sliced)
 }
 END_TEST
 
+START_TEST(test_reduce)
+{
+    escdf_handle_t *file_id;
+    escdf_grid_scalarfield_t *scalarfield;
+    escdf_grid_scalarfield_reduction_t red;
+    escdf_direction_type dirarr[2] = {ESCDF_DIRECTION_PERIODIC, ESCDF_DIRECTION_PERIODIC};
+    unsigned int uarr[2] = {6, 4};
+    double darr[4] = {2., 0., 1., 3.};
+    double dens[48], f, r[2], sum, sum_abs, sum_sq, mn, mx, moment[2], dv;
+    unsigned int tbl[24];
+    unsigned int i, c, ordered;
+
+    scalarfield = escdf_grid_scalarfield_new(NULL);
+    escdf_grid_scalarfield_set_number_of_physical_dimensions(scalarfield, 2);
+    escdf_grid_scalarfield_set_dimension_types(scalarfield, dirarr, 2);
+    escdf_grid_scalarfield_set_lattice_vectors(scalarfield, darr, 4);
+    escdf_grid_scalarfield_set_number_of_grid_points(scalarfield, uarr, 2);
+    escdf_grid_scalarfield_set_number_of_components(scalarfield, 2);
+    escdf_grid_scalarfield_set_real_or_complex(scalarfield, ESCDF_REAL);
+    escdf_grid_scalarfield_set_chunk_size(scalarfield, 5);
+    for (i = 0; i < 24; i++) {
+        tbl[i] = (i * 5) % 24;
+    }
+
+    /* The grid points in the default ordering, then stored in the order of
+       tbl. */
+    for (ordered = 0; ordered < 2; ordered++) {
+        escdf_grid_scalarfield_set_use_default_ordering(scalarfield, ordered == 0);
+        for (i = 0; i < 24; i++) {
+            f = (ordered == 0) ? (double)i : (double)tbl[i];
+            dens[i] = f * 0.5 - 4.;
+            dens[24 + i] = f * f;
+        }
+        file_id = escdf_create("tmp_grid_scalarfield_reduce.h5", NULL);
+        ck_assert(file_id != NULL);
+        ck_assert(escdf_grid_scalarfield_write_metadata(scalarfield, file_id) == ESCDF_SUCCESS);
+        if (ordered == 0) {
+            ck_assert(escdf_grid_scalarfield_write_values_on_grid_ordered(scalarfield, file_id, dens,
+                                                                          NULL, NULL, NULL) == ESCDF_SUCCESS);
+        } else {
+            ck_assert(escdf_grid_scalarfield_write_values_on_grid_sliced(scalarfield, file_id, dens,
+                                                                         tbl, 24) == ESCDF_SUCCESS);
+        }
+
+        for (c = 0; c < 2; c++) {
+            sum = sum_abs = sum_sq = moment[0] = moment[1] = 0.;
+            mn = HUGE_VAL;
+            mx = -HUGE_VAL;
+            for (i = 0; i < 24; i++) {
+                f = (c == 0) ? (double)i * 0.5 - 4. : (double)(i * i);
+                r[0] = (i % 6) / 6. * darr[0] + (i / 6) / 4. * darr[2];
+                r[1] = (i % 6) / 6. * darr[1] + (i / 6) / 4. * darr[3];
+                sum += f;
+                sum_abs += fabs(f);
+                sum_sq += f * f;
+                mn = fmin(mn, f);
+                mx = fmax(mx, f);
+                moment[0] += r[0] * f;
+                moment[1] += r[1] * f;
+            }
+            dv = 6. / 24.;
+            ck_assert(escdf_grid_scalarfield_reduce(scalarfield, file_id, c, &red) == ESCDF_SUCCESS);
+            ck_assert(red.number_of_values == 24);
+            ck_assert(fabs(red.sum - sum) < 1e-10);
+            ck_assert(fabs(red.integral - sum * dv) < 1e-10);
+            ck_assert(red.minimum == mn);
+            ck_assert(red.maximum == mx);
+            ck_assert(red.norm_max == fmax(-mn, mx));
+            ck_assert(fabs(red.norm_1 - sum_abs * dv) < 1e-10);
+            ck_assert(fabs(red.norm_2 - sqrt(sum_sq * dv)) < 1e-10);
+            ck_assert(fabs(red.first_moment[0] - moment[0] * dv) < 1e-10);
+            ck_assert(fabs(red.first_moment[1] - moment[1] * dv) < 1e-10);
+            ck_assert(red.first_moment[2] == 0.);
+        }
+        ck_assert(escdf_grid_scalarfield_reduce(scalarfield, file_id, 2, &red) == ESCDF_ERANGE);
+        escdf_close(file_id);
+    }
+
+    escdf_grid_scalarfield_free(scalarfield);
+}
+END_TEST
+
+START_TEST(test_write_statistics)
+{
+    escdf_handle_t *file_id;
+    escdf_grid_scalarfield_t *scalarfield;
+    escdf_grid_scalarfield_statistics_t stats;
+    escdf_direction_type dirarr[2] = {ESCDF_DIRECTION_FREE, ESCDF_DIRECTION_FREE};
+    unsigned int uarr[2] = {6, 4};
+    double darr[4] = {1., 0., 0., 1.};
+    double dens[48], part[48], value;
+    hsize_t start[3], count[3];
+    unsigned int i, j;
+    uint64_t checksum;
+
+    scalarfield = escdf_grid_scalarfield_new(NULL);
+    escdf_grid_scalarfield_set_number_of_physical_dimensions(scalarfield, 2);
+    escdf_grid_scalarfield_set_dimension_types(scalarfield, dirarr, 2);
+    escdf_grid_scalarfield_set_lattice_vectors(scalarfield, darr, 4);
+    escdf_grid_scalarfield_set_number_of_grid_points(scalarfield, uarr, 2);
+    escdf_grid_scalarfield_set_number_of_components(scalarfield, 2);
+    escdf_grid_scalarfield_set_real_or_complex(scalarfield, ESCDF_REAL);
+    escdf_grid_scalarfield_set_use_default_ordering(scalarfield, true);
+    ck_assert(!escdf_grid_scalarfield_get_write_statistics(scalarfield));
+    ck_assert(escdf_grid_scalarfield_set_write_statistics(scalarfield, true) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_get_write_statistics(scalarfield));
+    for (i = 0; i < 48; i++) {
+        dens[i] = (double)i * 0.25 - 3.;
+    }
+
+    file_id = escdf_create("tmp_grid_scalarfield_statistics.h5", NULL);
+    ck_assert(file_id != NULL);
+    ck_assert(escdf_grid_scalarfield_write_metadata(scalarfield, file_id) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_read_statistics(scalarfield, file_id, 0, &stats) == ESCDF_EUNINIT);
+
+    /* The second half of the grid points, then the first one. */
+    start[0] = 0;
+    start[2] = 0;
+    count[0] = 2;
+    count[1] = 12;
+    count[2] = 1;
+    for (j = 0; j < 2; j++) {
+        start[1] = 12 - 12 * j;
+        for (i = 0; i < 12; i++) {
+            part[i] = dens[start[1] + i];
+            part[12 + i] = dens[24 + start[1] + i];
+        }
+        ck_assert(escdf_grid_scalarfield_write_values_on_grid(scalarfield, file_id, part, NULL,
+                                                              start, count, NULL) == ESCDF_SUCCESS);
+        if (j == 0) {
+            /* Half written, nothing to verify or read yet. */
+            ck_assert(escdf_grid_scalarfield_verify(scalarfield, file_id) == ESCDF_EUNINIT);
+            ck_assert(escdf_grid_scalarfield_read_statistics(scalarfield, file_id, 1,
+                                                             &stats) == ESCDF_EUNINIT);
+        }
+    }
+    ck_assert(escdf_grid_scalarfield_read_statistics(scalarfield, file_id, 1, &stats) == ESCDF_SUCCESS);
+    ck_assert(stats.number_of_values == 24);
+    ck_assert(stats.sum[0] == 141.);
+    ck_assert(stats.minimum[0] == 3.);
+    ck_assert(stats.maximum[0] == 8.75);
+    ck_assert(escdf_grid_scalarfield_read_statistics(scalarfield, file_id, 0, &stats) == ESCDF_SUCCESS);
+    ck_assert(stats.sum[0] == -3.);
+    ck_assert(stats.minimum[0] == -3.);
+    ck_assert(stats.maximum[0] == 2.75);
+    checksum = stats.checksum;
+    ck_assert(escdf_grid_scalarfield_read_statistics(scalarfield, file_id, 2, &stats) == ESCDF_ERANGE);
+    ck_assert(escdf_grid_scalarfield_verify(scalarfield, file_id) == ESCDF_SUCCESS);
+    escdf_close(file_id);
+
+    /* Written at once, the checksum is the same. */
+    file_id = escdf_create("tmp_grid_scalarfield_statistics.h5", NULL);
+    ck_assert(file_id != NULL);
+    ck_assert(escdf_grid_scalarfield_write_metadata(scalarfield, file_id) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_write_values_on_grid(scalarfield, file_id, dens, NULL,
+                                                          NULL, NULL, NULL) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_read_statistics(scalarfield, file_id, 0, &stats) == ESCDF_SUCCESS);
+    ck_assert(stats.checksum == checksum);
+
+    /* Written again in whole, the statistics are replaced. */
+    for (i = 0; i < 48; i++) {
+        part[i] = dens[i] + 1.;
+    }
+    ck_assert(escdf_grid_scalarfield_write_values_on_grid(scalarfield, file_id, part, NULL,
+                                                          NULL, NULL, NULL) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_read_statistics(scalarfield, file_id, 0, &stats) == ESCDF_SUCCESS);
+    ck_assert(stats.number_of_values == 24);
+    ck_assert(stats.sum[0] == 21.);
+    ck_assert(stats.minimum[0] == -2.);
+    ck_assert(stats.maximum[0] == 3.75);
+    ck_assert(escdf_grid_scalarfield_verify(scalarfield, file_id) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_write_values_on_grid(scalarfield, file_id, dens, NULL,
+                                                          NULL, NULL, NULL) == ESCDF_SUCCESS);
+
+    /* A value changed behind the statistics. */
+    escdf_grid_scalarfield_set_write_statistics(scalarfield, false);
+    start[0] = 1;
+    start[1] = 5;
+    count[0] = 1;
+    count[1] = 1;
+    value = 0.;
+    ck_assert(escdf_grid_scalarfield_write_values_on_grid(scalarfield, file_id, &value, NULL,
+                                                          start, count, NULL) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_verify(scalarfield, file_id) == ESCDF_EFILE_CORRUPT);
+
+    /* A value written twice. */
+    escdf_grid_scalarfield_set_write_statistics(scalarfield, true);
+    ck_assert(escdf_grid_scalarfield_write_values_on_grid(scalarfield, file_id, &value, NULL,
+                                                          start, count, NULL) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_read_statistics(scalarfield, file_id, 1, &stats) == ESCDF_EUNINIT);
+    ck_assert(escdf_grid_scalarfield_read_statistics(scalarfield, file_id, 0, &stats) == ESCDF_SUCCESS);
+    escdf_close(file_id);
+
+    /* Complex values, written chunk by chunk. */
+    escdf_grid_scalarfield_set_number_of_components(scalarfield, 1);
+    escdf_grid_scalarfield_set_real_or_complex(scalarfield, ESCDF_COMPLEX);
+    escdf_grid_scalarfield_set_chunk_size(scalarfield, 5);
+    escdf_grid_scalarfield_set_write_statistics(scalarfield, true);
+    file_id = escdf_create("tmp_grid_scalarfield_statistics.h5", NULL);
+    ck_assert(file_id != NULL);
+    ck_assert(escdf_grid_scalarfield_write_metadata(scalarfield, file_id) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_write_values_on_grid_chunks(scalarfield, file_id, dens,
+                                                                 0, 10) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_write_values_on_grid_chunks(scalarfield, file_id, dens + 20,
+                                                                 10, 14) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_read_statistics(scalarfield, file_id, 0, &stats) == ESCDF_SUCCESS);
+    ck_assert(stats.number_of_values == 24);
+    ck_assert(stats.sum[0] == 66.);
+    ck_assert(stats.sum[1] == 72.);
+    ck_assert(stats.minimum[1] == -2.75);
+    ck_assert(stats.maximum[0] == 8.5);
+    ck_assert(escdf_grid_scalarfield_verify(scalarfield, file_id) == ESCDF_SUCCESS);
+    escdf_close(file_id);
+
+    escdf_grid_scalarfield_free(scalarfield);
+}
+END_TEST
+
+/* Average of the values of component c over the block (i, j, k) of level
+   l, computed point by point. */
+static double _block_average(const double *values, const unsigned int *n, unsigned int c,
+                             unsigned int l, unsigned int i, unsigned int j, unsigned int k)
+{
+    unsigned int f, a, b, d, cnt;
+    double sum;
+
+    f = 1u << l;
+    sum = 0.;
+    cnt = 0;
+    for (d = k * f; d < (k + 1) * f && d < n[2]; d++) {
+        for (b = j * f; b < (j + 1) * f && b < n[1]; b++) {
+            for (a = i * f; a < (i + 1) * f && a < n[0]; a++) {
+                sum += values[c * n[0] * n[1] * n[2] + a + n[0] * (b + n[1] * d)];
+                cnt += 1;
+            }
+        }
+    }
+    return sum / cnt;
+}
+
+START_TEST(test_pyramid)
+{
+    escdf_handle_t *file_id;
+    escdf_grid_scalarfield_t *scalarfield;
+    escdf_direction_type dirarr[3] = {ESCDF_DIRECTION_PERIODIC, ESCDF_DIRECTION_PERIODIC,
+                                      ESCDF_DIRECTION_PERIODIC};
+    unsigned int uarr[3] = {5, 3, 7};
+    unsigned int m[3], nlevels, i, j, k, c, l;
+    double darr[9] = {1., 0., 0., 0., 1., 0., 0., 0., 1.};
+    double dens[210], buf[210];
+    hsize_t start[3], count[3];
+
+    scalarfield = escdf_grid_scalarfield_new(NULL);
+    escdf_grid_scalarfield_set_number_of_physical_dimensions(scalarfield, 3);
+    escdf_grid_scalarfield_set_dimension_types(scalarfield, dirarr, 3);
+    escdf_grid_scalarfield_set_lattice_vectors(scalarfield, darr, 9);
+    escdf_grid_scalarfield_set_number_of_grid_points(scalarfield, uarr, 3);
+    escdf_grid_scalarfield_set_number_of_components(scalarfield, 2);
+    escdf_grid_scalarfield_set_real_or_complex(scalarfield, ESCDF_REAL);
+    escdf_grid_scalarfield_set_use_default_ordering(scalarfield, true);
+    escdf_grid_scalarfield_set_chunk_size(scalarfield, 16);
+    for (i = 0; i < 105; i++) {
+        dens[i] = (double)i;
+        dens[105 + i] = (double)((i * 7) % 11);
+    }
+
+    ck_assert(escdf_grid_scalarfield_get_pyramid_grid_points(scalarfield, 2, m, 3) == ESCDF_SUCCESS);
+    ck_assert(m[0] == 2 && m[1] == 1 && m[2] == 2);
+
+    file_id = escdf_create("tmp_grid_scalarfield_pyramid.h5", NULL);
+    ck_assert(file_id != NULL);
+    ck_assert(escdf_grid_scalarfield_write_metadata(scalarfield, file_id) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_write_values_on_grid(scalarfield, file_id, dens, NULL,
+                                                          NULL, NULL, NULL) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_read_number_of_pyramid_levels(scalarfield, file_id,
+                                                                   &nlevels) == ESCDF_SUCCESS);
+    ck_assert(nlevels == 0);
+    ck_assert(escdf_grid_scalarfield_write_pyramid(scalarfield, file_id, 9) == ESCDF_ERANGE);
+    ck_assert(escdf_grid_scalarfield_write_pyramid(scalarfield, file_id, 3) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_read_number_of_pyramid_levels(scalarfield, file_id,
+                                                                   &nlevels) == ESCDF_SUCCESS);
+    ck_assert(nlevels == 3);
+
+    /* Whole levels, the blocks being truncated at the ends of the grid. */
+    for (l = 0; l <= 3; l++) {
+        escdf_grid_scalarfield_get_pyramid_grid_points(scalarfield, l, m, 3);
+        ck_assert(escdf_grid_scalarfield_read_pyramid(scalarfield, file_id, l, NULL, NULL,
+                                                      buf) == ESCDF_SUCCESS);
+        for (c = 0; c < 2; c++) {
+            for (k = 0; k < m[2]; k++) {
+                for (j = 0; j < m[1]; j++) {
+                    for (i = 0; i < m[0]; i++) {
+                        ck_assert(fabs(buf[c * m[0] * m[1] * m[2] + i + m[0] * (j + m[1] * k)] -
+                                       _block_average(dens, uarr, c, l, i, j, k)) < 1e-12);
+                    }
+                }
+            }
+        }
+    }
+
+    /* A box of the first level. */
+    start[0] = 1;
+    start[1] = 1;
+    start[2] = 1;
+    count[0] = 2;
+    count[1] = 1;
+    count[2] = 3;
+    ck_assert(escdf_grid_scalarfield_read_pyramid(scalarfield, file_id, 1, start, count,
+                                                  buf) == ESCDF_SUCCESS);
+    for (c = 0; c < 2; c++) {
+        for (k = 0; k < 3; k++) {
+            for (i = 0; i < 2; i++) {
+                ck_assert(fabs(buf[c * 6 + i + 2 * k] -
+                               _block_average(dens, uarr, c, 1, 1 + i, 1, 1 + k)) < 1e-12);
+            }
+        }
+    }
+    count[2] = 4;
+    ck_assert(escdf_grid_scalarfield_read_pyramid(scalarfield, file_id, 1, start, count,
+                                                  buf) == ESCDF_ERANGE);
+
+    /* A shallower pyramid replaces the previous one. */
+    ck_assert(escdf_grid_scalarfield_write_pyramid(scalarfield, file_id, 1) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_read_number_of_pyramid_levels(scalarfield, file_id,
+                                                                   &nlevels) == ESCDF_SUCCESS);
+    ck_assert(nlevels == 1);
+    ck_assert(escdf_grid_scalarfield_read_pyramid(scalarfield, file_id, 2, NULL, NULL,
+                                                  buf) != ESCDF_SUCCESS);
+    escdf_close(file_id);
+
+    escdf_grid_scalarfield_free(scalarfield);
+}
+END_TEST
+
+START_TEST(test_interpolate)
+{
+    escdf_handle_t *file_id;
+    escdf_grid_scalarfield_t *scalarfield;
+    escdf_direction_type dirarr[3] = {ESCDF_DIRECTION_FREE, ESCDF_DIRECTION_FREE,
+                                      ESCDF_DIRECTION_PERIODIC};
+    unsigned int uarr[3] = {6, 5, 40};
+    double darr[9] = {6., 0., 0., 1., 5., 0., 0., 0.5, 8.};
+    double *dens, x[3 * 50], r[3 * 50], v[50], w[50], u[3], t, h0, h1;
+    unsigned int i, j, k, p;
+
+    scalarfield = escdf_grid_scalarfield_new(NULL);
+    escdf_grid_scalarfield_set_number_of_physical_dimensions(scalarfield, 3);
+    escdf_grid_scalarfield_set_dimension_types(scalarfield, dirarr, 3);
+    escdf_grid_scalarfield_set_lattice_vectors(scalarfield, darr, 9);
+    escdf_grid_scalarfield_set_number_of_grid_points(scalarfield, uarr, 3);
+    escdf_grid_scalarfield_set_number_of_components(scalarfield, 1);
+    escdf_grid_scalarfield_set_real_or_complex(scalarfield, ESCDF_REAL);
+    escdf_grid_scalarfield_set_use_default_ordering(scalarfield, true);
+    /* Linear along the free dimensions, quadratic along the periodic one. */
+    dens = malloc(sizeof(double) * 1200);
+    for (k = 0; k < 40; k++) {
+        for (j = 0; j < 5; j++) {
+            for (i = 0; i < 6; i++) {
+                dens[i + 6 * (j + 5 * k)] = 2. * i - 3. * j + 0.1 * k * (40. - k);
+            }
+        }
+    }
+
+    file_id = escdf_create("tmp_grid_scalarfield_interpolate.h5", NULL);
+    ck_assert(file_id != NULL);
+    ck_assert(escdf_grid_scalarfield_write_metadata(scalarfield, file_id) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_write_values_on_grid(scalarfield, file_id, dens, NULL,
+                                                          NULL, NULL, NULL) == ESCDF_SUCCESS);
+
+    /* Grid points, some of them given in other images of the cell. */
+    for (p = 0; p < 50; p++) {
+        x[3 * p] = (p % 6) / 6.;
+        x[3 * p + 1] = (p % 5) / 5.;
+        x[3 * p + 2] = (p * 7 % 40) / 40. + (double)(p % 3) - 1.;
+    }
+    ck_assert(escdf_grid_scalarfield_interpolate(scalarfield, file_id, 0,
+                                                 ESCDF_INTERPOLATION_TRILINEAR, true, 50, x,
+                                                 v) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_interpolate(scalarfield, file_id, 0,
+                                                 ESCDF_INTERPOLATION_TRICUBIC, true, 50, x,
+                                                 w) == ESCDF_SUCCESS);
+    for (p = 0; p < 50; p++) {
+        t = dens[p % 6 + 6 * (p % 5 + 5 * (p * 7 % 40))];
+        ck_assert(fabs(v[p] - t) < 1e-10);
+        ck_assert(fabs(w[p] - t) < 1e-10);
+    }
+
+    /* Points between the grid points, in reduced and cartesian coordinates,
+       the cubic stencils staying away from the wrap of the quadratic. */
+    for (p = 0; p < 50; p++) {
+        x[3 * p] = (0.37 * p - floor(0.37 * p)) * 5. / 6.;
+        x[3 * p + 1] = (0.61 * p - floor(0.61 * p)) * 4. / 5.;
+        x[3 * p + 2] = (1. + 36.9 * (0.13 * p - floor(0.13 * p))) / 40.;
+        for (i = 0; i < 3; i++) {
+            r[3 * p + i] = x[3 * p] * darr[i] + x[3 * p + 1] * darr[3 + i] +
+                x[3 * p + 2] * darr[6 + i];
+        }
+    }
+    ck_assert(escdf_grid_scalarfield_interpolate(scalarfield, file_id, 0,
+                                                 ESCDF_INTERPOLATION_TRILINEAR, false, 50, r,
+                                                 v) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_interpolate(scalarfield, file_id, 0,
+                                                 ESCDF_INTERPOLATION_TRICUBIC, true, 50, x,
+                                                 w) == ESCDF_SUCCESS);
+    for (p = 0; p < 50; p++) {
+        u[0] = x[3 * p] * 6.;
+        u[1] = x[3 * p + 1] * 5.;
+        u[2] = x[3 * p + 2] * 40.;
+        k = (unsigned int)floor(u[2]);
+        t = u[2] - k;
+        h0 = 0.1 * k * (40. - k);
+        h1 = 0.1 * (k + 1) * (39. - k);
+        ck_assert(fabs(v[p] - (2. * u[0] - 3. * u[1] + (1. - t) * h0 + t * h1)) < 1e-9);
+        if (u[0] >= 1. && u[0] <= 4. && u[1] >= 1. && u[1] <= 3.) {
+            ck_assert(fabs(w[p] - (2. * u[0] - 3. * u[1] + 0.1 * u[2] * (40. - u[2]))) < 1e-9);
+        }
+    }
+
+    /* Outside of the grid along a free dimension. */
+    x[0] = 5.5 / 6.;
+    ck_assert(escdf_grid_scalarfield_interpolate(scalarfield, file_id, 0,
+                                                 ESCDF_INTERPOLATION_TRILINEAR, true, 50, x,
+                                                 v) == ESCDF_ERANGE);
+    ck_assert(escdf_grid_scalarfield_interpolate(scalarfield, file_id, 1,
+                                                 ESCDF_INTERPOLATION_TRILINEAR, true, 50, x,
+                                                 v) == ESCDF_ERANGE);
+    escdf_close(file_id);
+
+    free(dens);
+    escdf_grid_scalarfield_free(scalarfield);
+}
+END_TEST
+
+START_TEST(test_cache)
+{
+    escdf_handle_t *file_id;
+    escdf_grid_scalarfield_t *scalarfield, *other;
+    escdf_grid_scalarfield_cache_statistics_t stats;
+    escdf_direction_type dirarr[3] = {ESCDF_DIRECTION_PERIODIC, ESCDF_DIRECTION_PERIODIC,
+                                      ESCDF_DIRECTION_PERIODIC};
+    unsigned int uarr[3] = {20, 18, 17};
+    double darr[9] = {1., 0., 0., 0., 1., 0., 0., 0., 1.};
+    double *dens, buf[2 * 100], x[3 * 10], v[10], w[10];
+    unsigned int tbl[100], *ordering, i, p, pass;
+
+    scalarfield = escdf_grid_scalarfield_new(NULL);
+    escdf_grid_scalarfield_set_number_of_physical_dimensions(scalarfield, 3);
+    escdf_grid_scalarfield_set_dimension_types(scalarfield, dirarr, 3);
+    escdf_grid_scalarfield_set_lattice_vectors(scalarfield, darr, 9);
+    escdf_grid_scalarfield_set_number_of_grid_points(scalarfield, uarr, 3);
+    escdf_grid_scalarfield_set_number_of_components(scalarfield, 2);
+    escdf_grid_scalarfield_set_real_or_complex(scalarfield, ESCDF_REAL);
+    escdf_grid_scalarfield_set_use_default_ordering(scalarfield, true);
+    dens = malloc(sizeof(double) * 2 * 6120);
+    ordering = malloc(sizeof(unsigned int) * 6120);
+    for (i = 0; i < 6120; i++) {
+        dens[i] = (double)i;
+        dens[6120 + i] = -0.5 * i;
+        ordering[i] = (i * 7) % 6120;
+    }
+    for (p = 0; p < 100; p++) {
+        tbl[p] = (p * 2749) % 6120;
+    }
+    for (p = 0; p < 10; p++) {
+        x[3 * p] = 0.093 * p;
+        x[3 * p + 1] = 0.5 - 0.071 * p;
+        x[3 * p + 2] = 0.019 * p * p;
+    }
+
+    file_id = escdf_create("tmp_grid_scalarfield_cache.h5", NULL);
+    ck_assert(file_id != NULL);
+    ck_assert(escdf_grid_scalarfield_write_metadata(scalarfield, file_id) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_write_values_on_grid(scalarfield, file_id, dens, NULL,
+                                                          NULL, NULL, NULL) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_interpolate(scalarfield, file_id, 1,
+                                                 ESCDF_INTERPOLATION_TRICUBIC, true, 10, x,
+                                                 v) == ESCDF_SUCCESS);
+
+    /* Room for 3 blocks of 4096 grid points, out of the 6 read. */
+    ck_assert(escdf_grid_scalarfield_get_cache_size(scalarfield) == 0);
+    ck_assert(escdf_grid_scalarfield_set_cache_size(scalarfield, 3 * 4096 * 2 * sizeof(double)) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_get_cache_size(scalarfield) == 3 * 4096 * 2 * sizeof(double));
+    ck_assert(escdf_grid_scalarfield_read_values_on_grid_sliced(scalarfield, file_id, buf,
+                                                                tbl, 100) == ESCDF_SUCCESS);
+    for (p = 0; p < 100; p++) {
+        ck_assert(buf[p] == dens[tbl[p]]);
+        ck_assert(buf[100 + p] == dens[6120 + tbl[p]]);
+    }
+    ck_assert(escdf_grid_scalarfield_get_cache_statistics(scalarfield, &stats) == ESCDF_SUCCESS);
+    ck_assert(stats.misses == 6);
+    ck_assert(stats.hits == 0);
+    ck_assert(stats.evictions == 3);
+
+    /* The last blocks read are still there. */
+    tbl[0] = 6080;
+    ck_assert(escdf_grid_scalarfield_read_values_on_grid_sliced(scalarfield, file_id, buf,
+                                                                tbl, 1) == ESCDF_SUCCESS);
+    ck_assert(buf[0] == dens[6080]);
+    escdf_grid_scalarfield_get_cache_statistics(scalarfield, &stats);
+    ck_assert(stats.misses == 6);
+    ck_assert(stats.hits == 1);
+
+    /* The same interpolation through the cache. */
+    ck_assert(escdf_grid_scalarfield_interpolate(scalarfield, file_id, 1,
+                                                 ESCDF_INTERPOLATION_TRICUBIC, true, 10, x,
+                                                 w) == ESCDF_SUCCESS);
+    for (p = 0; p < 10; p++) {
+        ck_assert(fabs(v[p] - w[p]) < 1e-12);
+    }
+
+    /* Reading ahead of the first block. */
+    escdf_grid_scalarfield_clear_cache(scalarfield);
+    ck_assert(escdf_grid_scalarfield_set_cache_read_ahead(scalarfield, 2) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_get_cache_read_ahead(scalarfield) == 2);
+    tbl[0] = 0;
+    tbl[1] = 19;
+    ck_assert(escdf_grid_scalarfield_read_values_on_grid_sliced(scalarfield, file_id, buf,
+                                                                tbl, 1) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_read_values_on_grid_sliced(scalarfield, file_id, buf,
+                                                                tbl + 1, 1) == ESCDF_SUCCESS);
+    ck_assert(buf[0] == dens[19]);
+    escdf_grid_scalarfield_get_cache_statistics(scalarfield, &stats);
+    ck_assert(stats.misses == 1);
+    ck_assert(stats.read_ahead == 2);
+    ck_assert(stats.hits == 1);
+
+    /* Writing drops the cached blocks. */
+    for (i = 0; i < 2 * 6120; i++) {
+        dens[i] += 1.;
+    }
+    ck_assert(escdf_grid_scalarfield_write_values_on_grid(scalarfield, file_id, dens, NULL,
+                                                          NULL, NULL, NULL) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_read_values_on_grid_sliced(scalarfield, file_id, buf,
+                                                                tbl + 1, 1) == ESCDF_SUCCESS);
+    ck_assert(buf[0] == dens[19]);
+    ck_assert(buf[1] == dens[6120 + 19]);
+    escdf_close(file_id);
+
+    /* The blocks of a closed file are not taken for the ones of the next
+       file opened, even when its handle gets the same address. */
+    other = escdf_grid_scalarfield_new(NULL);
+    escdf_grid_scalarfield_set_number_of_physical_dimensions(other, 3);
+    escdf_grid_scalarfield_set_dimension_types(other, dirarr, 3);
+    escdf_grid_scalarfield_set_lattice_vectors(other, darr, 9);
+    escdf_grid_scalarfield_set_number_of_grid_points(other, uarr, 3);
+    escdf_grid_scalarfield_set_number_of_components(other, 2);
+    escdf_grid_scalarfield_set_real_or_complex(other, ESCDF_REAL);
+    escdf_grid_scalarfield_set_use_default_ordering(other, true);
+    for (i = 0; i < 2 * 6120; i++) {
+        dens[i] += 1.;
+    }
+    file_id = escdf_create("tmp_grid_scalarfield_cache_other.h5", NULL);
+    ck_assert(file_id != NULL);
+    ck_assert(escdf_grid_scalarfield_write_metadata(other, file_id) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_write_values_on_grid(other, file_id, dens, NULL,
+                                                          NULL, NULL, NULL) == ESCDF_SUCCESS);
+    escdf_close(file_id);
+    escdf_grid_scalarfield_free(other);
+    file_id = escdf_open("tmp_grid_scalarfield_cache_other.h5", NULL);
+    ck_assert(file_id != NULL);
+    ck_assert(escdf_grid_scalarfield_read_values_on_grid_sliced(scalarfield, file_id, buf,
+                                                                tbl + 1, 1) == ESCDF_SUCCESS);
+    ck_assert(buf[0] == dens[19]);
+    ck_assert(buf[1] == dens[6120 + 19]);
+    escdf_close(file_id);
+
+    /* Without the default ordering, the blocks are ranges of values, with
+       the cache then without. */
+    for (pass = 0; pass < 2; pass++) {
+        escdf_grid_scalarfield_set_use_default_ordering(scalarfield, false);
+        file_id = escdf_create("tmp_grid_scalarfield_cache.h5", NULL);
+        ck_assert(file_id != NULL);
+        ck_assert(escdf_grid_scalarfield_write_metadata(scalarfield, file_id) == ESCDF_SUCCESS);
+        ck_assert(escdf_grid_scalarfield_write_values_on_grid_sliced(scalarfield, file_id, dens,
+                                                                     ordering, 6120) == ESCDF_SUCCESS);
+        for (p = 0; p < 100; p++) {
+            tbl[p] = (p * 2749) % 6120;
+        }
+        ck_assert(escdf_grid_scalarfield_read_values_on_grid_sliced(scalarfield, file_id, buf,
+                                                                    tbl, 100) == ESCDF_SUCCESS);
+        for (p = 0; p < 100; p++) {
+            ck_assert(buf[p] == dens[(unsigned long)tbl[p] * 2623 % 6120]);
+        }
+        escdf_close(file_id);
+        escdf_grid_scalarfield_set_cache_size(scalarfield, 0);
+    }
+
+    free(ordering);
+    free(dens);
+    escdf_grid_scalarfield_free(scalarfield);
+}
+END_TEST
+
+START_TEST(test_map_values_on_grid)
+{
+    escdf_handle_t *file_id;
+    escdf_grid_scalarfield_t *scalarfield;
+    escdf_direction_type dirarr[3] = {ESCDF_DIRECTION_PERIODIC, ESCDF_DIRECTION_PERIODIC,
+                                      ESCDF_DIRECTION_PERIODIC};
+    unsigned int uarr[3] = {10, 8, 6};
+    double darr[9] = {1., 0., 0., 0., 1., 0., 0., 0., 1.};
+    double dens[2 * 480], buf[2 * 480];
+    const double *values;
+    char cwd[4096];
+    unsigned int i;
+
+    scalarfield = escdf_grid_scalarfield_new(NULL);
+    escdf_grid_scalarfield_set_number_of_physical_dimensions(scalarfield, 3);
+    escdf_grid_scalarfield_set_dimension_types(scalarfield, dirarr, 3);
+    escdf_grid_scalarfield_set_lattice_vectors(scalarfield, darr, 9);
+    escdf_grid_scalarfield_set_number_of_grid_points(scalarfield, uarr, 3);
+    escdf_grid_scalarfield_set_number_of_components(scalarfield, 2);
+    escdf_grid_scalarfield_set_real_or_complex(scalarfield, ESCDF_REAL);
+    escdf_grid_scalarfield_set_use_default_ordering(scalarfield, true);
+    for (i = 0; i < 2 * 480; i++) {
+        dens[i] = 0.25 * i - 3.;
+    }
+
+    /* Mapped while the file is still being written. */
+    file_id = escdf_create("tmp_grid_scalarfield_map.h5", NULL);
+    ck_assert(file_id != NULL);
+    ck_assert(escdf_grid_scalarfield_write_metadata(scalarfield, file_id) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_write_values_on_grid(scalarfield, file_id, dens, NULL,
+                                                          NULL, NULL, NULL) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_map_values_on_grid(scalarfield, file_id,
+                                                        &values) == ESCDF_SUCCESS);
+    ck_assert(values != NULL);
+    for (i = 0; i < 2 * 480; i++) {
+        ck_assert(values[i] == dens[i]);
+    }
+    escdf_close(file_id);
+    /* The view outlives the handle. */
+    ck_assert(values[2 * 480 - 1] == dens[2 * 480 - 1]);
+    ck_assert(escdf_grid_scalarfield_map_values_on_grid(scalarfield, NULL,
+                                                        &values) == ESCDF_EOBJECT);
+
+    file_id = escdf_open("tmp_grid_scalarfield_map.h5", NULL);
+    ck_assert(file_id != NULL);
+    ck_assert(escdf_grid_scalarfield_map_values_on_grid(scalarfield, file_id,
+                                                        &values) == ESCDF_SUCCESS);
+    for (i = 0; i < 2 * 480; i++) {
+        ck_assert(values[i] == dens[i]);
+    }
+    escdf_close(file_id);
+    escdf_grid_scalarfield_unmap_values_on_grid(scalarfield);
+    escdf_grid_scalarfield_unmap_values_on_grid(scalarfield);
+
+    /* Opened by a relative name, then out of its directory: the values are
+       read instead. */
+    ck_assert(getcwd(cwd, sizeof(cwd)) != NULL);
+    file_id = escdf_open("tmp_grid_scalarfield_map.h5", NULL);
+    ck_assert(file_id != NULL);
+    ck_assert(chdir("..") == 0);
+    ck_assert(escdf_grid_scalarfield_map_values_on_grid(scalarfield, file_id,
+                                                        &values) == ESCDF_ENOSUPPORT);
+    ck_assert(values == NULL);
+    ck_assert(escdf_grid_scalarfield_read_values_on_grid(scalarfield, file_id, buf, NULL,
+                                                         NULL, NULL) == ESCDF_SUCCESS);
+    ck_assert(buf[2 * 480 - 1] == dens[2 * 480 - 1]);
+    ck_assert(chdir(cwd) == 0);
+    escdf_close(file_id);
+
+    /* Chunked data sets must be read. */
+    ck_assert(escdf_grid_scalarfield_set_chunk_size(scalarfield, 64) == ESCDF_SUCCESS);
+    file_id = escdf_create("tmp_grid_scalarfield_map.h5", NULL);
+    ck_assert(file_id != NULL);
+    ck_assert(escdf_grid_scalarfield_write_metadata(scalarfield, file_id) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_write_values_on_grid(scalarfield, file_id, dens, NULL,
+                                                          NULL, NULL, NULL) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_map_values_on_grid(scalarfield, file_id,
+                                                        &values) == ESCDF_ENOSUPPORT);
+    ck_assert(values == NULL);
+    escdf_close(file_id);
+
+    escdf_grid_scalarfield_free(scalarfield);
+}
+END_TEST
+
 Suite * make_grid_scalarfield_suite(void)
 {
     Suite *s;
@@ -608,10 +1693,21 @@ Suite * make_grid_scalarfield_suite(void)
     tcase_add_test(tc_info, test_set_number_of_components);
     tcase_add_test(tc_info, test_set_real_or_complex);
     tcase_add_test(tc_info, test_set_use_default_ordering);
+    tcase_add_test(tc_info, test_set_storage);
     tcase_add_test(tc_info, test_write_metadata);
+    tcase_add_test(tc_info, test_write_packed_metadata);
     tcase_add_test(tc_info, test_read_values_on_grid);
     tcase_add_test(tc_info, test_write_values_on_grid);
+    tcase_add_test(tc_info, test_write_values_on_grid_multi);
     tcase_add_test(tc_info, test_read_values_on_grid_sliced);
+    tcase_add_test(tc_info, test_read_values_on_grid_threads);
+    tcase_add_test(tc_info, test_values_on_grid_chunks);
+    tcase_add_test(tc_info, test_reduce);
+    tcase_add_test(tc_info, test_write_statistics);
+    tcase_add_test(tc_info, test_pyramid);
+    tcase_add_test(tc_info, test_interpolate);
+    tcase_add_test(tc_info, test_cache);
+    tcase_add_test(tc_info, test_map_values_on_grid);
     suite_add_tcase(s, tc_info);
 
     return s;
@@ -82,6 +82,18 @@ START_TEST(test_handle_create_path)
 }
 END_TEST
 
+START_TEST(test_handle_trusted)
+{
+    escdf_handle_t *handle;
+
+    ck_assert((handle = escdf_open(FILE, NULL)) != NULL);
+    ck_assert(!escdf_is_trusted(handle));
+    escdf_set_trusted(handle, true);
+    ck_assert(escdf_is_trusted(handle));
+    ck_assert(escdf_close(handle) == ESCDF_SUCCESS);
+}
+END_TEST
+
 
 Suite * make_handle_suite(void)
 {
@@ -100,6 +112,7 @@ Suite * make_handle_suite(void)
     tcase_add_checked_fixture(tc_handle_existing, handle_setup, handle_teardown);
     tcase_add_test(tc_handle_existing, test_handle_open);
     tcase_add_test(tc_handle_existing, test_handle_open_path);
+    tcase_add_test(tc_handle_existing, test_handle_trusted);
     suite_add_tcase(s, tc_handle_existing);
 
     return s;
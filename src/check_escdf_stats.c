@@ -0,0 +1,140 @@
+/*
+  Copyright (C) 2016 D. Caliste, F. Corsetti, M. Oliveira, Y. Pouillon, and D. Strubbe
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+/**
+ * @file check_escdf_stats.c
+ * @brief checks escdf_stats.c and escdf_stats.h
+ */
+
+#include <stdlib.h>
+#include <check.h>
+
+#include "escdf_grid_scalarfields.h"
+#include "escdf_stats.h"
+
+#if defined HAVE_CONFIG_H
+#include "config.h"
+#else
+#define ESCDF_CHK_DATADIR "."
+#endif
+
+static escdf_handle_t *handle;
+
+void stats_setup(void)
+{
+    handle = escdf_open(ESCDF_CHK_DATADIR "/grid_scalarfield_read.h5", NULL);
+}
+
+void stats_teardown(void)
+{
+    escdf_close(handle);
+}
+
+START_TEST(test_stats_disabled)
+{
+    escdf_stats_t stats;
+    escdf_grid_scalarfield_t *scalarfield;
+
+    ck_assert(handle != NULL);
+    ck_assert(!escdf_stats_is_enabled(handle));
+
+    scalarfield = escdf_grid_scalarfield_new("densities/pseudo_density");
+    ck_assert(escdf_grid_scalarfield_read_metadata(scalarfield, handle) == ESCDF_SUCCESS);
+    escdf_grid_scalarfield_free(scalarfield);
+
+    ck_assert(escdf_stats_get(handle, &stats) == ESCDF_SUCCESS);
+    ck_assert(stats.calls[ESCDF_STATS_READ_METADATA] == 0);
+    ck_assert(stats.opens == 0);
+}
+END_TEST
+
+START_TEST(test_stats_record)
+{
+    escdf_stats_t stats;
+    escdf_grid_scalarfield_t *scalarfield;
+    double dens[108];
+    hsize_t start[3] = {0, 2, 0};
+    hsize_t count[3] = {2, 2, 1};
+
+    ck_assert(handle != NULL);
+    ck_assert(escdf_stats_enable(handle, false) == ESCDF_SUCCESS);
+    ck_assert(escdf_stats_is_enabled(handle));
+
+    scalarfield = escdf_grid_scalarfield_new("densities/pseudo_density");
+    ck_assert(escdf_grid_scalarfield_read_metadata(scalarfield, handle) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_read_values_on_grid(scalarfield, handle, dens,
+                                                         NULL, NULL, NULL) == ESCDF_SUCCESS);
+    ck_assert(escdf_grid_scalarfield_read_values_on_grid(scalarfield, handle, dens,
+                                                         start, count, NULL) == ESCDF_SUCCESS);
+    escdf_grid_scalarfield_free(scalarfield);
+
+    ck_assert(escdf_stats_get(handle, &stats) == ESCDF_SUCCESS);
+    ck_assert(stats.calls[ESCDF_STATS_READ_METADATA] == 1);
+    ck_assert(stats.bytes[ESCDF_STATS_READ_METADATA] > 0);
+    ck_assert(stats.calls[ESCDF_STATS_READ_DATA] == 2);
+    ck_assert(stats.bytes[ESCDF_STATS_READ_DATA] == (108 + 4) * sizeof(double));
+    ck_assert(stats.calls[ESCDF_STATS_WRITE_DATA] == 0);
+    ck_assert(stats.selections == 2);
+    ck_assert(stats.opens >= 5);
+    ck_assert(escdf_stats_metadata_time(&stats) >= 0.);
+    ck_assert(escdf_stats_raw_time(&stats) >= 0.);
+
+    ck_assert(escdf_stats_reset(handle) == ESCDF_SUCCESS);
+    ck_assert(escdf_stats_get(handle, &stats) == ESCDF_SUCCESS);
+    ck_assert(stats.calls[ESCDF_STATS_READ_DATA] == 0);
+    ck_assert(stats.selections == 0);
+
+    ck_assert(escdf_stats_disable(handle) == ESCDF_SUCCESS);
+    ck_assert(!escdf_stats_is_enabled(handle));
+}
+END_TEST
+
+START_TEST(test_stats_print)
+{
+    FILE *f;
+
+    ck_assert(handle != NULL);
+    ck_assert(escdf_stats_enable(handle, false) == ESCDF_SUCCESS);
+
+    f = tmpfile();
+    ck_assert(f != NULL);
+    ck_assert(escdf_stats_print(handle, f) == ESCDF_SUCCESS);
+    ck_assert(escdf_stats_report(handle, f) == ESCDF_SUCCESS);
+    ck_assert(ftell(f) > 0);
+    fclose(f);
+}
+END_TEST
+
+
+Suite * make_stats_suite(void)
+{
+    Suite *s;
+    TCase *tc_stats;
+
+    s = suite_create("Stats");
+
+    tc_stats = tcase_create("Record");
+    tcase_add_checked_fixture(tc_stats, stats_setup, stats_teardown);
+    tcase_add_test(tc_stats, test_stats_disabled);
+    tcase_add_test(tc_stats, test_stats_record);
+    tcase_add_test(tc_stats, test_stats_print);
+    suite_add_tcase(s, tc_stats);
+
+    return s;
+}
@@ -17,9 +17,16 @@
 
 */
 
+#include <stdint.h>
+#include <stdlib.h>
 #include <check.h>
 
+#include "escdf_error.h"
 #include "utils.h"
+#include "utils_hdf5.h"
+
+#define FILE_RANGE "tmp_utils_range.h5"
+#define FILE_SWAP "tmp_utils_swap.h5"
 
 START_TEST(test_set_bool)
 {
@@ -53,11 +60,129 @@ START_TEST(test_set_double)
 }
 END_TEST
 
+START_TEST(test_minmax)
+{
+    int vi[5] = {3, -7, 12, 0, 5}, imin, imax;
+    unsigned int vu[4] = {4, 9, 1, 6}, umin, umax;
+    double vd[4] = {0. / 0., 2.5, -1., 0. / 0.}, dmin, dmax;
+
+    utils_minmax_int(vi, 5, &imin, &imax);
+    ck_assert(imin == -7 && imax == 12);
+    utils_minmax_uint(vu, 4, &umin, &umax);
+    ck_assert(umin == 1 && umax == 9);
+    utils_minmax_dbl(vd, 4, &dmin, &dmax);
+    ck_assert(dmin == -1. && dmax == 2.5);
+    utils_minmax_int(vi + 2, 1, &imin, &imax);
+    ck_assert(imin == 12 && imax == 12);
+}
+END_TEST
+
+START_TEST(test_read_array_into)
+{
+    hid_t file_id;
+    hsize_t dims[1] = {4};
+    int values[4] = {0, 1, 2, 3}, check[4];
+    int range[2] = {0, 2};
+    int *array;
+    unsigned int i;
+
+    file_id = H5Fcreate(FILE_RANGE, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    ck_assert(file_id >= 0);
+    ck_assert(utils_hdf5_write_attr(file_id, "values", H5T_STD_I32LE, dims, 1,
+                                    H5T_NATIVE_INT, values) == ESCDF_SUCCESS);
+
+    /* Out of range, unless the check is skipped. */
+    ck_assert(utils_hdf5_read_int_array_into(file_id, "values", check, dims, 1,
+                                             range) == ESCDF_ERANGE);
+    ck_assert(utils_hdf5_read_int_array(file_id, "values", &array, dims, 1,
+                                        range) == ESCDF_ERANGE);
+    ck_assert(array == NULL);
+    ck_assert(utils_hdf5_read_int_array_into(file_id, "values", check, dims, 1,
+                                             NULL) == ESCDF_SUCCESS);
+    range[1] = 3;
+    ck_assert(utils_hdf5_read_int_array(file_id, "values", &array, dims, 1,
+                                        range) == ESCDF_SUCCESS);
+    for (i = 0; i < 4; i++) {
+        ck_assert(check[i] == values[i]);
+        ck_assert(array[i] == values[i]);
+    }
+    free(array);
+
+    H5Fclose(file_id);
+}
+END_TEST
+
+START_TEST(test_swap_bytes)
+{
+    uint16_t v16[3] = {0x0102, 0x0304, 0x0506};
+    uint32_t v32[3] = {0x01020304u, 0x05060708u, 0x090a0b0cu};
+    uint64_t v64[2] = {0x0102030405060708ull, 0x090a0b0c0d0e0f10ull};
+    unsigned char v3[6] = {1, 2, 3, 4, 5, 6};
+
+    utils_swap_bytes(v16, 3, 2);
+    ck_assert(v16[0] == 0x0201 && v16[1] == 0x0403 && v16[2] == 0x0605);
+    utils_swap_bytes(v32, 3, 4);
+    ck_assert(v32[0] == 0x04030201u && v32[1] == 0x08070605u && v32[2] == 0x0c0b0a09u);
+    utils_swap_bytes(v64, 2, 8);
+    ck_assert(v64[0] == 0x0807060504030201ull && v64[1] == 0x100f0e0d0c0b0a09ull);
+    utils_swap_bytes(v3, 2, 3);
+    ck_assert(v3[0] == 3 && v3[1] == 2 && v3[2] == 1 &&
+              v3[3] == 6 && v3[4] == 5 && v3[5] == 4);
+}
+END_TEST
+
+START_TEST(test_conversion)
+{
+    ck_assert(utils_hdf5_conversion(H5T_STD_U32LE, H5T_STD_U32LE) == UTILS_HDF5_CONV_NONE);
+    ck_assert(utils_hdf5_conversion(H5T_STD_U32LE, H5T_STD_U32BE) == UTILS_HDF5_CONV_SWAP);
+    ck_assert(utils_hdf5_conversion(H5T_IEEE_F64BE, H5T_IEEE_F64LE) == UTILS_HDF5_CONV_SWAP);
+    ck_assert(utils_hdf5_conversion(H5T_STD_I32LE, H5T_STD_U32LE) == UTILS_HDF5_CONV_HDF5);
+    ck_assert(utils_hdf5_conversion(H5T_STD_I32LE, H5T_STD_U32BE) == UTILS_HDF5_CONV_HDF5);
+    ck_assert(utils_hdf5_conversion(H5T_IEEE_F32LE, H5T_IEEE_F64LE) == UTILS_HDF5_CONV_HDF5);
+}
+END_TEST
+
+START_TEST(test_dataset_swapped)
+{
+    hid_t file_id, dtset_id;
+    hsize_t dims[1] = {5}, start[1] = {1}, count[1] = {3};
+    double values[5] = {1., -2.5, 3.25, 1e300, -0.}, raw[5], check[5];
+    H5T_order_t order;
+    hid_t foreign;
+    unsigned int i;
+
+    /* A data set in the byte order that is not the native one. */
+    order = H5Tget_order(H5T_NATIVE_DOUBLE);
+    foreign = (order == H5T_ORDER_LE) ? H5T_IEEE_F64BE : H5T_IEEE_F64LE;
+    file_id = H5Fcreate(FILE_SWAP, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    ck_assert(file_id >= 0);
+    ck_assert(utils_hdf5_create_dataset(file_id, "values", foreign, dims, 1,
+                                        H5P_DEFAULT, &dtset_id) == ESCDF_SUCCESS);
+
+    ck_assert(utils_hdf5_write_dataset(dtset_id, H5P_DEFAULT, values, H5T_NATIVE_DOUBLE,
+                                       NULL, NULL, NULL) == ESCDF_SUCCESS);
+    ck_assert(H5Dread(dtset_id, foreign, H5S_ALL, H5S_ALL, H5P_DEFAULT, raw) >= 0);
+    utils_swap_bytes(raw, 5, sizeof(double));
+    for (i = 0; i < 5; i++) {
+        ck_assert(raw[i] == values[i]);
+    }
+
+    ck_assert(utils_hdf5_read_dataset(dtset_id, H5P_DEFAULT, check, H5T_NATIVE_DOUBLE,
+                                      start, count, NULL) == ESCDF_SUCCESS);
+    for (i = 0; i < 3; i++) {
+        ck_assert(check[i] == values[i + 1]);
+    }
+
+    H5Dclose(dtset_id);
+    H5Fclose(file_id);
+}
+END_TEST
+
 
 Suite * make_utils_suite(void)
 {
     Suite *s;
-    TCase *tc_set;
+    TCase *tc_set, *tc_range, *tc_order;
 
     s = suite_create("Utils");
 
@@ -68,5 +193,16 @@ Suite * make_utils_suite(void)
     tcase_add_test(tc_set, test_set_double);
     suite_add_tcase(s, tc_set);
 
+    tc_range = tcase_create("Range checks");
+    tcase_add_test(tc_range, test_minmax);
+    tcase_add_test(tc_range, test_read_array_into);
+    suite_add_tcase(s, tc_range);
+
+    tc_order = tcase_create("Byte order");
+    tcase_add_test(tc_order, test_swap_bytes);
+    tcase_add_test(tc_order, test_conversion);
+    tcase_add_test(tc_order, test_dataset_swapped);
+    suite_add_tcase(s, tc_order);
+
     return s;
 }
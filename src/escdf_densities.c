@@ -17,151 +17,347 @@
 
 */
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "escdf_densities.h"
 
 #include "utils.h"
+#include "utils_hdf5.h"
+#include "utils_stats.h"
+
+/******************************************************************************
+ * Data structures                                                            *
+ ******************************************************************************/
+
+/* Group names of the known types of densities. */
+static const char *density_names[ESCDF_DENSITY_UNKNOWN] = {
+    "pseudo_density", "core_density", "total_density", "atom_core_density"
+};
 
 struct _density_t {
+    char *name;
     escdf_density_type_t type;
-    union {
-        _grid_scalarfield_t *grid_scalarfield;
-    };
-    _density_t *next;
+    bool on_grid; /**< The group holds values_on_grid */
+    bool radial; /**< The group holds radial_values */
+
+    /* Read on first access. */
+    escdf_grid_scalarfield_t *grid_scalarfield;
+    escdf_radial_densities_t *radial_densities;
 };
 
 struct _escdf_densities_t {
     char *path;
+    escdf_handle_t *file_id; /**< Handle the metadata is read from */
     _uint_set_t number_of_densities;
 
+    /* The densities, in the order of the group, and the index of the first
+       one of each type, -1 if none. */
     struct _density_t *densities;
+    unsigned int capacity;
+    int by_type[ESCDF_DENSITY_UNKNOWN];
 };
 
-escdf_densities_t* escdf_densities_new(const char *path)
-{
+/* State of the iteration over the links of the densities group. */
+typedef struct {
     escdf_densities_t *densities;
+    escdf_errno_t err;
+} _iterate_t;
 
-    densities = malloc(sizeof(escdf_densities_t));
-    if (!path || !path[0]) {
-        densities->path = strdup("densities");
-    } else {
-        densities->path = strdup(path);
+
+/******************************************************************************
+ * Private functions                                                          *
+ ******************************************************************************/
+
+static void _clear_densities(escdf_densities_t *densities)
+{
+    unsigned int i;
+
+    for (i = 0; i < densities->number_of_densities.value; i++) {
+        free(densities->densities[i].name);
+        escdf_grid_scalarfield_free(densities->densities[i].grid_scalarfield);
+        escdf_radial_densities_free(densities->densities[i].radial_densities);
     }
-    densities->number_of_densities.value = 0;
-    densities->number_of_densities.value = false;
+    free(densities->densities);
     densities->densities = NULL;
-    
-    return densities;
+    densities->capacity = 0;
+    densities->number_of_densities.value = 0;
+    densities->number_of_densities.is_set = false;
+    for (i = 0; i < ESCDF_DENSITY_UNKNOWN; i++) {
+        densities->by_type[i] = -1;
+    }
 }
 
-void escdf_densities_free(escdf_densities_t *densities)
+/**
+ * Adds a density for each subgroup: its type comes from its name, and it is
+ * on a grid when it holds values_on_grid, radial when it holds
+ * radial_values. Other objects are skipped.
+ */
+static herr_t _add_density(hid_t gid, const char *name, const H5L_info_t *info,
+                           void *op_data)
 {
-    struct _density_t *iter, *current;
-
-    if (!densities)
-        return;
+    _iterate_t *iter;
+    escdf_densities_t *densities;
+    struct _density_t *density;
+    hid_t oid;
+    htri_t on_grid, radial;
+    H5I_type_t type;
+    unsigned int t;
+    void *tmp;
+
+    iter = op_data;
+    densities = iter->densities;
+    (void)info;
+
+    if ((oid = H5Oopen(gid, name, H5P_DEFAULT)) < 0) {
+        DEFER_FUNC_ERROR(oid);
+        iter->err = ESCDF_ERROR;
+        return -1;
+    }
+    utils_stats_count_open();
+    type = H5Iget_type(oid);
+    on_grid = (type == H5I_GROUP) ? H5Lexists(oid, "values_on_grid", H5P_DEFAULT) : 0;
+    radial = (type == H5I_GROUP) ? H5Lexists(oid, "radial_values", H5P_DEFAULT) : 0;
+    H5Oclose(oid);
+    if (type != H5I_GROUP) {
+        return 0;
+    }
+    if (on_grid < 0 || radial < 0) {
+        DEFER_FUNC_ERROR(ESCDF_ERROR);
+        iter->err = ESCDF_ERROR;
+        return -1;
+    }
 
-    free(densities->path);
-    iter = densities->densities;
-    while (iter) {
-        switch (iter->type) {
-        case (ESCDF_DENSITY_GRID_PSEUDO):
-        case (ESCDF_DENSITY_GRID_CORE):
-        case (ESCDF_DENSITY_GRID_TOTAL):
-            escdf_grid_scalarfield_free(iter->grid_scalarfield);
+    if (densities->number_of_densities.value == densities->capacity) {
+        densities->capacity = (densities->capacity > 0) ? 2 * densities->capacity : 8;
+        tmp = realloc(densities->densities, sizeof(struct _density_t) * densities->capacity);
+        if (tmp == NULL) {
+            DEFER_FUNC_ERROR(ESCDF_ENOMEM);
+            iter->err = ESCDF_ENOMEM;
+            return -1;
+        }
+        densities->densities = tmp;
+    }
+    density = densities->densities + densities->number_of_densities.value;
+    if ((density->name = strdup(name)) == NULL) {
+        DEFER_FUNC_ERROR(ESCDF_ENOMEM);
+        iter->err = ESCDF_ENOMEM;
+        return -1;
+    }
+    density->type = ESCDF_DENSITY_UNKNOWN;
+    for (t = 0; t < ESCDF_DENSITY_UNKNOWN; t++) {
+        if (strcmp(name, density_names[t]) == 0) {
+            density->type = (escdf_density_type_t)t;
             break;
-        default:
-            escdf_return_if_fails(false);
         }
-        current = iter;
-        iter = iter->next;
-        free(current);
     }
+    density->on_grid = (on_grid > 0);
+    density->radial = (radial > 0);
+    density->grid_scalarfield = NULL;
+    density->radial_densities = NULL;
+    if (density->type != ESCDF_DENSITY_UNKNOWN && densities->by_type[density->type] < 0) {
+        densities->by_type[density->type] = (int)densities->number_of_densities.value;
+    }
+    densities->number_of_densities.value += 1;
+
+    return 0;
+}
+
+static struct _density_t* _get_density_from_i(const escdf_densities_t *densities,
+                                              const unsigned int i_density)
+{
+    FULFILL_OR_RETURN_VAL(densities, ESCDF_EOBJECT, NULL);
+    FULFILL_OR_RETURN_VAL(i_density < densities->number_of_densities.value, ESCDF_ERANGE, NULL);
+
+    return densities->densities + i_density;
+}
+
+static struct _density_t* _get_density_from_type(const escdf_densities_t *densities,
+                                                 const escdf_density_type_t type)
+{
+    FULFILL_OR_RETURN_VAL(densities, ESCDF_EOBJECT, NULL);
+    FULFILL_OR_RETURN_VAL(type < ESCDF_DENSITY_UNKNOWN, ESCDF_EVALUE, NULL);
+
+    if (densities->by_type[type] < 0) {
+        return NULL;
+    }
+    return densities->densities + densities->by_type[type];
 }
 
-static escdf_err_t _density_from_group(hid_t gid, const gchar *path,
-                                       struct _density_t **density)
+/* Reads the metadata of a density on a grid, on its first access. */
+static escdf_grid_scalarfield_t* _load_grid_scalarfield(const escdf_densities_t *densities,
+                                                        struct _density_t *density)
 {
-    htri_t exists;
-    escdf_err_t err;
+    escdf_grid_scalarfield_t *scalarfield;
+    escdf_errno_t err;
+    char *path;
+
+    FULFILL_OR_RETURN_VAL(density->on_grid, ESCDF_EVALUE, NULL);
 
-    if ((exists = H5Lexists(gid, "values_on_grid",  H5P_DEFAULT)) < 0)
-        return escdf_error(exists);
-    if (exists == TRUE) {
-        *density = malloc(sizeof(struct _density_t));
-        err = escdf_grid_scalarfield_read_metadata(&(*density)->grid_scalarfield, path);
-        if (err == ESCDF_NO_ERROR) {
-            escdf_grid_scalarfield_get_type((*density)->type = ...;
+    /* The lock serialises the loads of the same density by several threads. */
+    utils_hdf5_lock();
+    if (density->grid_scalarfield == NULL) {
+        path = malloc(strlen(densities->path) + strlen(density->name) + 2);
+        if (path == NULL) {
+            utils_hdf5_unlock();
+            DEFER_FUNC_ERROR(ESCDF_ENOMEM);
+            return NULL;
+        }
+        sprintf(path, "%s/%s", densities->path, density->name);
+        scalarfield = escdf_grid_scalarfield_new(path);
+        free(path);
+        if (scalarfield == NULL) {
+            utils_hdf5_unlock();
+            DEFER_FUNC_ERROR(ESCDF_ENOMEM);
+            return NULL;
+        }
+        err = escdf_grid_scalarfield_read_metadata(scalarfield, densities->file_id);
+        if (err == ESCDF_SUCCESS) {
+            density->grid_scalarfield = scalarfield;
+        } else {
+            escdf_grid_scalarfield_free(scalarfield);
         }
-        return err;
     }
+    scalarfield = density->grid_scalarfield;
+    utils_hdf5_unlock();
 
-    /* No known density in thhis group. */
-    return -1;
+    return scalarfield;
 }
 
-escdf_err_t escdf_densities_read_metadata(escdf_densities_t **densities, const char *path)
+/* Reads the radial densities of a density, on its first access. */
+static escdf_radial_densities_t* _load_radial_densities(const escdf_densities_t *densities,
+                                                        struct _density_t *density)
 {
-    herr_t err;
-    H5G_info_t ginfo;
-    hsize_t n;
-    
-    escdf_return_val_if_fails(densities, NULL);
+    escdf_radial_densities_t *radial;
+    escdf_errno_t err;
+    char *path;
 
-    *densities = escdf_densities_new(path);
+    FULFILL_OR_RETURN_VAL(density->radial, ESCDF_EVALUE, NULL);
 
-    /* We traverse objects of current group to find which types of
-       density this group contains, based on main ESCDF variable. */
-    n = 0;
-    do {
-        err = H5Gget_info_by_idx(loc_id, densities->path,
-                                 H5_INDEX_CRT_ORDER, H5_ITER_NATIVE, n++,
-                                 &ginfo, H5P_DEFAULT);
-        if (err >= 0) {
-            
+    utils_hdf5_lock();
+    if (density->radial_densities == NULL) {
+        path = malloc(strlen(densities->path) + strlen(density->name) + 2);
+        if (path == NULL) {
+            utils_hdf5_unlock();
+            DEFER_FUNC_ERROR(ESCDF_ENOMEM);
+            return NULL;
+        }
+        sprintf(path, "%s/%s", densities->path, density->name);
+        radial = escdf_radial_densities_new(path);
+        free(path);
+        if (radial == NULL) {
+            utils_hdf5_unlock();
+            DEFER_FUNC_ERROR(ESCDF_ENOMEM);
+            return NULL;
+        }
+        err = escdf_radial_densities_read(radial, densities->file_id);
+        if (err == ESCDF_SUCCESS) {
+            density->radial_densities = radial;
+        } else {
+            escdf_radial_densities_free(radial);
         }
-    } while (err >= 0);
-    if (n > 1) {
-        densities->number_of_densities.value = n - 1;
-        densities->number_of_densities.is_set = true;
     }
+    radial = density->radial_densities;
+    utils_hdf5_unlock();
 
-    return ESCDF_NO_ERROR;
+    return radial;
 }
 
-unsigned int escdf_densities_get_number_of_densities(const escdf_densities_t *densities)
+
+/******************************************************************************
+ * Global functions                                                           *
+ ******************************************************************************/
+
+escdf_densities_t* escdf_densities_new(const char *path)
 {
-    escdf_return_val_if_fails(densities, 0);
+    escdf_densities_t *densities;
 
-    return densities->number_of_densities.value;
+    densities = calloc(1, sizeof(escdf_densities_t));
+    FULFILL_OR_RETURN_VAL(densities != NULL, ESCDF_ENOMEM, NULL);
+    if (!path || !path[0]) {
+        densities->path = strdup("densities");
+    } else {
+        densities->path = strdup(path);
+    }
+    _clear_densities(densities);
+
+    return densities;
 }
 
-static const struct _density_t* _get_density_from_i(const escdf_densities_t *densities,
-                                               const unsigned int i_density)
+void escdf_densities_free(escdf_densities_t *densities)
 {
-    unsigned int i;
-    struct _density_t *iter;
-    
-    escdf_return_val_if_fails(densities, NULL);
-    escdf_return_val_if_fails(i_density >= densities->number_of_densities, NULL);
+    if (!densities)
+        return;
+
+    _clear_densities(densities);
+    free(densities->path);
+    free(densities);
+}
+
+escdf_errno_t escdf_densities_read_metadata(escdf_densities_t *densities,
+                                            escdf_handle_t *file_id)
+{
+    _iterate_t iter;
+    utils_stats_timer_t timer;
+    hsize_t idx;
+    herr_t err_id;
+    hid_t gid;
+
+    FULFILL_OR_RETURN(densities, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(file_id, ESCDF_EOBJECT);
+
+    utils_stats_start(file_id, &timer);
+    utils_hdf5_lock();
+    _clear_densities(densities);
+    if ((gid = H5Gopen(file_id->group_id, densities->path, H5P_DEFAULT)) < 0) {
+        utils_hdf5_unlock();
+        utils_stats_stop(file_id, &timer, ESCDF_STATS_READ_METADATA);
+        RETURN_WITH_ERROR(gid);
+    }
+    utils_stats_count_open();
+
+    /* A single pass over the links of the group, by name. */
+    iter.densities = densities;
+    iter.err = ESCDF_SUCCESS;
+    idx = 0;
+    err_id = H5Literate(gid, H5_INDEX_NAME, H5_ITER_INC, &idx, _add_density, &iter);
+    H5Gclose(gid);
+    if (err_id < 0) {
+        _clear_densities(densities);
+    } else {
+        densities->number_of_densities.is_set = true;
+        densities->file_id = file_id;
+    }
+    utils_hdf5_unlock();
+    utils_stats_stop(file_id, &timer, ESCDF_STATS_READ_METADATA);
 
-    for (iter = densities->densities, i = 0; iter; iter = iter->next, i++) {
-        if (i == i_density)
-            return iter;
+    if (err_id < 0) {
+        if (iter.err != ESCDF_SUCCESS) {
+            return iter.err;
+        }
+        RETURN_WITH_ERROR(err_id);
     }
-    return NULL;
+
+    return ESCDF_SUCCESS;
+}
+
+unsigned int escdf_densities_get_number_of_densities(const escdf_densities_t *densities)
+{
+    FULFILL_OR_RETURN_VAL(densities, ESCDF_EOBJECT, 0);
+
+    return densities->number_of_densities.value;
 }
-static const struct _density_t* _get_density_from_type(const escdf_densities_t *densities,
-                                                       const escdf_density_type_t type)
+
+const char* escdf_densities_get_name(const escdf_densities_t *densities,
+                                     const unsigned int i_density)
 {
-    struct _density_t *iter;
-    
-    escdf_return_val_if_fails(densities, NULL);
+    const struct _density_t *density;
 
-    for (iter = densities->densities; iter; iter = iter->next) {
-        if (iter->type == type)
-            return iter;
+    if ((density = _get_density_from_i(densities, i_density)) == NULL) {
+        return NULL;
     }
-    return NULL;
+    return density->name;
 }
 
 escdf_density_type_t escdf_densities_get_type(const escdf_densities_t *densities,
@@ -169,38 +365,66 @@ escdf_density_type_t escdf_densities_get_type(const escdf_densities_t *densities
 {
     const struct _density_t *density;
 
-    density = _get_density_from_i(densities, i_density);
-    escdf_return_val_if_fails(densities, ESCDF_DENSITY_UNKNOWN);
-    
+    if ((density = _get_density_from_i(densities, i_density)) == NULL) {
+        return ESCDF_DENSITY_UNKNOWN;
+    }
     return density->type;
 }
 
+bool escdf_densities_has_type(const escdf_densities_t *densities,
+                              const escdf_density_type_t type)
+{
+    FULFILL_OR_RETURN_VAL(densities, ESCDF_EOBJECT, false);
+
+    return type < ESCDF_DENSITY_UNKNOWN && densities->by_type[type] >= 0;
+}
+
 escdf_grid_scalarfield_t* escdf_densities_get_grid_scalarfield(const escdf_densities_t *densities,
                                                                const unsigned int i_density)
 {
-    const struct _density_t *density;
-
-    density = _get_density_from_i(densities, i_density);
-    escdf_return_val_if_fails(densities, NULL);
-    escdf_return_val_if_fails(density->type == ESCDF_DENSITY_GRID_PSEUDO
-                              || density->type == ESCDF_DENSITY_GRID_CORE
-                              || density->type == ESCDF_DENSITY_GRID_TOTAL
-                              , NULL);
+    struct _density_t *density;
 
-    return density->grid_scalarfield;
+    if ((density = _get_density_from_i(densities, i_density)) == NULL) {
+        return NULL;
+    }
+    return _load_grid_scalarfield(densities, density);
 }
+
 escdf_grid_scalarfield_t* escdf_densities_get_grid_scalarfield_from_type(const escdf_densities_t *densities,
                                                                          const escdf_density_type_t type)
 {
-    const struct _density_t *density;
+    struct _density_t *density;
 
-    escdf_return_val_if_fails(type == ESCDF_DENSITY_GRID_PSEUDO
-                              || type == ESCDF_DENSITY_GRID_CORE
-                              || type == ESCDF_DENSITY_GRID_TOTAL
-                              , NULL);
-    
-    density = _get_density_from_type(densities, type);
-    escdf_return_val_if_fails(densities, NULL);
+    FULFILL_OR_RETURN_VAL(type == ESCDF_DENSITY_GRID_PSEUDO
+                          || type == ESCDF_DENSITY_GRID_CORE
+                          || type == ESCDF_DENSITY_GRID_TOTAL, ESCDF_EVALUE, NULL);
 
-    return density->grid_scalarfield;
+    if ((density = _get_density_from_type(densities, type)) == NULL) {
+        return NULL;
+    }
+    return _load_grid_scalarfield(densities, density);
+}
+
+escdf_radial_densities_t* escdf_densities_get_radial_densities(const escdf_densities_t *densities,
+                                                               const unsigned int i_density)
+{
+    struct _density_t *density;
+
+    if ((density = _get_density_from_i(densities, i_density)) == NULL) {
+        return NULL;
+    }
+    return _load_radial_densities(densities, density);
+}
+
+escdf_radial_densities_t* escdf_densities_get_radial_densities_from_type(const escdf_densities_t *densities,
+                                                                         const escdf_density_type_t type)
+{
+    struct _density_t *density;
+
+    FULFILL_OR_RETURN_VAL(type == ESCDF_DENSITY_ATOM_CORE, ESCDF_EVALUE, NULL);
+
+    if ((density = _get_density_from_type(densities, type)) == NULL) {
+        return NULL;
+    }
+    return _load_radial_densities(densities, density);
 }
@@ -20,17 +20,24 @@
 #ifndef LIBESCDF_DENSITIES_H
 #define LIBESCDF_DENSITIES_H
 
+#include "escdf_error.h"
+#include "escdf_handle.h"
 #include "escdf_grid_scalarfields.h"
+#include "escdf_radial_densities.h"
+
+/******************************************************************************
+ * Data structures                                                            *
+ ******************************************************************************/
 
 struct _escdf_densities_t;
 typedef struct _escdf_densities_t escdf_densities_t;
 
-/* typedef enum { */
-/*     ESCDF_GRID_DENSITY, */
-/*     ESCDF_ATOM_CENTERED_DENSITY, */
-/*     ESCDF_UNKNOWN_DENSITY */
-/* } escdf_density_family_t; */
-
+/**
+ * Types of the densities, given by the name of their group:
+ * "pseudo_density", "core_density", "total_density" and
+ * "atom_core_density". Densities in groups with other names are of the
+ * unknown type.
+ */
 typedef enum {
     ESCDF_DENSITY_GRID_PSEUDO,
     ESCDF_DENSITY_GRID_CORE,
@@ -39,23 +46,64 @@ typedef enum {
     ESCDF_DENSITY_UNKNOWN
 } escdf_density_type_t;
 
-
-
+/******************************************************************************
+ * Global functions                                                           *
+ ******************************************************************************/
+
+/**
+ * Creates a new instance of the densities container.
+ *
+ * @param[in] path: the path to the ESCDF densities group, "densities" when
+ * NULL or empty.
+ * @return instance of the densities container.
+ */
 escdf_densities_t* escdf_densities_new(const char *path);
 
+/**
+ * Free all memory associated with the densities container, including the
+ * scalarfields it returned.
+ *
+ * @param[in,out] densities: the densities container.
+ */
 void escdf_densities_free(escdf_densities_t *densities);
 
-
-escdf_err_t escdf_densities_read_metadata(escdf_densities_t **densities, const char *path);
+/**
+ * Lists the densities of the group, one per subgroup, in a single pass over
+ * its links. The metadata of each density is only read on the first access
+ * to it, so that the handle must stay open while the container is used.
+ *
+ * @param[in,out] densities: the densities container.
+ * @param[in] file_id: the handle on the opened HDF5 file.
+ * @return error code.
+ */
+escdf_errno_t escdf_densities_read_metadata(escdf_densities_t *densities,
+                                            escdf_handle_t *file_id);
 
 unsigned int escdf_densities_get_number_of_densities(const escdf_densities_t *densities);
 
+/**
+ * Accessors to the densities, by their index in the group (in the order of
+ * their names), or by their type. The scalarfields and radial densities
+ * are owned by the container, and are NULL for the densities not on a grid,
+ * respectively not radial, or when they cannot be read.
+ */
+const char* escdf_densities_get_name(const escdf_densities_t *densities,
+                                     const unsigned int i_density);
+
 escdf_density_type_t escdf_densities_get_type(const escdf_densities_t *densities,
                                               const unsigned int i_density);
 
+bool escdf_densities_has_type(const escdf_densities_t *densities,
+                              const escdf_density_type_t type);
+
 escdf_grid_scalarfield_t* escdf_densities_get_grid_scalarfield(const escdf_densities_t *densities,
                                                                const unsigned int i_density);
 escdf_grid_scalarfield_t* escdf_densities_get_grid_scalarfield_from_type(const escdf_densities_t *densities,
                                                                          const escdf_density_type_t type);
 
+escdf_radial_densities_t* escdf_densities_get_radial_densities(const escdf_densities_t *densities,
+                                                               const unsigned int i_density);
+escdf_radial_densities_t* escdf_densities_get_radial_densities_from_type(const escdf_densities_t *densities,
+                                                                         const escdf_density_type_t type);
+
 #endif
@@ -28,20 +28,31 @@
 #include "config.h"
 #endif
 
-/* Store successive errors in a chain */
-static escdf_error_t *ESCDF_error_chain = NULL;
+#ifndef ESCDF_THREAD_LOCAL
+#define ESCDF_THREAD_LOCAL
+#endif
+
+/* Store successive errors in a ring, one per thread */
+static ESCDF_THREAD_LOCAL struct {
+    escdf_error_t errors[ESCDF_ERROR_CHAIN_SIZE];
+    unsigned int first; /* index of the oldest error */
+    unsigned int len; /* number of errors in the ring */
+    unsigned int dropped; /* number of errors overwritten since last clear */
+} ESCDF_error_chain;
+
+#define ESCDF_ERROR_AT(i) \
+    ESCDF_error_chain.errors[(ESCDF_error_chain.first + (i)) % ESCDF_ERROR_CHAIN_SIZE]
 
 escdf_errno_t escdf_error_add(const escdf_errno_t error_id, const char *filename,
                               const int line, const char *routine)
 {
-    size_t s;
     escdf_error_t *last_err;
 
     /* Notes:
        * this routine cannot call any error macro, in order to avoid
          infinite loops;
-       * errors in this routine must be fatal, in order to avoid
-         infinite loops;
+       * this routine does not allocate memory, the oldest error is
+         overwritten when the ring is full;
        * ESCDF_SUCCESS must always be ignored;
        * this routine returns the submitted error ID for automation
          purposes.
@@ -50,108 +61,68 @@ escdf_errno_t escdf_error_add(const escdf_errno_t error_id, const char *filename
     if ( error_id == ESCDF_SUCCESS )
         return error_id;
 
-    if ( ESCDF_error_chain == NULL ) {
-        ESCDF_error_chain = malloc (sizeof(escdf_error_t));
-        if ( ESCDF_error_chain == NULL ) {
-        escdf_error_show(ESCDF_ENOMEM, __FILE__, __LINE__, __func__);
-        exit(1);
-        }
-
-        ESCDF_error_chain->id = error_id;
-        ESCDF_error_chain->line = line;
-        ESCDF_error_chain->next = NULL;
-        s = strlen(filename);
-        ESCDF_error_chain->filename = (char *) malloc((s+1)*sizeof(char));
-        if ( ESCDF_error_chain->filename == NULL ) {
-        escdf_error_show(ESCDF_ENOMEM, __FILE__, __LINE__, __func__);
-        exit(1);
-        }
-        memcpy(ESCDF_error_chain->filename, filename, s);
-        ESCDF_error_chain->filename[s] = '\0';
-        s = strlen(routine);
-        ESCDF_error_chain->routine = (char *) malloc((s+1)*sizeof(char));
-        if ( ESCDF_error_chain->routine == NULL ) {
-            escdf_error_show(ESCDF_ENOMEM, __FILE__, __LINE__, __func__);
-            exit(1);
-        }
-        memcpy(ESCDF_error_chain->routine, routine, s);
-        ESCDF_error_chain->routine[s] = '\0';
+    if ( ESCDF_error_chain.len == ESCDF_ERROR_CHAIN_SIZE ) {
+        ESCDF_error_chain.first = (ESCDF_error_chain.first + 1) % ESCDF_ERROR_CHAIN_SIZE;
+        ESCDF_error_chain.dropped++;
     } else {
-        last_err = ESCDF_error_chain;
-        while ( last_err->next != NULL ) {
-        last_err = last_err->next;
-        }
-
-        last_err->next = (escdf_error_t *) malloc (sizeof(escdf_error_t));
-        if ( last_err->next == NULL ) {
-        escdf_error_show(ESCDF_ENOMEM, __FILE__, __LINE__, __func__);
-        exit(1);
-        }
-        last_err = last_err->next;
-        last_err->id = error_id;
-        last_err->line = line;
-        last_err->next = NULL;
-        s = strlen(filename);
-        last_err->filename = (char *) malloc((s+1)*sizeof(char));
-        if ( last_err->filename == NULL ) {
-        escdf_error_show(ESCDF_ENOMEM, __FILE__, __LINE__, __func__);
-        exit(1);
-        }
-        memcpy(last_err->filename, filename, s);
-        last_err->filename[s] = '\0';
-        s = strlen(routine);
-        last_err->routine = (char *) malloc((s+1)*sizeof(char));
-        if ( last_err->routine == NULL ) {
-        escdf_error_show(ESCDF_ENOMEM, __FILE__, __LINE__, __func__);
-        exit(1);
-        }
-        memcpy(last_err->routine, routine, s);
-        last_err->routine[s] = '\0';
+        ESCDF_error_chain.len++;
     }
 
+    last_err = &ESCDF_ERROR_AT(ESCDF_error_chain.len - 1);
+    last_err->id = error_id;
+    last_err->filename = (filename != NULL) ? filename : "";
+    last_err->line = line;
+    last_err->routine = (routine != NULL) ? routine : "";
+
     return error_id;
 }
 
 void escdf_error_fetchall(char **err_str) 
 {
-    char buf[8];
-    char *tmp_str;
-    int err_len;
-    escdf_error_t *cursor = ESCDF_error_chain;
+    char buf[16];
+    size_t err_len;
+    unsigned int i;
+    escdf_error_t *cursor;
 
     *err_str = NULL;
 
-    if ( cursor != NULL ) {
-        *err_str  = (char *) malloc (20*sizeof(char));
-        assert(*err_str != NULL);
-        sprintf(*err_str, "%s\n", "libescdf: ERROR:");
+    if ( ESCDF_error_chain.len == 0 ) {
+        return;
     }
 
-    while ( cursor != NULL ) {
-        assert(cursor->filename != NULL);
-        assert(cursor->routine != NULL);
-
-        err_len  = 19;
+    /* Compute the total length first, to build the message in one go. */
+    err_len = 18;
+    if ( ESCDF_error_chain.dropped > 0 ) {
+        sprintf(buf, "%u", ESCDF_error_chain.dropped);
+        err_len += 33 + strlen(buf);
+    }
+    for ( i = 0; i < ESCDF_error_chain.len; i++ ) {
+        cursor = &ESCDF_ERROR_AT(i);
+        err_len += 19;
         err_len += strlen(escdf_error_string(cursor->id));
         err_len += strlen(cursor->filename);
         err_len += strlen(cursor->routine);
         sprintf(buf, "%d", cursor->line);
         err_len += strlen(buf);
+    }
 
-        tmp_str  = (char *) malloc ((err_len+1)*sizeof(char));
-        assert(tmp_str != NULL);
-        sprintf(tmp_str, "  * in %s(%s):%d:\n      %s\n", cursor->filename,
-                cursor->routine, cursor->line, escdf_error_string(cursor->id));
-        *err_str = realloc(*err_str, strlen(*err_str)+err_len+1);
-        if ( *err_str == NULL ) {
+    *err_str = (char *) malloc ((err_len+1)*sizeof(char));
+    if ( *err_str == NULL ) {
         fprintf(stderr, "libescdf: FATAL:\n      could not build error message"
                 ".\n");
         exit(1);
-        }
-        strcat(*err_str, tmp_str);
-        free(tmp_str);
+    }
 
-        cursor = cursor->next;
+    err_len = sprintf(*err_str, "%s\n", "libescdf: ERROR:");
+    if ( ESCDF_error_chain.dropped > 0 ) {
+        err_len += sprintf(*err_str + err_len, "  * %u earlier error(s) dropped\n",
+                           ESCDF_error_chain.dropped);
+    }
+    for ( i = 0; i < ESCDF_error_chain.len; i++ ) {
+        cursor = &ESCDF_ERROR_AT(i);
+        err_len += sprintf(*err_str + err_len, "  * in %s(%s):%d:\n      %s\n",
+                           cursor->filename, cursor->routine, cursor->line,
+                           escdf_error_string(cursor->id));
     }
 
     escdf_error_free();
@@ -173,59 +144,50 @@ void escdf_error_flush(FILE *fd)
 
 void escdf_error_free(void)
 {
-    escdf_error_t *first_err;
-
-    while ( ESCDF_error_chain != NULL ) {
-        first_err = ESCDF_error_chain;
-        ESCDF_error_chain = ESCDF_error_chain->next;
-        free(first_err->filename);
-        free(first_err->routine);
-        free(first_err);
-    }
+    ESCDF_error_chain.first = 0;
+    ESCDF_error_chain.len = 0;
+    ESCDF_error_chain.dropped = 0;
 }
 
 escdf_errno_t escdf_error_get_last(const char *routine)
 {
-    escdf_errno_t eid = ESCDF_SUCCESS;
-    escdf_error_t *cursor = ESCDF_error_chain;
-
-    while ( cursor != NULL ) {
-        if ( routine == NULL ) {
-            eid = cursor->id;
-        } else {
-            if ( strcmp(cursor->routine, routine) == 0 ) {
-                eid = cursor->id;
-            }
+    unsigned int i;
+    escdf_error_t *cursor;
+
+    /* Search from the newest error backwards. Routine names usually come
+       from __func__, so a pointer comparison avoids most strcmp calls. */
+    for ( i = ESCDF_error_chain.len; i > 0; i-- ) {
+        cursor = &ESCDF_ERROR_AT(i - 1);
+        if ( routine == NULL || cursor->routine == routine ||
+             strcmp(cursor->routine, routine) == 0 ) {
+            return cursor->id;
         }
-        cursor = cursor->next;
     }
 
-    return eid;
+    return ESCDF_SUCCESS;
 }
 
 int escdf_error_len(void)
 {
-    int n = 0;
-    escdf_error_t *cursor = ESCDF_error_chain;
-
-    while ( cursor != NULL ) {
-        n++;
-        cursor = cursor->next;
-    }
-
-    return n;
+    return (int)ESCDF_error_chain.len;
 }
 
-escdf_error_t *escdf_error_pop(void)
+escdf_errno_t escdf_error_pop(escdf_error_t *error)
 {
-    escdf_error_t *first_error = NULL;
+    escdf_errno_t eid;
+
+    if ( ESCDF_error_chain.len == 0 ) {
+        return ESCDF_SUCCESS;
+    }
 
-    if ( ESCDF_error_chain != NULL ) {
-        first_error = ESCDF_error_chain;
-        ESCDF_error_chain = ESCDF_error_chain->next;
+    eid = ESCDF_error_chain.errors[ESCDF_error_chain.first].id;
+    if ( error != NULL ) {
+        *error = ESCDF_error_chain.errors[ESCDF_error_chain.first];
     }
+    ESCDF_error_chain.first = (ESCDF_error_chain.first + 1) % ESCDF_ERROR_CHAIN_SIZE;
+    ESCDF_error_chain.len--;
 
-    return first_error;
+    return eid;
 }
 
 void escdf_error_show(const escdf_errno_t error_id, const char *filename,
@@ -23,6 +23,11 @@
 /**
  * @file escdf_error.h 
  * @brief Error handlers
+ *
+ * Each thread records its errors in its own chain, so that the routines
+ * below only ever see the errors raised by the calling thread. The chain
+ * is a preallocated ring of ESCDF_ERROR_CHAIN_SIZE records: adding,
+ * popping and counting errors never allocate memory.
  */
 
 #include <stdlib.h>
@@ -35,15 +40,20 @@
  * Data structures                                                    *
  **********************************************************************/
 
+/**
+ * Maximum number of errors kept per thread. When the chain is full, the
+ * oldest error is overwritten.
+ */
+#define ESCDF_ERROR_CHAIN_SIZE 64
+
 /**
  * Global error handling structure
  */
 struct escdf_error_type {
     int id; /**< ID of the error */
-    char *filename; /**< name of the file where the error appeared */
+    const char *filename; /**< name of the file where the error appeared */
     int line; /**< line number in the file where the error appeared */
-    char *routine; /**< routine where the error appeared */
-    struct escdf_error_type *next; /**< next error in the chain */
+    const char *routine; /**< routine where the error appeared */
 };
 typedef struct escdf_error_type escdf_error_t;
 
@@ -54,7 +64,8 @@ typedef int escdf_errno_t;
  **********************************************************************/
 
 /**
- * Add an error to the chain.
+ * Add an error to the chain. The filename and routine strings are not
+ * copied and must outlive the chain, as __FILE__ and __func__ do.
  * @param[in] error_id: error code.
  * @param[in] filename: source filename (use NULL if none).
  * @param[in] line: line number in the source file (ignored if filename
@@ -99,9 +110,10 @@ int escdf_error_len(void);
 
 /**
  * Pop the first available error.
- * @return error structure pointer
+ * @param[out] error: copy of the oldest error record (may be NULL).
+ * @return error code of the popped error, ESCDF_SUCCESS if the chain is empty
  */
-escdf_error_t *escdf_error_pop(void);
+escdf_errno_t escdf_error_pop(escdf_error_t *error);
 
 /**
  * Displays an error message.
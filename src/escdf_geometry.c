@@ -18,11 +18,16 @@
 */
 
 #include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <math.h>
 
 #include "escdf_geometry.h"
 
 #include "utils.h"
 #include "utils_hdf5.h"
+#include "utils_stats.h"
 
 /******************************************************************************
  * Data structures                                                            *
@@ -34,6 +39,7 @@
  * present in the group or not.
 */
 struct escdf_geometry {
+    const escdf_handle_t *handle; /**< File the group belongs to */
     hid_t group_id; /**< Handle for HDF5 group */
 
     /* The metadata */
@@ -50,6 +56,210 @@ struct escdf_geometry {
 };
 
 
+/******************************************************************************
+ * Private functions                                                          *
+ ******************************************************************************/
+
+/**
+ * Hyperslab of a per-site data set, [number_of_sites][ncols], given as in
+ * the data functions. Returns in packed whether the memory buffer is laid
+ * out contiguously (no map, or a map describing the contiguous layout).
+ */
+static escdf_errno_t _site_selection(const escdf_geometry_t *geometry,
+                                     unsigned int ncols,
+                                     const unsigned int *start,
+                                     const unsigned int *count,
+                                     const unsigned int *map,
+                                     hsize_t *dims, hsize_t *hstart,
+                                     hsize_t *hcount, bool *packed)
+{
+    unsigned int i;
+
+    FULFILL_OR_RETURN(geometry, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(geometry->number_of_sites.is_set, ESCDF_EUNINIT);
+
+    dims[0] = (hsize_t)geometry->number_of_sites.value;
+    dims[1] = ncols;
+    for (i = 0; i < 2; i++) {
+        hstart[i] = (start) ? start[i] : 0;
+        FULFILL_OR_RETURN(hstart[i] <= dims[i], ESCDF_ERANGE);
+        hcount[i] = (count) ? count[i] : dims[i] - hstart[i];
+        FULFILL_OR_RETURN(hstart[i] + hcount[i] <= dims[i], ESCDF_ERANGE);
+    }
+    /* Packed rows are contiguous values, one row after the other. */
+    *packed = (map == NULL) || hcount[0] * hcount[1] == 0 ||
+        ((hcount[1] == 1 || map[1] == 1) && (hcount[0] == 1 || map[0] == hcount[1]));
+
+    return ESCDF_SUCCESS;
+}
+
+/* Copy between a strided buffer, following map, and a packed one. */
+static void _gather(void *packed, const void *strided, const hsize_t *count,
+                    const unsigned int *map, size_t size)
+{
+    long long int i;
+    hsize_t j;
+
+#ifdef _OPENMP
+#pragma omp parallel for private(j)
+#endif
+    for (i = 0; i < (long long int)count[0]; i++) {
+        for (j = 0; j < count[1]; j++) {
+            memcpy((char*)packed + (i * count[1] + j) * size,
+                   (const char*)strided + (i * map[0] + j * map[1]) * size, size);
+        }
+    }
+}
+
+static void _scatter(void *strided, const void *packed, const hsize_t *count,
+                     const unsigned int *map, size_t size)
+{
+    long long int i;
+    hsize_t j;
+
+#ifdef _OPENMP
+#pragma omp parallel for private(j)
+#endif
+    for (i = 0; i < (long long int)count[0]; i++) {
+        for (j = 0; j < count[1]; j++) {
+            memcpy((char*)strided + (i * map[0] + j * map[1]) * size,
+                   (const char*)packed + (i * count[1] + j) * size, size);
+        }
+    }
+}
+
+/* Group of the spatial index of the sites, see escdf_geometry_write_site_index(). */
+#define SITE_INDEX_GROUP "site_index"
+
+/* Group of the trajectory, see escdf_geometry_open_trajectory(). */
+#define TRAJECTORY_GROUP "trajectory"
+
+static escdf_errno_t _write_site_data(const escdf_geometry_t *geometry,
+                                      const char *name, hid_t disk_type_id,
+                                      hid_t mem_type_id, unsigned int ncols,
+                                      const void *buffer,
+                                      const unsigned int *start,
+                                      const unsigned int *count,
+                                      const unsigned int *map)
+{
+    escdf_errno_t err;
+    hsize_t dims[2], hstart[2], hcount[2];
+    hid_t dtset_id;
+    utils_stats_timer_t timer;
+    void *packed_buffer;
+    size_t size;
+    bool packed;
+
+    if ((err = _site_selection(geometry, ncols, start, count, map,
+                               dims, hstart, hcount, &packed)) != ESCDF_SUCCESS) {
+        return err;
+    }
+
+    utils_stats_start(geometry->handle, &timer);
+
+    /* Strided layouts are packed outside of the HDF5 lock. */
+    packed_buffer = NULL;
+    if (!packed) {
+        size = H5Tget_size(mem_type_id);
+        packed_buffer = malloc(size * hcount[0] * hcount[1]);
+        if (packed_buffer == NULL) {
+            utils_stats_stop(geometry->handle, &timer, ESCDF_STATS_WRITE_DATA);
+            RETURN_WITH_ERROR(ESCDF_ENOMEM);
+        }
+        _gather(packed_buffer, buffer, hcount, map, size);
+    }
+
+    utils_hdf5_lock();
+    /* The spatial index does not hold once the positions are changed. */
+    if (strcmp(name, "site_positions") == 0 &&
+        utils_hdf5_check_present(geometry->group_id, SITE_INDEX_GROUP) &&
+        H5Ldelete(geometry->group_id, SITE_INDEX_GROUP, H5P_DEFAULT) < 0) {
+        utils_hdf5_unlock();
+        free(packed_buffer);
+        utils_stats_stop(geometry->handle, &timer, ESCDF_STATS_WRITE_DATA);
+        RETURN_WITH_ERROR(ESCDF_ERROR);
+    }
+    if (utils_hdf5_check_present(geometry->group_id, name)) {
+        err = utils_hdf5_check_dtset(geometry->group_id, name, dims, 2, &dtset_id);
+    } else {
+        err = utils_hdf5_create_dataset(geometry->group_id, name, disk_type_id,
+                                        dims, 2, H5P_DEFAULT, &dtset_id);
+    }
+    if (err == ESCDF_SUCCESS) {
+        err = utils_hdf5_write_dataset(dtset_id, geometry->handle->transfer_mode,
+                                       packed ? buffer : packed_buffer, mem_type_id,
+                                       hstart, hcount, NULL);
+        H5Dclose(dtset_id);
+    }
+    utils_hdf5_unlock();
+    free(packed_buffer);
+
+    utils_stats_stop(geometry->handle, &timer, ESCDF_STATS_WRITE_DATA);
+    return err;
+}
+
+static escdf_errno_t _read_site_data(const escdf_geometry_t *geometry,
+                                     const char *name, hid_t mem_type_id,
+                                     unsigned int ncols, void *buffer,
+                                     const unsigned int *start,
+                                     const unsigned int *count,
+                                     const unsigned int *map)
+{
+    escdf_errno_t err;
+    hsize_t dims[2], hstart[2], hcount[2];
+    hid_t dtset_id;
+    utils_stats_timer_t timer;
+    void *packed_buffer;
+    size_t size;
+    bool packed;
+
+    if ((err = _site_selection(geometry, ncols, start, count, map,
+                               dims, hstart, hcount, &packed)) != ESCDF_SUCCESS) {
+        return err;
+    }
+
+    utils_stats_start(geometry->handle, &timer);
+
+    size = H5Tget_size(mem_type_id);
+    packed_buffer = NULL;
+    if (!packed) {
+        packed_buffer = malloc(size * hcount[0] * hcount[1]);
+        if (packed_buffer == NULL) {
+            utils_stats_stop(geometry->handle, &timer, ESCDF_STATS_READ_DATA);
+            RETURN_WITH_ERROR(ESCDF_ENOMEM);
+        }
+    }
+
+    utils_hdf5_lock();
+    err = utils_hdf5_check_dtset(geometry->group_id, name, dims, 2, &dtset_id);
+    if (err == ESCDF_SUCCESS) {
+        err = utils_hdf5_read_dataset(dtset_id, geometry->handle->transfer_mode,
+                                      packed ? buffer : packed_buffer, mem_type_id,
+                                      hstart, hcount, NULL);
+        H5Dclose(dtset_id);
+    }
+    utils_hdf5_unlock();
+
+    /* Strided layouts are unpacked outside of the HDF5 lock. */
+    if (!packed) {
+        if (err == ESCDF_SUCCESS) {
+            _scatter(buffer, packed_buffer, hcount, map, size);
+        }
+        free(packed_buffer);
+    }
+
+    utils_stats_stop(geometry->handle, &timer, ESCDF_STATS_READ_DATA);
+    return err;
+}
+
+/* Number of components of the vectors per site, e.g. positions. */
+static unsigned int _site_ncols(const escdf_geometry_t *geometry)
+{
+    return (geometry && geometry->number_of_physical_dimensions.is_set) ?
+        (unsigned int)geometry->number_of_physical_dimensions.value : 0;
+}
+
+
 /******************************************************************************
  * Global functions                                                           *
  ******************************************************************************/
@@ -58,27 +268,36 @@ escdf_geometry_t * escdf_geometry_new(const escdf_handle_t *handle,
         const char *name)
 {
     escdf_geometry_t *geometry;
+    hid_t parent_id;
 
     geometry = (escdf_geometry_t *) malloc(sizeof(escdf_geometry_t));
-    //FULFILL_OR_RETURN(geometry != NULL, ESCDF_ENOMEM)
+    FULFILL_OR_RETURN_VAL(geometry != NULL, ESCDF_ENOMEM, NULL);
+    geometry->handle = handle;
 
+    utils_hdf5_lock();
     /* check if "geometries" group exists; if not, create it */
     if (!utils_hdf5_check_present(handle->group_id, "geometries")) {
-        geometry->group_id = H5Gcreate(handle->group_id, "geometries",
-                                       H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        parent_id = H5Gcreate(handle->group_id, "geometries",
+                              H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
     } else {
-        geometry->group_id = H5Gopen(handle->group_id, "geometries",
-                                     H5P_DEFAULT);
+        parent_id = H5Gopen(handle->group_id, "geometries", H5P_DEFAULT);
     }
 
     /* check if specific geometry group exists and open it; if not, create it */
-    if (!utils_hdf5_check_present(geometry->group_id, name)) {
-        geometry->group_id = H5Gcreate(geometry->group_id, name, H5P_DEFAULT,
-                                       H5P_DEFAULT, H5P_DEFAULT);
-    }
-    else {
-        geometry->group_id = H5Gopen(geometry->group_id, name, H5P_DEFAULT);
+    if (name == NULL || strcmp(name, ".") == 0) {
+        geometry->group_id = parent_id;
+    } else {
+        if (!utils_hdf5_check_present(parent_id, name)) {
+            geometry->group_id = H5Gcreate(parent_id, name, H5P_DEFAULT,
+                                           H5P_DEFAULT, H5P_DEFAULT);
+        }
+        else {
+            geometry->group_id = H5Gopen(parent_id, name, H5P_DEFAULT);
+        }
+        /* the "geometries" group is not needed anymore */
+        H5Gclose(parent_id);
     }
+    utils_hdf5_unlock();
 
     /* no metadata set at the moment */
     geometry->number_of_physical_dimensions.is_set = false;
@@ -100,19 +319,24 @@ escdf_errno_t escdf_geometry_free(escdf_geometry_t * geometry)
     herr_t herr_status;
 
     /* close the group */
+    utils_hdf5_lock();
     herr_status = H5Gclose(geometry->group_id);
+    utils_hdf5_unlock();
+    free(geometry->dimension_types);
+    free(geometry);
     FULFILL_OR_RETURN(herr_status >= 0, herr_status);
 
     return ESCDF_SUCCESS;
 }
 
-escdf_errno_t escdf_geometry_read_metadata(escdf_geometry_t *geometry)
+/* Must be called with the HDF5 lock. */
+static escdf_errno_t _read_metadata(escdf_geometry_t *geometry)
 {
     escdf_errno_t err;
     int number_of_physical_dimensions_range[2] = {3, 3};
     int dimension_types_range[2] = {0, 2};
     int number_of_species_range[2] = {1, 1000};
-    int number_of_sites_range[2] = {1, 1000};
+    int number_of_sites_range[2] = {1, INT_MAX};
     int absolute_or_reduced_coordinates_range[2] = {1, 2};
     int number_of_symmetry_operations_range[2] = {1, 1000};
     hsize_t oneDims[1];
@@ -169,17 +393,30 @@ escdf_errno_t escdf_geometry_read_metadata(escdf_geometry_t *geometry)
     }
 
     /* read datasets of the group: */
+    geometry->magnetic_moment_directions_is_present =
+        utils_hdf5_check_present(geometry->group_id, "magnetic_moment_directions");
 
     return ESCDF_SUCCESS;
 }
 
-escdf_errno_t escdf_geometry_write_metadata(const escdf_geometry_t *geometry)
+escdf_errno_t escdf_geometry_read_metadata(escdf_geometry_t *geometry)
 {
     escdf_errno_t err;
-    hsize_t dims[3];
-    int value;
 
-    FULFILL_OR_RETURN(geometry, ESCDF_EOBJECT);
+    utils_hdf5_lock();
+    err = _read_metadata(geometry);
+    utils_hdf5_unlock();
+
+    return err;
+}
+
+/* Must be called with the HDF5 lock. */
+static escdf_errno_t _write_metadata(const escdf_geometry_t *geometry)
+{
+    escdf_errno_t err;
+    hsize_t dims[3];
+    unsigned int value, values[3];
+    int i;
 
     /* check mandatory attributes */
     FULFILL_OR_RETURN(geometry->number_of_physical_dimensions.is_set, ESCDF_EUNINIT);
@@ -189,62 +426,71 @@ escdf_errno_t escdf_geometry_write_metadata(const escdf_geometry_t *geometry)
     FULFILL_OR_RETURN(geometry->number_of_sites.is_set, ESCDF_EUNINIT);
     FULFILL_OR_RETURN(geometry->absolute_or_reduced_coordinates.is_set, ESCDF_EUNINIT);
 
-    /* write attributes of the group: */
+    /* write attributes of the group, from unsigned copies of the values so
+       that the memory type matches the unsigned type on disk: */
 
     /* --number_of_physical_dimensions */
     dims[0] = 1;
+    value = (unsigned int)geometry->number_of_physical_dimensions.value;
     if ((err = utils_hdf5_write_attr
-         (geometry->group_id, "number_of_physical_dimensions", H5T_STD_U32LE, dims, 1, H5T_NATIVE_INT,
-          &geometry->number_of_physical_dimensions.value)) != ESCDF_SUCCESS) {
+         (geometry->group_id, "number_of_physical_dimensions", H5T_STD_U32LE, dims, 1, H5T_NATIVE_UINT,
+          &value)) != ESCDF_SUCCESS) {
         return err;
     }
 
     /* --dimension_types */
     dims[0] = geometry->number_of_physical_dimensions.value;
+    for (i = 0; i < geometry->number_of_physical_dimensions.value; i++) {
+        values[i] = (unsigned int)geometry->dimension_types[i];
+    }
     if ((err = utils_hdf5_write_attr
-         (geometry->group_id, "dimension_types", H5T_STD_U32LE, dims, 1, H5T_NATIVE_INT,
-          geometry->dimension_types)) != ESCDF_SUCCESS) {
+         (geometry->group_id, "dimension_types", H5T_STD_U32LE, dims, 1, H5T_NATIVE_UINT,
+          values)) != ESCDF_SUCCESS) {
         return err;
     }
 
     /* --embedded_system */
     dims[0] = 1;
-    value = (int)geometry->embedded_system.value;
+    value = (unsigned int)geometry->embedded_system.value;
     if ((err = utils_hdf5_write_attr
-         (geometry->group_id, "embedded_system", H5T_STD_U32LE, dims, 1, H5T_NATIVE_INT,
+         (geometry->group_id, "embedded_system", H5T_STD_U32LE, dims, 1, H5T_NATIVE_UINT,
           &value)) != ESCDF_SUCCESS) {
         return err;
     }
 
     /* --number_of_species */
     dims[0] = 1;
+    value = (unsigned int)geometry->number_of_species.value;
     if ((err = utils_hdf5_write_attr
-         (geometry->group_id, "number_of_species", H5T_STD_U32LE, dims, 1, H5T_NATIVE_INT,
-          &geometry->number_of_species.value)) != ESCDF_SUCCESS) {
+         (geometry->group_id, "number_of_species", H5T_STD_U32LE, dims, 1, H5T_NATIVE_UINT,
+          &value)) != ESCDF_SUCCESS) {
         return err;
     }
 
     /* --number_of_sites */
     dims[0] = 1;
+    value = (unsigned int)geometry->number_of_sites.value;
     if ((err = utils_hdf5_write_attr
-         (geometry->group_id, "number_of_sites", H5T_STD_U32LE, dims, 1, H5T_NATIVE_INT,
-          &geometry->number_of_sites.value)) != ESCDF_SUCCESS) {
+         (geometry->group_id, "number_of_sites", H5T_STD_U32LE, dims, 1, H5T_NATIVE_UINT,
+          &value)) != ESCDF_SUCCESS) {
         return err;
     }
 
     /* --absolute_or_reduced_coordinates */
     dims[0] = 1;
+    value = (unsigned int)geometry->absolute_or_reduced_coordinates.value;
     if ((err = utils_hdf5_write_attr
-         (geometry->group_id, "absolute_or_reduced_coordinates", H5T_STD_U32LE, dims, 1, H5T_NATIVE_INT,
-          &geometry->absolute_or_reduced_coordinates.value)) != ESCDF_SUCCESS) {
+         (geometry->group_id, "absolute_or_reduced_coordinates", H5T_STD_U32LE, dims, 1, H5T_NATIVE_UINT,
+          &value)) != ESCDF_SUCCESS) {
         return err;
     }
 
     /* --number_of_symmetry_operations */
     dims[0] = 1;
+    value = (unsigned int)geometry->number_of_symmetry_operations.value;
     if ((err = utils_hdf5_write_attr
-         (geometry->group_id, "number_of_symmetry_operations", H5T_STD_U32LE, dims, 1, H5T_NATIVE_INT,
-          &geometry->number_of_symmetry_operations.value)) != ESCDF_SUCCESS) {
+         (geometry->group_id, "number_of_symmetry_operations", H5T_STD_U32LE, dims, 1, H5T_NATIVE_UINT,
+          &value)) != ESCDF_SUCCESS) {
         return err;
     }
 
@@ -253,6 +499,19 @@ escdf_errno_t escdf_geometry_write_metadata(const escdf_geometry_t *geometry)
     return ESCDF_SUCCESS;
 }
 
+escdf_errno_t escdf_geometry_write_metadata(const escdf_geometry_t *geometry)
+{
+    escdf_errno_t err;
+
+    FULFILL_OR_RETURN(geometry, ESCDF_EOBJECT);
+
+    utils_hdf5_lock();
+    err = _write_metadata(geometry);
+    utils_hdf5_unlock();
+
+    return err;
+}
+
 escdf_errno_t escdf_geometry_set_number_of_physical_dimensions(
         escdf_geometry_t *geometry, const int number_of_physical_dimensions)
 {
@@ -441,4 +700,1901 @@ bool escdf_geometry_is_set_number_of_symmetry_operations(
         const escdf_geometry_t *geometry)
 {
     return geometry->number_of_symmetry_operations.is_set;
-}
\ No newline at end of file
+}
+
+
+/******************************************************************************
+ * Data functions                                                             *
+ ******************************************************************************/
+
+escdf_errno_t escdf_geometry_write_site_positions(
+        const escdf_geometry_t *geometry, const double *buffer,
+        const unsigned int *start, const unsigned int *count,
+        const unsigned int *map)
+{
+    FULFILL_OR_RETURN(_site_ncols(geometry) > 0, ESCDF_EUNINIT);
+
+    return _write_site_data(geometry, "site_positions", H5T_IEEE_F64LE, H5T_NATIVE_DOUBLE,
+                            _site_ncols(geometry), buffer, start, count, map);
+}
+
+escdf_errno_t escdf_geometry_read_site_positions(
+        const escdf_geometry_t *geometry, double *buffer,
+        const unsigned int *start, const unsigned int *count,
+        const unsigned int *map)
+{
+    FULFILL_OR_RETURN(_site_ncols(geometry) > 0, ESCDF_EUNINIT);
+
+    return _read_site_data(geometry, "site_positions", H5T_NATIVE_DOUBLE,
+                           _site_ncols(geometry), buffer, start, count, map);
+}
+
+escdf_errno_t escdf_geometry_write_site_velocities(
+        const escdf_geometry_t *geometry, const double *buffer,
+        const unsigned int *start, const unsigned int *count,
+        const unsigned int *map)
+{
+    FULFILL_OR_RETURN(_site_ncols(geometry) > 0, ESCDF_EUNINIT);
+
+    return _write_site_data(geometry, "site_velocities", H5T_IEEE_F64LE, H5T_NATIVE_DOUBLE,
+                            _site_ncols(geometry), buffer, start, count, map);
+}
+
+escdf_errno_t escdf_geometry_read_site_velocities(
+        const escdf_geometry_t *geometry, double *buffer,
+        const unsigned int *start, const unsigned int *count,
+        const unsigned int *map)
+{
+    FULFILL_OR_RETURN(_site_ncols(geometry) > 0, ESCDF_EUNINIT);
+
+    return _read_site_data(geometry, "site_velocities", H5T_NATIVE_DOUBLE,
+                           _site_ncols(geometry), buffer, start, count, map);
+}
+
+escdf_errno_t escdf_geometry_write_site_forces(
+        const escdf_geometry_t *geometry, const double *buffer,
+        const unsigned int *start, const unsigned int *count,
+        const unsigned int *map)
+{
+    FULFILL_OR_RETURN(_site_ncols(geometry) > 0, ESCDF_EUNINIT);
+
+    return _write_site_data(geometry, "site_forces", H5T_IEEE_F64LE, H5T_NATIVE_DOUBLE,
+                            _site_ncols(geometry), buffer, start, count, map);
+}
+
+escdf_errno_t escdf_geometry_read_site_forces(
+        const escdf_geometry_t *geometry, double *buffer,
+        const unsigned int *start, const unsigned int *count,
+        const unsigned int *map)
+{
+    FULFILL_OR_RETURN(_site_ncols(geometry) > 0, ESCDF_EUNINIT);
+
+    return _read_site_data(geometry, "site_forces", H5T_NATIVE_DOUBLE,
+                           _site_ncols(geometry), buffer, start, count, map);
+}
+
+escdf_errno_t escdf_geometry_write_magnetic_moment_directions(
+        const escdf_geometry_t *geometry, const double *buffer,
+        const unsigned int *start, const unsigned int *count,
+        const unsigned int *map)
+{
+    FULFILL_OR_RETURN(_site_ncols(geometry) > 0, ESCDF_EUNINIT);
+
+    return _write_site_data(geometry, "magnetic_moment_directions", H5T_IEEE_F64LE, H5T_NATIVE_DOUBLE,
+                            _site_ncols(geometry), buffer, start, count, map);
+}
+
+escdf_errno_t escdf_geometry_read_magnetic_moment_directions(
+        const escdf_geometry_t *geometry, double *buffer,
+        const unsigned int *start, const unsigned int *count,
+        const unsigned int *map)
+{
+    FULFILL_OR_RETURN(_site_ncols(geometry) > 0, ESCDF_EUNINIT);
+
+    return _read_site_data(geometry, "magnetic_moment_directions", H5T_NATIVE_DOUBLE,
+                           _site_ncols(geometry), buffer, start, count, map);
+}
+
+escdf_errno_t escdf_geometry_write_species_at_sites(
+        const escdf_geometry_t *geometry, const int *buffer,
+        const unsigned int *start, const unsigned int *count,
+        const unsigned int *map)
+{
+    return _write_site_data(geometry, "species_at_sites", H5T_STD_I32LE, H5T_NATIVE_INT,
+                            1, buffer, start, count, map);
+}
+
+escdf_errno_t escdf_geometry_read_species_at_sites(
+        const escdf_geometry_t *geometry, int *buffer,
+        const unsigned int *start, const unsigned int *count,
+        const unsigned int *map)
+{
+    return _read_site_data(geometry, "species_at_sites", H5T_NATIVE_INT,
+                           1, buffer, start, count, map);
+}
+
+
+/* Number of sites of the positions read at once to find a region. */
+#define SITE_SCAN_BLOCK 65536
+
+static const char *site_data_names[ESCDF_N_SITE_DATA] = {
+    "site_positions", "site_velocities", "site_forces",
+    "magnetic_moment_directions", "species_at_sites"
+};
+
+/* Name, types and number of columns of a per-site data set. */
+static escdf_errno_t _site_data_type(const escdf_geometry_t *geometry,
+                                     escdf_site_data data, hid_t *disk_type_id,
+                                     hid_t *mem_type_id, unsigned int *ncols)
+{
+    FULFILL_OR_RETURN(geometry, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(data < ESCDF_N_SITE_DATA, ESCDF_EVALUE);
+
+    if (data == ESCDF_SITE_SPECIES) {
+        *disk_type_id = H5T_STD_I32LE;
+        *mem_type_id = H5T_NATIVE_INT;
+        *ncols = 1;
+    } else {
+        *disk_type_id = H5T_IEEE_F64LE;
+        *mem_type_id = H5T_NATIVE_DOUBLE;
+        *ncols = _site_ncols(geometry);
+        FULFILL_OR_RETURN(*ncols > 0, ESCDF_EUNINIT);
+    }
+
+    return ESCDF_SUCCESS;
+}
+
+static escdf_errno_t _get_proc_site_offset(const escdf_geometry_t *geometry,
+                                           unsigned int my_count,
+                                           unsigned int *my_offset)
+{
+    unsigned long long int len_, offset_, sum_;
+
+    len_ = (unsigned long long int)my_count;
+    offset_ = 0;
+    sum_ = len_;
+#ifdef HAVE_MPI
+    if (geometry->handle->mpi_size > 1) {
+        MPI_Exscan(&len_, &offset_, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, geometry->handle->comm);
+        MPI_Allreduce(&len_, &sum_, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, geometry->handle->comm);
+        /* The scan is undefined on the first rank. */
+        if (geometry->handle->mpi_rank == 0) {
+            offset_ = 0;
+        }
+    }
+#endif
+    *my_offset = (unsigned int)offset_;
+
+    FULFILL_OR_RETURN(sum_ == (unsigned long long int)geometry->number_of_sites.value,
+                      ESCDF_ESIZE);
+
+    return ESCDF_SUCCESS;
+}
+
+escdf_errno_t escdf_geometry_get_site_block(const escdf_geometry_t *geometry,
+        unsigned int *first, unsigned int *count)
+{
+    unsigned int n, size, rank, base, rem;
+
+    FULFILL_OR_RETURN(geometry, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(geometry->number_of_sites.is_set, ESCDF_EUNINIT);
+
+    n = (unsigned int)geometry->number_of_sites.value;
+    size = (unsigned int)geometry->handle->mpi_size;
+    rank = (unsigned int)geometry->handle->mpi_rank;
+    base = n / size;
+    rem = n % size;
+    /* The first rem ranks get one more site. */
+    *count = base + (rank < rem ? 1 : 0);
+    *first = rank * base + (rank < rem ? rank : rem);
+
+    return ESCDF_SUCCESS;
+}
+
+escdf_errno_t escdf_geometry_write_site_data_distributed(
+        const escdf_geometry_t *geometry, escdf_site_data data,
+        const void *buffer, unsigned int count)
+{
+    escdf_errno_t err;
+    hid_t disk_type_id, mem_type_id;
+    unsigned int ncols, start[2], counts[2];
+
+    if ((err = _site_data_type(geometry, data, &disk_type_id, &mem_type_id,
+                               &ncols)) != ESCDF_SUCCESS) {
+        return err;
+    }
+    FULFILL_OR_RETURN(geometry->number_of_sites.is_set, ESCDF_EUNINIT);
+    if ((err = _get_proc_site_offset(geometry, count, start)) != ESCDF_SUCCESS) {
+        return err;
+    }
+    start[1] = 0;
+    counts[0] = count;
+    counts[1] = ncols;
+
+    return _write_site_data(geometry, site_data_names[data], disk_type_id, mem_type_id,
+                            ncols, buffer, start, counts, NULL);
+}
+
+escdf_errno_t escdf_geometry_read_site_data_distributed(
+        const escdf_geometry_t *geometry, escdf_site_data data, void *buffer)
+{
+    escdf_errno_t err;
+    hid_t disk_type_id, mem_type_id;
+    unsigned int ncols, start[2], counts[2];
+
+    if ((err = _site_data_type(geometry, data, &disk_type_id, &mem_type_id,
+                               &ncols)) != ESCDF_SUCCESS ||
+        (err = escdf_geometry_get_site_block(geometry, start, counts)) != ESCDF_SUCCESS) {
+        return err;
+    }
+    start[1] = 0;
+    counts[1] = ncols;
+
+    return _read_site_data(geometry, site_data_names[data], mem_type_id,
+                           ncols, buffer, start, counts, NULL);
+}
+
+/**
+ * Whether the position x is inside the box [lower, upper), and within
+ * radius of center when center is not NULL.
+ */
+static bool _site_in_region(const double *x, unsigned int ncols,
+                            const double *lower, const double *upper,
+                            const double *center, double radius)
+{
+    unsigned int j;
+    double d2;
+
+    for (j = 0; j < ncols; j++) {
+        if (!(x[j] >= lower[j] && x[j] < upper[j])) {
+            return false;
+        }
+    }
+    if (center) {
+        d2 = 0.;
+        for (j = 0; j < ncols; j++) {
+            d2 += (x[j] - center[j]) * (x[j] - center[j]);
+        }
+        return d2 <= radius * radius;
+    }
+
+    return true;
+}
+
+/* Appends a site to the growing list of the sites found. */
+static escdf_errno_t _append_site(unsigned int **found, unsigned int *n,
+                                  unsigned int *capacity, unsigned int site)
+{
+    void *tmp;
+
+    if (*n == *capacity) {
+        *capacity = (*capacity > 0) ? 2 * *capacity : 1024;
+        tmp = realloc(*found, sizeof(unsigned int) * *capacity);
+        FULFILL_OR_RETURN(tmp != NULL, ESCDF_ENOMEM);
+        *found = tmp;
+    }
+    (*found)[(*n)++] = site;
+
+    return ESCDF_SUCCESS;
+}
+
+/* Sites found in the region of one rank. */
+typedef struct {
+    unsigned int *sites;
+    unsigned int n, capacity;
+} _site_hits_t;
+
+/**
+ * Finds the sites of the region of each rank by scanning the positions:
+ * each rank reads its own block of sites (see
+ * escdf_geometry_get_site_block()) and tests it against the regions of all
+ * the ranks, then the sites found are sent to the ranks of their regions.
+ * A region is stored as lower, upper and center, of ncols values each,
+ * then radius and whether there is a center.
+ */
+static escdf_errno_t _scan_sites(const escdf_geometry_t *geometry,
+                                 const double *lower, const double *upper,
+                                 const double *center, double radius,
+                                 unsigned int **sites, unsigned int *nsites)
+{
+    escdf_errno_t err;
+    hsize_t dims[2], start[2], count[2];
+    hid_t dtset_id;
+    utils_hdf5_selection_t sel;
+    utils_stats_timer_t timer;
+    unsigned int ncols, n, first, mine, nblocks, nregions, stride, b, i, r;
+    double *positions, *regions, *region;
+    _site_hits_t *hits;
+#ifdef HAVE_MPI
+    int *sendcounts, *recvcounts, *sdispls, *rdispls, failed;
+    unsigned int *sendbuf, *recvbuf, total;
+#endif
+
+    ncols = _site_ncols(geometry);
+    n = (unsigned int)geometry->number_of_sites.value;
+    if ((err = escdf_geometry_get_site_block(geometry, &first, &mine)) != ESCDF_SUCCESS) {
+        return err;
+    }
+    /* Every rank makes as many reads as the largest block needs, since the
+       transfers may be collective. */
+    nregions = (unsigned int)geometry->handle->mpi_size;
+    nblocks = n / nregions + (n % nregions ? 1 : 0);
+    nblocks = nblocks / SITE_SCAN_BLOCK + (nblocks % SITE_SCAN_BLOCK ? 1 : 0);
+
+    stride = 3 * ncols + 2;
+    positions = malloc(sizeof(double) * ncols * (mine < SITE_SCAN_BLOCK ? mine + 1 : SITE_SCAN_BLOCK));
+    regions = malloc(sizeof(double) * stride * nregions);
+    hits = calloc(nregions, sizeof(_site_hits_t));
+    if (positions == NULL || regions == NULL || hits == NULL) {
+        free(positions);
+        free(regions);
+        free(hits);
+        RETURN_WITH_ERROR(ESCDF_ENOMEM);
+    }
+    region = regions + stride * geometry->handle->mpi_rank;
+    for (i = 0; i < ncols; i++) {
+        region[i] = lower[i];
+        region[ncols + i] = upper[i];
+        region[2 * ncols + i] = (center) ? center[i] : 0.;
+    }
+    region[3 * ncols] = radius;
+    region[3 * ncols + 1] = (center) ? 1. : 0.;
+#ifdef HAVE_MPI
+    if (geometry->handle->mpi_size > 1) {
+        MPI_Allgather(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, regions, (int)stride, MPI_DOUBLE,
+                      geometry->handle->comm);
+    }
+#endif
+
+    utils_stats_start(geometry->handle, &timer);
+    utils_hdf5_lock();
+    dims[0] = n;
+    dims[1] = ncols;
+    err = utils_hdf5_check_dtset(geometry->group_id, "site_positions", dims, 2, &dtset_id);
+    if (err == ESCDF_SUCCESS && (err = utils_hdf5_selection_init(&sel, dtset_id)) != ESCDF_SUCCESS) {
+        H5Dclose(dtset_id);
+    }
+    utils_hdf5_unlock();
+    if (err != ESCDF_SUCCESS) {
+        free(positions);
+        free(regions);
+        free(hits);
+        utils_stats_stop(geometry->handle, &timer, ESCDF_STATS_READ_DATA);
+        return err;
+    }
+
+    /* The reads go on after an error, with nothing selected, not to leave
+       the other ranks waiting. */
+    start[1] = 0;
+    count[1] = ncols;
+    for (b = 0; b < nblocks; b++) {
+        start[0] = first + (hsize_t)b * SITE_SCAN_BLOCK;
+        count[0] = ((hsize_t)b * SITE_SCAN_BLOCK < mine && err == ESCDF_SUCCESS) ?
+            mine - (hsize_t)b * SITE_SCAN_BLOCK : 0;
+        count[0] = (count[0] < SITE_SCAN_BLOCK) ? count[0] : SITE_SCAN_BLOCK;
+        utils_hdf5_lock();
+        if (count[0] > 0) {
+            err = utils_hdf5_selection_set_slice(&sel, start, count, NULL);
+        } else {
+            utils_hdf5_selection_set_hyperslabs(&sel, 0, NULL, NULL, NULL, NULL);
+        }
+        if (err == ESCDF_SUCCESS || count[0] == 0) {
+            utils_hdf5_selection_read(&sel, dtset_id, geometry->handle->transfer_mode,
+                                      H5T_NATIVE_DOUBLE, positions);
+        }
+        utils_hdf5_unlock();
+
+        for (i = 0; i < count[0] && err == ESCDF_SUCCESS; i++) {
+            for (r = 0; r < nregions && err == ESCDF_SUCCESS; r++) {
+                region = regions + stride * r;
+                if (_site_in_region(positions + i * ncols, ncols, region, region + ncols,
+                                    (region[3 * ncols + 1] != 0.) ? region + 2 * ncols : NULL,
+                                    region[3 * ncols])) {
+                    err = _append_site(&hits[r].sites, &hits[r].n, &hits[r].capacity,
+                                       (unsigned int)start[0] + i);
+                }
+            }
+        }
+    }
+
+    utils_hdf5_lock();
+    utils_hdf5_selection_free(&sel);
+    H5Dclose(dtset_id);
+    utils_hdf5_unlock();
+    free(positions);
+    free(regions);
+
+#ifdef HAVE_MPI
+    /* The blocks follow the order of the ranks, so that the sites received
+       are in increasing order. */
+    if (geometry->handle->mpi_size > 1) {
+        sendcounts = malloc(sizeof(int) * 4 * nregions);
+        sendbuf = recvbuf = NULL;
+        total = 0;
+        if (err == ESCDF_SUCCESS && sendcounts == NULL) {
+            DEFER_FUNC_ERROR(ESCDF_ENOMEM);
+            err = ESCDF_ENOMEM;
+        }
+        if (err == ESCDF_SUCCESS) {
+            recvcounts = sendcounts + nregions;
+            sdispls = recvcounts + nregions;
+            rdispls = sdispls + nregions;
+            for (r = 0; r < nregions; r++) {
+                sendcounts[r] = (int)hits[r].n;
+                sdispls[r] = (int)total;
+                total += hits[r].n;
+            }
+            if ((sendbuf = malloc(sizeof(unsigned int) * (total + 1))) == NULL) {
+                DEFER_FUNC_ERROR(ESCDF_ENOMEM);
+                err = ESCDF_ENOMEM;
+            }
+            for (r = 0; r < nregions && sendbuf != NULL; r++) {
+                if (hits[r].n > 0) {
+                    memcpy(sendbuf + sdispls[r], hits[r].sites, sizeof(unsigned int) * hits[r].n);
+                }
+            }
+        }
+        failed = (err != ESCDF_SUCCESS);
+        MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_LOR, geometry->handle->comm);
+        if (!failed) {
+            MPI_Alltoall(sendcounts, 1, MPI_INT, recvcounts, 1, MPI_INT, geometry->handle->comm);
+            total = 0;
+            for (r = 0; r < nregions; r++) {
+                rdispls[r] = (int)total;
+                total += (unsigned int)recvcounts[r];
+            }
+            if ((recvbuf = malloc(sizeof(unsigned int) * (total + 1))) == NULL) {
+                DEFER_FUNC_ERROR(ESCDF_ENOMEM);
+                err = ESCDF_ENOMEM;
+            }
+            failed = (err != ESCDF_SUCCESS);
+            MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_LOR, geometry->handle->comm);
+        }
+        if (!failed) {
+            MPI_Alltoallv(sendbuf, sendcounts, sdispls, MPI_UNSIGNED,
+                          recvbuf, recvcounts, rdispls, MPI_UNSIGNED,
+                          geometry->handle->comm);
+        } else if (err == ESCDF_SUCCESS) {
+            /* Failed on another rank. */
+            DEFER_FUNC_ERROR(ESCDF_ERROR);
+            err = ESCDF_ERROR;
+        }
+        free(sendbuf);
+        free(sendcounts);
+        for (r = 0; r < nregions; r++) {
+            free(hits[r].sites);
+        }
+        hits[0].sites = recvbuf;
+        hits[0].n = total;
+        if (err != ESCDF_SUCCESS || total == 0) {
+            free(recvbuf);
+            hits[0].sites = NULL;
+            hits[0].n = 0;
+        }
+    }
+#endif
+    utils_stats_stop(geometry->handle, &timer, ESCDF_STATS_READ_DATA);
+
+    if (err != ESCDF_SUCCESS) {
+        free(hits[0].sites);
+        free(hits);
+        *nsites = 0;
+        return err;
+    }
+    *sites = hits[0].sites;
+    *nsites = hits[0].n;
+    free(hits);
+
+    return ESCDF_SUCCESS;
+}
+
+escdf_errno_t escdf_geometry_read_site_data_at(
+        const escdf_geometry_t *geometry, escdf_site_data data,
+        const unsigned int *sites, unsigned int nsites, void *buffer)
+{
+    escdf_errno_t err;
+    hsize_t dims[2], *coord;
+    hid_t disk_type_id, mem_type_id, dtset_id;
+    utils_hdf5_selection_t sel;
+    utils_stats_timer_t timer;
+    unsigned int ncols;
+    long long int i;
+    hsize_t j, nranges;
+    bool increasing;
+
+    if ((err = _site_data_type(geometry, data, &disk_type_id, &mem_type_id,
+                               &ncols)) != ESCDF_SUCCESS) {
+        return err;
+    }
+    FULFILL_OR_RETURN(geometry->number_of_sites.is_set, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(nsites == 0 || (sites && buffer), ESCDF_EVALUE);
+
+    dims[0] = (hsize_t)geometry->number_of_sites.value;
+    dims[1] = ncols;
+    increasing = true;
+    for (i = 0; i < (long long int)nsites; i++) {
+        FULFILL_OR_RETURN(sites[i] < dims[0], ESCDF_ERANGE);
+        increasing = increasing && (i == 0 || sites[i] > sites[i - 1]);
+    }
+
+    if (increasing) {
+        /* Runs of consecutive sites, e.g. of a region of sites sorted
+           along a space-filling curve, are read as ranges of rows. */
+        coord = malloc(sizeof(hsize_t) * 2 * ((nsites > 0) ? nsites : 1));
+        FULFILL_OR_RETURN(coord != NULL, ESCDF_ENOMEM);
+        nranges = 0;
+        for (i = 0; i < (long long int)nsites; i++) {
+            if (nranges > 0 && sites[i] == coord[2 * nranges - 2] + coord[2 * nranges - 1]) {
+                coord[2 * nranges - 1] += 1;
+            } else {
+                coord[2 * nranges] = sites[i];
+                coord[2 * nranges + 1] = 1;
+                nranges += 1;
+            }
+        }
+    } else {
+        /* One point per value, in the order of the sites. */
+        coord = malloc(sizeof(hsize_t) * 2 * ncols * nsites);
+        FULFILL_OR_RETURN(coord != NULL, ESCDF_ENOMEM);
+        for (i = 0; i < (long long int)nsites; i++) {
+            for (j = 0; j < ncols; j++) {
+                coord[2 * (i * ncols + j)] = sites[i];
+                coord[2 * (i * ncols + j) + 1] = j;
+            }
+        }
+    }
+
+    utils_stats_start(geometry->handle, &timer);
+    utils_hdf5_lock();
+    err = utils_hdf5_check_dtset(geometry->group_id, site_data_names[data], dims, 2, &dtset_id);
+    if (err == ESCDF_SUCCESS) {
+        if ((err = utils_hdf5_selection_init(&sel, dtset_id)) == ESCDF_SUCCESS) {
+            if (increasing) {
+                err = utils_hdf5_selection_set_rows(&sel, (size_t)nranges, coord);
+            } else {
+                err = utils_hdf5_selection_set_elements(&sel, (size_t)nsites * ncols, coord);
+            }
+            if (err == ESCDF_SUCCESS) {
+                err = utils_hdf5_selection_read(&sel, dtset_id, geometry->handle->transfer_mode,
+                                                mem_type_id, buffer);
+            }
+            utils_hdf5_selection_free(&sel);
+        }
+        H5Dclose(dtset_id);
+    }
+    utils_hdf5_unlock();
+    utils_stats_stop(geometry->handle, &timer, ESCDF_STATS_READ_DATA);
+    free(coord);
+
+    return err;
+}
+
+
+/******************************************************************************
+ * Site index functions                                                       *
+ ******************************************************************************/
+
+/* Number of sites per cell aimed at when the number of cells is not given. */
+#define SITE_INDEX_SITES_PER_CELL 16
+
+/**
+ * Index of the cell of position x, the last dimension being the fastest.
+ * Positions outside of the grid of cells go to the closest cell.
+ */
+static hsize_t _site_cell(const double *x, unsigned int ncols,
+                          const double *corner, const double *cell_size,
+                          const unsigned int *number_of_cells)
+{
+    unsigned int j;
+    hsize_t cell;
+    double k;
+
+    cell = 0;
+    for (j = 0; j < ncols; j++) {
+        k = floor((x[j] - corner[j]) / cell_size[j]);
+        k = (k >= 0.) ? k : 0.;
+        k = (k < number_of_cells[j]) ? k : number_of_cells[j] - 1;
+        cell = cell * number_of_cells[j] + (hsize_t)k;
+    }
+
+    return cell;
+}
+
+static int _compare_sites(const void *a, const void *b)
+{
+    unsigned int i, j;
+
+    i = *(const unsigned int*)a;
+    j = *(const unsigned int*)b;
+
+    return (i > j) - (i < j);
+}
+
+/**
+ * Finds the sites of a region with the spatial index: for each row of cells
+ * overlapping the bounding box of the region along the last dimension, the
+ * offsets of the row are read, then the positions and indices of its sites,
+ * which are contiguous. The reads are independent.
+ */
+static escdf_errno_t _query_site_index(const escdf_geometry_t *geometry,
+                                       const double *lower, const double *upper,
+                                       const double *center, double radius,
+                                       unsigned int **sites, unsigned int *nsites)
+{
+    escdf_errno_t err;
+    hid_t group_id, dtset_ids[3];
+    utils_hdf5_selection_t sels[3];
+    utils_stats_timer_t timer;
+    hsize_t dims[2], ncells, first, last, coord[2], start[2], count[2];
+    unsigned int ncols, n, d, nsel, ndtset, number_of_cells[3], clo[3], chi[3], idx[3];
+    unsigned int range[2], capacity, max_len, *found, *row_sites, i;
+    double corner[3], cell_size[3], *row_positions, k;
+    bool empty;
+    void *tmp;
+
+    ncols = _site_ncols(geometry);
+    n = (unsigned int)geometry->number_of_sites.value;
+    FULFILL_OR_RETURN(ncols <= 3, ESCDF_ERROR_DIM);
+
+    utils_stats_start(geometry->handle, &timer);
+    utils_hdf5_lock();
+    ndtset = nsel = 0;
+    if ((group_id = H5Gopen(geometry->group_id, SITE_INDEX_GROUP, H5P_DEFAULT)) < 0) {
+        utils_hdf5_unlock();
+        utils_stats_stop(geometry->handle, &timer, ESCDF_STATS_READ_DATA);
+        RETURN_WITH_ERROR(group_id);
+    }
+    utils_stats_count_open();
+    dims[0] = ncols;
+    err = utils_hdf5_read_uint_array_into(group_id, "number_of_cells", number_of_cells,
+                                          dims, 1, NULL);
+    if (err == ESCDF_SUCCESS) {
+        err = utils_hdf5_read_dbl_array_into(group_id, "lower_corner", corner, dims, 1, NULL);
+    }
+    if (err == ESCDF_SUCCESS) {
+        err = utils_hdf5_read_dbl_array_into(group_id, "cell_size", cell_size, dims, 1, NULL);
+    }
+    ncells = 1;
+    for (d = 0; d < ncols && err == ESCDF_SUCCESS; d++) {
+        if (number_of_cells[d] == 0 || !(cell_size[d] > 0.)) {
+            DEFER_FUNC_ERROR(ESCDF_EFILE_FORMAT);
+            err = ESCDF_EFILE_FORMAT;
+        }
+        ncells *= number_of_cells[d];
+    }
+    if (err == ESCDF_SUCCESS) {
+        dims[0] = ncells + 1;
+        err = utils_hdf5_check_dtset(group_id, "cell_offsets", dims, 1, dtset_ids + ndtset);
+        ndtset += (err == ESCDF_SUCCESS);
+    }
+    if (err == ESCDF_SUCCESS) {
+        dims[0] = n;
+        err = utils_hdf5_check_dtset(group_id, "sites", dims, 1, dtset_ids + ndtset);
+        ndtset += (err == ESCDF_SUCCESS);
+    }
+    if (err == ESCDF_SUCCESS) {
+        dims[1] = ncols;
+        err = utils_hdf5_check_dtset(group_id, "site_positions", dims, 2, dtset_ids + ndtset);
+        ndtset += (err == ESCDF_SUCCESS);
+    }
+    for (nsel = 0; nsel < ndtset && err == ESCDF_SUCCESS; nsel++) {
+        if ((err = utils_hdf5_selection_init(sels + nsel, dtset_ids[nsel])) != ESCDF_SUCCESS) {
+            break;
+        }
+    }
+    utils_hdf5_unlock();
+
+    /* Range of the cells overlapping the region, along each dimension. */
+    empty = false;
+    for (d = 0; d < ncols && err == ESCDF_SUCCESS; d++) {
+        empty = empty || upper[d] < corner[d] ||
+            lower[d] >= corner[d] + number_of_cells[d] * cell_size[d];
+        k = floor((lower[d] - corner[d]) / cell_size[d]);
+        clo[d] = (k <= 0.) ? 0 : (k < number_of_cells[d]) ? (unsigned int)k : number_of_cells[d] - 1;
+        k = floor((upper[d] - corner[d]) / cell_size[d]);
+        chi[d] = (k <= 0.) ? 0 : (k < number_of_cells[d]) ? (unsigned int)k : number_of_cells[d] - 1;
+        idx[d] = clo[d];
+    }
+
+    found = row_sites = NULL;
+    row_positions = NULL;
+    capacity = max_len = 0;
+    while (err == ESCDF_SUCCESS && !empty) {
+        /* The cells of a row are consecutive, so are their sites. */
+        first = last = 0;
+        for (d = 0; d < ncols; d++) {
+            first = first * number_of_cells[d] + ((d + 1 < ncols) ? idx[d] : clo[d]);
+            last = last * number_of_cells[d] + ((d + 1 < ncols) ? idx[d] : chi[d]);
+        }
+        coord[0] = first;
+        coord[1] = last + 1;
+        utils_hdf5_lock();
+        err = utils_hdf5_selection_set_elements(sels, 2, coord);
+        if (err == ESCDF_SUCCESS) {
+            err = utils_hdf5_selection_read(sels, dtset_ids[0], H5P_DEFAULT,
+                                            H5T_NATIVE_UINT, range);
+        }
+        if (err == ESCDF_SUCCESS && range[1] > range[0]) {
+            if (range[1] > n) {
+                DEFER_FUNC_ERROR(ESCDF_EFILE_FORMAT);
+                err = ESCDF_EFILE_FORMAT;
+            } else if (range[1] - range[0] > max_len) {
+                max_len = range[1] - range[0];
+                if ((tmp = realloc(row_sites, sizeof(unsigned int) * max_len)) != NULL) {
+                    row_sites = tmp;
+                    tmp = realloc(row_positions, sizeof(double) * ncols * max_len);
+                    row_positions = (tmp != NULL) ? tmp : row_positions;
+                }
+                if (tmp == NULL) {
+                    DEFER_FUNC_ERROR(ESCDF_ENOMEM);
+                    err = ESCDF_ENOMEM;
+                }
+            }
+            start[0] = range[0];
+            start[1] = 0;
+            count[0] = range[1] - range[0];
+            count[1] = ncols;
+            if (err == ESCDF_SUCCESS) {
+                err = utils_hdf5_selection_set_slice(sels + 1, start, count, NULL);
+            }
+            if (err == ESCDF_SUCCESS) {
+                err = utils_hdf5_selection_read(sels + 1, dtset_ids[1], H5P_DEFAULT,
+                                                H5T_NATIVE_UINT, row_sites);
+            }
+            if (err == ESCDF_SUCCESS) {
+                err = utils_hdf5_selection_set_slice(sels + 2, start, count, NULL);
+            }
+            if (err == ESCDF_SUCCESS) {
+                err = utils_hdf5_selection_read(sels + 2, dtset_ids[2], H5P_DEFAULT,
+                                                H5T_NATIVE_DOUBLE, row_positions);
+            }
+        }
+        utils_hdf5_unlock();
+
+        for (i = 0; err == ESCDF_SUCCESS && range[1] > range[0] && i < range[1] - range[0]; i++) {
+            if (_site_in_region(row_positions + i * ncols, ncols, lower, upper, center, radius)) {
+                err = _append_site(&found, nsites, &capacity, row_sites[i]);
+            }
+        }
+
+        /* Next row, the last dimension being covered by the row itself. */
+        for (d = ncols - 1; d > 0; d--) {
+            if (++idx[d - 1] <= chi[d - 1]) {
+                break;
+            }
+            idx[d - 1] = clo[d - 1];
+        }
+        empty = (d == 0);
+    }
+    free(row_sites);
+    free(row_positions);
+
+    utils_hdf5_lock();
+    for (i = 0; i < nsel; i++) {
+        utils_hdf5_selection_free(sels + i);
+    }
+    for (i = 0; i < ndtset; i++) {
+        H5Dclose(dtset_ids[i]);
+    }
+    H5Gclose(group_id);
+    utils_hdf5_unlock();
+    utils_stats_stop(geometry->handle, &timer, ESCDF_STATS_READ_DATA);
+
+    if (err != ESCDF_SUCCESS) {
+        free(found);
+        *nsites = 0;
+        return err;
+    }
+    /* The sites come cell by cell. */
+    if (*nsites > 1) {
+        qsort(found, *nsites, sizeof(unsigned int), _compare_sites);
+    }
+    *sites = found;
+
+    return ESCDF_SUCCESS;
+}
+
+static escdf_errno_t _find_sites(const escdf_geometry_t *geometry,
+                                 const double *lower, const double *upper,
+                                 const double *center, double radius,
+                                 unsigned int **sites, unsigned int *nsites)
+{
+    bool indexed;
+
+    FULFILL_OR_RETURN(geometry, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(sites && nsites, ESCDF_EVALUE);
+    FULFILL_OR_RETURN(geometry->number_of_sites.is_set, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(_site_ncols(geometry) > 0, ESCDF_EUNINIT);
+
+    *sites = NULL;
+    *nsites = 0;
+
+    utils_hdf5_lock();
+    indexed = utils_hdf5_check_present(geometry->group_id, SITE_INDEX_GROUP);
+    utils_hdf5_unlock();
+
+    if (indexed) {
+        return _query_site_index(geometry, lower, upper, center, radius, sites, nsites);
+    }
+    return _scan_sites(geometry, lower, upper, center, radius, sites, nsites);
+}
+
+escdf_errno_t escdf_geometry_find_sites_in_region(
+        const escdf_geometry_t *geometry, const double *lower,
+        const double *upper, unsigned int **sites, unsigned int *nsites)
+{
+    FULFILL_OR_RETURN(lower && upper, ESCDF_EVALUE);
+
+    return _find_sites(geometry, lower, upper, NULL, 0., sites, nsites);
+}
+
+escdf_errno_t escdf_geometry_find_sites_within(
+        const escdf_geometry_t *geometry, const double *center, double radius,
+        unsigned int **sites, unsigned int *nsites)
+{
+    double lower[3], upper[3];
+    unsigned int d;
+
+    FULFILL_OR_RETURN(center && radius >= 0., ESCDF_EVALUE);
+    FULFILL_OR_RETURN(_site_ncols(geometry) > 0 && _site_ncols(geometry) <= 3, ESCDF_EUNINIT);
+
+    /* The bounding box, closed on its upper side. */
+    for (d = 0; d < _site_ncols(geometry); d++) {
+        lower[d] = center[d] - radius;
+        upper[d] = nextafter(center[d] + radius, INFINITY);
+    }
+
+    return _find_sites(geometry, lower, upper, center, radius, sites, nsites);
+}
+
+bool escdf_geometry_has_site_index(const escdf_geometry_t *geometry)
+{
+    bool indexed;
+
+    FULFILL_OR_RETURN_VAL(geometry, ESCDF_EOBJECT, false);
+
+    utils_hdf5_lock();
+    indexed = utils_hdf5_check_present(geometry->group_id, SITE_INDEX_GROUP);
+    utils_hdf5_unlock();
+
+    return indexed;
+}
+
+escdf_errno_t escdf_geometry_write_site_index(const escdf_geometry_t *geometry,
+                                              const unsigned int *number_of_cells)
+{
+    escdf_errno_t err;
+    hid_t group_id, dtset_id;
+    utils_stats_timer_t timer;
+    hsize_t dims[2], ncells, c;
+    unsigned int ncols, n, d, cells_per_dim[3], *offsets, *sorted;
+    double corner[3], upper[3], cell_size[3], *positions, *sorted_positions;
+    hsize_t *cells;
+    long long int i;
+
+    FULFILL_OR_RETURN(geometry, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(geometry->number_of_sites.is_set, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN((ncols = _site_ncols(geometry)) > 0, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(ncols <= 3, ESCDF_ERROR_DIM);
+
+    n = (unsigned int)geometry->number_of_sites.value;
+    positions = malloc(sizeof(double) * ncols * n);
+    FULFILL_OR_RETURN(positions != NULL, ESCDF_ENOMEM);
+    if ((err = _read_site_data(geometry, "site_positions", H5T_NATIVE_DOUBLE, ncols,
+                               positions, NULL, NULL, NULL)) != ESCDF_SUCCESS) {
+        free(positions);
+        return err;
+    }
+
+    /* The cells tile the bounding box of the sites. */
+    ncells = 1;
+    for (d = 0; d < ncols; d++) {
+        corner[d] = INFINITY;
+        upper[d] = -INFINITY;
+        for (i = 0; i < (long long int)n; i++) {
+            corner[d] = (positions[i * ncols + d] < corner[d]) ? positions[i * ncols + d] : corner[d];
+            upper[d] = (positions[i * ncols + d] > upper[d]) ? positions[i * ncols + d] : upper[d];
+        }
+        if (!isfinite(corner[d]) || !isfinite(upper[d])) {
+            free(positions);
+            RETURN_WITH_ERROR(ESCDF_ERANGE);
+        }
+        if (number_of_cells) {
+            cells_per_dim[d] = number_of_cells[d];
+        } else {
+            cells_per_dim[d] = (unsigned int)pow((double)n / SITE_INDEX_SITES_PER_CELL, 1. / ncols);
+            cells_per_dim[d] = (cells_per_dim[d] > 0) ? cells_per_dim[d] : 1;
+        }
+        if (cells_per_dim[d] == 0 || cells_per_dim[d] > INT_MAX / ncells) {
+            free(positions);
+            RETURN_WITH_ERROR(ESCDF_EVALUE);
+        }
+        ncells *= cells_per_dim[d];
+        /* The sites on the upper side go to the last cell. */
+        cell_size[d] = (upper[d] > corner[d]) ? (upper[d] - corner[d]) / cells_per_dim[d] : 1.;
+    }
+
+    utils_stats_start(geometry->handle, &timer);
+    cells = malloc(sizeof(hsize_t) * n);
+    offsets = calloc(ncells + 1, sizeof(unsigned int));
+    sorted = malloc(sizeof(unsigned int) * n);
+    sorted_positions = malloc(sizeof(double) * ncols * n);
+    if (cells == NULL || offsets == NULL || sorted == NULL || sorted_positions == NULL) {
+        free(cells);
+        free(offsets);
+        free(sorted);
+        free(sorted_positions);
+        free(positions);
+        utils_stats_stop(geometry->handle, &timer, ESCDF_STATS_WRITE_DATA);
+        RETURN_WITH_ERROR(ESCDF_ENOMEM);
+    }
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (i = 0; i < (long long int)n; i++) {
+        cells[i] = _site_cell(positions + i * ncols, ncols, corner, cell_size, cells_per_dim);
+    }
+    /* Counting sort of the sites by cell, keeping their order in a cell. */
+    for (i = 0; i < (long long int)n; i++) {
+        offsets[cells[i] + 1] += 1;
+    }
+    for (c = 0; c < ncells; c++) {
+        offsets[c + 1] += offsets[c];
+    }
+    for (i = 0; i < (long long int)n; i++) {
+        c = offsets[cells[i]]++;
+        sorted[c] = (unsigned int)i;
+        memcpy(sorted_positions + c * ncols, positions + i * ncols, sizeof(double) * ncols);
+    }
+    for (c = ncells; c > 0; c--) {
+        offsets[c] = offsets[c - 1];
+    }
+    offsets[0] = 0;
+    free(cells);
+    free(positions);
+
+    utils_hdf5_lock();
+    if (utils_hdf5_check_present(geometry->group_id, SITE_INDEX_GROUP) &&
+        H5Ldelete(geometry->group_id, SITE_INDEX_GROUP, H5P_DEFAULT) < 0) {
+        DEFER_FUNC_ERROR(ESCDF_ERROR);
+        err = ESCDF_ERROR;
+    } else {
+        err = utils_hdf5_create_group(geometry->group_id, SITE_INDEX_GROUP, &group_id);
+    }
+    if (err == ESCDF_SUCCESS) {
+        dims[0] = ncols;
+        err = utils_hdf5_write_attr(group_id, "number_of_cells", H5T_STD_U32LE, dims, 1,
+                                    H5T_NATIVE_UINT, cells_per_dim);
+        if (err == ESCDF_SUCCESS) {
+            err = utils_hdf5_write_attr(group_id, "lower_corner", H5T_IEEE_F64LE, dims, 1,
+                                        H5T_NATIVE_DOUBLE, corner);
+        }
+        if (err == ESCDF_SUCCESS) {
+            err = utils_hdf5_write_attr(group_id, "cell_size", H5T_IEEE_F64LE, dims, 1,
+                                        H5T_NATIVE_DOUBLE, cell_size);
+        }
+        dims[0] = ncells + 1;
+        if (err == ESCDF_SUCCESS &&
+            (err = utils_hdf5_create_dataset(group_id, "cell_offsets", H5T_STD_U32LE, dims, 1,
+                                             H5P_DEFAULT, &dtset_id)) == ESCDF_SUCCESS) {
+            err = utils_hdf5_write_dataset(dtset_id, geometry->handle->transfer_mode, offsets,
+                                           H5T_NATIVE_UINT, NULL, NULL, NULL);
+            H5Dclose(dtset_id);
+        }
+        dims[0] = n;
+        if (err == ESCDF_SUCCESS &&
+            (err = utils_hdf5_create_dataset(group_id, "sites", H5T_STD_U32LE, dims, 1,
+                                             H5P_DEFAULT, &dtset_id)) == ESCDF_SUCCESS) {
+            err = utils_hdf5_write_dataset(dtset_id, geometry->handle->transfer_mode, sorted,
+                                           H5T_NATIVE_UINT, NULL, NULL, NULL);
+            H5Dclose(dtset_id);
+        }
+        dims[1] = ncols;
+        if (err == ESCDF_SUCCESS &&
+            (err = utils_hdf5_create_dataset(group_id, "site_positions", H5T_IEEE_F64LE, dims, 2,
+                                             H5P_DEFAULT, &dtset_id)) == ESCDF_SUCCESS) {
+            err = utils_hdf5_write_dataset(dtset_id, geometry->handle->transfer_mode,
+                                           sorted_positions, H5T_NATIVE_DOUBLE, NULL, NULL, NULL);
+            H5Dclose(dtset_id);
+        }
+        H5Gclose(group_id);
+    }
+    utils_hdf5_unlock();
+    utils_stats_stop(geometry->handle, &timer, ESCDF_STATS_WRITE_DATA);
+
+    free(offsets);
+    free(sorted);
+    free(sorted_positions);
+
+    return err;
+}
+
+/* Bits per dimension of the Morton codes, 3 x 21 fitting in 64 bits. */
+#define MORTON_BITS 21
+
+typedef struct {
+    uint64_t key;
+    unsigned int site;
+} _morton_key_t;
+
+/* Spreads the MORTON_BITS lowest bits of v, 3 bits apart. */
+static uint64_t _morton_spread(uint64_t v)
+{
+    v &= (UINT64_C(1) << MORTON_BITS) - 1;
+    v = (v | v << 32) & UINT64_C(0x1f00000000ffff);
+    v = (v | v << 16) & UINT64_C(0x1f0000ff0000ff);
+    v = (v | v << 8) & UINT64_C(0x100f00f00f00f00f);
+    v = (v | v << 4) & UINT64_C(0x10c30c30c30c30c3);
+    v = (v | v << 2) & UINT64_C(0x1249249249249249);
+
+    return v;
+}
+
+static int _compare_morton_keys(const void *a, const void *b)
+{
+    const _morton_key_t *i, *j;
+
+    i = a;
+    j = b;
+    if (i->key != j->key) {
+        return (i->key > j->key) - (i->key < j->key);
+    }
+    return (i->site > j->site) - (i->site < j->site);
+}
+
+/* Moves the rows of values, of size bytes each, so that row k is the row order[k]. */
+static void _permute_rows(void *permuted, const void *values, const unsigned int *order,
+                          unsigned int n, size_t size)
+{
+    long long int k;
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (k = 0; k < (long long int)n; k++) {
+        memcpy((char*)permuted + k * size, (const char*)values + order[k] * size, size);
+    }
+}
+
+escdf_errno_t escdf_geometry_sort_sites(const escdf_geometry_t *geometry)
+{
+    escdf_errno_t err;
+    hid_t disk_type_id, mem_type_id;
+    unsigned int ncols, n, d, data, *order, *values;
+    double corner[3], scale[3], *positions;
+    _morton_key_t *keys;
+    const char *name;
+    void *buffer, *permuted;
+    long long int i;
+    size_t size;
+    bool present;
+
+    FULFILL_OR_RETURN(geometry, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(geometry->number_of_sites.is_set, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN((ncols = _site_ncols(geometry)) > 0, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(ncols <= 3, ESCDF_ERROR_DIM);
+
+    /* The frames of a trajectory would keep the former order of the sites. */
+    utils_hdf5_lock();
+    present = utils_hdf5_check_present(geometry->group_id, TRAJECTORY_GROUP);
+    utils_hdf5_unlock();
+    FULFILL_OR_RETURN(!present, ESCDF_ENOSUPPORT);
+
+    n = (unsigned int)geometry->number_of_sites.value;
+    positions = malloc(sizeof(double) * ncols * n);
+    keys = malloc(sizeof(_morton_key_t) * n);
+    order = malloc(sizeof(unsigned int) * n);
+    if (positions == NULL || keys == NULL || order == NULL) {
+        free(positions);
+        free(keys);
+        free(order);
+        RETURN_WITH_ERROR(ESCDF_ENOMEM);
+    }
+    if ((err = _read_site_data(geometry, "site_positions", H5T_NATIVE_DOUBLE, ncols,
+                               positions, NULL, NULL, NULL)) != ESCDF_SUCCESS) {
+        free(positions);
+        free(keys);
+        free(order);
+        return err;
+    }
+
+    /* The bounding box of the sites is mapped on 2^MORTON_BITS integers. */
+    for (d = 0; d < ncols; d++) {
+        corner[d] = INFINITY;
+        scale[d] = -INFINITY;
+        for (i = 0; i < (long long int)n; i++) {
+            corner[d] = (positions[i * ncols + d] < corner[d]) ? positions[i * ncols + d] : corner[d];
+            scale[d] = (positions[i * ncols + d] > scale[d]) ? positions[i * ncols + d] : scale[d];
+        }
+        if (!isfinite(corner[d]) || !isfinite(scale[d])) {
+            free(positions);
+            free(keys);
+            free(order);
+            RETURN_WITH_ERROR(ESCDF_ERANGE);
+        }
+        scale[d] = (scale[d] > corner[d]) ?
+            ((UINT64_C(1) << MORTON_BITS) - 1) / (scale[d] - corner[d]) : 0.;
+    }
+
+#ifdef _OPENMP
+#pragma omp parallel for private(d)
+#endif
+    for (i = 0; i < (long long int)n; i++) {
+        keys[i].key = 0;
+        keys[i].site = (unsigned int)i;
+        for (d = 0; d < ncols; d++) {
+            keys[i].key |= _morton_spread((uint64_t)((positions[i * ncols + d] - corner[d]) *
+                                                     scale[d])) << (ncols - 1 - d);
+        }
+    }
+    qsort(keys, n, sizeof(_morton_key_t), _compare_morton_keys);
+    for (i = 0; i < (long long int)n; i++) {
+        order[i] = keys[i].site;
+    }
+    free(keys);
+
+    /* Each present per-site data set is rewritten in the new order, which
+       also removes the spatial index. */
+    buffer = positions;
+    permuted = NULL;
+    for (data = 0; data <= ESCDF_N_SITE_DATA && err == ESCDF_SUCCESS; data++) {
+        if (data < ESCDF_N_SITE_DATA) {
+            name = site_data_names[data];
+            _site_data_type(geometry, (escdf_site_data)data, &disk_type_id, &mem_type_id, &ncols);
+        } else {
+            /* The original index of the sites, composed with a previous sort. */
+            name = "site_permutation";
+            disk_type_id = H5T_STD_U32LE;
+            mem_type_id = H5T_NATIVE_UINT;
+            ncols = 1;
+        }
+        size = H5Tget_size(mem_type_id) * ncols;
+        if (data != ESCDF_SITE_POSITIONS) {
+            utils_hdf5_lock();
+            present = utils_hdf5_check_present(geometry->group_id, name);
+            utils_hdf5_unlock();
+            if (!present && data < ESCDF_N_SITE_DATA) {
+                continue;
+            }
+            free(buffer);
+            buffer = malloc(size * n);
+            if (buffer == NULL) {
+                DEFER_FUNC_ERROR(ESCDF_ENOMEM);
+                err = ESCDF_ENOMEM;
+                break;
+            }
+            if (!present) {
+                values = buffer;
+                for (i = 0; i < (long long int)n; i++) {
+                    values[i] = (unsigned int)i;
+                }
+            } else if ((err = _read_site_data(geometry, name, mem_type_id, ncols, buffer,
+                                              NULL, NULL, NULL)) != ESCDF_SUCCESS) {
+                break;
+            }
+        }
+        free(permuted);
+        if ((permuted = malloc(size * n)) == NULL) {
+            DEFER_FUNC_ERROR(ESCDF_ENOMEM);
+            err = ESCDF_ENOMEM;
+            break;
+        }
+        _permute_rows(permuted, buffer, order, n, size);
+        err = _write_site_data(geometry, name, disk_type_id, mem_type_id, ncols, permuted,
+                               NULL, NULL, NULL);
+    }
+    free(buffer);
+    free(permuted);
+    free(order);
+
+    return err;
+}
+
+escdf_errno_t escdf_geometry_read_site_permutation(const escdf_geometry_t *geometry,
+                                                   unsigned int *permutation)
+{
+    bool present;
+    long long int i;
+
+    FULFILL_OR_RETURN(geometry, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(geometry->number_of_sites.is_set, ESCDF_EUNINIT);
+
+    utils_hdf5_lock();
+    present = utils_hdf5_check_present(geometry->group_id, "site_permutation");
+    utils_hdf5_unlock();
+    if (present) {
+        return _read_site_data(geometry, "site_permutation", H5T_NATIVE_UINT, 1,
+                               permutation, NULL, NULL, NULL);
+    }
+
+    /* Sites never sorted are in their original order. */
+    for (i = 0; i < geometry->number_of_sites.value; i++) {
+        permutation[i] = (unsigned int)i;
+    }
+
+    return ESCDF_SUCCESS;
+}
+
+
+/******************************************************************************
+ * Trajectory functions                                                       *
+ ******************************************************************************/
+
+/* Upper bound of the size of the chunks of the trajectory data sets. */
+#define TRAJECTORY_CHUNK_BYTES (4 * 1024 * 1024)
+
+/* Quantised positions: bound of the integers, so that deltas fit in 32 bits,
+   and deflate level applied after the byte shuffle. */
+#define TRAJECTORY_QUANTA_MAX 1073741824.
+#define TRAJECTORY_DEFLATE_LEVEL 4
+
+static const char *trajectory_names[ESCDF_N_TRAJECTORY_FIELDS] = {
+    "site_positions", "lattice_vectors", "site_forces", "times"
+};
+
+struct escdf_trajectory {
+    const escdf_geometry_t *geometry;
+    hid_t group_id;
+
+    /* Data set of each field, -1 when the field is not stored. */
+    hid_t dtset_ids[ESCDF_N_TRAJECTORY_FIELDS];
+    unsigned int frame_rank[ESCDF_N_TRAJECTORY_FIELDS];
+    hsize_t frame_dims[ESCDF_N_TRAJECTORY_FIELDS][2];
+    hsize_t frame_len[ESCDF_N_TRAJECTORY_FIELDS];
+
+    /* Frames written, and frames buffered before the next write. */
+    hsize_t number_of_frames;
+    unsigned int frames_per_write;
+    unsigned int number_of_buffered;
+    double *buffers[ESCDF_N_TRAJECTORY_FIELDS];
+
+    /* Quantisation of the positions, precision is 0 when they are raw. Each
+       frame is stored as the difference with the previous one, but every
+       keyframe_interval frames, stored as they are. reference holds the
+       quantised positions of the last frame written. */
+    double precision;
+    hsize_t keyframe_interval;
+    int32_t *reference;
+};
+
+/* Creates or opens the data set of a field, to be called with the lock. */
+static escdf_errno_t _open_trajectory_field(escdf_trajectory_t *trajectory,
+                                            escdf_trajectory_field field,
+                                            bool create, hsize_t *frames)
+{
+    hsize_t dims[3], maxdims[3], chunk[3], row;
+    unsigned int i, rank, interval;
+    hid_t dcpl_id, dtspace_id;
+    escdf_errno_t err;
+    bool quantised;
+    size_t size;
+    htri_t present;
+    int ndims;
+
+    rank = trajectory->frame_rank[field] + 1;
+    quantised = (field == ESCDF_TRAJECTORY_POSITIONS && trajectory->precision > 0.);
+    if (create) {
+        dims[0] = 0;
+        maxdims[0] = H5S_UNLIMITED;
+        /* One write of frames_per_write frames fills whole chunks. */
+        size = (quantised) ? sizeof(int32_t) : sizeof(double);
+        chunk[0] = trajectory->frames_per_write;
+        if (chunk[0] * trajectory->frame_len[field] * size > TRAJECTORY_CHUNK_BYTES) {
+            chunk[0] = TRAJECTORY_CHUNK_BYTES / (trajectory->frame_len[field] * size);
+            chunk[0] = (chunk[0] > 0) ? chunk[0] : 1;
+        }
+        for (i = 1; i < rank; i++) {
+            dims[i] = maxdims[i] = chunk[i] = trajectory->frame_dims[field][i - 1];
+        }
+        /* Frames larger than the bound are split along their first
+           dimension, the sites. */
+        if (rank > 1 && trajectory->frame_len[field] * size > TRAJECTORY_CHUNK_BYTES) {
+            row = trajectory->frame_len[field] / chunk[1];
+            chunk[1] = TRAJECTORY_CHUNK_BYTES / (row * size);
+            chunk[1] = (chunk[1] > 0) ? chunk[1] : 1;
+        }
+        if ((dcpl_id = H5Pcreate(H5P_DATASET_CREATE)) < 0) {
+            RETURN_WITH_ERROR(dcpl_id);
+        }
+        if (H5Pset_chunk(dcpl_id, rank, chunk) < 0 ||
+            (quantised && H5Pset_shuffle(dcpl_id) < 0) ||
+            (quantised && H5Zfilter_avail(H5Z_FILTER_DEFLATE) > 0 &&
+             H5Pset_deflate(dcpl_id, TRAJECTORY_DEFLATE_LEVEL) < 0)) {
+            H5Pclose(dcpl_id);
+            RETURN_WITH_ERROR(ESCDF_ERROR);
+        }
+        err = utils_hdf5_create_dataset_max(trajectory->group_id, trajectory_names[field],
+                                            quantised ? H5T_STD_I32LE : H5T_IEEE_F64LE,
+                                            dims, maxdims, rank,
+                                            dcpl_id, trajectory->dtset_ids + field);
+        H5Pclose(dcpl_id);
+        *frames = 0;
+        if (err != ESCDF_SUCCESS || !quantised) {
+            return err;
+        }
+
+        /* The keyframes start the chunks. */
+        trajectory->keyframe_interval = chunk[0];
+        interval = (unsigned int)chunk[0];
+        if ((err = utils_hdf5_write_attr(trajectory->dtset_ids[field], "precision",
+                                         H5T_IEEE_F64LE, NULL, 0, H5T_NATIVE_DOUBLE,
+                                         &trajectory->precision)) != ESCDF_SUCCESS) {
+            return err;
+        }
+        return utils_hdf5_write_attr(trajectory->dtset_ids[field], "keyframe_interval",
+                                     H5T_STD_U32LE, NULL, 0, H5T_NATIVE_UINT, &interval);
+    }
+
+    if ((trajectory->dtset_ids[field] = H5Dopen(trajectory->group_id,
+                                                trajectory_names[field], H5P_DEFAULT)) < 0) {
+        RETURN_WITH_ERROR(trajectory->dtset_ids[field]);
+    }
+    utils_stats_count_open();
+    if ((dtspace_id = H5Dget_space(trajectory->dtset_ids[field])) < 0) {
+        RETURN_WITH_ERROR(dtspace_id);
+    }
+    ndims = H5Sget_simple_extent_ndims(dtspace_id);
+    if (ndims == (int)rank) {
+        ndims = H5Sget_simple_extent_dims(dtspace_id, dims, NULL);
+    }
+    H5Sclose(dtspace_id);
+    FULFILL_OR_RETURN(ndims == (int)rank, ESCDF_ERROR_DIM);
+    for (i = 1; i < rank; i++) {
+        FULFILL_OR_RETURN(dims[i] == trajectory->frame_dims[field][i - 1], ESCDF_ERROR_DIM);
+    }
+    *frames = dims[0];
+
+    /* The encoding of an existing trajectory is the one of the file. */
+    if (field == ESCDF_TRAJECTORY_POSITIONS) {
+        trajectory->precision = 0.;
+        if ((present = H5Aexists(trajectory->dtset_ids[field], "precision")) < 0) {
+            RETURN_WITH_ERROR(present);
+        }
+        if (present) {
+            if ((err = utils_hdf5_read_attr(trajectory->dtset_ids[field], "precision",
+                                            H5T_NATIVE_DOUBLE, NULL, 0,
+                                            &trajectory->precision)) != ESCDF_SUCCESS ||
+                (err = utils_hdf5_read_attr(trajectory->dtset_ids[field], "keyframe_interval",
+                                            H5T_NATIVE_UINT, NULL, 0,
+                                            &interval)) != ESCDF_SUCCESS) {
+                return err;
+            }
+            FULFILL_OR_RETURN(trajectory->precision > 0. && interval > 0, ESCDF_EFILE_FORMAT);
+            trajectory->keyframe_interval = interval;
+        }
+    }
+
+    return ESCDF_SUCCESS;
+}
+
+/* Creates or opens the trajectory group and data sets, with the lock. */
+static escdf_errno_t _open_trajectory(escdf_trajectory_t *trajectory,
+                                      unsigned int fields)
+{
+    escdf_errno_t err;
+    hsize_t frames;
+    bool create;
+    int f;
+
+    create = !utils_hdf5_check_present(trajectory->geometry->group_id, TRAJECTORY_GROUP);
+    if (create) {
+        trajectory->group_id = H5Gcreate(trajectory->geometry->group_id, TRAJECTORY_GROUP,
+                                         H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    } else {
+        trajectory->group_id = H5Gopen(trajectory->geometry->group_id, TRAJECTORY_GROUP,
+                                       H5P_DEFAULT);
+        utils_stats_count_open();
+    }
+    if (trajectory->group_id < 0) {
+        RETURN_WITH_ERROR(trajectory->group_id);
+    }
+
+    /* The times are always stored, and give the number of frames. */
+    fields |= 1u << ESCDF_TRAJECTORY_TIMES;
+    frames = 0;
+    for (f = ESCDF_N_TRAJECTORY_FIELDS - 1; f >= 0; f--) {
+        if (create ? !(fields & (1u << f)) :
+            !utils_hdf5_check_present(trajectory->group_id, trajectory_names[f])) {
+            FULFILL_OR_RETURN(f != ESCDF_TRAJECTORY_TIMES, ESCDF_EFILE_FORMAT);
+            continue;
+        }
+        if ((err = _open_trajectory_field(trajectory, f, create, &frames)) != ESCDF_SUCCESS) {
+            return err;
+        }
+        if (f == ESCDF_TRAJECTORY_TIMES) {
+            trajectory->number_of_frames = frames;
+        }
+        FULFILL_OR_RETURN(frames == trajectory->number_of_frames, ESCDF_ESIZE);
+    }
+
+    return ESCDF_SUCCESS;
+}
+
+static escdf_errno_t _write_buffered_frames(escdf_trajectory_t *trajectory,
+                                            const int32_t *encoded)
+{
+    escdf_errno_t err;
+    hsize_t dims[3], start[3], count[3];
+    unsigned int i, rank;
+    herr_t err_id;
+    int f;
+
+    err = ESCDF_SUCCESS;
+    for (f = 0; f < ESCDF_N_TRAJECTORY_FIELDS && err == ESCDF_SUCCESS; f++) {
+        if (trajectory->dtset_ids[f] < 0) {
+            continue;
+        }
+        rank = trajectory->frame_rank[f] + 1;
+        dims[0] = trajectory->number_of_frames + trajectory->number_of_buffered;
+        start[0] = trajectory->number_of_frames;
+        count[0] = trajectory->number_of_buffered;
+        for (i = 1; i < rank; i++) {
+            dims[i] = count[i] = trajectory->frame_dims[f][i - 1];
+            start[i] = 0;
+        }
+        if ((err_id = H5Dset_extent(trajectory->dtset_ids[f], dims)) < 0) {
+            DEFER_FUNC_ERROR(err_id);
+            err = ESCDF_ERROR;
+            break;
+        }
+        if (f == ESCDF_TRAJECTORY_POSITIONS && encoded != NULL) {
+            err = utils_hdf5_write_dataset(trajectory->dtset_ids[f],
+                                           trajectory->geometry->handle->transfer_mode,
+                                           encoded, H5T_NATIVE_INT32, start, count, NULL);
+        } else {
+            err = utils_hdf5_write_dataset(trajectory->dtset_ids[f],
+                                           trajectory->geometry->handle->transfer_mode,
+                                           trajectory->buffers[f], H5T_NATIVE_DOUBLE,
+                                           start, count, NULL);
+        }
+    }
+
+    return err;
+}
+
+/**
+ * Checks that the positions of a frame can be quantised, before the frame
+ * is buffered: NaN escapes the range check, and cannot be converted to an
+ * integer.
+ */
+static escdf_errno_t _check_positions(const escdf_trajectory_t *trajectory,
+                                      const double *x)
+{
+    double scale, min, max;
+    long long int i, n;
+    int finite;
+
+    n = (long long int)trajectory->frame_len[ESCDF_TRAJECTORY_POSITIONS];
+    scale = 1. / trajectory->precision;
+    finite = 1;
+#ifdef _OPENMP
+#pragma omp parallel for reduction(&&:finite)
+#endif
+    for (i = 0; i < n; i++) {
+        finite = finite && isfinite(x[i]);
+    }
+    FULFILL_OR_RETURN(finite, ESCDF_EVALUE);
+    utils_minmax_dbl(x, (size_t)n, &min, &max);
+    FULFILL_OR_RETURN(fabs(min) * scale < TRAJECTORY_QUANTA_MAX &&
+                      fabs(max) * scale < TRAJECTORY_QUANTA_MAX, ESCDF_ERANGE);
+
+    return ESCDF_SUCCESS;
+}
+
+/**
+ * Quantises the buffered positions, checked by _check_positions(), as
+ * differences with the previous frame but for the keyframes. The loops over
+ * the values of a frame are independent, and vectorised.
+ */
+static escdf_errno_t _encode_positions(const escdf_trajectory_t *trajectory,
+                                       int32_t *encoded, int32_t *ref)
+{
+    const double *x;
+    int32_t *e;
+    double scale;
+    hsize_t len, frame;
+    long long int i;
+    unsigned int b;
+
+    len = trajectory->frame_len[ESCDF_TRAJECTORY_POSITIONS];
+    scale = 1. / trajectory->precision;
+
+    for (b = 0; b < trajectory->number_of_buffered; b++) {
+        frame = trajectory->number_of_frames + b;
+        x = trajectory->buffers[ESCDF_TRAJECTORY_POSITIONS] + b * len;
+        e = encoded + b * len;
+        if (frame % trajectory->keyframe_interval == 0) {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+            for (i = 0; i < (long long int)len; i++) {
+                ref[i] = e[i] = (int32_t)nearbyint(x[i] * scale);
+            }
+        } else {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+            for (i = 0; i < (long long int)len; i++) {
+                e[i] = (int32_t)nearbyint(x[i] * scale);
+                e[i] -= ref[i];
+                ref[i] += e[i];
+            }
+        }
+    }
+
+    return ESCDF_SUCCESS;
+}
+
+/**
+ * Reads count quantised frames of positions, from first every stride. For
+ * each keyframe interval, the frames from the keyframe to the last one
+ * requested are read at once, as their chunk is anyway, then summed up
+ * into the caller's buffer, if any, and into last, if any, for the last
+ * frame read.
+ */
+static escdf_errno_t _read_quantised(escdf_trajectory_t *trajectory,
+                                     hsize_t first, hsize_t count, hsize_t stride,
+                                     double *buffer, int32_t *last)
+{
+    escdf_errno_t err;
+    hsize_t start[3], counts[3];
+    hsize_t len, interval, i, j, f, k, n;
+    int32_t *deltas;
+    long long int v;
+
+    len = trajectory->frame_len[ESCDF_TRAJECTORY_POSITIONS];
+    interval = trajectory->keyframe_interval;
+    deltas = NULL;
+    err = ESCDF_SUCCESS;
+    for (i = 0; i < count && err == ESCDF_SUCCESS; i = j + 1) {
+        f = first + i * stride;
+        k = f - f % interval;
+        for (j = i; j + 1 < count && first + (j + 1) * stride < k + interval; j++);
+        n = first + j * stride - k + 1;
+
+        free(deltas);
+        deltas = malloc(sizeof(int32_t) * n * len);
+        FULFILL_OR_RETURN(deltas != NULL, ESCDF_ENOMEM);
+        start[0] = k;
+        counts[0] = n;
+        start[1] = start[2] = 0;
+        counts[1] = trajectory->frame_dims[ESCDF_TRAJECTORY_POSITIONS][0];
+        counts[2] = trajectory->frame_dims[ESCDF_TRAJECTORY_POSITIONS][1];
+        utils_hdf5_lock();
+        err = utils_hdf5_read_dataset(trajectory->dtset_ids[ESCDF_TRAJECTORY_POSITIONS],
+                                      trajectory->geometry->handle->transfer_mode,
+                                      deltas, H5T_NATIVE_INT32, start, counts, NULL);
+        utils_hdf5_unlock();
+        if (err != ESCDF_SUCCESS) {
+            break;
+        }
+
+        /* Each value is summed up along the frames independently. */
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+        for (v = 0; v < (long long int)len; v++) {
+            hsize_t fr;
+            int32_t a;
+
+            a = 0;
+            for (fr = 0; fr < n; fr++) {
+                a += deltas[fr * len + v];
+                if (buffer && k + fr >= f && (k + fr - f) % stride == 0) {
+                    buffer[(i + (k + fr - f) / stride) * len + v] = a * trajectory->precision;
+                }
+            }
+            if (last) {
+                last[v] = a;
+            }
+        }
+    }
+    free(deltas);
+
+    return err;
+}
+
+static void _free_trajectory(escdf_trajectory_t *trajectory)
+{
+    int f;
+
+    for (f = 0; f < ESCDF_N_TRAJECTORY_FIELDS; f++) {
+        if (trajectory->dtset_ids[f] >= 0) {
+            H5Dclose(trajectory->dtset_ids[f]);
+        }
+        free(trajectory->buffers[f]);
+    }
+    free(trajectory->reference);
+    if (trajectory->group_id >= 0) {
+        H5Gclose(trajectory->group_id);
+    }
+    free(trajectory);
+}
+
+static escdf_trajectory_t * _new_trajectory(
+        const escdf_geometry_t *geometry, unsigned int fields,
+        unsigned int frames_per_write, double precision)
+{
+    escdf_trajectory_t *trajectory;
+    escdf_errno_t err;
+    unsigned int ndims;
+    int f;
+
+    FULFILL_OR_RETURN_VAL(geometry, ESCDF_EOBJECT, NULL);
+    FULFILL_OR_RETURN_VAL(_site_ncols(geometry) > 0, ESCDF_EUNINIT, NULL);
+    FULFILL_OR_RETURN_VAL(geometry->number_of_sites.is_set, ESCDF_EUNINIT, NULL);
+    FULFILL_OR_RETURN_VAL(frames_per_write > 0, ESCDF_EVALUE, NULL);
+
+    trajectory = calloc(1, sizeof(escdf_trajectory_t));
+    FULFILL_OR_RETURN_VAL(trajectory != NULL, ESCDF_ENOMEM, NULL);
+    trajectory->geometry = geometry;
+    trajectory->group_id = -1;
+    trajectory->frames_per_write = frames_per_write;
+    trajectory->precision = precision;
+
+    /* Shape of one frame of each field. */
+    ndims = _site_ncols(geometry);
+    trajectory->frame_rank[ESCDF_TRAJECTORY_POSITIONS] = 2;
+    trajectory->frame_dims[ESCDF_TRAJECTORY_POSITIONS][0] = geometry->number_of_sites.value;
+    trajectory->frame_dims[ESCDF_TRAJECTORY_POSITIONS][1] = ndims;
+    trajectory->frame_rank[ESCDF_TRAJECTORY_LATTICE_VECTORS] = 2;
+    trajectory->frame_dims[ESCDF_TRAJECTORY_LATTICE_VECTORS][0] = ndims;
+    trajectory->frame_dims[ESCDF_TRAJECTORY_LATTICE_VECTORS][1] = ndims;
+    trajectory->frame_rank[ESCDF_TRAJECTORY_FORCES] = 2;
+    trajectory->frame_dims[ESCDF_TRAJECTORY_FORCES][0] = geometry->number_of_sites.value;
+    trajectory->frame_dims[ESCDF_TRAJECTORY_FORCES][1] = ndims;
+    trajectory->frame_rank[ESCDF_TRAJECTORY_TIMES] = 0;
+    for (f = 0; f < ESCDF_N_TRAJECTORY_FIELDS; f++) {
+        trajectory->dtset_ids[f] = -1;
+        trajectory->frame_len[f] = (trajectory->frame_rank[f] > 0) ?
+            trajectory->frame_dims[f][0] * trajectory->frame_dims[f][1] : 1;
+    }
+
+    utils_hdf5_lock();
+    err = _open_trajectory(trajectory, fields);
+    utils_hdf5_unlock();
+
+    for (f = 0; f < ESCDF_N_TRAJECTORY_FIELDS && err == ESCDF_SUCCESS; f++) {
+        if (trajectory->dtset_ids[f] >= 0) {
+            trajectory->buffers[f] = malloc(sizeof(double) * frames_per_write *
+                                            trajectory->frame_len[f]);
+            if (trajectory->buffers[f] == NULL) {
+                DEFER_FUNC_ERROR(ESCDF_ENOMEM);
+                err = ESCDF_ENOMEM;
+            }
+        }
+    }
+
+    /* Appending after a keyframe needs the last frame written. */
+    if (err == ESCDF_SUCCESS && trajectory->precision > 0. &&
+        trajectory->dtset_ids[ESCDF_TRAJECTORY_POSITIONS] >= 0) {
+        trajectory->reference = malloc(sizeof(int32_t) *
+                                       trajectory->frame_len[ESCDF_TRAJECTORY_POSITIONS]);
+        if (trajectory->reference == NULL) {
+            DEFER_FUNC_ERROR(ESCDF_ENOMEM);
+            err = ESCDF_ENOMEM;
+        } else if (trajectory->number_of_frames % trajectory->keyframe_interval != 0) {
+            err = _read_quantised(trajectory, trajectory->number_of_frames - 1, 1, 1,
+                                  NULL, trajectory->reference);
+        }
+    }
+    if (err != ESCDF_SUCCESS) {
+        utils_hdf5_lock();
+        _free_trajectory(trajectory);
+        utils_hdf5_unlock();
+        return NULL;
+    }
+
+    return trajectory;
+}
+
+escdf_trajectory_t * escdf_geometry_open_trajectory(
+        const escdf_geometry_t *geometry, unsigned int fields,
+        unsigned int frames_per_write)
+{
+    return _new_trajectory(geometry, fields, frames_per_write, 0.);
+}
+
+escdf_trajectory_t * escdf_geometry_open_trajectory_quantised(
+        const escdf_geometry_t *geometry, unsigned int fields,
+        unsigned int frames_per_write, double precision)
+{
+    FULFILL_OR_RETURN_VAL(precision > 0., ESCDF_EVALUE, NULL);
+
+    return _new_trajectory(geometry, fields, frames_per_write, precision);
+}
+
+escdf_errno_t escdf_trajectory_close(escdf_trajectory_t *trajectory)
+{
+    escdf_errno_t err;
+
+    FULFILL_OR_RETURN(trajectory, ESCDF_EOBJECT);
+
+    err = escdf_trajectory_flush(trajectory);
+    utils_hdf5_lock();
+    _free_trajectory(trajectory);
+    utils_hdf5_unlock();
+
+    return err;
+}
+
+escdf_errno_t escdf_trajectory_append(escdf_trajectory_t *trajectory,
+        double time, const double *positions, const double *lattice_vectors,
+        const double *forces)
+{
+    escdf_errno_t err;
+    const double *values[ESCDF_N_TRAJECTORY_FIELDS];
+    hsize_t len;
+    int f;
+
+    FULFILL_OR_RETURN(trajectory, ESCDF_EOBJECT);
+
+    values[ESCDF_TRAJECTORY_POSITIONS] = positions;
+    values[ESCDF_TRAJECTORY_LATTICE_VECTORS] = lattice_vectors;
+    values[ESCDF_TRAJECTORY_FORCES] = forces;
+    values[ESCDF_TRAJECTORY_TIMES] = &time;
+    for (f = 0; f < ESCDF_N_TRAJECTORY_FIELDS; f++) {
+        FULFILL_OR_RETURN(trajectory->dtset_ids[f] < 0 || values[f] != NULL, ESCDF_EVALUE);
+    }
+    /* A frame that cannot be written is never buffered. */
+    if (trajectory->reference != NULL) {
+        if ((err = _check_positions(trajectory, positions)) != ESCDF_SUCCESS) {
+            return err;
+        }
+    }
+    /* The buffer is still full when its last write failed. */
+    if (trajectory->number_of_buffered == trajectory->frames_per_write) {
+        if ((err = escdf_trajectory_flush(trajectory)) != ESCDF_SUCCESS) {
+            return err;
+        }
+    }
+
+    for (f = 0; f < ESCDF_N_TRAJECTORY_FIELDS; f++) {
+        if (trajectory->dtset_ids[f] >= 0) {
+            len = trajectory->frame_len[f];
+            memcpy(trajectory->buffers[f] + trajectory->number_of_buffered * len,
+                   values[f], sizeof(double) * len);
+        }
+    }
+    trajectory->number_of_buffered += 1;
+
+    if (trajectory->number_of_buffered == trajectory->frames_per_write) {
+        return escdf_trajectory_flush(trajectory);
+    }
+    return ESCDF_SUCCESS;
+}
+
+escdf_errno_t escdf_trajectory_flush(escdf_trajectory_t *trajectory)
+{
+    escdf_errno_t err;
+    utils_stats_timer_t timer;
+    int32_t *encoded, *ref;
+    hsize_t len;
+
+    FULFILL_OR_RETURN(trajectory, ESCDF_EOBJECT);
+
+    if (trajectory->number_of_buffered == 0) {
+        return ESCDF_SUCCESS;
+    }
+
+    utils_stats_start(trajectory->geometry->handle, &timer);
+
+    /* The positions are encoded outside of the HDF5 lock, against a copy
+       of the reference, which replaces it once the frames are written, so
+       that a failed write can be retried. */
+    encoded = NULL;
+    ref = NULL;
+    if (trajectory->reference != NULL) {
+        len = trajectory->frame_len[ESCDF_TRAJECTORY_POSITIONS];
+        encoded = malloc(sizeof(int32_t) * trajectory->number_of_buffered * len);
+        ref = malloc(sizeof(int32_t) * len);
+        if (encoded == NULL || ref == NULL) {
+            free(encoded);
+            free(ref);
+            utils_stats_stop(trajectory->geometry->handle, &timer, ESCDF_STATS_WRITE_DATA);
+            RETURN_WITH_ERROR(ESCDF_ENOMEM);
+        }
+        memcpy(ref, trajectory->reference, sizeof(int32_t) * len);
+        if ((err = _encode_positions(trajectory, encoded, ref)) != ESCDF_SUCCESS) {
+            free(encoded);
+            free(ref);
+            utils_stats_stop(trajectory->geometry->handle, &timer, ESCDF_STATS_WRITE_DATA);
+            return err;
+        }
+    }
+
+    utils_hdf5_lock();
+    err = _write_buffered_frames(trajectory, encoded);
+    utils_hdf5_unlock();
+    free(encoded);
+    utils_stats_stop(trajectory->geometry->handle, &timer, ESCDF_STATS_WRITE_DATA);
+
+    if (err == ESCDF_SUCCESS) {
+        trajectory->number_of_frames += trajectory->number_of_buffered;
+        trajectory->number_of_buffered = 0;
+        if (ref != NULL) {
+            free(trajectory->reference);
+            trajectory->reference = ref;
+        }
+    } else {
+        free(ref);
+    }
+    return err;
+}
+
+hsize_t escdf_trajectory_get_number_of_frames(
+        const escdf_trajectory_t *trajectory)
+{
+    FULFILL_OR_RETURN_VAL(trajectory, ESCDF_EOBJECT, 0);
+
+    return trajectory->number_of_frames + trajectory->number_of_buffered;
+}
+
+double escdf_trajectory_get_precision(const escdf_trajectory_t *trajectory)
+{
+    FULFILL_OR_RETURN_VAL(trajectory, ESCDF_EOBJECT, 0.);
+
+    return trajectory->precision;
+}
+
+bool escdf_trajectory_has_field(const escdf_trajectory_t *trajectory,
+        escdf_trajectory_field field)
+{
+    FULFILL_OR_RETURN_VAL(trajectory, ESCDF_EOBJECT, false);
+    FULFILL_OR_RETURN_VAL(field < ESCDF_N_TRAJECTORY_FIELDS, ESCDF_EVALUE, false);
+
+    return trajectory->dtset_ids[field] >= 0;
+}
+
+escdf_errno_t escdf_trajectory_read_frames(escdf_trajectory_t *trajectory,
+        escdf_trajectory_field field, hsize_t first, hsize_t count,
+        hsize_t stride, double *buffer)
+{
+    escdf_errno_t err;
+    hsize_t start[3], counts[3], strides[3];
+    unsigned int i, rank;
+    utils_stats_timer_t timer;
+
+    FULFILL_OR_RETURN(trajectory, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(field < ESCDF_N_TRAJECTORY_FIELDS, ESCDF_EVALUE);
+    FULFILL_OR_RETURN(trajectory->dtset_ids[field] >= 0, ESCDF_EUNINIT);
+
+    if ((err = escdf_trajectory_flush(trajectory)) != ESCDF_SUCCESS) {
+        return err;
+    }
+    if (count == 0) {
+        return ESCDF_SUCCESS;
+    }
+    stride = (stride > 0) ? stride : 1;
+    FULFILL_OR_RETURN(first + (count - 1) * stride < trajectory->number_of_frames,
+                      ESCDF_ERANGE);
+
+    if (field == ESCDF_TRAJECTORY_POSITIONS && trajectory->precision > 0.) {
+        utils_stats_start(trajectory->geometry->handle, &timer);
+        err = _read_quantised(trajectory, first, count, stride, buffer, NULL);
+        utils_stats_stop(trajectory->geometry->handle, &timer, ESCDF_STATS_READ_DATA);
+        return err;
+    }
+
+    /* Frames are selected along the first dimension only. */
+    rank = trajectory->frame_rank[field] + 1;
+    start[0] = first;
+    counts[0] = count;
+    strides[0] = stride;
+    for (i = 1; i < rank; i++) {
+        start[i] = 0;
+        counts[i] = trajectory->frame_dims[field][i - 1];
+        strides[i] = 1;
+    }
+
+    utils_stats_start(trajectory->geometry->handle, &timer);
+    utils_hdf5_lock();
+    err = utils_hdf5_read_dataset(trajectory->dtset_ids[field],
+                                  trajectory->geometry->handle->transfer_mode,
+                                  buffer, H5T_NATIVE_DOUBLE, start, counts, strides);
+    utils_hdf5_unlock();
+    utils_stats_stop(trajectory->geometry->handle, &timer, ESCDF_STATS_READ_DATA);
+
+    return err;
+}
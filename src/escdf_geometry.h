@@ -36,6 +36,34 @@
 
 typedef struct escdf_geometry escdf_geometry_t;
 
+/**
+ * Trajectory of a geometry, e.g. of a molecular dynamics run: one frame per
+ * step, each with some of the fields below. The time of each frame is
+ * always stored.
+ */
+typedef struct escdf_trajectory escdf_trajectory_t;
+
+typedef enum {
+    ESCDF_TRAJECTORY_POSITIONS = 0,
+    ESCDF_TRAJECTORY_LATTICE_VECTORS,
+    ESCDF_TRAJECTORY_FORCES,
+    ESCDF_TRAJECTORY_TIMES,
+    ESCDF_N_TRAJECTORY_FIELDS
+} escdf_trajectory_field;
+
+/**
+ * Per-site data sets, for the distributed functions below. The species at
+ * sites are int, the other ones double.
+ */
+typedef enum {
+    ESCDF_SITE_POSITIONS = 0,
+    ESCDF_SITE_VELOCITIES,
+    ESCDF_SITE_FORCES,
+    ESCDF_SITE_MAGNETIC_MOMENT_DIRECTIONS,
+    ESCDF_SITE_SPECIES,
+    ESCDF_N_SITE_DATA
+} escdf_site_data;
+
 
 /******************************************************************************
  * Global functions                                                           *
@@ -153,44 +181,461 @@ escdf_errno_t escdf_geometry_get_dimension_types(
 const int * escdf_geometry_ptr_dimension_types(
         const escdf_geometry_t *geometry);
 
+/**
+ * Sets the value of embedded_system in the geometry data type.
+ *
+ * @param[in,out] geometry: instance of the geometry group.
+ * @param[in] embedded_system: the value of the variable to be set.
+ * @return error code.
+ */
+escdf_errno_t escdf_geometry_set_embedded_system(
+        escdf_geometry_t *geometry, const bool embedded_system);
+
+/**
+ * Get the value of embedded_system stored in the geometry data type.
+ *
+ * @param[in] geometry: instance of the geometry group.
+ * @return the value of the variable.
+ */
+bool escdf_geometry_get_embedded_system(
+        const escdf_geometry_t *geometry);
+
+/**
+ * Returns if embedded_system has been set or not in the geometry data type.
+ *
+ * @param[in] geometry: instance of the geometry group.
+ * @return TRUE if the variable has been set, FALSE otherwise.
+ */
+bool escdf_geometry_is_set_embedded_system(
+        const escdf_geometry_t *geometry);
+
+/**
+ * Sets the value of number_of_species in the geometry data type.
+ *
+ * @param[in,out] geometry: instance of the geometry group.
+ * @param[in] number_of_species: the value of the variable to be set.
+ * @return error code.
+ */
+escdf_errno_t escdf_geometry_set_number_of_species(
+        escdf_geometry_t *geometry, const int number_of_species);
+
+/**
+ * Get the value of number_of_species stored in the geometry data type.
+ *
+ * @param[in] geometry: instance of the geometry group.
+ * @return the value of the variable.
+ */
+int escdf_geometry_get_number_of_species(
+        const escdf_geometry_t *geometry);
+
+/**
+ * Returns if number_of_species has been set or not in the geometry data type.
+ *
+ * @param[in] geometry: instance of the geometry group.
+ * @return TRUE if the variable has been set, FALSE otherwise.
+ */
+bool escdf_geometry_is_set_number_of_species(
+        const escdf_geometry_t *geometry);
+
+/**
+ * Sets the value of number_of_sites in the geometry data type.
+ *
+ * @param[in,out] geometry: instance of the geometry group.
+ * @param[in] number_of_sites: the value of the variable to be set.
+ * @return error code.
+ */
+escdf_errno_t escdf_geometry_set_number_of_sites(
+        escdf_geometry_t *geometry, const int number_of_sites);
+
+/**
+ * Get the value of number_of_sites stored in the geometry data type.
+ *
+ * @param[in] geometry: instance of the geometry group.
+ * @return the value of the variable.
+ */
+int escdf_geometry_get_number_of_sites(
+        const escdf_geometry_t *geometry);
+
+/**
+ * Returns if number_of_sites has been set or not in the geometry data type.
+ *
+ * @param[in] geometry: instance of the geometry group.
+ * @return TRUE if the variable has been set, FALSE otherwise.
+ */
+bool escdf_geometry_is_set_number_of_sites(
+        const escdf_geometry_t *geometry);
+
+/**
+ * Sets the value of absolute_or_reduced_coordinates in the geometry data type.
+ *
+ * @param[in,out] geometry: instance of the geometry group.
+ * @param[in] absolute_or_reduced_coordinates: the value of the variable to be set.
+ * @return error code.
+ */
+escdf_errno_t escdf_geometry_set_absolute_or_reduced_coordinates(
+        escdf_geometry_t *geometry, const int absolute_or_reduced_coordinates);
+
+/**
+ * Get the value of absolute_or_reduced_coordinates stored in the geometry data type.
+ *
+ * @param[in] geometry: instance of the geometry group.
+ * @return the value of the variable.
+ */
+int escdf_geometry_get_absolute_or_reduced_coordinates(
+        const escdf_geometry_t *geometry);
+
+/**
+ * Returns if absolute_or_reduced_coordinates has been set or not in the geometry data type.
+ *
+ * @param[in] geometry: instance of the geometry group.
+ * @return TRUE if the variable has been set, FALSE otherwise.
+ */
+bool escdf_geometry_is_set_absolute_or_reduced_coordinates(
+        const escdf_geometry_t *geometry);
+
+/**
+ * Sets the value of number_of_symmetry_operations in the geometry data type.
+ *
+ * @param[in,out] geometry: instance of the geometry group.
+ * @param[in] number_of_symmetry_operations: the value of the variable to be set.
+ * @return error code.
+ */
+escdf_errno_t escdf_geometry_set_number_of_symmetry_operations(
+        escdf_geometry_t *geometry, const int number_of_symmetry_operations);
+
+/**
+ * Get the value of number_of_symmetry_operations stored in the geometry data type.
+ *
+ * @param[in] geometry: instance of the geometry group.
+ * @return the value of the variable.
+ */
+int escdf_geometry_get_number_of_symmetry_operations(
+        const escdf_geometry_t *geometry);
+
+/**
+ * Returns if number_of_symmetry_operations has been set or not in the geometry data type.
+ *
+ * @param[in] geometry: instance of the geometry group.
+ * @return TRUE if the variable has been set, FALSE otherwise.
+ */
+bool escdf_geometry_is_set_number_of_symmetry_operations(
+        const escdf_geometry_t *geometry);
+
 
 /******************************************************************************
  * Data functions                                                             *
  ******************************************************************************/
 
 /**
- * Writes the magnetic_moment_directions variable to the geometry group.
+ * Per-site data sets are 2D arrays, [number_of_sites][number_of_physical_dimensions]
+ * for the positions, velocities, forces and magnetic moment directions, and
+ * [number_of_sites][1] for the species at sites. number_of_sites (and
+ * number_of_physical_dimensions for the vectors) must be set. Data sets
+ * are created by the first write.
+ *
+ * All the functions below share the same arguments:
  *
  * @param[in] geometry: instance of the geometry group.
- * @param[in] buffer: the buffer where the data is stored in memory.
- * @param[in] start:
- * @param[in] count:
- * @param[in] map:
+ * @param[in,out] buffer: the buffer where the data is stored in memory.
+ * @param[in] start: vector of 2 integers specifying the index in the variable
+ * where the first of the data values will be written or read, NULL for the
+ * first one.
+ * @param[in] count: vector of 2 integers specifying the edge lengths along
+ * each dimension of the block of data values to be written or read, NULL for
+ * everything from start.
+ * @param[in] map: vector of 2 integers that specifies the mapping between the
+ * dimensions of the variable and the in-memory structure of the internal data
+ * array: the value (i, j) of the block is buffer[i * map[0] + j * map[1]],
+ * e.g. {stride, 1} for sites stored as records of stride values. NULL for a
+ * contiguous buffer.
  * @return error code.
  */
+escdf_errno_t escdf_geometry_write_site_positions(
+        const escdf_geometry_t *geometry, const double *buffer,
+        const unsigned int *start, const unsigned int *count,
+        const unsigned int *map);
+escdf_errno_t escdf_geometry_read_site_positions(
+        const escdf_geometry_t *geometry, double *buffer,
+        const unsigned int *start, const unsigned int *count,
+        const unsigned int *map);
+
+escdf_errno_t escdf_geometry_write_site_velocities(
+        const escdf_geometry_t *geometry, const double *buffer,
+        const unsigned int *start, const unsigned int *count,
+        const unsigned int *map);
+escdf_errno_t escdf_geometry_read_site_velocities(
+        const escdf_geometry_t *geometry, double *buffer,
+        const unsigned int *start, const unsigned int *count,
+        const unsigned int *map);
+
+escdf_errno_t escdf_geometry_write_site_forces(
+        const escdf_geometry_t *geometry, const double *buffer,
+        const unsigned int *start, const unsigned int *count,
+        const unsigned int *map);
+escdf_errno_t escdf_geometry_read_site_forces(
+        const escdf_geometry_t *geometry, double *buffer,
+        const unsigned int *start, const unsigned int *count,
+        const unsigned int *map);
+
 escdf_errno_t escdf_geometry_write_magnetic_moment_directions(
         const escdf_geometry_t *geometry, const double *buffer,
         const unsigned int *start, const unsigned int *count,
         const unsigned int *map);
+escdf_errno_t escdf_geometry_read_magnetic_moment_directions(
+        const escdf_geometry_t *geometry, double *buffer,
+        const unsigned int *start, const unsigned int *count,
+        const unsigned int *map);
+
+escdf_errno_t escdf_geometry_write_species_at_sites(
+        const escdf_geometry_t *geometry, const int *buffer,
+        const unsigned int *start, const unsigned int *count,
+        const unsigned int *map);
+escdf_errno_t escdf_geometry_read_species_at_sites(
+        const escdf_geometry_t *geometry, int *buffer,
+        const unsigned int *start, const unsigned int *count,
+        const unsigned int *map);
+
+
+/**
+ * Distributed access to the per-site data sets, for the ranks sharing the
+ * handle. These functions are collective on its communicator, and the data
+ * is transferred with its transfer mode. In serial, the single rank owns
+ * all the sites.
+ */
+
 /**
- * Reads the magnetic_moment_directions variable from the geometry group.
+ * Returns the contiguous block of sites of this rank, the number_of_sites
+ * being split as evenly as possible between the ranks, in their order.
  *
  * @param[in] geometry: instance of the geometry group.
- * @param[out] buffer: the buffer where the data is to be stored in memory.
- * @param[in] start: vector of integers specifying the index in the variable
- * where the first of the data values will be read.
- * @param[in] count: vector of integers specifying the edge lengths along each
- * dimension of the block of data values to be read.
- * @param[in] map: vector of integers that specifies the mapping between the
- * dimensions of the variable and the in-memory structure of the internal data
- * array.
+ * @param[out] first: index of the first site of the block.
+ * @param[out] count: number of sites of the block, possibly 0.
  * @return error code.
  */
-escdf_errno_t escdf_geometry_read_magnetic_moment_directions(
-        const escdf_geometry_t *geometry, double *buffer,
-        const unsigned int *start, const unsigned int *count,
-        const unsigned int *map);
+escdf_errno_t escdf_geometry_get_site_block(const escdf_geometry_t *geometry,
+        unsigned int *first, unsigned int *count);
+
+/**
+ * Writes the count sites of each rank, one block after the other in the
+ * order of the ranks. The offset of each rank is computed from the counts,
+ * whose sum must be number_of_sites.
+ *
+ * @param[in] geometry: instance of the geometry group.
+ * @param[in] data: the data set to write.
+ * @param[in] buffer: the count sites of this rank, contiguous.
+ * @param[in] count: the number of sites of this rank, possibly 0.
+ * @return error code.
+ */
+escdf_errno_t escdf_geometry_write_site_data_distributed(
+        const escdf_geometry_t *geometry, escdf_site_data data,
+        const void *buffer, unsigned int count);
+
+/**
+ * Reads the block of sites of this rank, as given by
+ * escdf_geometry_get_site_block(), into a contiguous buffer.
+ */
+escdf_errno_t escdf_geometry_read_site_data_distributed(
+        const escdf_geometry_t *geometry, escdf_site_data data, void *buffer);
+
+/**
+ * Finds the sites whose positions are inside the box [lower, upper) of
+ * each rank, given in the coordinates of the stored positions. Without a
+ * spatial index, each rank scans only its own block of positions (see
+ * escdf_geometry_get_site_block()), piece by piece so that the memory does
+ * not grow with the number of sites, against the regions of all the ranks,
+ * and the ranks then exchange the sites found. With one (see
+ * escdf_geometry_write_site_index()), only the sites of the cells
+ * overlapping the box are read, with independent reads.
+ *
+ * @param[in] geometry: instance of the geometry group.
+ * @param[in] lower, upper: the corners of the box, with
+ * number_of_physical_dimensions coordinates.
+ * @param[out] sites: the indices of the sites found, in increasing order,
+ * to be freed by the caller, NULL when none.
+ * @param[out] nsites: the number of sites found.
+ * @return error code.
+ */
+escdf_errno_t escdf_geometry_find_sites_in_region(
+        const escdf_geometry_t *geometry, const double *lower,
+        const double *upper, unsigned int **sites, unsigned int *nsites);
+
+/**
+ * Finds the sites within radius of center, like
+ * escdf_geometry_find_sites_in_region(), distances being computed in the
+ * coordinates of the stored positions.
+ */
+escdf_errno_t escdf_geometry_find_sites_within(
+        const escdf_geometry_t *geometry, const double *center, double radius,
+        unsigned int **sites, unsigned int *nsites);
+
+/**
+ * Writes a spatial index of the sites, in the "site_index" subgroup: the
+ * bounding box of the positions is split into a grid of cells, and the
+ * indices and positions of the sites are stored sorted by cell, the last
+ * dimension being the fastest, with the offset of the first site of each
+ * cell. The index is removed when the positions are written again.
+ *
+ * @param[in] geometry: instance of the geometry group, with its positions.
+ * @param[in] number_of_cells: number of cells along each of the
+ * number_of_physical_dimensions (at most 3), NULL for about 16 sites per
+ * cell.
+ * @return error code.
+ */
+escdf_errno_t escdf_geometry_write_site_index(const escdf_geometry_t *geometry,
+        const unsigned int *number_of_cells);
+
+bool escdf_geometry_has_site_index(const escdf_geometry_t *geometry);
+
+/**
+ * Reorders the sites along a Morton (Z-order) curve over the bounding box
+ * of their positions, so that close sites are stored close to each other:
+ * the sites of a region then make a few ranges of consecutive sites, that
+ * escdf_geometry_read_site_data_at() reads as such. All the per-site data
+ * sets present are rewritten in the new order, and the spatial index, if
+ * any, is removed, to be written again on the sorted sites.
+ *
+ * The original index of each stored site is kept in the "site_permutation"
+ * data set, [number_of_sites][1], composed with the previous sorts.
+ *
+ * The frames of a trajectory are not reordered, so the sites of a geometry
+ * with a trajectory cannot be sorted: ESCDF_ENOSUPPORT is returned and
+ * nothing is changed. Sort the sites before opening the trajectory.
+ *
+ * @param[in] geometry: instance of the geometry group, with its positions.
+ * @return error code.
+ */
+escdf_errno_t escdf_geometry_sort_sites(const escdf_geometry_t *geometry);
+
+/**
+ * Reads the original index of each stored site, the identity when the
+ * sites have never been sorted.
+ *
+ * @param[in] geometry: instance of the geometry group.
+ * @param[out] permutation: number_of_sites indices.
+ * @return error code.
+ */
+escdf_errno_t escdf_geometry_read_site_permutation(const escdf_geometry_t *geometry,
+        unsigned int *permutation);
+
+/**
+ * Reads the nsites sites of each rank, given by their indices, e.g. as
+ * found by escdf_geometry_find_sites_in_region(), into a contiguous buffer.
+ * Increasing indices are read as ranges of consecutive sites, other ones
+ * site by site.
+ */
+escdf_errno_t escdf_geometry_read_site_data_at(
+        const escdf_geometry_t *geometry, escdf_site_data data,
+        const unsigned int *sites, unsigned int nsites, void *buffer);
+
+
+/******************************************************************************
+ * Trajectory functions                                                       *
+ ******************************************************************************/
+
+/**
+ * Opens the trajectory of the geometry, in its "trajectory" group, creating
+ * it if needed. Each field is stored in a chunked data set whose first
+ * dimension is the frame, [frame][number_of_sites][number_of_physical_dimensions]
+ * for the positions and forces, [frame][3][3] for the lattice vectors and
+ * [frame] for the times, so that any frame is accessed directly by its
+ * index. number_of_sites and number_of_physical_dimensions must be set.
+ *
+ * @param[in] geometry: instance of the geometry group.
+ * @param[in] fields: the fields to store, as a mask of
+ * (1 << ESCDF_TRAJECTORY_*), when the trajectory is created. The fields of
+ * an existing trajectory are the ones found in the file.
+ * @param[in] frames_per_write: number of frames buffered by
+ * escdf_trajectory_append() before they are written at once, also used as
+ * the number of frames per chunk. The chunks are capped at 4 MiB, with
+ * fewer frames per chunk, and frames larger than that are split along the
+ * sites.
+ * @return instance of the trajectory, NULL on error.
+ */
+escdf_trajectory_t * escdf_geometry_open_trajectory(
+        const escdf_geometry_t *geometry, unsigned int fields,
+        unsigned int frames_per_write);
+
+/**
+ * Same as escdf_geometry_open_trajectory(), but the positions of a new
+ * trajectory are stored quantised to multiples of precision, as 32-bit
+ * integers. Each frame holds the difference with the previous one, except
+ * for a keyframe at the start of each chunk, and the data set is shuffled
+ * and deflated, which shrinks the smooth MD trajectories several times.
+ * The precision and the keyframe interval are stored as the "precision"
+ * and "keyframe_interval" attributes of the data set. The positions are
+ * decoded by escdf_trajectory_read_frames(), within precision / 2, and
+ * must stay below 2^30 * precision in absolute value.
+ *
+ * @param[in] precision: the quantum of the positions, strictly positive.
+ * It is ignored for an existing trajectory, whose encoding is kept.
+ * @return instance of the trajectory, NULL on error.
+ */
+escdf_trajectory_t * escdf_geometry_open_trajectory_quantised(
+        const escdf_geometry_t *geometry, unsigned int fields,
+        unsigned int frames_per_write, double precision);
+
+/**
+ * Writes the buffered frames and frees the trajectory.
+ *
+ * @param[in,out] trajectory: the trajectory.
+ * @return error code.
+ */
+escdf_errno_t escdf_trajectory_close(escdf_trajectory_t *trajectory);
+
+/**
+ * Appends a frame. The values are copied, the frames being written once
+ * frames_per_write of them are buffered, or by escdf_trajectory_flush().
+ * With quantised positions, a frame holding positions that are not finite
+ * is rejected with ESCDF_EVALUE, and one holding positions out of range
+ * with ESCDF_ERANGE, before it is buffered. When writing the buffered
+ * frames fails, they stay buffered, to be written by the next flush. If the
+ * buffer is then full, the next append writes it first, and returns the
+ * error without buffering its frame.
+ *
+ * @param[in,out] trajectory: the trajectory.
+ * @param[in] time: the time of the frame.
+ * @param[in] positions, lattice_vectors, forces: the values of the frame,
+ * laid out as one frame of the data sets. They are ignored for the fields
+ * that are not stored, and must not be NULL otherwise.
+ * @return error code.
+ */
+escdf_errno_t escdf_trajectory_append(escdf_trajectory_t *trajectory,
+        double time, const double *positions, const double *lattice_vectors,
+        const double *forces);
+
+escdf_errno_t escdf_trajectory_flush(escdf_trajectory_t *trajectory);
+
+/**
+ * Returns the number of frames, written or buffered.
+ */
+hsize_t escdf_trajectory_get_number_of_frames(
+        const escdf_trajectory_t *trajectory);
+
+/**
+ * Returns the quantum of the positions, 0 when they are not quantised.
+ */
+double escdf_trajectory_get_precision(const escdf_trajectory_t *trajectory);
 
+bool escdf_trajectory_has_field(const escdf_trajectory_t *trajectory,
+        escdf_trajectory_field field);
+
+/**
+ * Reads count frames of a field, starting from frame first and every stride
+ * frames, e.g. every 10th frame for analysis. The buffered frames are
+ * written first.
+ *
+ * @param[in,out] trajectory: the trajectory.
+ * @param[in] field: the field to read.
+ * @param[in] first: index of the first frame.
+ * @param[in] count: number of frames to read.
+ * @param[in] stride: distance between two frames read, 0 or 1 for
+ * consecutive frames.
+ * @param[out] buffer: the count frames, one after the other.
+ * @return error code.
+ */
+escdf_errno_t escdf_trajectory_read_frames(escdf_trajectory_t *trajectory,
+        escdf_trajectory_field field, hsize_t first, hsize_t count,
+        hsize_t stride, double *buffer);
 
 
 #endif
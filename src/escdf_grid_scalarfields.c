@@ -24,6 +24,11 @@
 
 #include "utils.h"
 #include "utils_hdf5.h"
+#include "utils_stats.h"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
 
 
 typedef struct {
@@ -34,6 +39,51 @@ typedef struct {
     double *lattice_vectors;
 } _cell_t;
 
+/* A slot of the block cache, holding one block of values_on_grid, linked
+   in the list of the slots in use. */
+typedef struct {
+    hsize_t block; /* index of the block plus one, 0 when free */
+    unsigned long long last_use;
+    long long int prev, next; /* -1 at the ends of the list */
+} _cache_slot_t;
+
+/* LRU cache of aligned blocks of values_on_grid, for all the components,
+   with a hash table from the blocks to their slots. */
+typedef struct {
+    size_t size; /* in bytes, as set by the user */
+    /* The layout the blocks were read with, and the generation of the
+       handle, as its address may be reused by the next file opened. */
+    unsigned long long generation;
+    hsize_t n[3], bdims[3], nb[3], block_len;
+    unsigned int ncomp, rc;
+    size_t nslots, nused, table_mask;
+    /* The slots in use, from the most to the least recently used, the
+       first nused ones. mark is the last one used by the current batch,
+       if any, after which the blocks read ahead are inserted. */
+    _cache_slot_t *slots;
+    long long int head, tail, mark;
+    double *values;
+    long long int *table;
+    hsize_t *hyperslabs;
+    unsigned long long clock;
+    hsize_t last_miss; /* plus one, 0 when none */
+    escdf_grid_scalarfield_cache_statistics_t stats;
+} _cache_t;
+
+static void _cache_release(_cache_t *cache)
+{
+    free(cache->slots);
+    free(cache->values);
+    free(cache->table);
+    free(cache->hyperslabs);
+    cache->slots = NULL;
+    cache->values = NULL;
+    cache->table = NULL;
+    cache->hyperslabs = NULL;
+    cache->nslots = 0;
+    cache->generation = 0;
+}
+
 struct _escdf_grid_scalarfield_t {
     char *path;
     /* The metadata */
@@ -43,6 +93,20 @@ struct _escdf_grid_scalarfield_t {
     _uint_set_t real_or_complex;
     _bool_set_t use_default_ordering;
 
+    /* Storage properties, only used when creating the datasets */
+    hsize_t chunk_size;
+    unsigned int deflate_level;
+    bool packed_metadata;
+    bool write_statistics;
+
+    /* Block cache for random-access reads, NULL when disabled */
+    _cache_t *cache;
+    unsigned int cache_read_ahead;
+
+    /* Memory mapping of values_on_grid, NULL when none */
+    void *map_addr;
+    size_t map_len;
+
     /* The data */
     bool values_on_grid_is_present;
     bool grid_ordering_is_present;
@@ -53,6 +117,7 @@ escdf_grid_scalarfield_t* escdf_grid_scalarfield_new(const char *path)
     escdf_grid_scalarfield_t *scalarfield;
 
     scalarfield = calloc(1, sizeof(escdf_grid_scalarfield_t));
+    FULFILL_OR_RETURN_VAL(scalarfield != NULL, ESCDF_ENOMEM, NULL);
     if (!path || !path[0]) {
         scalarfield->path = strdup("density");
     } else {
@@ -71,79 +136,235 @@ void escdf_grid_scalarfield_free(escdf_grid_scalarfield_t *scalarfield)
     free(scalarfield->cell.dimension_types);
     free(scalarfield->cell.lattice_vectors);
     free(scalarfield->number_of_grid_points);
+    if (scalarfield->cache) {
+        _cache_release(scalarfield->cache);
+        free(scalarfield->cache);
+    }
+    utils_hdf5_unmap(scalarfield->map_addr, scalarfield->map_len);
 
     free(scalarfield);
 }
 
-escdf_errno_t escdf_grid_scalarfield_read_metadata(escdf_grid_scalarfield_t *scalarfield,
-                                                   escdf_handle_t *file_id)
+/* Ranges of the metadata values. */
+static unsigned int rgPhys[2] = {1, 3};
+static int rgDim[2] = {0, 2};
+static double rgCell[2] = {0., HUGE_VAL};
+static unsigned int rgGrid[2] = {1, 1024 * 1024};
+static unsigned int rgComp[2] = {1, 4};
+static unsigned int rgCplx[2] = {1, 2};
+
+/* Packed layout of the metadata, stored as a single compound attribute
+   instead of one attribute per variable. The arrays are sized for three
+   dimensions; only the first number_of_physical_dimensions values (squared
+   for the lattice vectors, stored contiguously) are meaningful. */
+#define PACKED_METADATA "metadata"
+#define PACKED_NFIELDS 7
+
+typedef struct {
+    unsigned int number_of_physical_dimensions;
+    int dimension_types[3];
+    double lattice_vectors[9];
+    unsigned int number_of_grid_points[3];
+    unsigned int number_of_components;
+    unsigned int real_or_complex;
+    unsigned int use_default_ordering;
+} _packed_metadata_t;
+
+/* Compound type of the packed metadata, in memory or on disk. */
+static hid_t _packed_metadata_type(bool disk)
 {
-    escdf_errno_t err;
+    const char *names[PACKED_NFIELDS] = {
+        "number_of_physical_dimensions", "dimension_types", "lattice_vectors",
+        "number_of_grid_points", "number_of_components", "real_or_complex",
+        "use_default_ordering"};
+    size_t offsets[PACKED_NFIELDS] = {
+        HOFFSET(_packed_metadata_t, number_of_physical_dimensions),
+        HOFFSET(_packed_metadata_t, dimension_types),
+        HOFFSET(_packed_metadata_t, lattice_vectors),
+        HOFFSET(_packed_metadata_t, number_of_grid_points),
+        HOFFSET(_packed_metadata_t, number_of_components),
+        HOFFSET(_packed_metadata_t, real_or_complex),
+        HOFFSET(_packed_metadata_t, use_default_ordering)};
+    hsize_t counts[PACKED_NFIELDS] = {1, 3, 9, 3, 1, 1, 1};
+    hid_t types[PACKED_NFIELDS];
+    hid_t type_id, field_id;
+    size_t size;
     unsigned int i;
-    unsigned int rgPhys[2] = {1, 3};
-    int rgDim[2] = {0, 2};
-    double rgCell[2] = {0., HUGE_VAL};
-    unsigned int rgGrid[2] = {1, 1024 * 1024};
-    unsigned int rgComp[2] = {1, 4};
-    unsigned int rgCplx[2] = {1, 2};
+
+    if (disk) {
+        types[0] = H5T_STD_U32LE;
+        types[1] = H5T_STD_I32LE;
+        types[2] = H5T_IEEE_F64LE;
+        types[3] = types[4] = types[5] = types[6] = H5T_STD_U32LE;
+        /* No padding on disk. */
+        size = 0;
+        for (i = 0; i < PACKED_NFIELDS; i++) {
+            offsets[i] = size;
+            size += H5Tget_size(types[i]) * counts[i];
+        }
+    } else {
+        types[0] = H5T_NATIVE_UINT;
+        types[1] = H5T_NATIVE_INT;
+        types[2] = H5T_NATIVE_DOUBLE;
+        types[3] = types[4] = types[5] = types[6] = H5T_NATIVE_UINT;
+        size = sizeof(_packed_metadata_t);
+    }
+
+    if ((type_id = H5Tcreate(H5T_COMPOUND, size)) < 0) {
+        DEFER_FUNC_ERROR(type_id);
+        return type_id;
+    }
+    for (i = 0; i < PACKED_NFIELDS; i++) {
+        field_id = (counts[i] > 1) ?
+            H5Tarray_create(types[i], 1, counts + i) : H5Tcopy(types[i]);
+        if (field_id < 0 || H5Tinsert(type_id, names[i], offsets[i], field_id) < 0) {
+            DEFER_FUNC_ERROR(ESCDF_ERROR);
+            if (field_id >= 0)
+                H5Tclose(field_id);
+            H5Tclose(type_id);
+            return -1;
+        }
+        H5Tclose(field_id);
+    }
+
+    return type_id;
+}
+
+static escdf_errno_t _read_packed_attributes(escdf_grid_scalarfield_t *scalarfield,
+                                             hid_t loc_id, bool trusted)
+{
+    _packed_metadata_t packed;
+    escdf_errno_t err;
+    hid_t type_id;
+    unsigned int i, n;
+
+    if ((type_id = _packed_metadata_type(false)) < 0)
+        return ESCDF_ERROR;
+    err = utils_hdf5_read_attr(loc_id, PACKED_METADATA, type_id, NULL, 0, &packed);
+    H5Tclose(type_id);
+    if (err != ESCDF_SUCCESS)
+        return err;
+
+    /* Same checks as with the attribute per variable layout. The number of
+       dimensions is always checked, since it bounds the arrays. */
+    n = packed.number_of_physical_dimensions;
+    FULFILL_OR_RETURN(n >= rgPhys[0] && n <= rgPhys[1], ESCDF_ERANGE);
+    for (i = 0; i < n && !trusted; i++) {
+        FULFILL_OR_RETURN(packed.dimension_types[i] >= rgDim[0] &&
+                          packed.dimension_types[i] <= rgDim[1], ESCDF_ERANGE);
+        FULFILL_OR_RETURN(packed.number_of_grid_points[i] >= rgGrid[0] &&
+                          packed.number_of_grid_points[i] <= rgGrid[1], ESCDF_ERANGE);
+    }
+    for (i = 0; i < n * n && !trusted; i++) {
+        FULFILL_OR_RETURN(packed.lattice_vectors[i] >= rgCell[0] &&
+                          packed.lattice_vectors[i] <= rgCell[1], ESCDF_ERANGE);
+    }
+    FULFILL_OR_RETURN(trusted || (packed.number_of_components >= rgComp[0] &&
+                                  packed.number_of_components <= rgComp[1]), ESCDF_ERANGE);
+    FULFILL_OR_RETURN(trusted || (packed.real_or_complex >= rgCplx[0] &&
+                                  packed.real_or_complex <= rgCplx[1]), ESCDF_ERANGE);
+
+    scalarfield->cell.number_of_physical_dimensions = _uint_set(n);
+    free(scalarfield->cell.dimension_types);
+    scalarfield->cell.dimension_types = malloc(sizeof(int) * n);
+    memcpy(scalarfield->cell.dimension_types, packed.dimension_types, sizeof(int) * n);
+    free(scalarfield->cell.lattice_vectors);
+    scalarfield->cell.lattice_vectors = malloc(sizeof(double) * n * n);
+    memcpy(scalarfield->cell.lattice_vectors, packed.lattice_vectors, sizeof(double) * n * n);
+    free(scalarfield->number_of_grid_points);
+    scalarfield->number_of_grid_points = malloc(sizeof(unsigned int) * n);
+    memcpy(scalarfield->number_of_grid_points, packed.number_of_grid_points,
+           sizeof(unsigned int) * n);
+    scalarfield->number_of_components = _uint_set(packed.number_of_components);
+    scalarfield->real_or_complex = _uint_set(packed.real_or_complex);
+    scalarfield->use_default_ordering = _bool_set((bool)packed.use_default_ordering);
+
+    return ESCDF_SUCCESS;
+}
+
+static escdf_errno_t _read_attributes(escdf_grid_scalarfield_t *scalarfield,
+                                      hid_t loc_id, bool trusted)
+{
+    escdf_errno_t err;
     hsize_t oneDims[1];
     hsize_t lattDims[2];
-    hsize_t valDims[3];
-    hid_t loc_id;
-    
-    FULFILL_OR_RETURN(scalarfield, ESCDF_EOBJECT);
-
-    if ((loc_id = H5Gopen(file_id->group_id, scalarfield->path, H5P_DEFAULT)) < 0)
-        RETURN_WITH_ERROR(loc_id);
 
     if ((err = utils_hdf5_read_uint(loc_id, "number_of_physical_dimensions",
                                     &scalarfield->cell.number_of_physical_dimensions,
                                     rgPhys)) != ESCDF_SUCCESS) {
-        H5Gclose(loc_id);
         return err;
     }
     
+    /* The number of dimensions is always checked, since it bounds the arrays. */
     oneDims[0] = scalarfield->cell.number_of_physical_dimensions.value;
+    free(scalarfield->cell.dimension_types);
     if ((err = utils_hdf5_read_int_array(loc_id, "dimension_types",
                                          &scalarfield->cell.dimension_types,
-                                         oneDims, 1, rgDim)) != ESCDF_SUCCESS) {
-        H5Gclose(loc_id);
+                                         oneDims, 1, trusted ? NULL : rgDim)) != ESCDF_SUCCESS) {
         return err;
     }
 
     lattDims[0] = lattDims[1] = scalarfield->cell.number_of_physical_dimensions.value;
+    free(scalarfield->cell.lattice_vectors);
     if ((err = utils_hdf5_read_dbl_array(loc_id, "lattice_vectors",
                                          &scalarfield->cell.lattice_vectors,
-                                         lattDims, 2, rgCell)) != ESCDF_SUCCESS) {
-        H5Gclose(loc_id);
+                                         lattDims, 2, trusted ? NULL : rgCell)) != ESCDF_SUCCESS) {
         return err;
     }
 
     oneDims[0] = scalarfield->cell.number_of_physical_dimensions.value;
+    free(scalarfield->number_of_grid_points);
     if ((err = utils_hdf5_read_uint_array(loc_id, "number_of_grid_points",
                                           &scalarfield->number_of_grid_points,
-                                          oneDims, 1, rgGrid)) != ESCDF_SUCCESS) {
-        H5Gclose(loc_id);
+                                          oneDims, 1, trusted ? NULL : rgGrid)) != ESCDF_SUCCESS) {
         return err;
     }
         
     if ((err = utils_hdf5_read_uint(loc_id, "number_of_components",
                                     &scalarfield->number_of_components,
-                                    rgComp)) != ESCDF_SUCCESS) {
-        H5Gclose(loc_id);
+                                    trusted ? NULL : rgComp)) != ESCDF_SUCCESS) {
         return err;
     }
     
     if ((err = utils_hdf5_read_uint(loc_id, "real_or_complex",
                                     &scalarfield->real_or_complex,
-                                    rgCplx)) != ESCDF_SUCCESS) {
-        H5Gclose(loc_id);
+                                    trusted ? NULL : rgCplx)) != ESCDF_SUCCESS) {
         return err;
     }
 
     if ((err = utils_hdf5_read_bool(loc_id, "use_default_ordering",
                                     &scalarfield->use_default_ordering))
         != ESCDF_SUCCESS) {
+        return err;
+    }
+
+    return ESCDF_SUCCESS;
+}
+
+static escdf_errno_t _read_metadata(escdf_grid_scalarfield_t *scalarfield,
+                                    escdf_handle_t *file_id)
+{
+    escdf_errno_t err;
+    unsigned int i;
+    hsize_t valDims[3];
+    hid_t loc_id;
+    htri_t packed;
+    
+    FULFILL_OR_RETURN(scalarfield, ESCDF_EOBJECT);
+
+    if ((loc_id = H5Gopen(file_id->group_id, scalarfield->path, H5P_DEFAULT)) < 0)
+        RETURN_WITH_ERROR(loc_id);
+    utils_stats_count_open();
+
+    /* Both the packed and the attribute per variable layouts are read. */
+    if ((packed = H5Aexists(loc_id, PACKED_METADATA)) < 0) {
+        H5Gclose(loc_id);
+        RETURN_WITH_ERROR(packed);
+    }
+    err = (packed) ?
+        _read_packed_attributes(scalarfield, loc_id, file_id->trusted) :
+        _read_attributes(scalarfield, loc_id, file_id->trusted);
+    if (err != ESCDF_SUCCESS) {
         H5Gclose(loc_id);
         return err;
     }
@@ -172,32 +393,73 @@ escdf_errno_t escdf_grid_scalarfield_read_metadata(escdf_grid_scalarfield_t *sca
     return ESCDF_SUCCESS;
 }
 
-escdf_errno_t escdf_grid_scalarfield_write_metadata(const escdf_grid_scalarfield_t *scalarfield, escdf_handle_t *loc_id)
+escdf_errno_t escdf_grid_scalarfield_read_metadata(escdf_grid_scalarfield_t *scalarfield,
+                                                   escdf_handle_t *file_id)
 {
-    hid_t gid;
     escdf_errno_t err;
-    hsize_t dims[3];
+    utils_stats_timer_t timer;
+
+    utils_stats_start(file_id, &timer);
+    utils_hdf5_lock();
+    err = _read_metadata(scalarfield, file_id);
+    utils_hdf5_unlock();
+    utils_stats_stop(file_id, &timer, ESCDF_STATS_READ_METADATA);
+
+    return err;
+}
+
+/* Creation properties of the data sets, given the storage properties. The
+   chunks run along the grid points (second dimension of values_on_grid). */
+static escdf_errno_t _create_dcpl(const escdf_grid_scalarfield_t *scalarfield,
+                                  const hsize_t *dims, unsigned int ndims,
+                                  hid_t *dcpl_pt)
+{
+    hsize_t chunk[3];
+    herr_t err_id;
     unsigned int i;
-    int value;
-    
-    FULFILL_OR_RETURN(scalarfield, ESCDF_EOBJECT);
 
-    /* Check all mandatory attributes. */
-    FULFILL_OR_RETURN(scalarfield->cell.number_of_physical_dimensions.is_set, ESCDF_EUNINIT);
-    FULFILL_OR_RETURN(scalarfield->cell.dimension_types, ESCDF_EUNINIT);
-    FULFILL_OR_RETURN(scalarfield->cell.lattice_vectors, ESCDF_EUNINIT);
-    FULFILL_OR_RETURN(scalarfield->number_of_grid_points, ESCDF_EUNINIT);
-    FULFILL_OR_RETURN(scalarfield->number_of_components.is_set, ESCDF_EUNINIT);
-    FULFILL_OR_RETURN(scalarfield->real_or_complex.is_set, ESCDF_EUNINIT);
+    *dcpl_pt = H5P_DEFAULT;
+    if (scalarfield->chunk_size == 0 && scalarfield->deflate_level == 0) {
+        return ESCDF_SUCCESS;
+    }
+
+    for (i = 0; i < ndims; i++) {
+        chunk[i] = (dims[i] > 0) ? 1 : 0;
+    }
+    /* Compression requires a chunked layout, use a default chunk size. */
+    i = (ndims == 3) ? 1 : 0;
+    chunk[i] = (scalarfield->chunk_size > 0) ? scalarfield->chunk_size : 65536;
+    if (chunk[i] > dims[i])
+        chunk[i] = dims[i];
+    if (ndims == 3)
+        chunk[2] = dims[2];
+
+    if ((*dcpl_pt = H5Pcreate(H5P_DATASET_CREATE)) < 0) {
+        RETURN_WITH_ERROR(*dcpl_pt);
+    }
+    if ((err_id = H5Pset_chunk(*dcpl_pt, ndims, chunk)) < 0) {
+        H5Pclose(*dcpl_pt);
+        RETURN_WITH_ERROR(err_id);
+    }
+    if (scalarfield->deflate_level > 0 &&
+        (err_id = H5Pset_deflate(*dcpl_pt, scalarfield->deflate_level)) < 0) {
+        H5Pclose(*dcpl_pt);
+        RETURN_WITH_ERROR(err_id);
+    }
+
+    return ESCDF_SUCCESS;
+}
 
-    gid = H5Gcreate(loc_id->group_id, scalarfield->path, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
-    FULFILL_OR_RETURN(gid >= 0, gid);
+static escdf_errno_t _write_attributes(const escdf_grid_scalarfield_t *scalarfield,
+                                       hid_t gid)
+{
+    escdf_errno_t err;
+    hsize_t dims[2];
+    unsigned int value;
 
-    /* Write to file. */
     if ((err = utils_hdf5_write_attr
-         (gid, "number_of_physical_dimensions", H5T_STD_U32LE, NULL, 0, H5T_NATIVE_INT,
+         (gid, "number_of_physical_dimensions", H5T_STD_U32LE, NULL, 0, H5T_NATIVE_UINT,
           &scalarfield->cell.number_of_physical_dimensions.value)) != ESCDF_SUCCESS) {
-        H5Gclose(gid);
         return err;
     }
 
@@ -205,7 +467,6 @@ escdf_errno_t escdf_grid_scalarfield_write_metadata(const escdf_grid_scalarfield
     if ((err = utils_hdf5_write_attr
          (gid, "dimension_types", H5T_STD_I32LE, dims, 1, H5T_NATIVE_INT,
           scalarfield->cell.dimension_types)) != ESCDF_SUCCESS) {
-        H5Gclose(gid);
         return err;
     }
 
@@ -213,36 +474,98 @@ escdf_errno_t escdf_grid_scalarfield_write_metadata(const escdf_grid_scalarfield
     if ((err = utils_hdf5_write_attr
          (gid, "lattice_vectors", H5T_IEEE_F64LE, dims, 2, H5T_NATIVE_DOUBLE,
           scalarfield->cell.lattice_vectors)) != ESCDF_SUCCESS) {
-        H5Gclose(gid);
         return err;
     }
 
     dims[0] = scalarfield->cell.number_of_physical_dimensions.value;
     if ((err = utils_hdf5_write_attr
-         (gid, "number_of_grid_points", H5T_STD_U32LE, dims, 1, H5T_NATIVE_INT,
+         (gid, "number_of_grid_points", H5T_STD_U32LE, dims, 1, H5T_NATIVE_UINT,
           scalarfield->number_of_grid_points)) != ESCDF_SUCCESS) {
-        H5Gclose(gid);
         return err;
     }
 
     if ((err = utils_hdf5_write_attr
-         (gid, "number_of_components", H5T_STD_U32LE, NULL, 0, H5T_NATIVE_INT,
+         (gid, "number_of_components", H5T_STD_U32LE, NULL, 0, H5T_NATIVE_UINT,
           &scalarfield->number_of_components.value)) != ESCDF_SUCCESS) {
-        H5Gclose(gid);
         return err;
     }
 
     if ((err = utils_hdf5_write_attr
-         (gid, "real_or_complex", H5T_STD_U32LE, NULL, 0, H5T_NATIVE_INT,
+         (gid, "real_or_complex", H5T_STD_U32LE, NULL, 0, H5T_NATIVE_UINT,
           &scalarfield->real_or_complex.value)) != ESCDF_SUCCESS) {
-        H5Gclose(gid);
         return err;
     }
 
-    value = (int)scalarfield->use_default_ordering.value;
+    value = (unsigned int)scalarfield->use_default_ordering.value;
     if ((err = utils_hdf5_write_attr
-         (gid, "use_default_ordering", H5T_STD_U32LE, NULL, 0, H5T_NATIVE_INT,
+         (gid, "use_default_ordering", H5T_STD_U32LE, NULL, 0, H5T_NATIVE_UINT,
           &value)) != ESCDF_SUCCESS) {
+        return err;
+    }
+
+    return ESCDF_SUCCESS;
+}
+
+static escdf_errno_t _write_packed_attributes(const escdf_grid_scalarfield_t *scalarfield,
+                                              hid_t gid)
+{
+    _packed_metadata_t packed;
+    escdf_errno_t err;
+    hid_t mem_type_id, disk_type_id;
+    unsigned int n;
+
+    memset(&packed, 0, sizeof(packed));
+    n = scalarfield->cell.number_of_physical_dimensions.value;
+    packed.number_of_physical_dimensions = n;
+    memcpy(packed.dimension_types, scalarfield->cell.dimension_types, sizeof(int) * n);
+    memcpy(packed.lattice_vectors, scalarfield->cell.lattice_vectors, sizeof(double) * n * n);
+    memcpy(packed.number_of_grid_points, scalarfield->number_of_grid_points,
+           sizeof(unsigned int) * n);
+    packed.number_of_components = scalarfield->number_of_components.value;
+    packed.real_or_complex = scalarfield->real_or_complex.value;
+    packed.use_default_ordering = (unsigned int)scalarfield->use_default_ordering.value;
+
+    if ((mem_type_id = _packed_metadata_type(false)) < 0)
+        return ESCDF_ERROR;
+    if ((disk_type_id = _packed_metadata_type(true)) < 0) {
+        H5Tclose(mem_type_id);
+        return ESCDF_ERROR;
+    }
+    err = utils_hdf5_write_attr(gid, PACKED_METADATA, disk_type_id, NULL, 0,
+                                mem_type_id, &packed);
+    H5Tclose(disk_type_id);
+    H5Tclose(mem_type_id);
+
+    return err;
+}
+
+static escdf_errno_t _write_metadata(const escdf_grid_scalarfield_t *scalarfield, escdf_handle_t *loc_id)
+{
+    hid_t gid;
+    escdf_errno_t err;
+    hsize_t dims[3];
+    unsigned int i;
+    hid_t dcpl_id;
+    
+    FULFILL_OR_RETURN(scalarfield, ESCDF_EOBJECT);
+
+    /* Check all mandatory attributes. */
+    FULFILL_OR_RETURN(scalarfield->cell.number_of_physical_dimensions.is_set, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->cell.dimension_types, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->cell.lattice_vectors, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->number_of_grid_points, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->number_of_components.is_set, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->real_or_complex.is_set, ESCDF_EUNINIT);
+
+    /* The parent groups, e.g. densities, are created as needed. */
+    if ((err = utils_hdf5_create_group(loc_id->group_id, scalarfield->path, &gid)) != ESCDF_SUCCESS) {
+        return err;
+    }
+
+    err = (scalarfield->packed_metadata) ?
+        _write_packed_attributes(scalarfield, gid) :
+        _write_attributes(scalarfield, gid);
+    if (err != ESCDF_SUCCESS) {
         H5Gclose(gid);
         return err;
     }
@@ -254,21 +577,49 @@ escdf_errno_t escdf_grid_scalarfield_write_metadata(const escdf_grid_scalarfield
         dims[1] *= scalarfield->number_of_grid_points[i];
     }
     dims[2] = scalarfield->real_or_complex.value;
-    if ((err = utils_hdf5_create_dataset
-         (gid, "values_on_grid", H5T_IEEE_F64LE, dims, 3, NULL)) != ESCDF_SUCCESS) {
+    if ((err = _create_dcpl(scalarfield, dims, 3, &dcpl_id)) != ESCDF_SUCCESS) {
         H5Gclose(gid);
         return err;
     }
+    if ((err = utils_hdf5_create_dataset
+         (gid, "values_on_grid", H5T_IEEE_F64LE, dims, 3, dcpl_id, NULL)) != ESCDF_SUCCESS) {
+        goto cleanup_dcpl;
+    }
     if (!scalarfield->use_default_ordering.value) {
-        if ((err = utils_hdf5_create_dataset
-             (gid, "grid_ordering", H5T_STD_U32LE, dims + 1, 1, NULL)) != ESCDF_SUCCESS) {
+        if (dcpl_id != H5P_DEFAULT) {
+            H5Pclose(dcpl_id);
+        }
+        if ((err = _create_dcpl(scalarfield, dims + 1, 1, &dcpl_id)) != ESCDF_SUCCESS) {
             H5Gclose(gid);
             return err;
         }
+        if ((err = utils_hdf5_create_dataset
+             (gid, "grid_ordering", H5T_STD_U32LE, dims + 1, 1, dcpl_id, NULL)) != ESCDF_SUCCESS) {
+            goto cleanup_dcpl;
+        }
     }
+    err = ESCDF_SUCCESS;
 
+    cleanup_dcpl:
+    if (dcpl_id != H5P_DEFAULT) {
+        H5Pclose(dcpl_id);
+    }
     H5Gclose(gid);
-    return ESCDF_SUCCESS;
+    return err;
+}
+
+escdf_errno_t escdf_grid_scalarfield_write_metadata(const escdf_grid_scalarfield_t *scalarfield, escdf_handle_t *loc_id)
+{
+    escdf_errno_t err;
+    utils_stats_timer_t timer;
+
+    utils_stats_start(loc_id, &timer);
+    utils_hdf5_lock();
+    err = _write_metadata(scalarfield, loc_id);
+    utils_hdf5_unlock();
+    utils_stats_stop(loc_id, &timer, ESCDF_STATS_WRITE_METADATA);
+
+    return err;
 }
 
 /************/
@@ -358,6 +709,31 @@ bool escdf_grid_scalarfield_get_use_default_ordering(const escdf_grid_scalarfiel
     
     return scalarfield->use_default_ordering.value;
 }
+hsize_t escdf_grid_scalarfield_get_chunk_size(const escdf_grid_scalarfield_t *scalarfield)
+{
+    FULFILL_OR_RETURN_VAL(scalarfield, ESCDF_EOBJECT, 0);
+
+    return scalarfield->chunk_size;
+}
+unsigned int escdf_grid_scalarfield_get_deflate_level(const escdf_grid_scalarfield_t *scalarfield)
+{
+    FULFILL_OR_RETURN_VAL(scalarfield, ESCDF_EOBJECT, 0);
+
+    return scalarfield->deflate_level;
+}
+bool escdf_grid_scalarfield_get_packed_metadata(const escdf_grid_scalarfield_t *scalarfield)
+{
+    FULFILL_OR_RETURN_VAL(scalarfield, ESCDF_EOBJECT, false);
+
+    return scalarfield->packed_metadata;
+}
+
+bool escdf_grid_scalarfield_get_write_statistics(const escdf_grid_scalarfield_t *scalarfield)
+{
+    FULFILL_OR_RETURN_VAL(scalarfield, ESCDF_EOBJECT, false);
+
+    return scalarfield->write_statistics;
+}
 
 
 /************/
@@ -473,98 +849,645 @@ escdf_errno_t escdf_grid_scalarfield_set_use_default_ordering(escdf_grid_scalarf
     return ESCDF_SUCCESS;
 }
 
-/*******************/
-/* Data accessors. */
-/*******************/
-static escdf_errno_t _get_proc_grid_offset(hsize_t *my_offset,
-                                           escdf_handle_t *file_id,
-                                           unsigned int number_of_physical_dimensions,
-                                           unsigned int *number_of_grid_points,
-                                           hsize_t my_len)
+escdf_errno_t escdf_grid_scalarfield_set_chunk_size(escdf_grid_scalarfield_t *scalarfield,
+                                                    const hsize_t chunk_size)
 {
-    unsigned long long int *proclens;
-    unsigned long long int len_;
-    hsize_t nValues, nGridPoints;
-    int i;
+    FULFILL_OR_RETURN(scalarfield, ESCDF_EOBJECT);
 
-    proclens = malloc(sizeof(unsigned long long int) * file_id->mpi_size);
-    len_ = (unsigned long long int)my_len;
-    if (file_id->mpi_size == 1) {
-        proclens[0] = len_;
-    }
-#ifdef HAVE_MPI
-    else {
-        MPI_Allgather(&len_, 1, MPI_UNSIGNED_LONG_LONG,
-                      proclens, 1, MPI_UNSIGNED_LONG_LONG, file_id->comm);
-    }
-#endif
+    scalarfield->chunk_size = chunk_size;
 
-    *my_offset = 0;
-    for (i = 0; i < file_id->mpi_rank; i++) {
-        *my_offset += proclens[i];
-    }
+    return ESCDF_SUCCESS;
+}
 
-    /* Check that sum(proclens) == product(number_of_grid_points). */
-    nValues = proclens[0];
-    for (i = 1; i < file_id->mpi_size; i++) {
-        nValues += proclens[i];
-    }
-    free(proclens);
+escdf_errno_t escdf_grid_scalarfield_set_deflate_level(escdf_grid_scalarfield_t *scalarfield,
+                                                       const unsigned int deflate_level)
+{
+    FULFILL_OR_RETURN(scalarfield, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(deflate_level < 10, ESCDF_ERANGE);
 
-    nGridPoints = number_of_grid_points[0];
-    for (i = 1; i < number_of_physical_dimensions; i++) {
-        nGridPoints *= number_of_grid_points[i];
-    }
+    scalarfield->deflate_level = deflate_level;
 
-    FULFILL_OR_RETURN(nValues == nGridPoints, ESCDF_ESIZE);
+    return ESCDF_SUCCESS;
+}
+
+escdf_errno_t escdf_grid_scalarfield_set_packed_metadata(escdf_grid_scalarfield_t *scalarfield,
+                                                         const bool packed_metadata)
+{
+    FULFILL_OR_RETURN(scalarfield, ESCDF_EOBJECT);
+
+    scalarfield->packed_metadata = packed_metadata;
 
     return ESCDF_SUCCESS;
 }
 
-static escdf_errno_t _get_values_on_grid(const escdf_grid_scalarfield_t *scalarfield,
-                                         const hid_t loc_id, hid_t *dtset_id)
+escdf_errno_t escdf_grid_scalarfield_set_write_statistics(escdf_grid_scalarfield_t *scalarfield,
+                                                          const bool write_statistics)
 {
-    hsize_t bounds[3];
-    unsigned int i;
+    FULFILL_OR_RETURN(scalarfield, ESCDF_EOBJECT);
+
+    scalarfield->write_statistics = write_statistics;
 
-    /* Check that variable on disk is consistent with metadata in scalarfield. */
-    /* Create the global distribution bounds. */
-    bounds[0] = scalarfield->number_of_components.value;
-    bounds[1] = scalarfield->number_of_grid_points[0];
-    for (i = 1; i < scalarfield->cell.number_of_physical_dimensions.value; i++) {
-        bounds[1] *= scalarfield->number_of_grid_points[i];
-    }
-    bounds[2] = scalarfield->real_or_complex.value;
-    /* Get the dataset for this variable and check its dimensions. */
-    FULFILL_OR_RETURN(utils_hdf5_check_dtset(loc_id, "values_on_grid",
-                                             bounds, 3, dtset_id) == ESCDF_SUCCESS,
-                      ESCDF_ERROR);
     return ESCDF_SUCCESS;
 }
 
-static escdf_errno_t _get_g2d(const escdf_grid_scalarfield_t *scalarfield,
-                              hid_t loc_id, unsigned int **g2d)
+/****************/
+/* Block cache. */
+/****************/
+
+/* Number of grid points of the blocks, 4096 points along one dimension,
+   64 x 64 along two and 16 x 16 x 16 along three. */
+#define CACHE_BLOCK_SIZE 4096
+static const hsize_t cacheEdge[3] = {4096, 64, 16};
+
+static size_t _cache_hash(const _cache_t *cache, hsize_t block)
 {
-    hsize_t len;
-    unsigned int i;
-    hid_t dtset_id;
-    escdf_errno_t err;
-    unsigned int *d2g;
-    
-    *g2d = NULL;
+    return (size_t)((block * UINT64_C(0x9E3779B97F4A7C15)) >> 17) & cache->table_mask;
+}
 
-    if (scalarfield->use_default_ordering.value) {
-        return ESCDF_SUCCESS;
-    }
+static long long int _cache_find(const _cache_t *cache, hsize_t block)
+{
+    size_t h;
 
-    len = scalarfield->number_of_grid_points[0];
-    for (i = 1; i < scalarfield->cell.number_of_physical_dimensions.value; i++) {
-        len *= scalarfield->number_of_grid_points[i];
+    for (h = _cache_hash(cache, block); cache->table[h] >= 0; h = (h + 1) & cache->table_mask) {
+        if (cache->slots[cache->table[h]].block == block + 1) {
+            return cache->table[h];
+        }
+    }
+    return -1;
+}
+
+static void _cache_insert(_cache_t *cache, hsize_t block, size_t slot)
+{
+    size_t h;
+
+    for (h = _cache_hash(cache, block); cache->table[h] >= 0; h = (h + 1) & cache->table_mask);
+    cache->table[h] = (long long int)slot;
+    cache->slots[slot].block = block + 1;
+}
+
+/* Removes a block from the table, shifting back the entries that follow
+   it in its probing sequence. */
+static void _cache_remove(_cache_t *cache, hsize_t block)
+{
+    size_t h, i, home;
+
+    for (h = _cache_hash(cache, block);
+         cache->slots[cache->table[h]].block != block + 1; h = (h + 1) & cache->table_mask);
+    for (i = (h + 1) & cache->table_mask; cache->table[i] >= 0; i = (i + 1) & cache->table_mask) {
+        home = _cache_hash(cache, cache->slots[cache->table[i]].block - 1);
+        if (((i - home) & cache->table_mask) >= ((i - h) & cache->table_mask)) {
+            cache->table[h] = cache->table[i];
+            h = i;
+        }
+    }
+    cache->table[h] = -1;
+}
+
+/* Drops all the blocks, e.g. when values_on_grid is written. */
+static void _cache_invalidate(const escdf_grid_scalarfield_t *scalarfield)
+{
+    _cache_t *cache;
+    size_t i;
+
+    if ((cache = scalarfield->cache) == NULL || cache->nslots == 0) {
+        return;
+    }
+    for (i = 0; i < cache->nslots; i++) {
+        cache->slots[i].block = 0;
+        cache->slots[i].last_use = 0;
+    }
+    for (i = 0; i <= cache->table_mask; i++) {
+        cache->table[i] = -1;
+    }
+    cache->nused = 0;
+    cache->head = -1;
+    cache->tail = -1;
+    cache->mark = -1;
+    cache->last_miss = 0;
+}
+
+/* Sets the cache up for the current metadata and handle, dropping the
+   blocks read before when they changed. Returns false when the cache is
+   disabled, or too small for a block. Must be called with the HDF5 lock. */
+static bool _cache_ready(const escdf_grid_scalarfield_t *scalarfield,
+                         const escdf_handle_t *file_id)
+{
+    _cache_t *cache;
+    hsize_t n[3], bdims[3];
+    unsigned int ndims, a;
+    size_t table_len;
+
+    if ((cache = scalarfield->cache) == NULL) {
+        return false;
+    }
+    ndims = scalarfield->cell.number_of_physical_dimensions.value;
+    for (a = 0; a < 3; a++) {
+        n[a] = (a < ndims) ? scalarfield->number_of_grid_points[a] : 1;
+        bdims[a] = (a < ndims) ? cacheEdge[ndims - 1] : 1;
+    }
+    /* Without the default ordering, the blocks are ranges of values. */
+    if (scalarfield->use_default_ordering.is_set && !scalarfield->use_default_ordering.value) {
+        n[0] *= n[1] * n[2];
+        n[1] = n[2] = 1;
+        bdims[0] = CACHE_BLOCK_SIZE;
+        bdims[1] = bdims[2] = 1;
+    }
+    if (cache->nslots > 0 && cache->generation == file_id->generation &&
+        cache->ncomp == scalarfield->number_of_components.value &&
+        cache->rc == scalarfield->real_or_complex.value &&
+        !memcmp(cache->n, n, sizeof(n)) && !memcmp(cache->bdims, bdims, sizeof(bdims))) {
+        return true;
+    }
+
+    _cache_release(cache);
+    memcpy(cache->n, n, sizeof(n));
+    memcpy(cache->bdims, bdims, sizeof(bdims));
+    for (a = 0; a < 3; a++) {
+        cache->nb[a] = (n[a] + bdims[a] - 1) / bdims[a];
+    }
+    cache->block_len = bdims[0] * bdims[1] * bdims[2];
+    cache->ncomp = scalarfield->number_of_components.value;
+    cache->rc = scalarfield->real_or_complex.value;
+    cache->nslots = cache->size / (sizeof(double) * cache->block_len * cache->ncomp * cache->rc);
+    if (cache->nslots == 0) {
+        return false;
+    }
+    for (table_len = 1; table_len < 2 * cache->nslots; table_len *= 2);
+    cache->table_mask = table_len - 1;
+    cache->slots = calloc(cache->nslots, sizeof(_cache_slot_t));
+    cache->values = malloc(sizeof(double) * cache->nslots * cache->block_len * cache->ncomp *
+                           cache->rc);
+    cache->table = malloc(sizeof(long long int) * table_len);
+    cache->hyperslabs = malloc(sizeof(hsize_t) * 12 * bdims[2]);
+    if (!cache->slots || !cache->values || !cache->table || !cache->hyperslabs) {
+        _cache_release(cache);
+        return false;
+    }
+    cache->generation = file_id->generation;
+    cache->clock = 0;
+    _cache_invalidate(scalarfield);
+
+    return true;
+}
+
+/* First grid point and numbers of grid points of a block, clipped at the
+   upper ends of the grid. */
+static void _cache_extent(const _cache_t *cache, hsize_t block, hsize_t *origin, hsize_t *ext)
+{
+    unsigned int a;
+
+    for (a = 0; a < 3; a++) {
+        origin[a] = (block % cache->nb[a]) * cache->bdims[a];
+        block /= cache->nb[a];
+        ext[a] = (cache->n[a] - origin[a] < cache->bdims[a]) ? cache->n[a] - origin[a] :
+            cache->bdims[a];
+    }
+}
+
+/* Reads a block into a slot, as [ncomp][points of the block][rc], with one
+   strided hyperslab per plane. */
+static escdf_errno_t _cache_load(_cache_t *cache, utils_hdf5_selection_t *sel,
+                                 hid_t dtset_id, hsize_t block, size_t slot)
+{
+    escdf_errno_t err;
+    hsize_t origin[3], ext[3], k, *h;
+
+    _cache_extent(cache, block, origin, ext);
+    h = cache->hyperslabs;
+    for (k = 0; k < ext[2]; k++) {
+        h[3 * k] = 0;
+        h[3 * k + 1] = origin[0] + cache->n[0] * (origin[1] + cache->n[1] * (origin[2] + k));
+        h[3 * k + 2] = 0;
+        h[3 * (ext[2] + k)] = 1;
+        h[3 * (ext[2] + k) + 1] = cache->n[0];
+        h[3 * (ext[2] + k) + 2] = 1;
+        h[3 * (2 * ext[2] + k)] = 1;
+        h[3 * (2 * ext[2] + k) + 1] = ext[1];
+        h[3 * (2 * ext[2] + k) + 2] = 1;
+        h[3 * (3 * ext[2] + k)] = cache->ncomp;
+        h[3 * (3 * ext[2] + k) + 1] = ext[0];
+        h[3 * (3 * ext[2] + k) + 2] = cache->rc;
+    }
+    if ((err = utils_hdf5_selection_set_hyperslabs(sel, ext[2], h, h + 3 * ext[2],
+                                                   h + 6 * ext[2], h + 9 * ext[2])) != ESCDF_SUCCESS) {
+        return err;
+    }
+    return utils_hdf5_selection_read(sel, dtset_id, H5P_DEFAULT, H5T_NATIVE_DOUBLE,
+                                     cache->values + slot * cache->block_len * cache->ncomp *
+                                     cache->rc);
+}
+
+/* Takes a slot out of the list of the slots in use. */
+static void _cache_unlink(_cache_t *cache, long long int s)
+{
+    _cache_slot_t *slot;
+
+    slot = cache->slots + s;
+    if (slot->prev >= 0) {
+        cache->slots[slot->prev].next = slot->next;
+    } else {
+        cache->head = slot->next;
+    }
+    if (slot->next >= 0) {
+        cache->slots[slot->next].prev = slot->prev;
+    } else {
+        cache->tail = slot->prev;
+    }
+    if (cache->mark == s) {
+        cache->mark = slot->prev;
+    }
+}
+
+/* Links a slot after another one, at the front of the list for -1. */
+static void _cache_link(_cache_t *cache, long long int s, long long int after)
+{
+    _cache_slot_t *slot;
+
+    slot = cache->slots + s;
+    slot->prev = after;
+    slot->next = (after >= 0) ? cache->slots[after].next : cache->head;
+    if (after >= 0) {
+        cache->slots[after].next = s;
+    } else {
+        cache->head = s;
+    }
+    if (slot->next >= 0) {
+        cache->slots[slot->next].prev = s;
+    } else {
+        cache->tail = s;
+    }
+}
+
+/* Marks a slot, not in the list, as used by the current batch: it goes to
+   the front of the list, the slots being sorted by their last use. */
+static void _cache_use(_cache_t *cache, long long int s, unsigned long long stamp)
+{
+    cache->slots[s].last_use = stamp;
+    _cache_link(cache, s, -1);
+    if (cache->mark < 0 || cache->slots[cache->mark].last_use != stamp) {
+        cache->mark = s;
+    }
+}
+
+/* Marks a slot, not in the list, as read ahead by the current batch: it
+   goes after the slots used by the batch, which it is older than. */
+static void _cache_use_ahead(_cache_t *cache, long long int s, unsigned long long stamp)
+{
+    cache->slots[s].last_use = stamp - 1;
+    _cache_link(cache, s,
+                (cache->mark >= 0 && cache->slots[cache->mark].last_use == stamp) ?
+                cache->mark : -1);
+}
+
+/* Slot to reuse, out of the list: a free one or the least recently used
+   one, at the end of the list, if not used since stamp; -1 when there is
+   none. */
+static long long int _cache_victim(_cache_t *cache, unsigned long long stamp)
+{
+    long long int victim;
+
+    if (cache->nused < cache->nslots) {
+        return (long long int)cache->nused++;
+    }
+    victim = cache->tail;
+    if (victim < 0 || cache->slots[victim].last_use >= stamp) {
+        return -1;
+    }
+    _cache_unlink(cache, victim);
+    if (cache->slots[victim].block != 0) {
+        _cache_remove(cache, cache->slots[victim].block - 1);
+        cache->slots[victim].block = 0;
+        cache->stats.evictions += 1;
+    }
+    return victim;
+}
+
+/* Gives back a free slot, out of the list, at its end to be reused first. */
+static void _cache_free_slot(_cache_t *cache, long long int s)
+{
+    cache->slots[s].last_use = 0;
+    _cache_link(cache, s, cache->tail);
+}
+
+/* Slot of a block, read on a miss together with the cache_read_ahead
+   blocks that follow it in the direction of the misses. The blocks used
+   since stamp stay in the cache. */
+static escdf_errno_t _cache_fetch(const escdf_grid_scalarfield_t *scalarfield,
+                                  utils_hdf5_selection_t *sel, hid_t dtset_id,
+                                  hsize_t block, unsigned long long stamp, size_t *slot)
+{
+    escdf_errno_t err;
+    _cache_t *cache;
+    long long int s;
+    hsize_t next, nblocks;
+    bool forward;
+    unsigned int a;
+
+    cache = scalarfield->cache;
+    if ((s = _cache_find(cache, block)) >= 0) {
+        cache->stats.hits += 1;
+        _cache_unlink(cache, s);
+        _cache_use(cache, s, stamp);
+        *slot = (size_t)s;
+        return ESCDF_SUCCESS;
+    }
+
+    cache->stats.misses += 1;
+    /* The batches of blocks always leave a slot to reuse. */
+    if ((s = _cache_victim(cache, stamp)) < 0) {
+        RETURN_WITH_ERROR(ESCDF_ERROR);
+    }
+    if ((err = _cache_load(cache, sel, dtset_id, block, (size_t)s)) != ESCDF_SUCCESS) {
+        _cache_free_slot(cache, s);
+        return err;
+    }
+    _cache_insert(cache, block, (size_t)s);
+    _cache_use(cache, s, stamp);
+    *slot = (size_t)s;
+
+    /* The blocks read ahead may be evicted by the ones asked for next. */
+    forward = (cache->last_miss == 0 || block + 1 >= cache->last_miss);
+    cache->last_miss = block + 1;
+    nblocks = cache->nb[0] * cache->nb[1] * cache->nb[2];
+    for (a = 1; a <= scalarfield->cache_read_ahead; a++) {
+        if ((forward && block + a >= nblocks) || (!forward && block < a)) {
+            break;
+        }
+        next = (forward) ? block + a : block - a;
+        if (_cache_find(cache, next) >= 0) {
+            continue;
+        }
+        if ((s = _cache_victim(cache, stamp)) < 0) {
+            break;
+        }
+        if ((err = _cache_load(cache, sel, dtset_id, next, (size_t)s)) != ESCDF_SUCCESS) {
+            _cache_free_slot(cache, s);
+            return err;
+        }
+        _cache_insert(cache, next, (size_t)s);
+        _cache_use_ahead(cache, s, stamp);
+        cache->stats.read_ahead += 1;
+    }
+
+    return ESCDF_SUCCESS;
+}
+
+static int _compare_blocks(const void *a, const void *b)
+{
+    hsize_t ba = *(const hsize_t*)a, bb = *(const hsize_t*)b;
+
+    return (ba > bb) - (ba < bb);
+}
+
+/* Gathers the values of the components [c0, c0 + nc) at npts positions of
+   values_on_grid through the cache, into out[c - c0][ld][rc]. The blocks
+   are fetched by batches that fit in the cache. Must be called with the
+   HDF5 lock, after _cache_ready(). */
+static escdf_errno_t _cache_gather(const escdf_grid_scalarfield_t *scalarfield,
+                                   hid_t dtset_id, hsize_t npts, const hsize_t *g,
+                                   unsigned int c0, unsigned int nc, hsize_t ld, double *out)
+{
+    escdf_errno_t err;
+    _cache_t *cache;
+    utils_hdf5_selection_t sel;
+    hsize_t *blocks, *uniq, *found, origin[3], ext[3], x[3], p, q, nuniq, u0, u1, len, local;
+    size_t *slots;
+    const double *values;
+    unsigned long long stamp;
+    unsigned int c, r;
+
+    cache = scalarfield->cache;
+    blocks = malloc(sizeof(hsize_t) * 2 * npts);
+    slots = malloc(sizeof(size_t) * cache->nslots);
+    if (blocks == NULL || slots == NULL) {
+        free(blocks);
+        free(slots);
+        RETURN_WITH_ERROR(ESCDF_ENOMEM);
+    }
+    uniq = blocks + npts;
+    for (p = 0; p < npts; p++) {
+        x[0] = g[p] % cache->n[0];
+        x[1] = (g[p] / cache->n[0]) % cache->n[1];
+        x[2] = g[p] / (cache->n[0] * cache->n[1]);
+        blocks[p] = x[0] / cache->bdims[0] +
+            cache->nb[0] * (x[1] / cache->bdims[1] + cache->nb[1] * (x[2] / cache->bdims[2]));
+        uniq[p] = blocks[p];
+    }
+    qsort(uniq, npts, sizeof(hsize_t), _compare_blocks);
+    for (nuniq = 0, p = 0; p < npts; p++) {
+        if (nuniq == 0 || uniq[p] != uniq[nuniq - 1]) {
+            uniq[nuniq++] = uniq[p];
+        }
+    }
+
+    if ((err = utils_hdf5_selection_init(&sel, dtset_id)) != ESCDF_SUCCESS) {
+        free(blocks);
+        free(slots);
+        return err;
+    }
+    for (u0 = 0; u0 < nuniq && err == ESCDF_SUCCESS; u0 = u1) {
+        u1 = (nuniq - u0 < cache->nslots) ? nuniq : u0 + cache->nslots;
+        /* The blocks read ahead are stamped stamp - 1. */
+        cache->clock += 2;
+        stamp = cache->clock;
+        for (q = u0; q < u1 && err == ESCDF_SUCCESS; q++) {
+            err = _cache_fetch(scalarfield, &sel, dtset_id, uniq[q], stamp, slots + q - u0);
+        }
+        for (p = 0; p < npts && err == ESCDF_SUCCESS; p++) {
+            found = bsearch(blocks + p, uniq + u0, u1 - u0, sizeof(hsize_t), _compare_blocks);
+            if (found == NULL) {
+                continue;
+            }
+            _cache_extent(cache, blocks[p], origin, ext);
+            len = ext[0] * ext[1] * ext[2];
+            x[0] = g[p] % cache->n[0];
+            x[1] = (g[p] / cache->n[0]) % cache->n[1];
+            x[2] = g[p] / (cache->n[0] * cache->n[1]);
+            local = (x[0] - origin[0]) + ext[0] * ((x[1] - origin[1]) + ext[1] * (x[2] - origin[2]));
+            values = cache->values + slots[found - uniq - u0] * cache->block_len * cache->ncomp *
+                cache->rc;
+            for (c = c0; c < c0 + nc; c++) {
+                for (r = 0; r < cache->rc; r++) {
+                    out[((c - c0) * ld + p) * cache->rc + r] =
+                        values[(c * len + local) * cache->rc + r];
+                }
+            }
+        }
+    }
+    utils_hdf5_selection_free(&sel);
+    free(blocks);
+    free(slots);
+
+    return err;
+}
+
+escdf_errno_t escdf_grid_scalarfield_set_cache_size(escdf_grid_scalarfield_t *scalarfield,
+                                                    const size_t size)
+{
+    FULFILL_OR_RETURN(scalarfield, ESCDF_EOBJECT);
+
+    utils_hdf5_lock();
+    if (scalarfield->cache) {
+        _cache_release(scalarfield->cache);
+    }
+    if (size == 0) {
+        free(scalarfield->cache);
+        scalarfield->cache = NULL;
+    } else if (scalarfield->cache == NULL) {
+        scalarfield->cache = calloc(1, sizeof(_cache_t));
+    }
+    if (scalarfield->cache) {
+        scalarfield->cache->size = size;
+    }
+    utils_hdf5_unlock();
+    FULFILL_OR_RETURN(size == 0 || scalarfield->cache, ESCDF_ENOMEM);
+
+    return ESCDF_SUCCESS;
+}
+
+size_t escdf_grid_scalarfield_get_cache_size(const escdf_grid_scalarfield_t *scalarfield)
+{
+    FULFILL_OR_RETURN_VAL(scalarfield, ESCDF_EOBJECT, 0);
+
+    return (scalarfield->cache) ? scalarfield->cache->size : 0;
+}
+
+escdf_errno_t escdf_grid_scalarfield_set_cache_read_ahead(escdf_grid_scalarfield_t *scalarfield,
+                                                          const unsigned int number_of_blocks)
+{
+    FULFILL_OR_RETURN(scalarfield, ESCDF_EOBJECT);
+
+    scalarfield->cache_read_ahead = number_of_blocks;
+
+    return ESCDF_SUCCESS;
+}
+
+unsigned int escdf_grid_scalarfield_get_cache_read_ahead(const escdf_grid_scalarfield_t *scalarfield)
+{
+    FULFILL_OR_RETURN_VAL(scalarfield, ESCDF_EOBJECT, 0);
+
+    return scalarfield->cache_read_ahead;
+}
+
+escdf_errno_t escdf_grid_scalarfield_get_cache_statistics(const escdf_grid_scalarfield_t *scalarfield,
+                                                          escdf_grid_scalarfield_cache_statistics_t *statistics)
+{
+    FULFILL_OR_RETURN(scalarfield, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(statistics, ESCDF_EVALUE);
+
+    utils_hdf5_lock();
+    if (scalarfield->cache) {
+        *statistics = scalarfield->cache->stats;
+    } else {
+        memset(statistics, 0, sizeof(escdf_grid_scalarfield_cache_statistics_t));
+    }
+    utils_hdf5_unlock();
+
+    return ESCDF_SUCCESS;
+}
+
+void escdf_grid_scalarfield_clear_cache(escdf_grid_scalarfield_t *scalarfield)
+{
+    if (!scalarfield || !scalarfield->cache)
+        return;
+
+    utils_hdf5_lock();
+    _cache_invalidate(scalarfield);
+    memset(&scalarfield->cache->stats, 0, sizeof(escdf_grid_scalarfield_cache_statistics_t));
+    utils_hdf5_unlock();
+}
+
+/*******************/
+/* Data accessors. */
+/*******************/
+static escdf_errno_t _get_proc_grid_offset(hsize_t *my_offset,
+                                           escdf_handle_t *file_id,
+                                           unsigned int number_of_physical_dimensions,
+                                           unsigned int *number_of_grid_points,
+                                           hsize_t my_len)
+{
+    unsigned long long int len_, offset_, sum_;
+    hsize_t nValues, nGridPoints;
+    int i;
+
+    len_ = (unsigned long long int)my_len;
+    offset_ = 0;
+    sum_ = len_;
+#ifdef HAVE_MPI
+    /* The offset and the total are reduced, instead of gathering all the
+       lengths on every rank. */
+    if (file_id->mpi_size > 1) {
+        MPI_Exscan(&len_, &offset_, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, file_id->comm);
+        MPI_Allreduce(&len_, &sum_, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, file_id->comm);
+        /* The scan is undefined on the first rank. */
+        if (file_id->mpi_rank == 0) {
+            offset_ = 0;
+        }
+    }
+#else
+    (void)file_id;
+#endif
+    *my_offset = (hsize_t)offset_;
+
+    /* Check that the sum of the lengths == product(number_of_grid_points). */
+    nValues = (hsize_t)sum_;
+
+    nGridPoints = number_of_grid_points[0];
+    for (i = 1; i < number_of_physical_dimensions; i++) {
+        nGridPoints *= number_of_grid_points[i];
+    }
+
+    FULFILL_OR_RETURN(nValues == nGridPoints, ESCDF_ESIZE);
+
+    return ESCDF_SUCCESS;
+}
+
+static escdf_errno_t _get_values_on_grid(const escdf_grid_scalarfield_t *scalarfield,
+                                         const hid_t loc_id, hid_t *dtset_id)
+{
+    hsize_t bounds[3];
+    unsigned int i;
+
+    /* Check that variable on disk is consistent with metadata in scalarfield. */
+    /* Create the global distribution bounds. */
+    bounds[0] = scalarfield->number_of_components.value;
+    bounds[1] = scalarfield->number_of_grid_points[0];
+    for (i = 1; i < scalarfield->cell.number_of_physical_dimensions.value; i++) {
+        bounds[1] *= scalarfield->number_of_grid_points[i];
+    }
+    bounds[2] = scalarfield->real_or_complex.value;
+    /* Get the dataset for this variable and check its dimensions. */
+    FULFILL_OR_RETURN(utils_hdf5_check_dtset(loc_id, "values_on_grid",
+                                             bounds, 3, dtset_id) == ESCDF_SUCCESS,
+                      ESCDF_ERROR);
+    return ESCDF_SUCCESS;
+}
+
+static escdf_errno_t _get_g2d(const escdf_grid_scalarfield_t *scalarfield,
+                              hid_t loc_id, unsigned int **g2d)
+{
+    hsize_t len;
+    unsigned int i;
+    hid_t dtset_id;
+    escdf_errno_t err;
+    unsigned int *d2g;
+    
+    *g2d = NULL;
+
+    if (scalarfield->use_default_ordering.value) {
+        return ESCDF_SUCCESS;
+    }
+
+    len = scalarfield->number_of_grid_points[0];
+    for (i = 1; i < scalarfield->cell.number_of_physical_dimensions.value; i++) {
+        len *= scalarfield->number_of_grid_points[i];
     }
 
     /* Get the lookup table for this variable and check its dimensions. */
+    utils_hdf5_lock();
     if ((err = utils_hdf5_check_dtset(loc_id, "grid_ordering",
                                       &len, 1, &dtset_id)) != ESCDF_SUCCESS) {
+        utils_hdf5_unlock();
         return err;
     }
     /* Actual read of all the lookup table. */
@@ -574,11 +1497,17 @@ static escdf_errno_t _get_g2d(const escdf_grid_scalarfield_t *scalarfield,
                                        NULL, NULL, NULL)) != ESCDF_SUCCESS) {
         free(d2g);
         H5Dclose(dtset_id);
+        utils_hdf5_unlock();
         return err;
     }
     H5Dclose(dtset_id);
-    /* Invert d2g into g2d. */
+    utils_hdf5_unlock();
+
+    /* Invert d2g into g2d, outside of the HDF5 lock. */
     *g2d = malloc(sizeof(unsigned int) * len);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
     for (i = 0; i < len; i++) {
         (*g2d)[d2g[i]] = i;
     }
@@ -595,9 +1524,11 @@ static escdf_errno_t _read_at(const escdf_grid_scalarfield_t *scalarfield,
 {
     escdf_errno_t err;
     hid_t dtset_id;
+    utils_hdf5_selection_t sel;
     hsize_t *coord;
     size_t num_elements;
     unsigned int i, j;
+    bool cached;
 
     /* To limit the size of coord array, only MAX_BLOCK_SIZE grid
        points are read at once. Thus the memory footprint of this
@@ -607,7 +1538,16 @@ static escdf_errno_t _read_at(const escdf_grid_scalarfield_t *scalarfield,
 #define MAX_BLOCK_SIZE (1024 * 1024)
 
     /* Check that variable on disk is consistent with metadata in scalarfield. */
-    if ((err = _get_values_on_grid(scalarfield, loc_id, &dtset_id)) != ESCDF_SUCCESS) {
+    utils_hdf5_lock();
+    err = _get_values_on_grid(scalarfield, loc_id, &dtset_id);
+    if (err == ESCDF_SUCCESS) {
+        /* The dataspaces are shared by all the blocks. */
+        if ((err = utils_hdf5_selection_init(&sel, dtset_id)) != ESCDF_SUCCESS) {
+            H5Dclose(dtset_id);
+        }
+    }
+    utils_hdf5_unlock();
+    if (err != ESCDF_SUCCESS) {
         return err;
     }
 
@@ -623,11 +1563,35 @@ static escdf_errno_t _read_at(const escdf_grid_scalarfield_t *scalarfield,
 
     coord = malloc(sizeof(hsize_t) * MAX_BLOCK_SIZE *
                    scalarfield->real_or_complex.value * 3);
-    for (i = 0; i < scalarfield->number_of_components.value; i++) {
+
+    /* With a block cache, the grid points are gathered from whole blocks,
+       read once, and independently of the other MPI ranks. */
+    utils_hdf5_lock();
+    cached = _cache_ready(scalarfield, file_id);
+    utils_hdf5_unlock();
+    for (j0 = 0; cached && j0 < glen; j0 += blocksize) {
+        blocksize = (glen - j0 < MAX_BLOCK_SIZE) ? glen - j0 : MAX_BLOCK_SIZE;
+        for (j = 0; j < blocksize; j++) {
+            coord[j] = indirect[j0 + j];
+        }
+        utils_hdf5_lock();
+        err = _cache_gather(scalarfield, dtset_id, blocksize, coord, 0,
+                            scalarfield->number_of_components.value, glen,
+                            buf + j0 * scalarfield->real_or_complex.value);
+        utils_hdf5_unlock();
+        if (err != ESCDF_SUCCESS) {
+            goto cleanup;
+        }
+    }
+    for (i = 0; i < scalarfield->number_of_components.value && !cached; i++) {
         j0 = 0;
         for (iblock = 0; iblock < nblock; iblock++) {
             blocksize = (glen - j0 < MAX_BLOCK_SIZE) ? glen - j0 : MAX_BLOCK_SIZE;
+            /* The coordinates are generated outside of the HDF5 lock. */
             if (scalarfield->real_or_complex.value == ESCDF_COMPLEX) {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
                 for (j = 0; j < blocksize; j++) {
                     coord[(j * 2 + 0) * 3 + 0] = i;
                     coord[(j * 2 + 0) * 3 + 1] = indirect[j0 + j];
@@ -637,6 +1601,9 @@ static escdf_errno_t _read_at(const escdf_grid_scalarfield_t *scalarfield,
                     coord[(j * 2 + 1) * 3 + 2] = 1;
                 }
             } else {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
                 for (j = 0; j < blocksize; j++) {
                     coord[j * 3 + 0] = i;
                     coord[j * 3 + 1] = indirect[j0 + j];
@@ -644,45 +1611,348 @@ static escdf_errno_t _read_at(const escdf_grid_scalarfield_t *scalarfield,
                 }
             }
             offset = i * num_elements + j0 * scalarfield->real_or_complex.value;
-            if ((err = utils_hdf5_read_dataset_at(dtset_id, file_id->transfer_mode,
-                                                  buf + offset,
-                                                  H5T_NATIVE_DOUBLE,
-                                                  blocksize * scalarfield->real_or_complex.value, coord)) != ESCDF_SUCCESS) {
-                free(coord);
-                H5Dclose(dtset_id);
-                return err;
+            utils_hdf5_lock();
+            err = utils_hdf5_selection_set_elements(&sel, blocksize * scalarfield->real_or_complex.value,
+                                                    coord);
+            if (err == ESCDF_SUCCESS) {
+                err = utils_hdf5_selection_read(&sel, dtset_id, file_id->transfer_mode,
+                                                H5T_NATIVE_DOUBLE, buf + offset);
+            }
+            utils_hdf5_unlock();
+            if (err != ESCDF_SUCCESS) {
+                goto cleanup;
             }
             j0 += blocksize;
         }
     }
+
+    cleanup:
     free(coord);
+    utils_hdf5_lock();
+    utils_hdf5_selection_free(&sel);
     H5Dclose(dtset_id);
-    return ESCDF_SUCCESS;
+    utils_hdf5_unlock();
+    return err;
 }
 
-escdf_errno_t escdf_grid_scalarfield_write_values_on_grid_ordered(const escdf_grid_scalarfield_t *scalarfield,
-                                                                  escdf_handle_t *file_id,
-                                                                  const double *buf,
-                                                                  const hsize_t *start,
-                                                                  const hsize_t *count,
-                                                                  const hsize_t *stride)
-{
-    return escdf_grid_scalarfield_write_values_on_grid
-        (scalarfield, file_id, buf, NULL, start, count, stride);
+/**************************/
+/* Write-time statistics. */
+/**************************/
+
+/* Primes of xxHash64. */
+#define PRIME64_1 UINT64_C(0x9E3779B185EBCA87)
+#define PRIME64_2 UINT64_C(0xC2B2AE3D27D4EB4F)
+#define PRIME64_3 UINT64_C(0x165667B19E3779F9)
+
+/* Per component statistics, sums, minima and maxima per real and imaginary
+   part, laid out as [number_of_components][real_or_complex]. */
+typedef struct {
+    unsigned int ncomp, rc;
+    uint64_t *counts, *checksums;
+    double *sums, *minima, *maxima;
+} _statistics_t;
+
+/* Hash of a value and of its index in its component, with the avalanche
+   of xxHash64, so that the sum over the values is a checksum independent of
+   the order of the writes. */
+static uint64_t _hash_value(uint64_t index, double value)
+{
+    uint64_t h;
+
+    memcpy(&h, &value, sizeof(uint64_t));
+    h = (h * PRIME64_2) ^ ((index + 1) * PRIME64_1);
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+
+    return h;
 }
-escdf_errno_t escdf_grid_scalarfield_write_values_on_grid(const escdf_grid_scalarfield_t *scalarfield,
-                                                          escdf_handle_t *file_id,
-                                                          const double *buf,
-                                                          const unsigned int *tbl,
-                                                          const hsize_t *start,
-                                                          const hsize_t *count,
-                                                          const hsize_t *stride)
+
+/* Checksum of n consecutive values of a component, from the index first. */
+static uint64_t _checksum_values(const double *values, hsize_t first, hsize_t n)
 {
-    escdf_errno_t err;
-    hid_t dtset_id, loc_id;
-    hsize_t len;
+    uint64_t h;
+    long long int i;
+
+    h = 0;
+#ifdef _OPENMP
+#pragma omp parallel for simd reduction(+:h)
+#endif
+    for (i = 0; i < (long long int)n; i++) {
+        h += _hash_value(first + (uint64_t)i, values[i]);
+    }
+
+    return h;
+}
+
+static escdf_errno_t _statistics_init(const escdf_grid_scalarfield_t *scalarfield,
+                                      _statistics_t *stats)
+{
+    unsigned int i, n;
+
+    stats->ncomp = scalarfield->number_of_components.value;
+    stats->rc = scalarfield->real_or_complex.value;
+    n = stats->ncomp * stats->rc;
+    stats->counts = calloc(2 * stats->ncomp, sizeof(uint64_t));
+    stats->sums = calloc(3 * n, sizeof(double));
+    if (stats->counts == NULL || stats->sums == NULL) {
+        free(stats->counts);
+        free(stats->sums);
+        RETURN_WITH_ERROR(ESCDF_ENOMEM);
+    }
+    stats->checksums = stats->counts + stats->ncomp;
+    stats->minima = stats->sums + n;
+    stats->maxima = stats->sums + 2 * n;
+    for (i = 0; i < n; i++) {
+        stats->minima[i] = HUGE_VAL;
+        stats->maxima[i] = -HUGE_VAL;
+    }
+
+    return ESCDF_SUCCESS;
+}
+
+static void _statistics_free(_statistics_t *stats)
+{
+    free(stats->counts);
+    free(stats->sums);
+}
+
+/**
+ * Statistics of the values of a write, buf holding the values selected by
+ * start, count and stride in values_on_grid, NULL for the whole data set.
+ */
+static void _statistics_of_write(const escdf_grid_scalarfield_t *scalarfield,
+                                 const double *buf, const hsize_t *start,
+                                 const hsize_t *count, const hsize_t *stride,
+                                 _statistics_t *stats)
+{
+    hsize_t s[3], n[3], st[3], c, r, k, e;
+    long long int p;
     unsigned int i;
+    double sum, mn, mx, v;
+    uint64_t h;
+
+    n[0] = stats->ncomp;
+    n[1] = scalarfield->number_of_grid_points[0];
+    for (i = 1; i < scalarfield->cell.number_of_physical_dimensions.value; i++) {
+        n[1] *= scalarfield->number_of_grid_points[i];
+    }
+    n[2] = stats->rc;
+    for (i = 0; i < 3; i++) {
+        s[i] = (start) ? start[i] : 0;
+        n[i] = (count) ? count[i] : n[i];
+        st[i] = (stride) ? stride[i] : 1;
+    }
+
+    for (c = 0; c < n[0]; c++) {
+        for (r = 0; r < n[2]; r++) {
+            k = (s[0] + c * st[0]) * stats->rc + s[2] + r * st[2];
+            e = s[2] + r * st[2];
+            sum = 0.;
+            mn = HUGE_VAL;
+            mx = -HUGE_VAL;
+            h = 0;
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:sum,h) reduction(min:mn) reduction(max:mx) private(v)
+#endif
+            for (p = 0; p < (long long int)n[1]; p++) {
+                v = buf[(c * n[1] + p) * n[2] + r];
+                sum += v;
+                mn = (v < mn) ? v : mn;
+                mx = (v > mx) ? v : mx;
+                h += _hash_value((s[1] + p * st[1]) * stats->rc + e, v);
+            }
+            stats->sums[k] += sum;
+            stats->minima[k] = (mn < stats->minima[k]) ? mn : stats->minima[k];
+            stats->maxima[k] = (mx > stats->maxima[k]) ? mx : stats->maxima[k];
+            stats->checksums[s[0] + c * st[0]] += h;
+        }
+        stats->counts[s[0] + c * st[0]] += n[1];
+    }
+}
+
+/* Writes an attribute, over its previous value if any. Must be called with
+   the HDF5 lock. */
+static escdf_errno_t _update_attr(hid_t loc_id, const char *name, hid_t disk_type_id,
+                                  hsize_t *dims, unsigned int ndims, hid_t mem_type_id,
+                                  const void *buf)
+{
+    hid_t attr_id;
+    herr_t err_id;
+
+    if (H5Aexists(loc_id, name) <= 0) {
+        return utils_hdf5_write_attr(loc_id, name, disk_type_id, dims, ndims,
+                                     mem_type_id, buf);
+    }
+    if ((attr_id = H5Aopen(loc_id, name, H5P_DEFAULT)) < 0) {
+        RETURN_WITH_ERROR(attr_id);
+    }
+    err_id = H5Awrite(attr_id, mem_type_id, buf);
+    H5Aclose(attr_id);
+    FULFILL_OR_RETURN(err_id >= 0, ESCDF_ERROR);
+
+    return ESCDF_SUCCESS;
+}
+
+/* Reads the statistics stored with values_on_grid, if any, into stats. Must
+   be called with the HDF5 lock. */
+static escdf_errno_t _read_statistics(hid_t dtset_id, _statistics_t *stats, bool *present)
+{
+    escdf_errno_t err;
+    hsize_t dims[2];
+
+    *present = (H5Aexists(dtset_id, "statistics_counts") > 0);
+    if (!*present) {
+        return ESCDF_SUCCESS;
+    }
+    dims[0] = stats->ncomp;
+    dims[1] = stats->rc;
+    err = utils_hdf5_read_attr(dtset_id, "statistics_counts", H5T_NATIVE_UINT64, dims, 1,
+                               stats->counts);
+    if (err == ESCDF_SUCCESS) {
+        err = utils_hdf5_read_attr(dtset_id, "statistics_checksums", H5T_NATIVE_UINT64, dims, 1,
+                                   stats->checksums);
+    }
+    if (err == ESCDF_SUCCESS) {
+        err = utils_hdf5_read_attr(dtset_id, "statistics_sums", H5T_NATIVE_DOUBLE, dims, 2,
+                                   stats->sums);
+    }
+    if (err == ESCDF_SUCCESS) {
+        err = utils_hdf5_read_attr(dtset_id, "statistics_minima", H5T_NATIVE_DOUBLE, dims, 2,
+                                   stats->minima);
+    }
+    if (err == ESCDF_SUCCESS) {
+        err = utils_hdf5_read_attr(dtset_id, "statistics_maxima", H5T_NATIVE_DOUBLE, dims, 2,
+                                   stats->maxima);
+    }
+
+    return err;
+}
+
+/**
+ * Reduces the statistics of a write over the MPI ranks, and records them
+ * with values_on_grid: they replace the stored ones of the components
+ * written in whole, e.g. at each step of a self-consistent loop, and are
+ * added to the ones of the components written in part. All the ranks take
+ * part, even when their write failed with err, so that none of them blocks.
+ */
+static escdf_errno_t _record_statistics(const escdf_grid_scalarfield_t *scalarfield,
+                                        escdf_handle_t *file_id, _statistics_t *stats,
+                                        escdf_errno_t err)
+{
+    _statistics_t stored;
+    hid_t loc_id, dtset_id;
+    hsize_t dims[2], npts;
+    unsigned int i, r, k;
+    bool present;
+#ifdef HAVE_MPI
+    unsigned int n;
+    int failed;
+
+    if (file_id->mpi_size > 1) {
+        n = stats->ncomp * stats->rc;
+        failed = (err != ESCDF_SUCCESS);
+        MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_LOR, file_id->comm);
+        if (failed) {
+            return (err != ESCDF_SUCCESS) ? err : ESCDF_ERROR;
+        }
+        MPI_Allreduce(MPI_IN_PLACE, stats->counts, 2 * stats->ncomp, MPI_UINT64_T, MPI_SUM,
+                      file_id->comm);
+        MPI_Allreduce(MPI_IN_PLACE, stats->sums, n, MPI_DOUBLE, MPI_SUM, file_id->comm);
+        MPI_Allreduce(MPI_IN_PLACE, stats->minima, n, MPI_DOUBLE, MPI_MIN, file_id->comm);
+        MPI_Allreduce(MPI_IN_PLACE, stats->maxima, n, MPI_DOUBLE, MPI_MAX, file_id->comm);
+    }
+#endif
+    FULFILL_OR_RETURN(err == ESCDF_SUCCESS, err);
+    if ((err = _statistics_init(scalarfield, &stored)) != ESCDF_SUCCESS) {
+        return err;
+    }
+
+    utils_hdf5_lock();
+    if ((loc_id = H5Gopen(file_id->group_id, scalarfield->path, H5P_DEFAULT)) < 0) {
+        utils_hdf5_unlock();
+        _statistics_free(&stored);
+        RETURN_WITH_ERROR(loc_id);
+    }
+    utils_stats_count_open();
+    if ((dtset_id = H5Dopen(loc_id, "values_on_grid", H5P_DEFAULT)) < 0) {
+        DEFER_FUNC_ERROR(dtset_id);
+        err = ESCDF_ERROR;
+    } else {
+        err = _read_statistics(dtset_id, &stored, &present);
+    }
+    if (err == ESCDF_SUCCESS) {
+        npts = scalarfield->number_of_grid_points[0];
+        for (i = 1; i < scalarfield->cell.number_of_physical_dimensions.value; i++) {
+            npts *= scalarfield->number_of_grid_points[i];
+        }
+        for (i = 0; i < stats->ncomp; i++) {
+            if (stats->counts[i] == npts) {
+                stored.counts[i] = 0;
+                stored.checksums[i] = 0;
+                for (r = 0; r < stats->rc; r++) {
+                    k = i * stats->rc + r;
+                    stored.sums[k] = 0.;
+                    stored.minima[k] = HUGE_VAL;
+                    stored.maxima[k] = -HUGE_VAL;
+                }
+            }
+            stored.counts[i] += stats->counts[i];
+            stored.checksums[i] += stats->checksums[i];
+            for (r = 0; r < stats->rc; r++) {
+                k = i * stats->rc + r;
+                stored.sums[k] += stats->sums[k];
+                stored.minima[k] = (stats->minima[k] < stored.minima[k]) ? stats->minima[k] : stored.minima[k];
+                stored.maxima[k] = (stats->maxima[k] > stored.maxima[k]) ? stats->maxima[k] : stored.maxima[k];
+            }
+        }
+        dims[0] = stats->ncomp;
+        dims[1] = stats->rc;
+        err = _update_attr(dtset_id, "statistics_counts", H5T_STD_U64LE, dims, 1,
+                           H5T_NATIVE_UINT64, stored.counts);
+        if (err == ESCDF_SUCCESS) {
+            err = _update_attr(dtset_id, "statistics_checksums", H5T_STD_U64LE, dims, 1,
+                               H5T_NATIVE_UINT64, stored.checksums);
+        }
+        if (err == ESCDF_SUCCESS) {
+            err = _update_attr(dtset_id, "statistics_sums", H5T_IEEE_F64LE, dims, 2,
+                               H5T_NATIVE_DOUBLE, stored.sums);
+        }
+        if (err == ESCDF_SUCCESS) {
+            err = _update_attr(dtset_id, "statistics_minima", H5T_IEEE_F64LE, dims, 2,
+                               H5T_NATIVE_DOUBLE, stored.minima);
+        }
+        if (err == ESCDF_SUCCESS) {
+            err = _update_attr(dtset_id, "statistics_maxima", H5T_IEEE_F64LE, dims, 2,
+                               H5T_NATIVE_DOUBLE, stored.maxima);
+        }
+    }
+    if (dtset_id >= 0) {
+        H5Dclose(dtset_id);
+    }
+    H5Gclose(loc_id);
+    utils_hdf5_unlock();
+    _statistics_free(&stored);
+
+    return err;
+}
 
+escdf_errno_t escdf_grid_scalarfield_write_values_on_grid_ordered(const escdf_grid_scalarfield_t *scalarfield,
+                                                                  escdf_handle_t *file_id,
+                                                                  const double *buf,
+                                                                  const hsize_t *start,
+                                                                  const hsize_t *count,
+                                                                  const hsize_t *stride)
+{
+    return escdf_grid_scalarfield_write_values_on_grid
+        (scalarfield, file_id, buf, NULL, start, count, stride);
+}
+/* Check that a scalarfield can be written, with or without lookup table. */
+static escdf_errno_t _check_write(const escdf_grid_scalarfield_t *scalarfield,
+                                  const unsigned int *tbl)
+{
     FULFILL_OR_RETURN(scalarfield, ESCDF_EOBJECT);
     FULFILL_OR_RETURN(scalarfield->cell.number_of_physical_dimensions.is_set, ESCDF_EUNINIT);
     FULFILL_OR_RETURN(scalarfield->number_of_components.is_set, ESCDF_EUNINIT);
@@ -695,53 +1965,209 @@ escdf_errno_t escdf_grid_scalarfield_write_values_on_grid(const escdf_grid_scala
         FULFILL_OR_RETURN(scalarfield->use_default_ordering.is_set &&
                           scalarfield->use_default_ordering.value, ESCDF_EUNINIT);
     }
-    
-    if ((loc_id = H5Gopen(file_id->group_id, scalarfield->path, H5P_DEFAULT)) < 0) {
-        RETURN_WITH_ERROR(loc_id);
-    }
 
-    /* Write buf in dataset "values_on_grid". */
-    if ((err = _get_values_on_grid(scalarfield, loc_id, &dtset_id)) != ESCDF_SUCCESS) {
-        H5Gclose(loc_id);
-        return err;
+    return ESCDF_SUCCESS;
+}
+
+/* Open the data sets of n writes, values_on_grid and grid_ordering when a
+   lookup table is given, and write them all in a single transfer. */
+static escdf_errno_t _write_values_on_grid_multi(escdf_handle_t *file_id,
+                                                 const escdf_grid_scalarfield_write_t *writes,
+                                                 const size_t n)
+{
+    escdf_errno_t err;
+    hid_t loc_id, *dtset_ids, *mem_type_ids;
+    const void **bufs;
+    const hsize_t **starts, **counts, **strides;
+    const escdf_grid_scalarfield_write_t *w;
+    hsize_t len;
+    size_t i, m;
+    unsigned int j;
+
+    /* The cached blocks go stale. */
+    for (i = 0; i < n; i++) {
+        _cache_invalidate(writes[i].scalarfield);
     }
-    if ((err = utils_hdf5_write_dataset(dtset_id, file_id->transfer_mode,
-                                        buf, H5T_NATIVE_DOUBLE,
-                                        start, count, stride)) != ESCDF_SUCCESS) {
-        H5Dclose(dtset_id);
-        H5Gclose(loc_id);
-        return err;
+
+    /* At most two data sets per write. */
+    dtset_ids = malloc(sizeof(hid_t) * 2 * n);
+    mem_type_ids = malloc(sizeof(hid_t) * 2 * n);
+    bufs = malloc(sizeof(void*) * 2 * n);
+    starts = malloc(sizeof(hsize_t*) * 2 * n);
+    counts = malloc(sizeof(hsize_t*) * 2 * n);
+    strides = malloc(sizeof(hsize_t*) * 2 * n);
+    if (!dtset_ids || !mem_type_ids || !bufs || !starts || !counts || !strides) {
+        err = ESCDF_ENOMEM;
+        DEFER_FUNC_ERROR(err);
+        m = 0;
+        goto cleanup;
     }
-    H5Dclose(dtset_id);
 
-    /* Write the lookup table. */
-    if (tbl != NULL) {
-        len = scalarfield->number_of_grid_points[0];
-        for (i = 1; i < scalarfield->cell.number_of_physical_dimensions.value; i++) {
-            len *= scalarfield->number_of_grid_points[i];
+    err = ESCDF_SUCCESS;
+    for (i = 0, m = 0; i < n && err == ESCDF_SUCCESS; i++) {
+        w = writes + i;
+        if ((loc_id = H5Gopen(file_id->group_id, w->scalarfield->path, H5P_DEFAULT)) < 0) {
+            DEFER_FUNC_ERROR(loc_id);
+            err = ESCDF_ERROR;
+            break;
         }
+        utils_stats_count_open();
 
-        if ((err = utils_hdf5_check_dtset(loc_id, "grid_ordering",
-                                          &len, 1, &dtset_id)) != ESCDF_SUCCESS) {
+        /* Values in dataset "values_on_grid". */
+        if ((err = _get_values_on_grid(w->scalarfield, loc_id, dtset_ids + m)) != ESCDF_SUCCESS) {
             H5Gclose(loc_id);
+            break;
+        }
+        mem_type_ids[m] = H5T_NATIVE_DOUBLE;
+        bufs[m] = w->buf;
+        starts[m] = w->start;
+        counts[m] = w->count;
+        strides[m] = w->stride;
+        m += 1;
+
+        /* The lookup table, for the grid points only. */
+        if (w->tbl != NULL) {
+            len = w->scalarfield->number_of_grid_points[0];
+            for (j = 1; j < w->scalarfield->cell.number_of_physical_dimensions.value; j++) {
+                len *= w->scalarfield->number_of_grid_points[j];
+            }
+            if ((err = utils_hdf5_check_dtset(loc_id, "grid_ordering",
+                                              &len, 1, dtset_ids + m)) != ESCDF_SUCCESS) {
+                H5Gclose(loc_id);
+                break;
+            }
+            mem_type_ids[m] = H5T_NATIVE_UINT;
+            bufs[m] = w->tbl;
+            starts[m] = (w->start) ? w->start + 1 : NULL;
+            counts[m] = (w->count) ? w->count + 1 : NULL;
+            strides[m] = (w->stride) ? w->stride + 1 : NULL;
+            m += 1;
+        }
+        H5Gclose(loc_id);
+    }
+
+    if (err == ESCDF_SUCCESS) {
+        err = utils_hdf5_write_datasets(m, dtset_ids, file_id->transfer_mode, bufs,
+                                        mem_type_ids, starts, counts, strides);
+    }
+
+    cleanup:
+    for (i = 0; i < m; i++) {
+        H5Dclose(dtset_ids[i]);
+    }
+    free(dtset_ids);
+    free(mem_type_ids);
+    free(bufs);
+    free(starts);
+    free(counts);
+    free(strides);
+    return err;
+}
+
+static escdf_errno_t _write_values_on_grid(const escdf_grid_scalarfield_t *scalarfield,
+                                           escdf_handle_t *file_id,
+                                           const double *buf,
+                                           const unsigned int *tbl,
+                                           const hsize_t *start,
+                                           const hsize_t *count,
+                                           const hsize_t *stride)
+{
+    escdf_grid_scalarfield_write_t write;
+
+    write.scalarfield = scalarfield;
+    write.buf = buf;
+    write.tbl = tbl;
+    write.start = start;
+    write.count = count;
+    write.stride = stride;
+
+    return _write_values_on_grid_multi(file_id, &write, 1);
+}
+
+escdf_errno_t escdf_grid_scalarfield_write_values_on_grid(const escdf_grid_scalarfield_t *scalarfield,
+                                                          escdf_handle_t *file_id,
+                                                          const double *buf,
+                                                          const unsigned int *tbl,
+                                                          const hsize_t *start,
+                                                          const hsize_t *count,
+                                                          const hsize_t *stride)
+{
+    escdf_errno_t err;
+    utils_stats_timer_t timer;
+    _statistics_t stats;
+
+    if ((err = _check_write(scalarfield, tbl)) != ESCDF_SUCCESS)
+        return err;
+
+    utils_stats_start(file_id, &timer);
+    /* The statistics are computed outside of the HDF5 lock. */
+    if (scalarfield->write_statistics) {
+        if ((err = _statistics_init(scalarfield, &stats)) != ESCDF_SUCCESS) {
+            utils_stats_stop(file_id, &timer, ESCDF_STATS_WRITE_DATA);
             return err;
         }
+        _statistics_of_write(scalarfield, buf, start, count, stride, &stats);
+    }
+    utils_hdf5_lock();
+    err = _write_values_on_grid(scalarfield, file_id, buf, tbl, start, count, stride);
+    utils_hdf5_unlock();
+    if (scalarfield->write_statistics) {
+        err = _record_statistics(scalarfield, file_id, &stats, err);
+        _statistics_free(&stats);
+    }
+    utils_stats_stop(file_id, &timer, ESCDF_STATS_WRITE_DATA);
 
-        /* Actual write action. */
-        if ((err = utils_hdf5_write_dataset(dtset_id, file_id->transfer_mode,
-                                            tbl, H5T_NATIVE_INT,
-                                            (start) ? start + 1 : NULL,
-                                            (count) ? count + 1 : NULL,
-                                            (stride) ? stride + 1 : NULL)) != ESCDF_SUCCESS) {
-            H5Dclose(dtset_id);
-            H5Gclose(loc_id);
+    return err;
+}
+
+escdf_errno_t escdf_grid_scalarfield_write_values_on_grid_multi(escdf_handle_t *file_id,
+                                                                const escdf_grid_scalarfield_write_t *writes,
+                                                                const size_t n)
+{
+    escdf_errno_t err;
+    utils_stats_timer_t timer;
+    _statistics_t *stats;
+    size_t i;
+
+    FULFILL_OR_RETURN(writes != NULL || n == 0, ESCDF_EOBJECT);
+    for (i = 0; i < n; i++) {
+        if ((err = _check_write(writes[i].scalarfield, writes[i].tbl)) != ESCDF_SUCCESS)
             return err;
+    }
+    if (n == 0)
+        return ESCDF_SUCCESS;
+
+    stats = calloc(n, sizeof(_statistics_t));
+    FULFILL_OR_RETURN(stats != NULL, ESCDF_ENOMEM);
+
+    utils_stats_start(file_id, &timer);
+    err = ESCDF_SUCCESS;
+    for (i = 0; i < n && err == ESCDF_SUCCESS; i++) {
+        if (writes[i].scalarfield->write_statistics &&
+            (err = _statistics_init(writes[i].scalarfield, stats + i)) == ESCDF_SUCCESS) {
+            _statistics_of_write(writes[i].scalarfield, writes[i].buf, writes[i].start,
+                                 writes[i].count, writes[i].stride, stats + i);
+        }
+    }
+    if (err == ESCDF_SUCCESS) {
+        utils_hdf5_lock();
+        err = _write_values_on_grid_multi(file_id, writes, n);
+        utils_hdf5_unlock();
+        for (i = 0; i < n; i++) {
+            if (writes[i].scalarfield->write_statistics) {
+                err = _record_statistics(writes[i].scalarfield, file_id, stats + i, err);
+            }
+        }
+    }
+    for (i = 0; i < n; i++) {
+        if (stats[i].counts != NULL) {
+            _statistics_free(stats + i);
         }
-        H5Dclose(dtset_id);
     }
+    free(stats);
+    utils_stats_stop(file_id, &timer, ESCDF_STATS_WRITE_DATA);
 
-    H5Gclose(loc_id);
-    return ESCDF_SUCCESS;
+    return err;
 }
 
 /**
@@ -798,23 +2224,19 @@ escdf_errno_t escdf_grid_scalarfield_write_values_on_grid_sliced(const escdf_gri
         (scalarfield, file_id, buf, tbl, start, count, NULL);
 }
 
-escdf_errno_t escdf_grid_scalarfield_read_values_on_grid(const escdf_grid_scalarfield_t *scalarfield,
-                                                         escdf_handle_t *file_id, double *buf,
-                                                         const hsize_t *start,
-                                                         const hsize_t *count,
-                                                         const hsize_t *stride)
+static escdf_errno_t _read_values_on_grid(const escdf_grid_scalarfield_t *scalarfield,
+                                          escdf_handle_t *file_id, double *buf,
+                                          const hsize_t *start,
+                                          const hsize_t *count,
+                                          const hsize_t *stride)
 {
     escdf_errno_t err;
     hid_t dtset_id, loc_id;
 
-    FULFILL_OR_RETURN(scalarfield, ESCDF_EOBJECT);
-    FULFILL_OR_RETURN(scalarfield->number_of_components.is_set, ESCDF_EUNINIT);
-    FULFILL_OR_RETURN(scalarfield->number_of_grid_points, ESCDF_EUNINIT);
-    FULFILL_OR_RETURN(scalarfield->real_or_complex.is_set, ESCDF_EUNINIT);
-    
     if ((loc_id = H5Gopen(file_id->group_id, scalarfield->path, H5P_DEFAULT)) < 0) {
         RETURN_WITH_ERROR(loc_id);
     }
+    utils_stats_count_open();
     
     if ((err = _get_values_on_grid(scalarfield, loc_id, &dtset_id)) != ESCDF_SUCCESS) {
         H5Gclose(loc_id);
@@ -832,11 +2254,42 @@ escdf_errno_t escdf_grid_scalarfield_read_values_on_grid(const escdf_grid_scalar
     H5Gclose(loc_id);
     return ESCDF_SUCCESS;
 }
-escdf_errno_t escdf_grid_scalarfield_read_values_on_grid_sliced(const escdf_grid_scalarfield_t *scalarfield,
-                                                                escdf_handle_t *file_id,
-                                                                double *buf,
-                                                                const unsigned int *tbl,
-                                                                const hsize_t len)
+
+escdf_errno_t escdf_grid_scalarfield_read_values_on_grid(const escdf_grid_scalarfield_t *scalarfield,
+                                                         escdf_handle_t *file_id, double *buf,
+                                                         const hsize_t *start,
+                                                         const hsize_t *count,
+                                                         const hsize_t *stride)
+{
+    escdf_errno_t err;
+    utils_stats_timer_t timer;
+
+    FULFILL_OR_RETURN(scalarfield, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(scalarfield->number_of_components.is_set, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->number_of_grid_points, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->real_or_complex.is_set, ESCDF_EUNINIT);
+
+    utils_stats_start(file_id, &timer);
+    utils_hdf5_lock();
+    err = _read_values_on_grid(scalarfield, file_id, buf, start, count, stride);
+    utils_hdf5_unlock();
+    utils_stats_stop(file_id, &timer, ESCDF_STATS_READ_DATA);
+
+    return err;
+}
+
+static void _close_group(hid_t loc_id)
+{
+    utils_hdf5_lock();
+    H5Gclose(loc_id);
+    utils_hdf5_unlock();
+}
+
+static escdf_errno_t _read_values_on_grid_sliced(const escdf_grid_scalarfield_t *scalarfield,
+                                                 escdf_handle_t *file_id,
+                                                 double *buf,
+                                                 const unsigned int *tbl,
+                                                 const hsize_t len)
 {
     escdf_errno_t err;
     hid_t loc_id;
@@ -851,19 +2304,26 @@ escdf_errno_t escdf_grid_scalarfield_read_values_on_grid_sliced(const escdf_grid
     FULFILL_OR_RETURN(scalarfield->number_of_grid_points, ESCDF_EUNINIT);
     FULFILL_OR_RETURN(scalarfield->real_or_complex.is_set, ESCDF_EUNINIT);
     
-    if ((loc_id = H5Gopen(file_id->group_id, scalarfield->path, H5P_DEFAULT)) < 0) {
+    utils_hdf5_lock();
+    loc_id = H5Gopen(file_id->group_id, scalarfield->path, H5P_DEFAULT);
+    utils_hdf5_unlock();
+    if (loc_id < 0) {
         RETURN_WITH_ERROR(loc_id);
     }
+    utils_stats_count_open();
 
     if ((err = _get_g2d(scalarfield, loc_id, &g2d)) != ESCDF_SUCCESS) {
-        H5Gclose(loc_id);
+        _close_group(loc_id);
         return err;
     }
         
     if (tbl && g2d) {
         /* Case where ask for a disordered subset of points in a
            disordered storage. */
-        indirect = malloc(sizeof(hsize_t) * len);
+        indirect = malloc(sizeof(unsigned int) * len);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
         for (i = 0; i < len; i++) {
             indirect[i] = g2d[tbl[i]];
         }
@@ -871,7 +2331,7 @@ escdf_errno_t escdf_grid_scalarfield_read_values_on_grid_sliced(const escdf_grid
         if ((err = _read_at(scalarfield, file_id, loc_id,
                             buf, indirect, len)) != ESCDF_SUCCESS) {
             free(indirect);
-            H5Gclose(loc_id);
+            _close_group(loc_id);
             return err;
         }
         free(indirect);
@@ -880,7 +2340,7 @@ escdf_errno_t escdf_grid_scalarfield_read_values_on_grid_sliced(const escdf_grid
            ordered storage. */
         if ((err = _read_at(scalarfield, file_id, loc_id,
                             buf, tbl, len)) != ESCDF_SUCCESS) {
-            H5Gclose(loc_id);
+            _close_group(loc_id);
             return err;
         }
     } else if (!tbl && g2d) {
@@ -891,11 +2351,14 @@ escdf_errno_t escdf_grid_scalarfield_read_values_on_grid_sliced(const escdf_grid
                                          scalarfield->number_of_grid_points,
                                          len)) != ESCDF_SUCCESS) {
             free(g2d);
-            H5Gclose(loc_id);
+            _close_group(loc_id);
             return err;
         }
 
-        indirect = malloc(sizeof(hsize_t) * len);
+        indirect = malloc(sizeof(unsigned int) * len);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
         for (i = 0; i < len; i++) {
             indirect[i] = g2d[goffset + i];
         }
@@ -904,7 +2367,7 @@ escdf_errno_t escdf_grid_scalarfield_read_values_on_grid_sliced(const escdf_grid
         if ((err = _read_at(scalarfield, file_id, loc_id,
                             buf, indirect, len)) != ESCDF_SUCCESS) {
             free(indirect);
-            H5Gclose(loc_id);
+            _close_group(loc_id);
             return err;
         }
         free(indirect);
@@ -921,21 +2384,2098 @@ escdf_errno_t escdf_grid_scalarfield_read_values_on_grid_sliced(const escdf_grid
         if ((err = _get_proc_grid_offset
              (&start[1], file_id, scalarfield->cell.number_of_physical_dimensions.value,
               scalarfield->number_of_grid_points, len)) != ESCDF_SUCCESS) {
-            H5Gclose(loc_id);
+            _close_group(loc_id);
             return err;
         }
 
         if ((err = escdf_grid_scalarfield_read_values_on_grid
              (scalarfield, file_id, buf, start, count, NULL)) != ESCDF_SUCCESS) {
-            H5Gclose(loc_id);
+            _close_group(loc_id);
             return err;
         }
     }
     
-    H5Gclose(loc_id);
+    _close_group(loc_id);
     return ESCDF_SUCCESS;
 }
 
+escdf_errno_t escdf_grid_scalarfield_read_values_on_grid_sliced(const escdf_grid_scalarfield_t *scalarfield,
+                                                                escdf_handle_t *file_id,
+                                                                double *buf,
+                                                                const unsigned int *tbl,
+                                                                const hsize_t len)
+{
+    escdf_errno_t err;
+    utils_stats_timer_t timer;
+
+    utils_stats_start(file_id, &timer);
+    err = _read_values_on_grid_sliced(scalarfield, file_id, buf, tbl, len);
+    utils_stats_stop(file_id, &timer, ESCDF_STATS_READ_DATA);
+
+    return err;
+}
+
+static escdf_errno_t _map_values_on_grid(escdf_grid_scalarfield_t *scalarfield,
+                                         escdf_handle_t *file_id,
+                                         const double **values)
+{
+    escdf_errno_t err;
+    hid_t dtset_id, loc_id;
+    const void *buf;
+
+    if ((loc_id = H5Gopen(file_id->group_id, scalarfield->path, H5P_DEFAULT)) < 0) {
+        RETURN_WITH_ERROR(loc_id);
+    }
+    utils_stats_count_open();
+
+    if ((err = _get_values_on_grid(scalarfield, loc_id, &dtset_id)) != ESCDF_SUCCESS) {
+        H5Gclose(loc_id);
+        return err;
+    }
+    err = utils_hdf5_map_dataset(dtset_id, H5T_NATIVE_DOUBLE,
+                                 &scalarfield->map_addr, &scalarfield->map_len,
+                                 &buf);
+    H5Dclose(dtset_id);
+    H5Gclose(loc_id);
+    if (err == ESCDF_SUCCESS)
+        *values = buf;
+
+    return err;
+}
+
+escdf_errno_t escdf_grid_scalarfield_map_values_on_grid(escdf_grid_scalarfield_t *scalarfield,
+                                                        escdf_handle_t *file_id,
+                                                        const double **values)
+{
+    escdf_errno_t err;
+    utils_stats_timer_t timer;
+
+    FULFILL_OR_RETURN(scalarfield, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(file_id, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(values, ESCDF_EVALUE);
+    *values = NULL;
+    escdf_grid_scalarfield_unmap_values_on_grid(scalarfield);
+    FULFILL_OR_RETURN(scalarfield->number_of_components.is_set, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->number_of_grid_points, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->real_or_complex.is_set, ESCDF_EUNINIT);
+#ifdef HAVE_MPI
+    /* Each rank would map the whole data set. */
+    FULFILL_OR_RETURN(file_id->mpi_size == 1, ESCDF_ENOSUPPORT);
+#endif
+
+    utils_stats_start(file_id, &timer);
+    utils_hdf5_lock();
+    err = _map_values_on_grid(scalarfield, file_id, values);
+    utils_hdf5_unlock();
+    utils_stats_stop(file_id, &timer, ESCDF_STATS_READ_DATA);
+
+    return err;
+}
+
+void escdf_grid_scalarfield_unmap_values_on_grid(escdf_grid_scalarfield_t *scalarfield)
+{
+    if (!scalarfield || !scalarfield->map_addr)
+        return;
+
+    utils_hdf5_unmap(scalarfield->map_addr, scalarfield->map_len);
+    scalarfield->map_addr = NULL;
+    scalarfield->map_len = 0;
+}
+
+/**************************/
+/* Chunk-level accessors. */
+/**************************/
+typedef struct {
+    hid_t loc_id, dtset_id;
+    hsize_t npts, chunk_len; /* grid points in total and per chunk */
+    hsize_t nchunks; /* chunks per component in the range */
+    unsigned int ncomp, rc;
+    unsigned int deflate_level;
+} _chunks_t;
+
+/* Open values_on_grid and check whether the range [start, start + count) of
+   grid points can be accessed chunk by chunk. On success, the group and the
+   data set are left open; *direct is false when the regular data set I/O
+   has to be used instead. Must be called with the HDF5 lock. */
+static escdf_errno_t _open_chunks(const escdf_grid_scalarfield_t *scalarfield,
+                                  escdf_handle_t *file_id,
+                                  const hsize_t start, const hsize_t count,
+                                  _chunks_t *chunks, bool *direct)
+{
+    escdf_errno_t err;
+    hsize_t chunk[3];
+    unsigned int i;
+
+    chunks->ncomp = scalarfield->number_of_components.value;
+    chunks->rc = scalarfield->real_or_complex.value;
+    chunks->npts = scalarfield->number_of_grid_points[0];
+    for (i = 1; i < scalarfield->cell.number_of_physical_dimensions.value; i++) {
+        chunks->npts *= scalarfield->number_of_grid_points[i];
+    }
+    FULFILL_OR_RETURN(start + count <= chunks->npts, ESCDF_ESIZE);
+
+    if ((chunks->loc_id = H5Gopen(file_id->group_id, scalarfield->path, H5P_DEFAULT)) < 0) {
+        RETURN_WITH_ERROR(chunks->loc_id);
+    }
+    utils_stats_count_open();
+    if ((err = _get_values_on_grid(scalarfield, chunks->loc_id, &chunks->dtset_id)) != ESCDF_SUCCESS) {
+        H5Gclose(chunks->loc_id);
+        return err;
+    }
+
+    /* Chunks must hold whole grid points, for one component, and the range
+       must be made of whole chunks. */
+    *direct = file_id->mpi_size == 1 && count > 0 &&
+        utils_hdf5_direct_chunks(chunks->dtset_id, H5T_NATIVE_DOUBLE, chunk, 3,
+                                 &chunks->deflate_level) &&
+        chunk[0] == 1 && chunk[2] == chunks->rc &&
+        start % chunk[1] == 0 &&
+        (count % chunk[1] == 0 || start + count == chunks->npts);
+    if (*direct) {
+        chunks->chunk_len = chunk[1];
+        chunks->nchunks = (count + chunk[1] - 1) / chunk[1];
+    }
+
+    return ESCDF_SUCCESS;
+}
+
+static void _close_chunks(_chunks_t *chunks)
+{
+    utils_hdf5_lock();
+    H5Dclose(chunks->dtset_id);
+    H5Gclose(chunks->loc_id);
+    utils_hdf5_unlock();
+}
+
+/* Copy the values of chunk ichunk (component ichunk / nchunks) between buf,
+   laid out as [ncomp][count][rc], and a full chunk, zero padded. */
+static void _pack_chunk(const _chunks_t *chunks, hsize_t count, hsize_t ichunk,
+                        const double *buf, double *chunk)
+{
+    hsize_t icomp, k, len;
+
+    icomp = ichunk / chunks->nchunks;
+    k = (ichunk % chunks->nchunks) * chunks->chunk_len;
+    len = (k + chunks->chunk_len <= count) ? chunks->chunk_len : count - k;
+    memcpy(chunk, buf + (icomp * count + k) * chunks->rc, sizeof(double) * len * chunks->rc);
+    if (len < chunks->chunk_len) {
+        memset(chunk + len * chunks->rc, 0,
+               sizeof(double) * (chunks->chunk_len - len) * chunks->rc);
+    }
+}
+
+static void _unpack_chunk(const _chunks_t *chunks, hsize_t count, hsize_t ichunk,
+                          const double *chunk, double *buf)
+{
+    hsize_t icomp, k, len;
+
+    icomp = ichunk / chunks->nchunks;
+    k = (ichunk % chunks->nchunks) * chunks->chunk_len;
+    len = (k + chunks->chunk_len <= count) ? chunks->chunk_len : count - k;
+    memcpy(buf + (icomp * count + k) * chunks->rc, chunk, sizeof(double) * len * chunks->rc);
+}
+
+static void _chunk_offset(const _chunks_t *chunks, hsize_t start, hsize_t ichunk,
+                          hsize_t *offset)
+{
+    offset[0] = ichunk / chunks->nchunks;
+    offset[1] = start + (ichunk % chunks->nchunks) * chunks->chunk_len;
+    offset[2] = 0;
+}
+
+static escdf_errno_t _write_values_on_grid_chunks(const escdf_grid_scalarfield_t *scalarfield,
+                                                  escdf_handle_t *file_id,
+                                                  const double *buf,
+                                                  const hsize_t start,
+                                                  const hsize_t count)
+{
+    escdf_errno_t err;
+    _chunks_t chunks;
+    bool direct;
+    hsize_t start3[3], count3[3], offset[3];
+    hsize_t i, n;
+    size_t raw, *sizes;
+    unsigned char **data;
+    int nomem, failed;
+
+    utils_hdf5_lock();
+    err = _open_chunks(scalarfield, file_id, start, count, &chunks, &direct);
+    utils_hdf5_unlock();
+    FULFILL_OR_RETURN(err == ESCDF_SUCCESS, err);
+
+    if (!direct) {
+        _close_chunks(&chunks);
+        start3[0] = 0;
+        start3[1] = start;
+        start3[2] = 0;
+        count3[0] = chunks.ncomp;
+        count3[1] = count;
+        count3[2] = chunks.rc;
+        utils_hdf5_lock();
+        err = _write_values_on_grid(scalarfield, file_id, buf, NULL, start3, count3, NULL);
+        utils_hdf5_unlock();
+        return err;
+    }
+
+    /* Filter the chunks in parallel, outside of the HDF5 lock. */
+    n = chunks.ncomp * chunks.nchunks;
+    raw = sizeof(double) * chunks.chunk_len * chunks.rc;
+    data = calloc(n, sizeof(unsigned char*));
+    sizes = malloc(sizeof(size_t) * n);
+    if (data == NULL || sizes == NULL) {
+        free(data);
+        free(sizes);
+        _close_chunks(&chunks);
+        RETURN_WITH_ERROR(ESCDF_ENOMEM);
+    }
+    nomem = 0;
+    failed = 0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) reduction(||:nomem, failed)
+#endif
+    for (i = 0; i < n; i++) {
+        double *chunk;
+#ifdef HAVE_ZLIB
+        uLongf len;
+#endif
+
+        chunk = malloc(raw);
+        if (chunk == NULL) {
+            nomem = 1;
+            continue;
+        }
+        _pack_chunk(&chunks, count, i, buf, chunk);
+        if (chunks.deflate_level == 0) {
+            data[i] = (unsigned char*)chunk;
+            sizes[i] = raw;
+            continue;
+        }
+#ifdef HAVE_ZLIB
+        len = compressBound((uLong)raw);
+        data[i] = malloc(len);
+        if (data[i] == NULL) {
+            nomem = 1;
+        } else if (compress2(data[i], &len, (const Bytef*)chunk, (uLong)raw,
+                             (int)chunks.deflate_level) != Z_OK) {
+            failed = 1;
+        }
+        sizes[i] = (size_t)len;
+#endif
+        free(chunk);
+    }
+
+    err = (nomem) ? ESCDF_ENOMEM : (failed) ? ESCDF_ERROR : ESCDF_SUCCESS;
+    utils_hdf5_lock();
+    _cache_invalidate(scalarfield);
+    for (i = 0; i < n && err == ESCDF_SUCCESS; i++) {
+        _chunk_offset(&chunks, start, i, offset);
+        err = utils_hdf5_write_chunk(chunks.dtset_id, file_id->transfer_mode,
+                                     offset, data[i], sizes[i]);
+    }
+    utils_hdf5_unlock();
+    if (err == ESCDF_SUCCESS && utils_stats_recording()) {
+        utils_stats_count_bytes(H5T_NATIVE_DOUBLE, (hsize_t)chunks.ncomp * count * chunks.rc);
+    }
+
+    for (i = 0; i < n; i++) {
+        free(data[i]);
+    }
+    free(data);
+    free(sizes);
+    _close_chunks(&chunks);
+    FULFILL_OR_RETURN(err == ESCDF_SUCCESS, err);
+
+    return ESCDF_SUCCESS;
+}
+
+escdf_errno_t escdf_grid_scalarfield_write_values_on_grid_chunks(const escdf_grid_scalarfield_t *scalarfield,
+                                                                 escdf_handle_t *file_id,
+                                                                 const double *buf,
+                                                                 const hsize_t start,
+                                                                 const hsize_t count)
+{
+    escdf_errno_t err;
+    utils_stats_timer_t timer;
+    _statistics_t stats;
+    hsize_t start3[3], count3[3];
+
+    FULFILL_OR_RETURN(scalarfield, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(scalarfield->cell.number_of_physical_dimensions.is_set, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->number_of_components.is_set, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->number_of_grid_points, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->real_or_complex.is_set, ESCDF_EUNINIT);
+
+    utils_stats_start(file_id, &timer);
+    if (scalarfield->write_statistics) {
+        if ((err = _statistics_init(scalarfield, &stats)) != ESCDF_SUCCESS) {
+            utils_stats_stop(file_id, &timer, ESCDF_STATS_WRITE_DATA);
+            return err;
+        }
+        start3[0] = 0;
+        start3[1] = start;
+        start3[2] = 0;
+        count3[0] = stats.ncomp;
+        count3[1] = count;
+        count3[2] = stats.rc;
+        _statistics_of_write(scalarfield, buf, start3, count3, NULL, &stats);
+    }
+    err = _write_values_on_grid_chunks(scalarfield, file_id, buf, start, count);
+    if (scalarfield->write_statistics) {
+        err = _record_statistics(scalarfield, file_id, &stats, err);
+        _statistics_free(&stats);
+    }
+    utils_stats_stop(file_id, &timer, ESCDF_STATS_WRITE_DATA);
+
+    return err;
+}
+
+static escdf_errno_t _read_values_on_grid_chunks(const escdf_grid_scalarfield_t *scalarfield,
+                                                 escdf_handle_t *file_id,
+                                                 double *buf,
+                                                 const hsize_t start,
+                                                 const hsize_t count)
+{
+    escdf_errno_t err;
+    _chunks_t chunks;
+    bool direct;
+    hsize_t start3[3], count3[3], offset[3];
+    hsize_t i, n;
+    size_t raw, *sizes;
+    void **data;
+    int nomem, failed;
+
+    utils_hdf5_lock();
+    err = _open_chunks(scalarfield, file_id, start, count, &chunks, &direct);
+    utils_hdf5_unlock();
+    FULFILL_OR_RETURN(err == ESCDF_SUCCESS, err);
+
+    if (!direct) {
+        _close_chunks(&chunks);
+        start3[0] = 0;
+        start3[1] = start;
+        start3[2] = 0;
+        count3[0] = chunks.ncomp;
+        count3[1] = count;
+        count3[2] = chunks.rc;
+        utils_hdf5_lock();
+        err = _read_values_on_grid(scalarfield, file_id, buf, start3, count3, NULL);
+        utils_hdf5_unlock();
+        return err;
+    }
+
+    n = chunks.ncomp * chunks.nchunks;
+    raw = sizeof(double) * chunks.chunk_len * chunks.rc;
+    data = calloc(n, sizeof(void*));
+    sizes = calloc(n, sizeof(size_t));
+    if (data == NULL || sizes == NULL) {
+        free(data);
+        free(sizes);
+        _close_chunks(&chunks);
+        RETURN_WITH_ERROR(ESCDF_ENOMEM);
+    }
+
+    /* Read the filtered chunks, then unfilter them in parallel, outside of
+       the HDF5 lock. */
+    err = ESCDF_SUCCESS;
+    utils_hdf5_lock();
+    for (i = 0; i < n && err == ESCDF_SUCCESS; i++) {
+        _chunk_offset(&chunks, start, i, offset);
+        err = utils_hdf5_read_chunk(chunks.dtset_id, file_id->transfer_mode,
+                                    offset, data + i, sizes + i);
+    }
+    utils_hdf5_unlock();
+
+    nomem = 0;
+    failed = 0;
+    if (err == ESCDF_SUCCESS) {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) reduction(||:nomem, failed)
+#endif
+        for (i = 0; i < n; i++) {
+            double *chunk;
+#ifdef HAVE_ZLIB
+            uLongf len;
+#endif
+
+            if (data[i] == NULL) {
+                /* Unwritten chunks hold the fill value, zero. */
+                if ((chunk = calloc(1, raw)) == NULL) {
+                    nomem = 1;
+                } else {
+                    _unpack_chunk(&chunks, count, i, chunk, buf);
+                    free(chunk);
+                }
+                continue;
+            }
+            if (chunks.deflate_level == 0) {
+                if (sizes[i] != raw) {
+                    failed = 1;
+                } else {
+                    _unpack_chunk(&chunks, count, i, data[i], buf);
+                }
+                continue;
+            }
+#ifdef HAVE_ZLIB
+            chunk = malloc(raw);
+            len = (uLongf)raw;
+            if (chunk == NULL) {
+                nomem = 1;
+            } else if (uncompress((Bytef*)chunk, &len, data[i], (uLong)sizes[i]) != Z_OK ||
+                       len != raw) {
+                failed = 1;
+            } else {
+                _unpack_chunk(&chunks, count, i, chunk, buf);
+            }
+            free(chunk);
+#endif
+        }
+        if (nomem) {
+            DEFER_FUNC_ERROR(ESCDF_ENOMEM);
+            err = ESCDF_ENOMEM;
+        } else if (failed) {
+            DEFER_FUNC_ERROR(ESCDF_EFILE_CORRUPT);
+            err = ESCDF_EFILE_CORRUPT;
+        } else if (utils_stats_recording()) {
+            utils_stats_count_bytes(H5T_NATIVE_DOUBLE, (hsize_t)chunks.ncomp * count * chunks.rc);
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        free(data[i]);
+    }
+    free(data);
+    free(sizes);
+    _close_chunks(&chunks);
+    FULFILL_OR_RETURN(err == ESCDF_SUCCESS, err);
+
+    return ESCDF_SUCCESS;
+}
+
+escdf_errno_t escdf_grid_scalarfield_read_values_on_grid_chunks(const escdf_grid_scalarfield_t *scalarfield,
+                                                                escdf_handle_t *file_id,
+                                                                double *buf,
+                                                                const hsize_t start,
+                                                                const hsize_t count)
+{
+    escdf_errno_t err;
+    utils_stats_timer_t timer;
+
+    FULFILL_OR_RETURN(scalarfield, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(scalarfield->cell.number_of_physical_dimensions.is_set, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->number_of_components.is_set, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->number_of_grid_points, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->real_or_complex.is_set, ESCDF_EUNINIT);
+
+    utils_stats_start(file_id, &timer);
+    err = _read_values_on_grid_chunks(scalarfield, file_id, buf, start, count);
+    utils_stats_stop(file_id, &timer, ESCDF_STATS_READ_DATA);
+
+    return err;
+}
+
+/***************/
+/* Reductions. */
+/***************/
+
+/* Number of grid points read at once by the reductions, rounded to whole
+   chunks, and reduced per OpenMP iteration. */
+#define REDUCTION_BLOCK_SIZE (256 * 1024)
+#define REDUCTION_TILE_SIZE 4096
+
+typedef struct {
+    double sum, sum_abs, sum_sq;
+    double minimum, maximum;
+    double moment[3]; /* sums of f times the fractional coordinates */
+} _partial_t;
+
+/* Reduces a row of values, with g1 the index along the first dimension of
+   the first one: its moment is the sum of f times the index. */
+static void _reduce_row(const double *values, hsize_t len, hsize_t g1,
+                        _partial_t *row, double *moment)
+{
+    double s, sa, sq, sg, mn, mx;
+    hsize_t i;
+
+    s = sa = sq = sg = 0.;
+    mn = HUGE_VAL;
+    mx = -HUGE_VAL;
+#ifdef _OPENMP
+#pragma omp simd reduction(+:s,sa,sq,sg) reduction(min:mn) reduction(max:mx)
+#endif
+    for (i = 0; i < len; i++) {
+        s += values[i];
+        sa += fabs(values[i]);
+        sq += values[i] * values[i];
+        sg += (double)i * values[i];
+        mn = (values[i] < mn) ? values[i] : mn;
+        mx = (values[i] > mx) ? values[i] : mx;
+    }
+    row->sum = s;
+    row->sum_abs = sa;
+    row->sum_sq = sq;
+    row->minimum = mn;
+    row->maximum = mx;
+    *moment = sg + (double)g1 * s;
+}
+
+/* Decomposes a grid point index, the first dimension running fastest. */
+static void _grid_coordinates(hsize_t g, unsigned int ndims, const unsigned int *ngrid,
+                              hsize_t *coord)
+{
+    unsigned int d;
+
+    for (d = 0; d < 3; d++) {
+        coord[d] = 0;
+    }
+    for (d = 0; d < ndims; d++) {
+        coord[d] = g % ngrid[d];
+        g /= ngrid[d];
+    }
+}
+
+/**
+ * Reduces the values of the grid points [first, first + n) on disk into
+ * partial, with d2g the index of each grid point when not in the default
+ * ordering. The tiles are reduced in parallel, row by row in the default
+ * ordering.
+ */
+static void _reduce_values(const double *values, const unsigned int *d2g,
+                           hsize_t first, hsize_t n, unsigned int ndims,
+                           const unsigned int *ngrid, _partial_t *partial)
+{
+    double sum, sum_abs, sum_sq, mn, mx, m0, m1, m2;
+    long long int t, ntiles;
+
+    sum = sum_abs = sum_sq = m0 = m1 = m2 = 0.;
+    mn = HUGE_VAL;
+    mx = -HUGE_VAL;
+    ntiles = (long long int)((n + REDUCTION_TILE_SIZE - 1) / REDUCTION_TILE_SIZE);
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:sum,sum_abs,sum_sq,m0,m1,m2) reduction(min:mn) reduction(max:mx)
+#endif
+    for (t = 0; t < ntiles; t++) {
+        _partial_t row;
+        hsize_t i, end, len, coord[3];
+        double moment, v;
+
+        i = (hsize_t)t * REDUCTION_TILE_SIZE;
+        end = (i + REDUCTION_TILE_SIZE < n) ? i + REDUCTION_TILE_SIZE : n;
+        if (d2g != NULL) {
+            for (; i < end; i++) {
+                v = values[i];
+                _grid_coordinates(d2g[i], ndims, ngrid, coord);
+                sum += v;
+                sum_abs += fabs(v);
+                sum_sq += v * v;
+                mn = (v < mn) ? v : mn;
+                mx = (v > mx) ? v : mx;
+                m0 += v * coord[0] / ngrid[0];
+                m1 += (ndims > 1) ? v * coord[1] / ngrid[1] : 0.;
+                m2 += (ndims > 2) ? v * coord[2] / ngrid[2] : 0.;
+            }
+            continue;
+        }
+        while (i < end) {
+            _grid_coordinates(first + i, ndims, ngrid, coord);
+            len = ngrid[0] - coord[0];
+            if (len > end - i) {
+                len = end - i;
+            }
+            _reduce_row(values + i, len, coord[0], &row, &moment);
+            sum += row.sum;
+            sum_abs += row.sum_abs;
+            sum_sq += row.sum_sq;
+            mn = (row.minimum < mn) ? row.minimum : mn;
+            mx = (row.maximum > mx) ? row.maximum : mx;
+            m0 += moment / ngrid[0];
+            m1 += (ndims > 1) ? row.sum * coord[1] / ngrid[1] : 0.;
+            m2 += (ndims > 2) ? row.sum * coord[2] / ngrid[2] : 0.;
+            i += len;
+        }
+    }
+
+    partial->sum += sum;
+    partial->sum_abs += sum_abs;
+    partial->sum_sq += sum_sq;
+    partial->minimum = (mn < partial->minimum) ? mn : partial->minimum;
+    partial->maximum = (mx > partial->maximum) ? mx : partial->maximum;
+    partial->moment[0] += m0;
+    partial->moment[1] += m1;
+    partial->moment[2] += m2;
+}
+
+/* Volume of the cell, from the lattice vectors as rows. */
+static double _cell_volume(const escdf_grid_scalarfield_t *scalarfield)
+{
+    const double *a;
+
+    a = scalarfield->cell.lattice_vectors;
+    switch (scalarfield->cell.number_of_physical_dimensions.value) {
+    case 1:
+        return fabs(a[0]);
+    case 2:
+        return fabs(a[0] * a[3] - a[1] * a[2]);
+    default:
+        return fabs(a[0] * (a[4] * a[8] - a[5] * a[7]) -
+                    a[1] * (a[3] * a[8] - a[5] * a[6]) +
+                    a[2] * (a[3] * a[7] - a[4] * a[6]));
+    }
+}
+
+/* Number of grid points per block, rounded to whole chunks of
+   values_on_grid. Must be called with the HDF5 lock. */
+static hsize_t _reduction_block_size(hid_t dtset_id)
+{
+    hsize_t cdims[3], block;
+    hid_t dcpl_id;
+
+    block = REDUCTION_BLOCK_SIZE;
+    if ((dcpl_id = H5Dget_create_plist(dtset_id)) < 0) {
+        return block;
+    }
+    if (H5Pget_layout(dcpl_id) == H5D_CHUNKED &&
+        H5Pget_chunk(dcpl_id, 3, cdims) == 3 && cdims[1] > 0) {
+        block = (block > cdims[1]) ? (block / cdims[1]) * cdims[1] : cdims[1];
+    }
+    H5Pclose(dcpl_id);
+
+    return block;
+}
+
+static escdf_errno_t _reduce(const escdf_grid_scalarfield_t *scalarfield,
+                             escdf_handle_t *file_id, unsigned int component,
+                             _partial_t *partial, hsize_t *npts)
+{
+    escdf_errno_t err;
+    hid_t loc_id, dtset_id, order_id;
+    hsize_t block, nblocks, ib, ib_end, first, n;
+    hsize_t start[3], count[3];
+    unsigned int ndims, i;
+    unsigned int *d2g;
+    double *values;
+
+    ndims = scalarfield->cell.number_of_physical_dimensions.value;
+    *npts = scalarfield->number_of_grid_points[0];
+    for (i = 1; i < ndims; i++) {
+        *npts *= scalarfield->number_of_grid_points[i];
+    }
+
+    utils_hdf5_lock();
+    if ((loc_id = H5Gopen(file_id->group_id, scalarfield->path, H5P_DEFAULT)) < 0) {
+        utils_hdf5_unlock();
+        RETURN_WITH_ERROR(loc_id);
+    }
+    utils_stats_count_open();
+    if ((err = _get_values_on_grid(scalarfield, loc_id, &dtset_id)) != ESCDF_SUCCESS) {
+        H5Gclose(loc_id);
+        utils_hdf5_unlock();
+        return err;
+    }
+    order_id = -1;
+    if (!scalarfield->use_default_ordering.value &&
+        (err = utils_hdf5_check_dtset(loc_id, "grid_ordering", npts, 1, &order_id)) != ESCDF_SUCCESS) {
+        H5Dclose(dtset_id);
+        H5Gclose(loc_id);
+        utils_hdf5_unlock();
+        return err;
+    }
+    block = _reduction_block_size(dtset_id);
+    utils_hdf5_unlock();
+
+    /* The slab of blocks of this rank. */
+    nblocks = (*npts + block - 1) / block;
+    ib = 0;
+    ib_end = nblocks;
+#ifdef HAVE_MPI
+    if (file_id->mpi_size > 1) {
+        ib = nblocks * file_id->mpi_rank / file_id->mpi_size;
+        ib_end = nblocks * (file_id->mpi_rank + 1) / file_id->mpi_size;
+    }
+#endif
+
+    values = malloc(sizeof(double) * block);
+    d2g = (order_id >= 0) ? malloc(sizeof(unsigned int) * block) : NULL;
+    if (values == NULL || (order_id >= 0 && d2g == NULL)) {
+        DEFER_FUNC_ERROR(ESCDF_ENOMEM);
+        err = ESCDF_ENOMEM;
+        ib_end = ib;
+    }
+
+    /* Independent reads, the ranks not reading the same number of blocks. */
+    for (; ib < ib_end && err == ESCDF_SUCCESS; ib++) {
+        first = ib * block;
+        n = (first + block < *npts) ? block : *npts - first;
+        start[0] = component;
+        start[1] = first;
+        start[2] = 0;
+        count[0] = 1;
+        count[1] = n;
+        count[2] = 1;
+        utils_hdf5_lock();
+        err = utils_hdf5_read_dataset(dtset_id, H5P_DEFAULT, values, H5T_NATIVE_DOUBLE,
+                                      start, count, NULL);
+        if (err == ESCDF_SUCCESS && d2g != NULL) {
+            err = utils_hdf5_read_dataset(order_id, H5P_DEFAULT, d2g, H5T_NATIVE_UINT,
+                                          start + 1, count + 1, NULL);
+        }
+        utils_hdf5_unlock();
+        if (err == ESCDF_SUCCESS) {
+            _reduce_values(values, d2g, first, n, ndims,
+                           scalarfield->number_of_grid_points, partial);
+        }
+    }
+    free(values);
+    free(d2g);
+
+    utils_hdf5_lock();
+    if (order_id >= 0) {
+        H5Dclose(order_id);
+    }
+    H5Dclose(dtset_id);
+    H5Gclose(loc_id);
+    utils_hdf5_unlock();
+
+    return err;
+}
+
+escdf_errno_t escdf_grid_scalarfield_reduce(const escdf_grid_scalarfield_t *scalarfield,
+                                            escdf_handle_t *file_id,
+                                            const unsigned int component,
+                                            escdf_grid_scalarfield_reduction_t *reduction)
+{
+    escdf_errno_t err;
+    utils_stats_timer_t timer;
+    _partial_t partial;
+    hsize_t npts;
+    double dv;
+    unsigned int ndims, c, d;
+#ifdef HAVE_MPI
+    double sums[6], extrema[2];
+    int failed;
+#endif
+
+    FULFILL_OR_RETURN(scalarfield, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(file_id, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(reduction, ESCDF_EVALUE);
+    FULFILL_OR_RETURN(scalarfield->cell.number_of_physical_dimensions.is_set, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->cell.lattice_vectors, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->number_of_components.is_set, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->number_of_grid_points, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->real_or_complex.is_set, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->use_default_ordering.is_set, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->real_or_complex.value == ESCDF_REAL, ESCDF_EVALUE);
+    FULFILL_OR_RETURN(component < scalarfield->number_of_components.value, ESCDF_ERANGE);
+
+    memset(&partial, 0, sizeof(_partial_t));
+    partial.minimum = HUGE_VAL;
+    partial.maximum = -HUGE_VAL;
+
+    utils_stats_start(file_id, &timer);
+    err = _reduce(scalarfield, file_id, component, &partial, &npts);
+    utils_stats_stop(file_id, &timer, ESCDF_STATS_READ_DATA);
+
+#ifdef HAVE_MPI
+    /* All the ranks reduce, even the failed ones, which would otherwise
+       block the others. */
+    if (file_id->mpi_size > 1) {
+        sums[0] = partial.sum;
+        sums[1] = partial.sum_abs;
+        sums[2] = partial.sum_sq;
+        sums[3] = partial.moment[0];
+        sums[4] = partial.moment[1];
+        sums[5] = partial.moment[2];
+        extrema[0] = -partial.minimum;
+        extrema[1] = partial.maximum;
+        failed = (err != ESCDF_SUCCESS);
+        MPI_Allreduce(MPI_IN_PLACE, sums, 6, MPI_DOUBLE, MPI_SUM, file_id->comm);
+        MPI_Allreduce(MPI_IN_PLACE, extrema, 2, MPI_DOUBLE, MPI_MAX, file_id->comm);
+        MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_LOR, file_id->comm);
+        partial.sum = sums[0];
+        partial.sum_abs = sums[1];
+        partial.sum_sq = sums[2];
+        partial.moment[0] = sums[3];
+        partial.moment[1] = sums[4];
+        partial.moment[2] = sums[5];
+        partial.minimum = -extrema[0];
+        partial.maximum = extrema[1];
+        if (failed && err == ESCDF_SUCCESS) {
+            err = ESCDF_ERROR;
+        }
+    }
+#endif
+    FULFILL_OR_RETURN(err == ESCDF_SUCCESS, err);
+
+    ndims = scalarfield->cell.number_of_physical_dimensions.value;
+    dv = _cell_volume(scalarfield) / npts;
+    reduction->number_of_values = npts;
+    reduction->sum = partial.sum;
+    reduction->integral = partial.sum * dv;
+    reduction->minimum = partial.minimum;
+    reduction->maximum = partial.maximum;
+    for (c = 0; c < 3; c++) {
+        reduction->first_moment[c] = 0.;
+        for (d = 0; d < ndims && c < ndims; d++) {
+            reduction->first_moment[c] += partial.moment[d] *
+                scalarfield->cell.lattice_vectors[d * ndims + c];
+        }
+        reduction->first_moment[c] *= dv;
+    }
+    reduction->norm_1 = partial.sum_abs * dv;
+    reduction->norm_2 = sqrt(partial.sum_sq * dv);
+    reduction->norm_max = (-partial.minimum > partial.maximum) ? -partial.minimum : partial.maximum;
+
+    return ESCDF_SUCCESS;
+}
+
+/***************/
+/* Statistics. */
+/***************/
+escdf_errno_t escdf_grid_scalarfield_read_statistics(const escdf_grid_scalarfield_t *scalarfield,
+                                                     escdf_handle_t *file_id,
+                                                     const unsigned int component,
+                                                     escdf_grid_scalarfield_statistics_t *statistics)
+{
+    escdf_errno_t err;
+    utils_stats_timer_t timer;
+    _statistics_t stats;
+    hid_t loc_id, dtset_id;
+    hsize_t npts;
+    unsigned int r;
+    bool present;
+
+    FULFILL_OR_RETURN(scalarfield, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(file_id, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(statistics, ESCDF_EVALUE);
+    FULFILL_OR_RETURN(scalarfield->number_of_grid_points, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->number_of_components.is_set, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->real_or_complex.is_set, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(component < scalarfield->number_of_components.value, ESCDF_ERANGE);
+
+    if ((err = _statistics_init(scalarfield, &stats)) != ESCDF_SUCCESS) {
+        return err;
+    }
+
+    utils_stats_start(file_id, &timer);
+    utils_hdf5_lock();
+    present = false;
+    if ((loc_id = H5Gopen(file_id->group_id, scalarfield->path, H5P_DEFAULT)) < 0) {
+        DEFER_FUNC_ERROR(loc_id);
+        err = ESCDF_ERROR;
+    } else {
+        utils_stats_count_open();
+        if ((dtset_id = H5Dopen(loc_id, "values_on_grid", H5P_DEFAULT)) < 0) {
+            DEFER_FUNC_ERROR(dtset_id);
+            err = ESCDF_ERROR;
+        } else {
+            err = _read_statistics(dtset_id, &stats, &present);
+            H5Dclose(dtset_id);
+        }
+        H5Gclose(loc_id);
+    }
+    utils_hdf5_unlock();
+    utils_stats_stop(file_id, &timer, ESCDF_STATS_READ_METADATA);
+
+    if (err == ESCDF_SUCCESS && !present) {
+        DEFER_FUNC_ERROR(ESCDF_EUNINIT);
+        err = ESCDF_EUNINIT;
+    }
+    /* The statistics of a component written in part, or more than once in
+       parts, do not describe the values stored. */
+    npts = scalarfield->number_of_grid_points[0];
+    for (r = 1; r < scalarfield->cell.number_of_physical_dimensions.value; r++) {
+        npts *= scalarfield->number_of_grid_points[r];
+    }
+    if (err == ESCDF_SUCCESS && stats.counts[component] != npts) {
+        DEFER_FUNC_ERROR(ESCDF_EUNINIT);
+        err = ESCDF_EUNINIT;
+    }
+    if (err == ESCDF_SUCCESS) {
+        memset(statistics, 0, sizeof(escdf_grid_scalarfield_statistics_t));
+        statistics->number_of_values = stats.counts[component];
+        statistics->checksum = stats.checksums[component];
+        for (r = 0; r < stats.rc; r++) {
+            statistics->sum[r] = stats.sums[component * stats.rc + r];
+            statistics->minimum[r] = stats.minima[component * stats.rc + r];
+            statistics->maximum[r] = stats.maxima[component * stats.rc + r];
+        }
+    }
+    _statistics_free(&stats);
+
+    return err;
+}
+
+/* Checksums of the components of the slab of blocks of this rank. */
+static escdf_errno_t _checksum_slab(escdf_handle_t *file_id, hid_t dtset_id,
+                                    const _statistics_t *stored, hsize_t npts,
+                                    uint64_t *checksums)
+{
+    escdf_errno_t err;
+    hsize_t block, nblocks, ib, ib_end, first, n;
+    hsize_t start[3], count[3];
+    unsigned int c;
+    double *values;
+
+    utils_hdf5_lock();
+    block = _reduction_block_size(dtset_id);
+    utils_hdf5_unlock();
+    nblocks = (npts + block - 1) / block;
+    ib = 0;
+    ib_end = nblocks;
+#ifdef HAVE_MPI
+    if (file_id->mpi_size > 1) {
+        ib = nblocks * file_id->mpi_rank / file_id->mpi_size;
+        ib_end = nblocks * (file_id->mpi_rank + 1) / file_id->mpi_size;
+    }
+#else
+    (void)file_id;
+#endif
+
+    values = malloc(sizeof(double) * block * stored->rc);
+    FULFILL_OR_RETURN(values != NULL, ESCDF_ENOMEM);
+
+    err = ESCDF_SUCCESS;
+    for (c = 0; c < stored->ncomp && err == ESCDF_SUCCESS; c++) {
+        checksums[c] = 0;
+        for (first = ib * block; first < ib_end * block && first < npts; first += block) {
+            n = (first + block < npts) ? block : npts - first;
+            start[0] = c;
+            start[1] = first;
+            start[2] = 0;
+            count[0] = 1;
+            count[1] = n;
+            count[2] = stored->rc;
+            utils_hdf5_lock();
+            err = utils_hdf5_read_dataset(dtset_id, H5P_DEFAULT, values, H5T_NATIVE_DOUBLE,
+                                          start, count, NULL);
+            utils_hdf5_unlock();
+            if (err != ESCDF_SUCCESS) {
+                break;
+            }
+            checksums[c] += _checksum_values(values, first * stored->rc, n * stored->rc);
+        }
+    }
+    free(values);
+
+    return err;
+}
+
+escdf_errno_t escdf_grid_scalarfield_verify(const escdf_grid_scalarfield_t *scalarfield,
+                                            escdf_handle_t *file_id)
+{
+    escdf_errno_t err;
+    utils_stats_timer_t timer;
+    _statistics_t stored;
+    hid_t loc_id, dtset_id;
+    hsize_t npts;
+    uint64_t *checksums;
+    unsigned int c;
+    bool present;
+#ifdef HAVE_MPI
+    int failed;
+#endif
+
+    FULFILL_OR_RETURN(scalarfield, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(file_id, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(scalarfield->cell.number_of_physical_dimensions.is_set, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->number_of_components.is_set, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->number_of_grid_points, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->real_or_complex.is_set, ESCDF_EUNINIT);
+
+    if ((err = _statistics_init(scalarfield, &stored)) != ESCDF_SUCCESS) {
+        return err;
+    }
+    checksums = malloc(sizeof(uint64_t) * stored.ncomp);
+    if (checksums == NULL) {
+        _statistics_free(&stored);
+        RETURN_WITH_ERROR(ESCDF_ENOMEM);
+    }
+    npts = scalarfield->number_of_grid_points[0];
+    for (c = 1; c < scalarfield->cell.number_of_physical_dimensions.value; c++) {
+        npts *= scalarfield->number_of_grid_points[c];
+    }
+
+    utils_stats_start(file_id, &timer);
+    utils_hdf5_lock();
+    dtset_id = -1;
+    present = false;
+    if ((loc_id = H5Gopen(file_id->group_id, scalarfield->path, H5P_DEFAULT)) < 0) {
+        DEFER_FUNC_ERROR(loc_id);
+        err = ESCDF_ERROR;
+    } else {
+        utils_stats_count_open();
+        if ((err = _get_values_on_grid(scalarfield, loc_id, &dtset_id)) == ESCDF_SUCCESS) {
+            err = _read_statistics(dtset_id, &stored, &present);
+        }
+    }
+    utils_hdf5_unlock();
+    if (err == ESCDF_SUCCESS && !present) {
+        DEFER_FUNC_ERROR(ESCDF_EUNINIT);
+        err = ESCDF_EUNINIT;
+    }
+    /* The checksum of a component written in part, or more than once,
+       covers other values than the ones stored. */
+    for (c = 0; c < stored.ncomp && err == ESCDF_SUCCESS; c++) {
+        if (stored.counts[c] != npts) {
+            DEFER_FUNC_ERROR(ESCDF_EUNINIT);
+            err = ESCDF_EUNINIT;
+        }
+    }
+    if (err == ESCDF_SUCCESS) {
+        err = _checksum_slab(file_id, dtset_id, &stored, npts, checksums);
+    }
+#ifdef HAVE_MPI
+    if (file_id->mpi_size > 1) {
+        failed = (err != ESCDF_SUCCESS);
+        MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_LOR, file_id->comm);
+        if (!failed) {
+            MPI_Allreduce(MPI_IN_PLACE, checksums, stored.ncomp, MPI_UINT64_T, MPI_SUM,
+                          file_id->comm);
+        } else if (err == ESCDF_SUCCESS) {
+            err = ESCDF_ERROR;
+        }
+    }
+#endif
+    utils_hdf5_lock();
+    if (dtset_id >= 0) {
+        H5Dclose(dtset_id);
+    }
+    if (loc_id >= 0) {
+        H5Gclose(loc_id);
+    }
+    utils_hdf5_unlock();
+    utils_stats_stop(file_id, &timer, ESCDF_STATS_READ_DATA);
+
+    for (c = 0; c < stored.ncomp && err == ESCDF_SUCCESS; c++) {
+        if (checksums[c] != stored.checksums[c]) {
+            DEFER_FUNC_ERROR(ESCDF_EFILE_CORRUPT);
+            err = ESCDF_EFILE_CORRUPT;
+        }
+    }
+    free(checksums);
+    _statistics_free(&stored);
+
+    return err;
+}
+
+/*************/
+/* Pyramids. */
+/*************/
+
+#define PYRAMID_MAX_LEVELS 8
+
+/* Numbers of grid points of a level of the pyramid along 3 dimensions, the
+   missing dimensions having one point. */
+static void _pyramid_grid(const escdf_grid_scalarfield_t *scalarfield, unsigned int level,
+                          hsize_t *m)
+{
+    hsize_t f;
+    unsigned int i;
+
+    f = (hsize_t)1 << level;
+    for (i = 0; i < 3; i++) {
+        m[i] = (i < scalarfield->cell.number_of_physical_dimensions.value) ?
+            (scalarfield->number_of_grid_points[i] + f - 1) / f : 1;
+    }
+}
+
+/* Number of fine grid points in the block ic of a level, along a dimension
+   of n fine points. */
+static hsize_t _pyramid_block(hsize_t ic, unsigned int level, hsize_t n)
+{
+    hsize_t f;
+
+    f = (hsize_t)1 << level;
+    return (n - ic * f < f) ? n - ic * f : f;
+}
+
+/* Adds a fine plane to the sum of the coarse plane of a level holding it,
+   each thread running over its own coarse rows. */
+static void _pyramid_accumulate(const double *fine, const hsize_t *n, unsigned int rc,
+                                unsigned int level, const hsize_t *m, double *coarse)
+{
+    hsize_t jc;
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (jc = 0; jc < m[1]; jc++) {
+        const double *row;
+        double *crow;
+        hsize_t j, j_end, i;
+        unsigned int r;
+
+        j_end = ((jc + 1) << level < n[1]) ? (jc + 1) << level : n[1];
+        crow = coarse + jc * m[0] * rc;
+        for (j = jc << level; j < j_end; j++) {
+            row = fine + j * n[0] * rc;
+            for (i = 0; i < n[0]; i++) {
+                for (r = 0; r < rc; r++) {
+                    crow[(i >> level) * rc + r] += row[i * rc + r];
+                }
+            }
+        }
+    }
+}
+
+/* Turns the sums of the coarse plane k of a level into averages. */
+static void _pyramid_normalise(double *coarse, const hsize_t *n, const hsize_t *m,
+                               hsize_t k, unsigned int rc, unsigned int level)
+{
+    hsize_t nk, j;
+
+    nk = _pyramid_block(k, level, n[2]);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (j = 0; j < m[1]; j++) {
+        double *crow;
+        hsize_t nj, i;
+        unsigned int r;
+        double w;
+
+        nj = nk * _pyramid_block(j, level, n[1]);
+        crow = coarse + j * m[0] * rc;
+        for (i = 0; i < m[0]; i++) {
+            w = 1. / (double)(nj * _pyramid_block(i, level, n[0]));
+            for (r = 0; r < rc; r++) {
+                crow[i * rc + r] *= w;
+            }
+        }
+    }
+}
+
+#define PYRAMID_NO_PLANE ((hsize_t)-1)
+
+/* Partial sum of this rank for the coarse plane k of a level, started in a
+   free slot when there is none yet. A rank holds at most two of them at
+   once: the one of the coarse plane left incomplete by the previous round,
+   and the one of its fine plane of the current round. */
+static double *_pyramid_partial(double **part, hsize_t *key, hsize_t k, size_t len)
+{
+    unsigned int s;
+
+    for (s = 0; s < 2; s++) {
+        if (key[s] == k) {
+            return part[s];
+        }
+    }
+    for (s = 0; s < 2; s++) {
+        if (key[s] == PYRAMID_NO_PLANE) {
+            key[s] = k;
+            memset(part[s], 0, sizeof(double) * len);
+            return part[s];
+        }
+    }
+
+    return NULL;
+}
+
+/* Sums the partial sums of a coarse plane over the ranks into the buffer of
+   the root, and releases the one of this rank. */
+static void _pyramid_reduce(escdf_handle_t *file_id, double **part, hsize_t *key, hsize_t k,
+                            const double *zero, size_t len, int root, double *sum)
+{
+    const double *send;
+    unsigned int s;
+
+    send = zero;
+    for (s = 0; s < 2; s++) {
+        if (key[s] == k) {
+            send = part[s];
+            key[s] = PYRAMID_NO_PLANE;
+        }
+    }
+#ifdef HAVE_MPI
+    if (file_id->mpi_size > 1) {
+        MPI_Reduce(send, sum, (int)len, MPI_DOUBLE, MPI_SUM, root, file_id->comm);
+        return;
+    }
+#else
+    (void)file_id;
+    (void)root;
+#endif
+    memcpy(sum, send, sizeof(double) * len);
+}
+
+/* Creates the data sets of the levels 1 to nlevels, over the ones of a
+   previous pyramid, and records the number of levels. Must be called with
+   the HDF5 lock. */
+static escdf_errno_t _create_pyramid(const escdf_grid_scalarfield_t *scalarfield,
+                                     hid_t loc_id, unsigned int nlevels, hid_t *pyr_ids)
+{
+    escdf_errno_t err;
+    hid_t dcpl_id;
+    hsize_t dims[3], m[3];
+    char name[32];
+    unsigned int l;
+
+    for (l = 1; l <= PYRAMID_MAX_LEVELS; l++) {
+        sprintf(name, "pyramid_level_%u", l);
+        if (H5Lexists(loc_id, name, H5P_DEFAULT) > 0 &&
+            H5Ldelete(loc_id, name, H5P_DEFAULT) < 0) {
+            RETURN_WITH_ERROR(ESCDF_ERROR);
+        }
+    }
+    for (l = 1; l <= nlevels; l++) {
+        _pyramid_grid(scalarfield, l, m);
+        dims[0] = scalarfield->number_of_components.value;
+        dims[1] = m[0] * m[1] * m[2];
+        dims[2] = scalarfield->real_or_complex.value;
+        if ((err = _create_dcpl(scalarfield, dims, 3, &dcpl_id)) != ESCDF_SUCCESS) {
+            return err;
+        }
+        sprintf(name, "pyramid_level_%u", l);
+        err = utils_hdf5_create_dataset(loc_id, name, H5T_IEEE_F64LE, dims, 3, dcpl_id,
+                                        pyr_ids + l - 1);
+        if (dcpl_id != H5P_DEFAULT) {
+            H5Pclose(dcpl_id);
+        }
+        if (err != ESCDF_SUCCESS) {
+            return err;
+        }
+    }
+
+    return _update_attr(loc_id, "number_of_pyramid_levels", H5T_STD_U32LE, NULL, 0,
+                        H5T_NATIVE_UINT, &nlevels);
+}
+
+/* Writes a coarse plane to a level, or takes part in the collective write
+   with an empty selection when count is NULL. */
+static escdf_errno_t _write_pyramid_slab(escdf_handle_t *file_id, hid_t dtset_id,
+                                         const double *coarse, const hsize_t *start,
+                                         const hsize_t *count)
+{
+    escdf_errno_t err;
+    utils_hdf5_selection_t sel;
+
+    utils_hdf5_lock();
+    if ((err = utils_hdf5_selection_init(&sel, dtset_id)) == ESCDF_SUCCESS) {
+        err = (count) ? utils_hdf5_selection_set_slice(&sel, start, count, NULL) :
+            utils_hdf5_selection_set_hyperslabs(&sel, 0, NULL, NULL, NULL, NULL);
+        if (err == ESCDF_SUCCESS) {
+            err = utils_hdf5_selection_write(&sel, dtset_id, file_id->transfer_mode,
+                                             H5T_NATIVE_DOUBLE, coarse);
+        }
+        utils_hdf5_selection_free(&sel);
+    }
+    utils_hdf5_unlock();
+
+    return err;
+}
+
+escdf_errno_t escdf_grid_scalarfield_write_pyramid(const escdf_grid_scalarfield_t *scalarfield,
+                                                   escdf_handle_t *file_id,
+                                                   const unsigned int number_of_levels)
+{
+    escdf_errno_t err, werr;
+    utils_stats_timer_t timer;
+    hid_t loc_id, dtset_id, pyr_ids[PYRAMID_MAX_LEVELS];
+    hsize_t n[3], m[PYRAMID_MAX_LEVELS + 1][3], start[3], count[3];
+    hsize_t key[PYRAMID_MAX_LEVELS][2], done[PYRAMID_MAX_LEVELS];
+    hsize_t plane, nrounds, round, a, b, z, k0, k_end;
+    size_t len[PYRAMID_MAX_LEVELS];
+    double *fine, *zero, *part[PYRAMID_MAX_LEVELS][2], *sum[PYRAMID_MAX_LEVELS];
+    unsigned int c, l, ncomp, rc;
+    int rank, size, j;
+#ifdef HAVE_MPI
+    int failed;
+#endif
+
+    if ((err = _check_write(scalarfield, NULL)) != ESCDF_SUCCESS) {
+        return err;
+    }
+    FULFILL_OR_RETURN(file_id, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(number_of_levels > 0 && number_of_levels <= PYRAMID_MAX_LEVELS,
+                      ESCDF_ERANGE);
+
+    ncomp = scalarfield->number_of_components.value;
+    rc = scalarfield->real_or_complex.value;
+    for (l = 0; l <= number_of_levels; l++) {
+        _pyramid_grid(scalarfield, l, m[l]);
+    }
+    memcpy(n, m[0], sizeof(n));
+    plane = n[0] * n[1];
+    rank = 0;
+    size = 1;
+#ifdef HAVE_MPI
+    if (file_id->mpi_size > 1) {
+        rank = file_id->mpi_rank;
+        size = file_id->mpi_size;
+    }
+#endif
+    nrounds = (n[2] + size - 1) / size;
+
+    /* A fine plane, and per level two partial sums and the sum of a coarse
+       plane, the largest coarse planes being the ones of the first level. */
+    fine = malloc(sizeof(double) * plane * rc);
+    zero = calloc(m[1][0] * m[1][1] * rc, sizeof(double));
+    memset(part, 0, sizeof(part));
+    memset(sum, 0, sizeof(sum));
+    err = (fine != NULL && zero != NULL) ? ESCDF_SUCCESS : ESCDF_ENOMEM;
+    for (l = 1; l <= number_of_levels && err == ESCDF_SUCCESS; l++) {
+        len[l - 1] = m[l][0] * m[l][1] * rc;
+        part[l - 1][0] = malloc(sizeof(double) * len[l - 1]);
+        part[l - 1][1] = malloc(sizeof(double) * len[l - 1]);
+        sum[l - 1] = malloc(sizeof(double) * len[l - 1]);
+        if (part[l - 1][0] == NULL || part[l - 1][1] == NULL || sum[l - 1] == NULL) {
+            err = ESCDF_ENOMEM;
+        }
+    }
+    if (err != ESCDF_SUCCESS) {
+        free(fine);
+        free(zero);
+        for (l = 0; l < number_of_levels; l++) {
+            free(part[l][0]);
+            free(part[l][1]);
+            free(sum[l]);
+        }
+        RETURN_WITH_ERROR(err);
+    }
+
+    utils_stats_start(file_id, &timer);
+    utils_hdf5_lock();
+    memset(pyr_ids, -1, sizeof(pyr_ids));
+    dtset_id = -1;
+    if ((loc_id = H5Gopen(file_id->group_id, scalarfield->path, H5P_DEFAULT)) < 0) {
+        DEFER_FUNC_ERROR(loc_id);
+        err = ESCDF_ERROR;
+    } else {
+        utils_stats_count_open();
+        if ((err = _get_values_on_grid(scalarfield, loc_id, &dtset_id)) == ESCDF_SUCCESS) {
+            err = _create_pyramid(scalarfield, loc_id, number_of_levels, pyr_ids);
+        }
+    }
+    utils_hdf5_unlock();
+#ifdef HAVE_MPI
+    if (file_id->mpi_size > 1) {
+        failed = (err != ESCDF_SUCCESS);
+        MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_LOR, file_id->comm);
+        if (failed && err == ESCDF_SUCCESS) {
+            err = ESCDF_ERROR;
+        }
+    }
+#endif
+
+    /* The fine planes are dealt round-robin over the ranks. At the end of
+       each round, the coarse planes whose fine planes have all been read
+       are summed over the ranks and written, each rank writing one of them
+       in turn, collectively, for the filtered data sets. */
+    for (c = 0; c < ncomp && err == ESCDF_SUCCESS; c++) {
+        for (l = 0; l < number_of_levels; l++) {
+            key[l][0] = PYRAMID_NO_PLANE;
+            key[l][1] = PYRAMID_NO_PLANE;
+            done[l] = 0;
+        }
+        for (round = 0; round < nrounds && err == ESCDF_SUCCESS; round++) {
+            a = round * size;
+            b = (a + size < n[2]) ? a + size : n[2];
+            z = a + rank;
+            if (z < b) {
+                start[0] = c;
+                start[1] = z * plane;
+                start[2] = 0;
+                count[0] = 1;
+                count[1] = plane;
+                count[2] = rc;
+                utils_hdf5_lock();
+                err = utils_hdf5_read_dataset(dtset_id, H5P_DEFAULT, fine, H5T_NATIVE_DOUBLE,
+                                              start, count, NULL);
+                utils_hdf5_unlock();
+                for (l = 1; l <= number_of_levels && err == ESCDF_SUCCESS; l++) {
+                    _pyramid_accumulate(fine, n, rc, l, m[l],
+                                        _pyramid_partial(part[l - 1], key[l - 1], z >> l,
+                                                         len[l - 1]));
+                }
+            }
+#ifdef HAVE_MPI
+            if (file_id->mpi_size > 1) {
+                failed = (err != ESCDF_SUCCESS);
+                MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_LOR, file_id->comm);
+                if (failed && err == ESCDF_SUCCESS) {
+                    err = ESCDF_ERROR;
+                }
+            }
+#endif
+            if (err != ESCDF_SUCCESS) {
+                break;
+            }
+
+            for (l = 1; l <= number_of_levels; l++) {
+                k_end = (b == n[2]) ? m[l][2] : b >> l;
+                for (k0 = done[l - 1]; k0 < k_end; k0 += size) {
+                    for (j = 0; j < size && k0 + j < k_end; j++) {
+                        _pyramid_reduce(file_id, part[l - 1], key[l - 1], k0 + j, zero,
+                                        len[l - 1], j, sum[l - 1]);
+                    }
+                    if (k0 + rank < k_end) {
+                        _pyramid_normalise(sum[l - 1], n, m[l], k0 + rank, rc, l);
+                    }
+                    start[0] = c;
+                    start[1] = (k0 + rank) * m[l][0] * m[l][1];
+                    start[2] = 0;
+                    count[0] = 1;
+                    count[1] = m[l][0] * m[l][1];
+                    count[2] = rc;
+                    werr = _write_pyramid_slab(file_id, pyr_ids[l - 1], sum[l - 1], start,
+                                               (k0 + rank < k_end) ? count : NULL);
+                    if (err == ESCDF_SUCCESS) {
+                        err = werr;
+                    }
+                }
+                done[l - 1] = k_end;
+            }
+#ifdef HAVE_MPI
+            if (file_id->mpi_size > 1) {
+                failed = (err != ESCDF_SUCCESS);
+                MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_LOR, file_id->comm);
+                if (failed && err == ESCDF_SUCCESS) {
+                    err = ESCDF_ERROR;
+                }
+            }
+#endif
+        }
+    }
+
+    utils_hdf5_lock();
+    for (l = 0; l < number_of_levels; l++) {
+        if (pyr_ids[l] >= 0) {
+            H5Dclose(pyr_ids[l]);
+        }
+    }
+    if (dtset_id >= 0) {
+        H5Dclose(dtset_id);
+    }
+    if (loc_id >= 0) {
+        H5Gclose(loc_id);
+    }
+    utils_hdf5_unlock();
+    utils_stats_stop(file_id, &timer, ESCDF_STATS_WRITE_DATA);
+
+    free(fine);
+    free(zero);
+    for (l = 0; l < number_of_levels; l++) {
+        free(part[l][0]);
+        free(part[l][1]);
+        free(sum[l]);
+    }
+
+    return err;
+}
+
+escdf_errno_t escdf_grid_scalarfield_read_number_of_pyramid_levels(const escdf_grid_scalarfield_t *scalarfield,
+                                                                   escdf_handle_t *file_id,
+                                                                   unsigned int *number_of_levels)
+{
+    escdf_errno_t err;
+    utils_stats_timer_t timer;
+    _uint_set_t value;
+    unsigned int range[2] = {1, PYRAMID_MAX_LEVELS};
+    hid_t loc_id;
+
+    FULFILL_OR_RETURN(scalarfield, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(file_id, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(number_of_levels, ESCDF_EVALUE);
+
+    utils_stats_start(file_id, &timer);
+    utils_hdf5_lock();
+    *number_of_levels = 0;
+    if ((loc_id = H5Gopen(file_id->group_id, scalarfield->path, H5P_DEFAULT)) < 0) {
+        DEFER_FUNC_ERROR(loc_id);
+        err = ESCDF_ERROR;
+    } else {
+        utils_stats_count_open();
+        err = ESCDF_SUCCESS;
+        if (H5Aexists(loc_id, "number_of_pyramid_levels") > 0 &&
+            (err = utils_hdf5_read_uint(loc_id, "number_of_pyramid_levels", &value,
+                                        range)) == ESCDF_SUCCESS) {
+            *number_of_levels = value.value;
+        }
+        H5Gclose(loc_id);
+    }
+    utils_hdf5_unlock();
+    utils_stats_stop(file_id, &timer, ESCDF_STATS_READ_METADATA);
+
+    return err;
+}
+
+escdf_errno_t escdf_grid_scalarfield_get_pyramid_grid_points(const escdf_grid_scalarfield_t *scalarfield,
+                                                             const unsigned int level,
+                                                             unsigned int *number_of_grid_points,
+                                                             const size_t len)
+{
+    hsize_t m[3];
+    unsigned int i;
+
+    FULFILL_OR_RETURN(scalarfield, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(scalarfield->number_of_grid_points, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(len == scalarfield->cell.number_of_physical_dimensions.value, ESCDF_ESIZE);
+    FULFILL_OR_RETURN(level <= PYRAMID_MAX_LEVELS, ESCDF_ERANGE);
+
+    _pyramid_grid(scalarfield, level, m);
+    for (i = 0; i < len; i++) {
+        number_of_grid_points[i] = (unsigned int)m[i];
+    }
+    return ESCDF_SUCCESS;
+}
+
+escdf_errno_t escdf_grid_scalarfield_read_pyramid(const escdf_grid_scalarfield_t *scalarfield,
+                                                  escdf_handle_t *file_id,
+                                                  const unsigned int level,
+                                                  const hsize_t *start,
+                                                  const hsize_t *count,
+                                                  double *buf)
+{
+    escdf_errno_t err;
+    utils_stats_timer_t timer;
+    utils_hdf5_selection_t sel;
+    hid_t loc_id, dtset_id;
+    hsize_t m[3], s[3], n[3], dims[3], *starts, *strides, *counts, *blocks;
+    char name[32];
+    unsigned int i, ndims;
+    hsize_t k;
+
+    FULFILL_OR_RETURN(scalarfield, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(file_id, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(buf, ESCDF_EVALUE);
+    FULFILL_OR_RETURN(scalarfield->cell.number_of_physical_dimensions.is_set, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->number_of_components.is_set, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->number_of_grid_points, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->real_or_complex.is_set, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(level <= PYRAMID_MAX_LEVELS, ESCDF_ERANGE);
+    /* The full grid is only a level of the pyramid in the default ordering. */
+    FULFILL_OR_RETURN(level > 0 || !scalarfield->use_default_ordering.is_set ||
+                      scalarfield->use_default_ordering.value, ESCDF_ENOSUPPORT);
+
+    ndims = scalarfield->cell.number_of_physical_dimensions.value;
+    _pyramid_grid(scalarfield, level, m);
+    for (i = 0; i < 3; i++) {
+        s[i] = (start && count && i < ndims) ? start[i] : 0;
+        n[i] = (start && count && i < ndims) ? count[i] : m[i];
+        FULFILL_OR_RETURN(n[i] > 0 && s[i] + n[i] <= m[i], ESCDF_ERANGE);
+    }
+    dims[0] = scalarfield->number_of_components.value;
+    dims[1] = m[0] * m[1] * m[2];
+    dims[2] = scalarfield->real_or_complex.value;
+
+    /* One strided hyperslab per plane of the box, each block being a row
+       of the box for all the components. */
+    starts = malloc(sizeof(hsize_t) * 12 * n[2]);
+    FULFILL_OR_RETURN(starts != NULL, ESCDF_ENOMEM);
+    strides = starts + 3 * n[2];
+    counts = strides + 3 * n[2];
+    blocks = counts + 3 * n[2];
+    for (k = 0; k < n[2]; k++) {
+        starts[3 * k] = 0;
+        starts[3 * k + 1] = s[0] + m[0] * (s[1] + m[1] * (s[2] + k));
+        starts[3 * k + 2] = 0;
+        strides[3 * k] = 1;
+        strides[3 * k + 1] = m[0];
+        strides[3 * k + 2] = 1;
+        counts[3 * k] = 1;
+        counts[3 * k + 1] = n[1];
+        counts[3 * k + 2] = 1;
+        blocks[3 * k] = dims[0];
+        blocks[3 * k + 1] = n[0];
+        blocks[3 * k + 2] = dims[2];
+    }
+
+    if (level > 0) {
+        sprintf(name, "pyramid_level_%u", level);
+    } else {
+        strcpy(name, "values_on_grid");
+    }
+    utils_stats_start(file_id, &timer);
+    utils_hdf5_lock();
+    if ((loc_id = H5Gopen(file_id->group_id, scalarfield->path, H5P_DEFAULT)) < 0) {
+        DEFER_FUNC_ERROR(loc_id);
+        err = ESCDF_ERROR;
+    } else {
+        utils_stats_count_open();
+        if ((err = utils_hdf5_check_dtset(loc_id, name, dims, 3, &dtset_id)) == ESCDF_SUCCESS) {
+            if ((err = utils_hdf5_selection_init(&sel, dtset_id)) == ESCDF_SUCCESS) {
+                err = utils_hdf5_selection_set_hyperslabs(&sel, n[2], starts, strides,
+                                                          counts, blocks);
+                if (err == ESCDF_SUCCESS) {
+                    err = utils_hdf5_selection_read(&sel, dtset_id, H5P_DEFAULT,
+                                                    H5T_NATIVE_DOUBLE, buf);
+                }
+                utils_hdf5_selection_free(&sel);
+            }
+            H5Dclose(dtset_id);
+        }
+        H5Gclose(loc_id);
+    }
+    utils_hdf5_unlock();
+    utils_stats_stop(file_id, &timer, ESCDF_STATS_READ_DATA);
+    free(starts);
+
+    return err;
+}
+
+/******************/
+/* Interpolation. */
+/******************/
+
+/* Number of grid points along each dimension of the blocks in which the
+   points are grouped, each block being read once with its halo. */
+#define INTERPOLATION_BLOCK_SIZE 32
+
+typedef struct {
+    hsize_t block;
+    size_t index;
+} _interpolation_point_t;
+
+static int _compare_interpolation_points(const void *a, const void *b)
+{
+    const _interpolation_point_t *pa = a, *pb = b;
+
+    if (pa->block != pb->block) {
+        return (pa->block < pb->block) ? -1 : 1;
+    }
+    return (pa->index < pb->index) ? -1 : (pa->index > pb->index);
+}
+
+/* Inverse of the lattice vectors as rows, completed to 3 dimensions with
+   unit vectors, so that the reduced coordinates of r are r inverse. */
+static escdf_errno_t _inverse_lattice(const escdf_grid_scalarfield_t *scalarfield,
+                                      double *inverse)
+{
+    double a[9], det;
+    unsigned int i, j, ndims;
+
+    ndims = scalarfield->cell.number_of_physical_dimensions.value;
+    for (i = 0; i < 3; i++) {
+        for (j = 0; j < 3; j++) {
+            a[i * 3 + j] = (i < ndims && j < ndims) ?
+                scalarfield->cell.lattice_vectors[i * ndims + j] : (double)(i == j);
+        }
+    }
+    inverse[0] = a[4] * a[8] - a[5] * a[7];
+    inverse[1] = a[2] * a[7] - a[1] * a[8];
+    inverse[2] = a[1] * a[5] - a[2] * a[4];
+    inverse[3] = a[5] * a[6] - a[3] * a[8];
+    inverse[4] = a[0] * a[8] - a[2] * a[6];
+    inverse[5] = a[2] * a[3] - a[0] * a[5];
+    inverse[6] = a[3] * a[7] - a[4] * a[6];
+    inverse[7] = a[1] * a[6] - a[0] * a[7];
+    inverse[8] = a[0] * a[4] - a[1] * a[3];
+    det = a[0] * inverse[0] + a[1] * inverse[3] + a[2] * inverse[6];
+    FULFILL_OR_RETURN(det != 0., ESCDF_EVALUE);
+    for (i = 0; i < 9; i++) {
+        inverse[i] /= det;
+    }
+
+    return ESCDF_SUCCESS;
+}
+
+/* Position of a point along a dimension of n grid points, in grid units,
+   wrapped into [0, n) for periodic dimensions. Returns false when the point
+   is outside of the grid along a non periodic one. */
+static bool _grid_position(double x, hsize_t n, bool periodic, double *u)
+{
+    *u = x * (double)n;
+    if (periodic) {
+        *u -= (double)n * floor(*u / (double)n);
+        /* Rounding may give n itself. */
+        if (*u >= (double)n) {
+            *u = 0.;
+        }
+        return true;
+    }
+    if (*u < -1e-10 || *u > (double)(n - 1) * (1. + 1e-10)) {
+        return false;
+    }
+    *u = (*u < 0.) ? 0. : (*u > (double)(n - 1)) ? (double)(n - 1) : *u;
+    return true;
+}
+
+/* Grid indices and weights of the stencil of a position along a
+   dimension, 2 points for linear and 4 for cubic (Catmull-Rom)
+   interpolation, and the index of the grid point below the position. */
+static hsize_t _stencil(double u, hsize_t n, bool periodic,
+                        escdf_grid_scalarfield_interpolation_t method,
+                        hsize_t *indices, double *weights)
+{
+    long long int base, g;
+    hsize_t width, s;
+    double t;
+
+    base = (long long int)floor(u);
+    if (!periodic && base >= (long long int)n - 1) {
+        base = (n > 1) ? (long long int)n - 2 : 0;
+    }
+    t = (n > 1) ? u - (double)base : 0.;
+    if (method == ESCDF_INTERPOLATION_TRILINEAR) {
+        width = 2;
+        weights[0] = 1. - t;
+        weights[1] = t;
+    } else {
+        width = 4;
+        weights[0] = 0.5 * t * (-1. + t * (2. - t));
+        weights[1] = 0.5 * (2. + t * t * (-5. + 3. * t));
+        weights[2] = 0.5 * t * (1. + t * (4. - 3. * t));
+        weights[3] = 0.5 * t * t * (t - 1.);
+    }
+    for (s = 0; s < width; s++) {
+        g = base + (long long int)s - ((width == 4) ? 1 : 0);
+        if (periodic) {
+            g %= (long long int)n;
+            g += (g < 0) ? (long long int)n : 0;
+        } else {
+            g = (g < 0) ? 0 : (g >= (long long int)n) ? (long long int)n - 1 : g;
+        }
+        indices[s] = (hsize_t)g;
+    }
+
+    return (hsize_t)base;
+}
+
+/* Grid indices along a dimension read for a block, as up to 2 ascending
+   runs of (first, count), with their positions in the block stored in
+   map. Returns the number of indices. */
+static hsize_t _block_runs(hsize_t block, hsize_t n, bool periodic,
+                           escdf_grid_scalarfield_interpolation_t method,
+                           hsize_t *runs, unsigned int *nruns, unsigned int *map)
+{
+    long long int lo, first;
+    hsize_t w, g, pos;
+    unsigned int r;
+
+    lo = (long long int)(block * INTERPOLATION_BLOCK_SIZE);
+    w = INTERPOLATION_BLOCK_SIZE + 1;
+    if (method == ESCDF_INTERPOLATION_TRICUBIC) {
+        lo -= 1;
+        w += 2;
+    }
+    if (periodic && w >= n) {
+        *nruns = 1;
+        runs[0] = 0;
+        runs[1] = n;
+    } else if (periodic) {
+        first = lo % (long long int)n;
+        first += (first < 0) ? (long long int)n : 0;
+        if ((hsize_t)first + w <= n) {
+            *nruns = 1;
+            runs[0] = (hsize_t)first;
+            runs[1] = w;
+        } else {
+            *nruns = 2;
+            runs[0] = 0;
+            runs[1] = (hsize_t)first + w - n;
+            runs[2] = (hsize_t)first;
+            runs[3] = n - (hsize_t)first;
+        }
+    } else {
+        *nruns = 1;
+        runs[0] = (lo < 0) ? 0 : (hsize_t)lo;
+        runs[1] = (((hsize_t)(lo + (long long int)w) < n) ? (hsize_t)(lo + (long long int)w) : n) -
+            runs[0];
+    }
+
+    pos = 0;
+    for (r = 0; r < *nruns; r++) {
+        for (g = runs[2 * r]; g < runs[2 * r] + runs[2 * r + 1]; g++) {
+            map[g] = (unsigned int)pos++;
+        }
+    }
+    return pos;
+}
+
+/* Selects the values of a component on the grid points of a block: for
+   each plane, one strided hyperslab per pair of runs along the first two
+   dimensions. They come in the order of the grid, which is the product of
+   the runs along each dimension. */
+static escdf_errno_t _select_block(utils_hdf5_selection_t *sel, const hsize_t *n,
+                                   unsigned int component, unsigned int rc,
+                                   hsize_t runs[3][4], const unsigned int *nruns,
+                                   const hsize_t *m)
+{
+    escdf_errno_t err;
+    hsize_t *starts, *strides, *counts, *blocks, k;
+    size_t nslabs, i;
+    unsigned int a, b, c;
+
+    nslabs = m[2] * nruns[1] * nruns[0];
+    starts = malloc(sizeof(hsize_t) * 12 * nslabs);
+    FULFILL_OR_RETURN(starts != NULL, ESCDF_ENOMEM);
+    strides = starts + 3 * nslabs;
+    counts = strides + 3 * nslabs;
+    blocks = counts + 3 * nslabs;
+    i = 0;
+    for (c = 0; c < nruns[2]; c++) {
+        for (k = runs[2][2 * c]; k < runs[2][2 * c] + runs[2][2 * c + 1]; k++) {
+            for (b = 0; b < nruns[1]; b++) {
+                for (a = 0; a < nruns[0]; a++, i++) {
+                    starts[3 * i] = component;
+                    starts[3 * i + 1] = runs[0][2 * a] + n[0] * (runs[1][2 * b] + n[1] * k);
+                    starts[3 * i + 2] = 0;
+                    strides[3 * i] = 1;
+                    strides[3 * i + 1] = n[0];
+                    strides[3 * i + 2] = 1;
+                    counts[3 * i] = 1;
+                    counts[3 * i + 1] = runs[1][2 * b + 1];
+                    counts[3 * i + 2] = 1;
+                    blocks[3 * i] = 1;
+                    blocks[3 * i + 1] = runs[0][2 * a + 1];
+                    blocks[3 * i + 2] = rc;
+                }
+            }
+        }
+    }
+    err = utils_hdf5_selection_set_hyperslabs(sel, nslabs, starts, strides, counts, blocks);
+    free(starts);
+
+    return err;
+}
+
+/* Grid indices of the points of a block, in the order of the grid. */
+static void _block_points(const hsize_t *n, hsize_t runs[3][4], const unsigned int *nruns,
+                          hsize_t *g)
+{
+    hsize_t i, j, k;
+    unsigned int a, b, c;
+
+    for (c = 0; c < nruns[2]; c++) {
+        for (k = runs[2][2 * c]; k < runs[2][2 * c] + runs[2][2 * c + 1]; k++) {
+            for (b = 0; b < nruns[1]; b++) {
+                for (j = runs[1][2 * b]; j < runs[1][2 * b] + runs[1][2 * b + 1]; j++) {
+                    for (a = 0; a < nruns[0]; a++) {
+                        for (i = runs[0][2 * a]; i < runs[0][2 * a] + runs[0][2 * a + 1]; i++) {
+                            *g++ = i + n[0] * (j + n[1] * k);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* Interpolates the points of a block, from its values laid out as
+   [m[2]][m[1]][m[0]][rc]. */
+static void _interpolate_block(const double *box, const hsize_t *m, unsigned int rc,
+                               const hsize_t *n, const bool *periodic,
+                               escdf_grid_scalarfield_interpolation_t method,
+                               unsigned int *const *map, const double *u,
+                               const _interpolation_point_t *points, size_t npoints,
+                               double *values)
+{
+    size_t q;
+    hsize_t width;
+
+    width = (method == ESCDF_INTERPOLATION_TRILINEAR) ? 2 : 4;
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (q = 0; q < npoints; q++) {
+        hsize_t indices[3][4], pos0[4], s0, s1, s2;
+        double weights[3][4], acc, w12;
+        const double *row;
+        unsigned int a, r;
+
+        for (a = 0; a < 3; a++) {
+            _stencil(u[3 * points[q].index + a], n[a], periodic[a], method,
+                     indices[a], weights[a]);
+        }
+        for (s0 = 0; s0 < width; s0++) {
+            pos0[s0] = map[0][indices[0][s0]] * rc;
+        }
+        for (r = 0; r < rc; r++) {
+            acc = 0.;
+            for (s2 = 0; s2 < width; s2++) {
+                for (s1 = 0; s1 < width; s1++) {
+                    w12 = weights[2][s2] * weights[1][s1];
+                    row = box + (map[2][indices[2][s2]] * m[1] + map[1][indices[1][s1]]) *
+                        m[0] * rc + r;
+#ifdef _OPENMP
+#pragma omp simd reduction(+:acc)
+#endif
+                    for (s0 = 0; s0 < width; s0++) {
+                        acc += w12 * weights[0][s0] * row[pos0[s0]];
+                    }
+                }
+            }
+            values[points[q].index * rc + r] = acc;
+        }
+    }
+}
+
+escdf_errno_t escdf_grid_scalarfield_interpolate(const escdf_grid_scalarfield_t *scalarfield,
+                                                 escdf_handle_t *file_id,
+                                                 const unsigned int component,
+                                                 const escdf_grid_scalarfield_interpolation_t method,
+                                                 const bool reduced,
+                                                 const size_t number_of_points,
+                                                 const double *points,
+                                                 double *values)
+{
+    escdf_errno_t err;
+    utils_stats_timer_t timer;
+    utils_hdf5_selection_t sel;
+    _interpolation_point_t *order;
+    hid_t loc_id, dtset_id;
+    hsize_t n[3], nb[3], m[3], b[3], runs[3][4], block, indices[4], len, box_len, *g;
+    unsigned int nruns[3], *map[3], ndims, rc, a, i;
+    size_t p, q, q_end;
+    double inverse[9], weights[4], x, *u, *box;
+    bool periodic[3], inside, selected, cached;
+
+    FULFILL_OR_RETURN(scalarfield, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(file_id, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(points || number_of_points == 0, ESCDF_EVALUE);
+    FULFILL_OR_RETURN(values || number_of_points == 0, ESCDF_EVALUE);
+    FULFILL_OR_RETURN(scalarfield->cell.number_of_physical_dimensions.is_set, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->cell.dimension_types, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(reduced || scalarfield->cell.lattice_vectors, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->number_of_components.is_set, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->number_of_grid_points, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(scalarfield->real_or_complex.is_set, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(!scalarfield->use_default_ordering.is_set ||
+                      scalarfield->use_default_ordering.value, ESCDF_ENOSUPPORT);
+    FULFILL_OR_RETURN(component < scalarfield->number_of_components.value, ESCDF_ERANGE);
+    FULFILL_OR_RETURN(method == ESCDF_INTERPOLATION_TRILINEAR ||
+                      method == ESCDF_INTERPOLATION_TRICUBIC, ESCDF_EVALUE);
+    if (number_of_points == 0) {
+        return ESCDF_SUCCESS;
+    }
+
+    ndims = scalarfield->cell.number_of_physical_dimensions.value;
+    rc = scalarfield->real_or_complex.value;
+    for (a = 0; a < 3; a++) {
+        n[a] = (a < ndims) ? scalarfield->number_of_grid_points[a] : 1;
+        periodic[a] = (a >= ndims ||
+                       scalarfield->cell.dimension_types[a] == ESCDF_DIRECTION_PERIODIC);
+        nb[a] = (n[a] + INTERPOLATION_BLOCK_SIZE - 1) / INTERPOLATION_BLOCK_SIZE;
+    }
+    if (!reduced && (err = _inverse_lattice(scalarfield, inverse)) != ESCDF_SUCCESS) {
+        return err;
+    }
+
+    /* Positions in grid units and blocks of the points, sorted by block. */
+    u = malloc(sizeof(double) * 3 * number_of_points);
+    order = malloc(sizeof(_interpolation_point_t) * number_of_points);
+    map[0] = malloc(sizeof(unsigned int) * (n[0] + n[1] + n[2]));
+    if (u == NULL || order == NULL || map[0] == NULL) {
+        free(u);
+        free(order);
+        free(map[0]);
+        RETURN_WITH_ERROR(ESCDF_ENOMEM);
+    }
+    map[1] = map[0] + n[0];
+    map[2] = map[1] + n[1];
+    inside = true;
+    for (p = 0; p < number_of_points && inside; p++) {
+        block = 0;
+        for (a = 3; a-- > 0 && inside;) {
+            x = 0.;
+            if (a < ndims && reduced) {
+                x = points[p * ndims + a];
+            } else if (a < ndims) {
+                for (i = 0; i < ndims; i++) {
+                    x += points[p * ndims + i] * inverse[i * 3 + a];
+                }
+            }
+            inside = _grid_position(x, n[a], periodic[a], u + 3 * p + a);
+            b[a] = _stencil(u[3 * p + a], n[a], periodic[a], method, indices, weights) /
+                INTERPOLATION_BLOCK_SIZE;
+            block = block * nb[a] + b[a];
+        }
+        order[p].block = block;
+        order[p].index = p;
+    }
+    if (!inside) {
+        free(u);
+        free(order);
+        free(map[0]);
+        RETURN_WITH_ERROR(ESCDF_ERANGE);
+    }
+    qsort(order, number_of_points, sizeof(_interpolation_point_t), _compare_interpolation_points);
+
+    box = NULL;
+    g = NULL;
+    box_len = 0;
+    utils_stats_start(file_id, &timer);
+    utils_hdf5_lock();
+    dtset_id = -1;
+    selected = false;
+    if ((loc_id = H5Gopen(file_id->group_id, scalarfield->path, H5P_DEFAULT)) < 0) {
+        DEFER_FUNC_ERROR(loc_id);
+        err = ESCDF_ERROR;
+    } else {
+        utils_stats_count_open();
+        if ((err = _get_values_on_grid(scalarfield, loc_id, &dtset_id)) == ESCDF_SUCCESS) {
+            err = utils_hdf5_selection_init(&sel, dtset_id);
+            selected = (err == ESCDF_SUCCESS);
+        }
+    }
+    cached = _cache_ready(scalarfield, file_id);
+    utils_hdf5_unlock();
+
+    /* Each block is read once, with the halo of its stencils, or gathered
+       from the block cache, then its points are interpolated outside of
+       the HDF5 lock. */
+    for (q = 0; q < number_of_points && err == ESCDF_SUCCESS; q = q_end) {
+        for (q_end = q + 1; q_end < number_of_points && order[q_end].block == order[q].block;
+             q_end++);
+        block = order[q].block;
+        len = rc;
+        for (a = 0; a < 3; a++) {
+            b[a] = block % nb[a];
+            block /= nb[a];
+            m[a] = _block_runs(b[a], n[a], periodic[a], method, runs[a], nruns + a, map[a]);
+            len *= m[a];
+        }
+        if (len > box_len) {
+            free(box);
+            free(g);
+            box_len = len;
+            box = malloc(sizeof(double) * box_len);
+            g = malloc(sizeof(hsize_t) * box_len / rc);
+            if (box == NULL || g == NULL) {
+                DEFER_FUNC_ERROR(ESCDF_ENOMEM);
+                err = ESCDF_ENOMEM;
+                break;
+            }
+        }
+        utils_hdf5_lock();
+        if (cached) {
+            _block_points(n, runs, nruns, g);
+            err = _cache_gather(scalarfield, dtset_id, len / rc, g, component, 1, len / rc, box);
+        } else {
+            err = _select_block(&sel, n, component, rc, runs, nruns, m);
+            if (err == ESCDF_SUCCESS) {
+                err = utils_hdf5_selection_read(&sel, dtset_id, H5P_DEFAULT, H5T_NATIVE_DOUBLE,
+                                                box);
+            }
+        }
+        utils_hdf5_unlock();
+        if (err == ESCDF_SUCCESS) {
+            _interpolate_block(box, m, rc, n, periodic, method, map, u, order + q, q_end - q,
+                               values);
+        }
+    }
+
+    utils_hdf5_lock();
+    if (selected) {
+        utils_hdf5_selection_free(&sel);
+    }
+    if (dtset_id >= 0) {
+        H5Dclose(dtset_id);
+    }
+    if (loc_id >= 0) {
+        H5Gclose(loc_id);
+    }
+    utils_hdf5_unlock();
+    utils_stats_stop(file_id, &timer, ESCDF_STATS_READ_DATA);
+
+    free(box);
+    free(g);
+    free(map[0]);
+    free(order);
+    free(u);
+
+    return err;
+}
+
 /***************/
 /* IO streams. */
 /***************/
@@ -24,6 +24,7 @@
 #include "escdf_handle.h"
 
 /* to be removed later when in utils.h */
+#include <stdint.h>
 #include <string.h>
 
 /******************************************************************************
@@ -46,6 +47,68 @@ typedef enum {
   ESCDF_COMPLEX = 2
 } escdf_real_or_complex;
 
+/**
+ * One write of values_on_grid, and of grid_ordering when tbl is not NULL,
+ * with the arguments of escdf_grid_scalarfield_write_values_on_grid().
+ */
+typedef struct {
+    const escdf_grid_scalarfield_t *scalarfield;
+    const double *buf;
+    const unsigned int *tbl;
+    const hsize_t *start;
+    const hsize_t *count;
+    const hsize_t *stride;
+} escdf_grid_scalarfield_write_t;
+
+/**
+ * Reductions of one component of values_on_grid, f, over all the grid
+ * points r. The integrals are sums times the volume element, the volume of
+ * the cell divided by the number of grid points.
+ */
+typedef struct {
+    hsize_t number_of_values;
+    double sum;             /**< sum of f */
+    double integral;        /**< integral of f, e.g. the total charge */
+    double minimum;
+    double maximum;
+    double first_moment[3]; /**< integral of r f, in cartesian coordinates */
+    double norm_1;          /**< integral of |f| */
+    double norm_2;          /**< square root of the integral of f^2 */
+    double norm_max;        /**< maximum of |f| */
+} escdf_grid_scalarfield_reduction_t;
+
+/**
+ * Statistics of one component of values_on_grid, accumulated on writing
+ * (see set_write_statistics()). The sums, minima and maxima are given for
+ * the real part, then the imaginary part of complex fields.
+ */
+typedef struct {
+    hsize_t number_of_values; /**< grid points written */
+    double sum[2];
+    double minimum[2];
+    double maximum[2];
+    uint64_t checksum;
+} escdf_grid_scalarfield_statistics_t;
+
+/**
+ * Counters of the block cache (see set_cache_size()), in blocks.
+ */
+typedef struct {
+    unsigned long long hits;       /**< blocks found in the cache */
+    unsigned long long misses;     /**< blocks read on demand */
+    unsigned long long read_ahead; /**< blocks read ahead of the accesses */
+    unsigned long long evictions;  /**< blocks dropped to make room */
+} escdf_grid_scalarfield_cache_statistics_t;
+
+/**
+ * Interpolation schemes, separable along each dimension: linear between the
+ * 2 nearest grid points, or cubic (Catmull-Rom) on the 4 nearest ones.
+ */
+typedef enum {
+    ESCDF_INTERPOLATION_TRILINEAR,
+    ESCDF_INTERPOLATION_TRICUBIC
+} escdf_grid_scalarfield_interpolation_t;
+
 /******************************************************************************
  * Global functions                                                           *
  ******************************************************************************/
@@ -132,6 +195,47 @@ escdf_errno_t escdf_grid_scalarfield_set_use_default_ordering(escdf_grid_scalarf
                                                               const bool use_default_ordering);
 bool escdf_grid_scalarfield_get_use_default_ordering(const escdf_grid_scalarfield_t *scalarfield);
 
+/**
+ * Storage properties of the data sets, used by write_metadata() when the
+ * data sets are created. They are not part of the metadata. A chunk size
+ * of 0 (the default) and a deflate level of 0 (the default) give a
+ * contiguous, uncompressed layout. The chunk size is given in grid
+ * points; setting a deflate level alone uses a default chunk size.
+ */
+escdf_errno_t escdf_grid_scalarfield_set_chunk_size(escdf_grid_scalarfield_t *scalarfield,
+                                                    const hsize_t chunk_size);
+hsize_t escdf_grid_scalarfield_get_chunk_size(const escdf_grid_scalarfield_t *scalarfield);
+
+escdf_errno_t escdf_grid_scalarfield_set_deflate_level(escdf_grid_scalarfield_t *scalarfield,
+                                                       const unsigned int deflate_level);
+unsigned int escdf_grid_scalarfield_get_deflate_level(const escdf_grid_scalarfield_t *scalarfield);
+
+/**
+ * Layout of the metadata written by write_metadata(). By default, each
+ * variable is stored in its own attribute. When packed, all of them are
+ * stored in a single compound attribute named "metadata", which costs one
+ * attribute access instead of seven on reading and writing. read_metadata()
+ * reads both layouts, whatever this setting.
+ */
+escdf_errno_t escdf_grid_scalarfield_set_packed_metadata(escdf_grid_scalarfield_t *scalarfield,
+                                                         const bool packed_metadata);
+bool escdf_grid_scalarfield_get_packed_metadata(const escdf_grid_scalarfield_t *scalarfield);
+
+/**
+ * Accumulate statistics of the values written: for each component, the
+ * number of grid points, the sums, minima and maxima, and an order
+ * independent checksum, the sum of a 64-bit hash of each value and its
+ * position. They are updated by every write of values_on_grid and stored
+ * as attributes of the data set, which makes the writes collective for
+ * handles shared by several MPI ranks. A write of a whole component
+ * replaces its statistics, e.g. at each step of a self-consistent loop,
+ * while writes of parts of it add to them: they are meaningful once each
+ * value has been written exactly once since the last whole write.
+ */
+escdf_errno_t escdf_grid_scalarfield_set_write_statistics(escdf_grid_scalarfield_t *scalarfield,
+                                                          const bool write_statistics);
+bool escdf_grid_scalarfield_get_write_statistics(const escdf_grid_scalarfield_t *scalarfield);
+
 escdf_errno_t escdf_grid_scalarfield_serialise(escdf_grid_scalarfield_t *scalarfield, FILE *f);
 
 /*******************/
@@ -150,6 +254,20 @@ escdf_errno_t escdf_grid_scalarfield_write_values_on_grid(const escdf_grid_scala
                                                           const hsize_t *start,
                                                           const hsize_t *count,
                                                           const hsize_t *stride);
+/**
+ * Perform n writes of scalarfields, e.g. the pseudo, core and total
+ * densities, in a single transfer of all their data sets. This is a
+ * collective call, with H5Dwrite_multi() when HDF5 provides it; otherwise
+ * the data sets are written one after the other, but still set up at once.
+ *
+ * @param[in] file_id: the handle on the opened HDF5 file.
+ * @param[in] writes: the n writes to perform.
+ * @param[in] n: the number of writes.
+ * @return error code.
+ */
+escdf_errno_t escdf_grid_scalarfield_write_values_on_grid_multi(escdf_handle_t *file_id,
+                                                                const escdf_grid_scalarfield_write_t *writes,
+                                                                const size_t n);
 escdf_errno_t escdf_grid_scalarfield_write_values_on_grid_sliced(const escdf_grid_scalarfield_t *scalarfield,
                                                                  escdf_handle_t *file_id,
                                                                  const double *buf,
@@ -168,4 +286,259 @@ escdf_errno_t escdf_grid_scalarfield_read_values_on_grid_sliced(const escdf_grid
                                                                 const unsigned int *tbl,
                                                                 const hsize_t len);
 
+/**
+ * Map values_on_grid in memory instead of reading it, when it is stored
+ * contiguously, uncompressed and in the native double type in a file
+ * opened with the default driver, in serial. No copy is made: the pages
+ * are loaded by the system as the values are accessed. The values are laid
+ * out as on disk, [number_of_components][number_of_grid_points]
+ * [real_or_complex], in the storage order of the grid points. The view is
+ * read-only and stays valid after the handle is closed, until the next call
+ * to this function, escdf_grid_scalarfield_unmap_values_on_grid() or
+ * escdf_grid_scalarfield_free().
+ *
+ * @param[in,out] scalarfield: instance of the scalarfield group.
+ * @param[in] file_id: the handle on the opened HDF5 file.
+ * @param[out] values: the mapped values, NULL on failure.
+ * @return error code, ESCDF_ENOSUPPORT when values_on_grid cannot be
+ * mapped and must be read instead.
+ */
+escdf_errno_t escdf_grid_scalarfield_map_values_on_grid(escdf_grid_scalarfield_t *scalarfield,
+                                                        escdf_handle_t *file_id,
+                                                        const double **values);
+void escdf_grid_scalarfield_unmap_values_on_grid(escdf_grid_scalarfield_t *scalarfield);
+
+/**
+ * Chunk-level access to the values of the grid points [start, start +
+ * count), for all the components. @buf is laid out as values_on_grid
+ * restricted to this range, [number_of_components][count][real_or_complex].
+ *
+ * When values_on_grid is chunked (see set_chunk_size()), with no filter but
+ * deflate, and the range is made of whole chunks (start a multiple of the
+ * chunk size, start + count a multiple of it or the number of grid points),
+ * the chunks are compressed or uncompressed in parallel by the library
+ * (with OpenMP) and written or read directly, bypassing the single-threaded
+ * HDF5 filter pipeline. Otherwise, and for handles shared by several MPI
+ * ranks, these calls fall back to the regular data set I/O.
+ *
+ * @param[in] scalarfield: instance of the scalarfield group.
+ * @param[in] file_id: the handle on the opened HDF5 file.
+ * @param[in,out] buf: the values to write, or read.
+ * @param[in] start: the first grid point of the range.
+ * @param[in] count: the number of grid points of the range.
+ * @return error code.
+ */
+escdf_errno_t escdf_grid_scalarfield_write_values_on_grid_chunks(const escdf_grid_scalarfield_t *scalarfield,
+                                                                 escdf_handle_t *file_id,
+                                                                 const double *buf,
+                                                                 const hsize_t start,
+                                                                 const hsize_t count);
+escdf_errno_t escdf_grid_scalarfield_read_values_on_grid_chunks(const escdf_grid_scalarfield_t *scalarfield,
+                                                                escdf_handle_t *file_id,
+                                                                double *buf,
+                                                                const hsize_t start,
+                                                                const hsize_t count);
+
+/****************/
+/* Block cache. */
+/****************/
+
+/**
+ * LRU cache of aligned blocks of values_on_grid, of 4096 grid points (16 x
+ * 16 x 16 in 3 dimensions), each holding all the components. When set,
+ * read_values_on_grid_sliced() with a lookup table and interpolate() round
+ * their accesses to whole blocks, read each missing block once and serve
+ * the others from memory. Without the default ordering, the blocks are
+ * ranges of 4096 values. The cache is dropped when values_on_grid is
+ * written through the scalarfield, or read from another handle; it should
+ * be cleared when the file is modified otherwise.
+ *
+ * The blocks are read independently, so that each MPI rank has its own
+ * cache. A size of 0 (the default) disables the cache.
+ *
+ * @param[in,out] scalarfield: instance of the scalarfield group.
+ * @param[in] size: the size of the cache, in bytes.
+ * @return error code.
+ */
+escdf_errno_t escdf_grid_scalarfield_set_cache_size(escdf_grid_scalarfield_t *scalarfield,
+                                                    const size_t size);
+size_t escdf_grid_scalarfield_get_cache_size(const escdf_grid_scalarfield_t *scalarfield);
+
+/**
+ * Number of blocks read ahead of each miss, along the direction of the
+ * misses, 0 by default. They are dropped first when the cache is full.
+ */
+escdf_errno_t escdf_grid_scalarfield_set_cache_read_ahead(escdf_grid_scalarfield_t *scalarfield,
+                                                          const unsigned int number_of_blocks);
+unsigned int escdf_grid_scalarfield_get_cache_read_ahead(const escdf_grid_scalarfield_t *scalarfield);
+
+escdf_errno_t escdf_grid_scalarfield_get_cache_statistics(const escdf_grid_scalarfield_t *scalarfield,
+                                                          escdf_grid_scalarfield_cache_statistics_t *statistics);
+
+/**
+ * Drops the cached blocks and resets the counters.
+ */
+void escdf_grid_scalarfield_clear_cache(escdf_grid_scalarfield_t *scalarfield);
+
+/***************/
+/* Reductions. */
+/***************/
+
+/**
+ * Computes the reductions of a real component of values_on_grid, reading it
+ * in blocks of bounded size (whole chunks when it is chunked) instead of
+ * all at once. The grid point of index i + n[0] * (j + n[1] * k) is at
+ * i / n[0] a1 + j / n[1] a2 + k / n[2] a3, the first dimension running
+ * fastest, and grid_ordering, when present, gives the index of each value.
+ *
+ * For handles shared by several MPI ranks, this is a collective call: the
+ * blocks are distributed in slabs over the ranks, which read them
+ * independently, and all of them get the reduced results.
+ *
+ * @param[in] scalarfield: instance of the scalarfield group, with its
+ * metadata.
+ * @param[in] file_id: the handle on the opened HDF5 file.
+ * @param[in] component: the component to reduce, from 0.
+ * @param[out] reduction: the results.
+ * @return error code.
+ */
+escdf_errno_t escdf_grid_scalarfield_reduce(const escdf_grid_scalarfield_t *scalarfield,
+                                            escdf_handle_t *file_id,
+                                            const unsigned int component,
+                                            escdf_grid_scalarfield_reduction_t *reduction);
+
+/***************/
+/* Statistics. */
+/***************/
+
+/**
+ * Reads the statistics of a component accumulated on writing, without
+ * reading values_on_grid.
+ *
+ * @return ESCDF_EUNINIT when there are no statistics, or when the number of
+ * values written since the last write of the whole component differs from
+ * the number of grid points, as the statistics do not describe the values
+ * stored then.
+ */
+escdf_errno_t escdf_grid_scalarfield_read_statistics(const escdf_grid_scalarfield_t *scalarfield,
+                                                     escdf_handle_t *file_id,
+                                                     const unsigned int component,
+                                                     escdf_grid_scalarfield_statistics_t *statistics);
+
+/**
+ * Recomputes the checksums of the components of values_on_grid, reading it
+ * in blocks distributed over the MPI ranks as in
+ * escdf_grid_scalarfield_reduce(), and compares them with the stored ones.
+ * This is a collective call for handles shared by several MPI ranks.
+ *
+ * @return ESCDF_SUCCESS when they match, ESCDF_EFILE_CORRUPT otherwise,
+ * ESCDF_EUNINIT when there are no statistics or a component was not
+ * written exactly once in whole, so that its checksum cannot be verified.
+ */
+escdf_errno_t escdf_grid_scalarfield_verify(const escdf_grid_scalarfield_t *scalarfield,
+                                            escdf_handle_t *file_id);
+
+/*************/
+/* Pyramids. */
+/*************/
+
+/**
+ * Writes the levels 1 to number_of_levels (at most 8) of a multi-resolution
+ * pyramid of values_on_grid, in the default ordering. The level l holds the
+ * averages of the values over blocks of 2^l grid points along each
+ * dimension, the blocks being truncated at the upper ends of the grid. The
+ * pyramid is computed in a single streaming pass over values_on_grid, plane
+ * by plane along the slowest dimension, the planes being distributed over
+ * the MPI ranks of shared handles (a collective call). Each coarse plane is
+ * written as soon as all its planes have been read, so that only a few
+ * planes per level are kept in memory.
+ *
+ * @param[in] scalarfield: instance of the scalarfield group.
+ * @param[in] file_id: the handle on the opened HDF5 file.
+ * @param[in] number_of_levels: the number of levels, besides the full grid.
+ * @return error code.
+ */
+escdf_errno_t escdf_grid_scalarfield_write_pyramid(const escdf_grid_scalarfield_t *scalarfield,
+                                                   escdf_handle_t *file_id,
+                                                   const unsigned int number_of_levels);
+
+/**
+ * Reads the number of levels of the pyramid written with values_on_grid, 0
+ * when there is none.
+ */
+escdf_errno_t escdf_grid_scalarfield_read_number_of_pyramid_levels(const escdf_grid_scalarfield_t *scalarfield,
+                                                                   escdf_handle_t *file_id,
+                                                                   unsigned int *number_of_levels);
+
+/**
+ * Gets the numbers of grid points of a level of the pyramid, the ones of
+ * the scalarfield divided by 2^level and rounded up.
+ */
+escdf_errno_t escdf_grid_scalarfield_get_pyramid_grid_points(const escdf_grid_scalarfield_t *scalarfield,
+                                                             const unsigned int level,
+                                                             unsigned int *number_of_grid_points,
+                                                             const size_t len);
+
+/**
+ * Reads a box of a level of the pyramid, level 0 being values_on_grid
+ * itself. @buf is laid out as [number_of_components][points of the
+ * box][real_or_complex], the first dimension running fastest in the box.
+ *
+ * @param[in] scalarfield: instance of the scalarfield group.
+ * @param[in] file_id: the handle on the opened HDF5 file.
+ * @param[in] level: the level to read.
+ * @param[in] start: the first grid point of the box along each dimension,
+ * in the grid of the level, NULL for the whole level.
+ * @param[in] count: the number of grid points of the box along each
+ * dimension, NULL for the whole level.
+ * @param[out] buf: the values of the box.
+ * @return error code.
+ */
+escdf_errno_t escdf_grid_scalarfield_read_pyramid(const escdf_grid_scalarfield_t *scalarfield,
+                                                  escdf_handle_t *file_id,
+                                                  const unsigned int level,
+                                                  const hsize_t *start,
+                                                  const hsize_t *count,
+                                                  double *buf);
+
+/******************/
+/* Interpolation. */
+/******************/
+
+/**
+ * Interpolates a component of values_on_grid at arbitrary points. The grid
+ * point of index i + n[0] * (j + n[1] * k) is at i / n[0] a1 + j / n[1] a2
+ * + k / n[2] a3. Along periodic dimensions the points are wrapped into the
+ * cell, and the stencils wrap around it; along the other ones they must lie
+ * within the grid, and the stencils are clamped at its ends.
+ *
+ * The points are grouped by blocks of the grid, each of them being read
+ * once with the halo of its stencils, or gathered from the block cache when
+ * there is one, so that only the parts of the grid around the points are
+ * read. The reads are independent, the points of
+ * each MPI rank being interpolated on their own.
+ *
+ * @param[in] scalarfield: instance of the scalarfield group, in the default
+ * ordering.
+ * @param[in] file_id: the handle on the opened HDF5 file.
+ * @param[in] component: the component to interpolate, from 0.
+ * @param[in] method: the interpolation scheme.
+ * @param[in] reduced: whether the points are given in reduced coordinates,
+ * or in cartesian ones.
+ * @param[in] number_of_points: the number of points.
+ * @param[in] points: the coordinates of the points,
+ * [number_of_points][number_of_physical_dimensions].
+ * @param[out] values: the interpolated values,
+ * [number_of_points][real_or_complex].
+ * @return error code, ESCDF_ERANGE for points outside of the grid.
+ */
+escdf_errno_t escdf_grid_scalarfield_interpolate(const escdf_grid_scalarfield_t *scalarfield,
+                                                 escdf_handle_t *file_id,
+                                                 const unsigned int component,
+                                                 const escdf_grid_scalarfield_interpolation_t method,
+                                                 const bool reduced,
+                                                 const size_t number_of_points,
+                                                 const double *points,
+                                                 double *values);
+
 #endif
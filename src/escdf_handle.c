@@ -23,11 +23,16 @@
 #include "escdf_error.h"
 #include "escdf_handle.h"
 #include "utils_hdf5.h"
+#include "utils_stats.h"
 
 
 /******************************************************************************
- * Global functions                                                           *
+ * Private functions                                                          *
  ******************************************************************************/
+
+/* Number of the handles created or opened so far, under the HDF5 lock. */
+static unsigned long long _generation = 0;
+
 static escdf_errno_t _create_root(escdf_handle_t *handle, const char *path)
 {
     if (path != NULL) {
@@ -40,7 +45,7 @@ static escdf_errno_t _create_root(escdf_handle_t *handle, const char *path)
     return ESCDF_SUCCESS;
 }
 
-escdf_handle_t * escdf_create(const char *filename, const char *path)
+static escdf_handle_t * _create(const char *filename, const char *path)
 {
     escdf_handle_t *handle = (escdf_handle_t *) malloc(sizeof(escdf_handle_t));
     FULFILL_OR_RETURN_VAL(handle != NULL, ESCDF_ENOMEM, NULL);
@@ -48,6 +53,8 @@ escdf_handle_t * escdf_create(const char *filename, const char *path)
     handle->mpi_rank = 0;
     handle->mpi_size = 1;
     handle->transfer_mode = H5P_DEFAULT;
+    handle->stats = NULL;
+    handle->trusted = false;
     handle->file_id = H5Fcreate(filename, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
     FULFILL_OR_RETURN_VAL(handle->file_id >= 0, ESCDF_EFILE_CORRUPT, NULL)
 
@@ -59,13 +66,16 @@ escdf_handle_t * escdf_create(const char *filename, const char *path)
     }
 }
 
-escdf_handle_t * escdf_open(const char *filename, const char *path) {
+static escdf_handle_t * _open(const char *filename, const char *path)
+{
     escdf_handle_t *handle = (escdf_handle_t *) malloc(sizeof(escdf_handle_t));
     FULFILL_OR_RETURN_VAL(handle != NULL, ESCDF_ENOMEM, NULL)
 
     handle->mpi_rank = 0;
     handle->mpi_size = 1;
     handle->transfer_mode = H5P_DEFAULT;
+    handle->stats = NULL;
+    handle->trusted = false;
     handle->file_id = H5Fopen(filename, H5F_ACC_RDWR, H5P_DEFAULT);
     FULFILL_OR_RETURN_VAL(handle->file_id >= 0, ESCDF_EFILE_CORRUPT, NULL)
 
@@ -78,7 +88,7 @@ escdf_handle_t * escdf_open(const char *filename, const char *path) {
 }
 
 #ifdef HAVE_MPI
-escdf_handle_t * escdf_create_mpi(const char *filename, const char *path,
+static escdf_handle_t * _create_mpi(const char *filename, const char *path,
     MPI_Comm comm)
 {
     hid_t fapl_id;
@@ -87,6 +97,8 @@ escdf_handle_t * escdf_create_mpi(const char *filename, const char *path,
     FULFILL_OR_RETURN_VAL(handle != NULL, ESCDF_ENOMEM, NULL);
 
     handle->comm = comm;
+    handle->stats = NULL;
+    handle->trusted = false;
     MPI_Comm_size(handle->comm, &(handle->mpi_size));
     MPI_Comm_rank(handle->comm, &(handle->mpi_rank));
 
@@ -124,7 +136,7 @@ escdf_handle_t * escdf_create_mpi(const char *filename, const char *path,
     }
 }
 
-escdf_handle_t * escdf_open_mpi(const char *filename, const char *path,
+static escdf_handle_t * _open_mpi(const char *filename, const char *path,
     MPI_Comm comm)
 {
     hid_t fapl_id;
@@ -133,6 +145,8 @@ escdf_handle_t * escdf_open_mpi(const char *filename, const char *path,
     FULFILL_OR_RETURN_VAL(handle != NULL, ESCDF_ENOMEM, NULL);
 
     handle->comm = comm;
+    handle->stats = NULL;
+    handle->trusted = false;
     MPI_Comm_size(handle->comm, &(handle->mpi_size));
     MPI_Comm_rank(handle->comm, &(handle->mpi_rank));
 
@@ -170,15 +184,106 @@ escdf_handle_t * escdf_open_mpi(const char *filename, const char *path,
 }
 #endif
 
+
+/******************************************************************************
+ * Global functions                                                           *
+ ******************************************************************************/
+
+escdf_handle_t * escdf_create(const char *filename, const char *path)
+{
+    escdf_handle_t *handle;
+
+    utils_hdf5_lock();
+    handle = _create(filename, path);
+    if (handle != NULL) {
+        handle->generation = ++_generation;
+    }
+    utils_hdf5_unlock();
+    if (handle != NULL) {
+        utils_stats_init_handle(handle);
+    }
+
+    return handle;
+}
+
+escdf_handle_t * escdf_open(const char *filename, const char *path)
+{
+    escdf_handle_t *handle;
+
+    utils_hdf5_lock();
+    handle = _open(filename, path);
+    if (handle != NULL) {
+        handle->generation = ++_generation;
+    }
+    utils_hdf5_unlock();
+    if (handle != NULL) {
+        utils_stats_init_handle(handle);
+    }
+
+    return handle;
+}
+
+#ifdef HAVE_MPI
+escdf_handle_t * escdf_create_mpi(const char *filename, const char *path,
+    MPI_Comm comm)
+{
+    escdf_handle_t *handle;
+
+    utils_hdf5_lock();
+    handle = _create_mpi(filename, path, comm);
+    if (handle != NULL) {
+        handle->generation = ++_generation;
+    }
+    utils_hdf5_unlock();
+    if (handle != NULL) {
+        utils_stats_init_handle(handle);
+    }
+
+    return handle;
+}
+
+escdf_handle_t * escdf_open_mpi(const char *filename, const char *path,
+    MPI_Comm comm)
+{
+    escdf_handle_t *handle;
+
+    utils_hdf5_lock();
+    handle = _open_mpi(filename, path, comm);
+    if (handle != NULL) {
+        handle->generation = ++_generation;
+    }
+    utils_hdf5_unlock();
+    if (handle != NULL) {
+        utils_stats_init_handle(handle);
+    }
+
+    return handle;
+}
+#endif
+
 escdf_errno_t escdf_close(escdf_handle_t *handle) {
     herr_t err;
 
+    utils_stats_close_handle(handle);
+
     err = 0;
+    utils_hdf5_lock();
     if (handle->transfer_mode != H5P_DEFAULT) {
         DEFER_TEST_ERROR((err = H5Pclose(handle->transfer_mode)) < 0, err);
     }
     DEFER_TEST_ERROR((err = H5Gclose(handle->group_id)) < 0, err);
     DEFER_TEST_ERROR((err = H5Fclose(handle->file_id)) < 0, err);
+    utils_hdf5_unlock();
     free(handle);
     return (err < 0) ? ESCDF_EIO : ESCDF_SUCCESS;
 }
+
+void escdf_set_trusted(escdf_handle_t *handle, bool trusted)
+{
+    handle->trusted = trusted;
+}
+
+bool escdf_is_trusted(const escdf_handle_t *handle)
+{
+    return handle->trusted;
+}
@@ -20,6 +20,7 @@
 #ifndef LIBESCDF_HANDLE_H
 #define LIBESCDF_HANDLE_H
 
+#include <stdbool.h>
 #include <hdf5.h>
 
 #include "escdf_error.h"
@@ -36,9 +37,24 @@
  * Data structures                                                            *
  ******************************************************************************/
 
+struct utils_stats;
+
 /**
-*
-*/
+ * Handle on an opened ESCDF file.
+ *
+ * Thread safety: all the HDF5 calls made by the library are serialised by a
+ * single library-wide lock, because HDF5 keeps global state. The handle
+ * itself is not modified between its creation and escdf_close(), so it can be
+ * shared among threads without any per-handle locking, provided that:
+ *  - escdf_create*() and escdf_open*() return before the handle is shared;
+ *  - escdf_close() is called once, by one thread, after all the other threads
+ *    are done with the handle.
+ * Objects attached to a handle (e.g. scalarfields) follow the same rule:
+ * setters and read_metadata() modify them and must not run concurrently with
+ * other calls on the same object, while data functions take them as const and
+ * can be called concurrently, e.g. to read different components or slabs.
+ * Each thread has its own error chain.
+ */
 typedef struct {
     hid_t file_id;  /**< HDF5 file identifier */
 
@@ -47,6 +63,12 @@ typedef struct {
     int mpi_size, mpi_rank;
     hid_t transfer_mode;
 
+    struct utils_stats *stats; /**< I/O statistics, NULL when not recorded (see escdf_stats.h) */
+
+    bool trusted; /**< Skip the range checks of the metadata read (see escdf_set_trusted()) */
+
+    unsigned long long generation; /**< Distinct for each file created or opened, unlike the address of the handle */
+
 #ifdef HAVE_MPI
     MPI_Comm comm;
 #endif
@@ -63,6 +85,16 @@ escdf_handle_t * escdf_open(const char *filename, const char *path);
 
 escdf_errno_t escdf_close(escdf_handle_t *handle);
 
+/**
+ * Trust the file, e.g. one written by the same code: the values read are
+ * not checked against their valid range anymore. Files are not trusted by
+ * default. Like the rest of the handle, this must be set before the handle
+ * is shared among threads.
+ */
+void escdf_set_trusted(escdf_handle_t *handle, bool trusted);
+
+bool escdf_is_trusted(const escdf_handle_t *handle);
+
 #ifdef HAVE_MPI
 escdf_handle_t * escdf_create_mpi(const char *filename, const char *path,
     MPI_Comm comm);
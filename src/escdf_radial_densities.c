@@ -0,0 +1,690 @@
+/*
+  Copyright (C) 2016 D. Caliste, F. Corsetti, M. Oliveira, Y. Pouillon, and D. Strubbe
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "escdf_radial_densities.h"
+
+#include "utils.h"
+#include "utils_hdf5.h"
+#include "utils_stats.h"
+
+/* Number of intervals of the tables the projection interpolates, each table
+   being padded with a zero against rounding at the cutoff radius. */
+#define RADIAL_TABLE_SIZE 1024
+#define RADIAL_TABLE_STRIDE (RADIAL_TABLE_SIZE + 2)
+
+/******************************************************************************
+ * Data structures                                                            *
+ ******************************************************************************/
+
+struct _radial_density_t {
+    unsigned int number_of_radial_points; /**< 0 while not set */
+    double cutoff_radius;
+    double *radial_grid;
+    double *radial_values;
+};
+
+struct _escdf_radial_densities_t {
+    char *path;
+    _uint_set_t number_of_species;
+    struct _radial_density_t *species;
+};
+
+/* A site, with the ranges of the grid points within its cutoff radius. */
+typedef struct {
+    double position[3];
+    long long int lower[3];
+    long long int upper[3];
+    unsigned int species;
+} _site_range_t;
+
+
+/******************************************************************************
+ * Private functions                                                          *
+ ******************************************************************************/
+
+static void _free_species(escdf_radial_densities_t *radial)
+{
+    unsigned int s;
+
+    for (s = 0; s < radial->number_of_species.value; s++) {
+        free(radial->species[s].radial_grid);
+        free(radial->species[s].radial_values);
+    }
+    free(radial->species);
+    radial->species = NULL;
+    radial->number_of_species.value = 0;
+    radial->number_of_species.is_set = false;
+}
+
+static const struct _radial_density_t* _get_species(const escdf_radial_densities_t *radial,
+                                                    const unsigned int species)
+{
+    FULFILL_OR_RETURN_VAL(radial, ESCDF_EOBJECT, NULL);
+    FULFILL_OR_RETURN_VAL(radial->number_of_species.is_set, ESCDF_EUNINIT, NULL);
+    FULFILL_OR_RETURN_VAL(species >= 1 && species <= radial->number_of_species.value,
+                          ESCDF_ERANGE, NULL);
+
+    return radial->species + species - 1;
+}
+
+static long long int _floor_div(long long int a, long long int b)
+{
+    return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
+/**
+ * Inverts the matrix of the lattice vectors, as rows, so that the
+ * fractional coordinates of a position r are r inverse.
+ */
+static escdf_errno_t _invert_lattice(const double *a, double *inverse)
+{
+    double det;
+    int i;
+
+    inverse[0] = a[4] * a[8] - a[5] * a[7];
+    inverse[1] = a[2] * a[7] - a[1] * a[8];
+    inverse[2] = a[1] * a[5] - a[2] * a[4];
+    inverse[3] = a[5] * a[6] - a[3] * a[8];
+    inverse[4] = a[0] * a[8] - a[2] * a[6];
+    inverse[5] = a[2] * a[3] - a[0] * a[5];
+    inverse[6] = a[3] * a[7] - a[4] * a[6];
+    inverse[7] = a[1] * a[6] - a[0] * a[7];
+    inverse[8] = a[0] * a[4] - a[1] * a[3];
+    det = a[0] * inverse[0] + a[1] * inverse[3] + a[2] * inverse[6];
+    FULFILL_OR_RETURN(det != 0.0, ESCDF_EVALUE);
+    for (i = 0; i < 9; i++) {
+        inverse[i] /= det;
+    }
+
+    return ESCDF_SUCCESS;
+}
+
+/**
+ * Tabulates a radial density at RADIAL_TABLE_SIZE + 1 uniformly spaced
+ * radii from 0 to the cutoff radius, interpolating linearly between the
+ * points of its grid. It is constant below the first radius of the grid,
+ * and vanishes beyond the last one.
+ */
+static void _tabulate(const struct _radial_density_t *density, double *table)
+{
+    unsigned int l, p;
+    double r, t;
+
+    p = 0;
+    for (l = 0; l <= RADIAL_TABLE_SIZE; l++) {
+        r = density->cutoff_radius * l / RADIAL_TABLE_SIZE;
+        while (p + 1 < density->number_of_radial_points && density->radial_grid[p + 1] < r) {
+            p++;
+        }
+        if (r <= density->radial_grid[0]) {
+            table[l] = density->radial_values[0];
+        } else if (p + 1 >= density->number_of_radial_points) {
+            table[l] = (r > density->radial_grid[p]) ? 0.0 : density->radial_values[p];
+        } else {
+            t = (r - density->radial_grid[p]) /
+                (density->radial_grid[p + 1] - density->radial_grid[p]);
+            table[l] = density->radial_values[p] +
+                t * (density->radial_values[p + 1] - density->radial_values[p]);
+        }
+    }
+    table[RADIAL_TABLE_SIZE + 1] = 0.0;
+}
+
+/**
+ * Adds the density of a site to the points of a row of the grid, from g1 =
+ * lower to g1 = upper, all in the same periodic image, at offset from the
+ * start of the row. base is the vector from the site to the point g1 = 0 of
+ * the row, and step the one between consecutive points.
+ */
+static void _add_row(double *row, long long int offset, long long int lower,
+                     long long int upper, const double *base, const double *step,
+                     double rc2, double inv_dr, const double *table)
+{
+    long long int g1;
+    double dx, dy, dz, d2, x, t;
+    int l;
+
+    for (g1 = lower; g1 <= upper; g1++) {
+        dx = base[0] + g1 * step[0];
+        dy = base[1] + g1 * step[1];
+        dz = base[2] + g1 * step[2];
+        d2 = dx * dx + dy * dy + dz * dz;
+        if (d2 < rc2) {
+            x = sqrt(d2) * inv_dr;
+            l = (int)x;
+            t = x - l;
+            row[g1 - offset] += table[l] + t * (table[l + 1] - table[l]);
+        }
+    }
+}
+
+/* Adds the density of a site to the plane g3 = k of the grid. */
+static void _add_site_to_plane(const _site_range_t *site, const double *lattice_vectors,
+                               const unsigned int *ngrid, long long int k,
+                               double rc2, double inv_dr, const double *table,
+                               double *plane)
+{
+    long long int n1, n2, n3, g1, g2, g3, j, m, last;
+    double step[3], base[3], base3[3];
+    int d;
+
+    n1 = ngrid[0];
+    n2 = ngrid[1];
+    n3 = ngrid[2];
+    for (d = 0; d < 3; d++) {
+        step[d] = lattice_vectors[d] / n1;
+    }
+    /* The images of the plane k within the range of the site. */
+    for (g3 = site->lower[2] + ((k - site->lower[2]) % n3 + n3) % n3;
+         g3 <= site->upper[2]; g3 += n3) {
+        for (d = 0; d < 3; d++) {
+            base3[d] = (double)g3 / n3 * lattice_vectors[6 + d] - site->position[d];
+        }
+        for (g2 = site->lower[1]; g2 <= site->upper[1]; g2++) {
+            j = g2 - _floor_div(g2, n2) * n2;
+            for (d = 0; d < 3; d++) {
+                base[d] = base3[d] + (double)g2 / n2 * lattice_vectors[3 + d];
+            }
+            /* One segment per periodic image along a1. */
+            for (g1 = site->lower[0]; g1 <= site->upper[0]; g1 = last + 1) {
+                m = _floor_div(g1, n1);
+                last = (m + 1) * n1 - 1;
+                if (last > site->upper[0]) {
+                    last = site->upper[0];
+                }
+                _add_row(plane + j * n1, m * n1, g1, last, base, step, rc2, inv_dr, table);
+            }
+        }
+    }
+}
+
+
+/******************************************************************************
+ * Global functions                                                           *
+ ******************************************************************************/
+
+escdf_radial_densities_t* escdf_radial_densities_new(const char *path)
+{
+    escdf_radial_densities_t *radial;
+
+    radial = calloc(1, sizeof(escdf_radial_densities_t));
+    FULFILL_OR_RETURN_VAL(radial != NULL, ESCDF_ENOMEM, NULL);
+    if (!path || !path[0]) {
+        radial->path = strdup("densities/atom_core_density");
+    } else {
+        radial->path = strdup(path);
+    }
+
+    return radial;
+}
+
+void escdf_radial_densities_free(escdf_radial_densities_t *radial)
+{
+    if (!radial)
+        return;
+
+    _free_species(radial);
+    free(radial->path);
+    free(radial);
+}
+
+escdf_errno_t escdf_radial_densities_read(escdf_radial_densities_t *radial,
+                                          escdf_handle_t *file_id)
+{
+    utils_stats_timer_t timer;
+    _uint_set_t number_of_species;
+    unsigned int range[2] = {1, UINT_MAX};
+    unsigned int *npoints;
+    unsigned int s;
+    double *cutoffs, *grid, *values;
+    hsize_t dims[1], total;
+    hid_t gid, dtset_id;
+    escdf_errno_t err;
+
+    FULFILL_OR_RETURN(radial, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(file_id, ESCDF_EOBJECT);
+
+    utils_stats_start(file_id, &timer);
+    utils_hdf5_lock();
+    if ((gid = H5Gopen(file_id->group_id, radial->path, H5P_DEFAULT)) < 0) {
+        utils_hdf5_unlock();
+        utils_stats_stop(file_id, &timer, ESCDF_STATS_READ_DATA);
+        RETURN_WITH_ERROR(gid);
+    }
+    utils_stats_count_open();
+
+    npoints = NULL;
+    cutoffs = grid = values = NULL;
+    total = 0;
+    err = utils_hdf5_read_uint(gid, "number_of_species", &number_of_species, range);
+    if (err == ESCDF_SUCCESS) {
+        dims[0] = number_of_species.value;
+        npoints = malloc(sizeof(unsigned int) * dims[0]);
+        cutoffs = malloc(sizeof(double) * dims[0]);
+        if (npoints == NULL || cutoffs == NULL) {
+            DEFER_FUNC_ERROR(ESCDF_ENOMEM);
+            err = ESCDF_ENOMEM;
+        }
+    }
+    if (err == ESCDF_SUCCESS &&
+        (err = utils_hdf5_check_dtset(gid, "number_of_radial_points", dims, 1, &dtset_id)) == ESCDF_SUCCESS) {
+        err = utils_hdf5_read_dataset(dtset_id, file_id->transfer_mode, npoints,
+                                      H5T_NATIVE_UINT, NULL, NULL, NULL);
+        H5Dclose(dtset_id);
+    }
+    if (err == ESCDF_SUCCESS &&
+        (err = utils_hdf5_check_dtset(gid, "cutoff_radii", dims, 1, &dtset_id)) == ESCDF_SUCCESS) {
+        err = utils_hdf5_read_dataset(dtset_id, file_id->transfer_mode, cutoffs,
+                                      H5T_NATIVE_DOUBLE, NULL, NULL, NULL);
+        H5Dclose(dtset_id);
+    }
+    if (err == ESCDF_SUCCESS) {
+        for (s = 0; s < number_of_species.value; s++) {
+            if (npoints[s] == 1) {
+                DEFER_FUNC_ERROR(ESCDF_ERANGE);
+                err = ESCDF_ERANGE;
+            }
+            total += npoints[s];
+        }
+        dims[0] = total;
+    }
+    if (err == ESCDF_SUCCESS && total > 0) {
+        grid = malloc(sizeof(double) * total);
+        values = malloc(sizeof(double) * total);
+        if (grid == NULL || values == NULL) {
+            DEFER_FUNC_ERROR(ESCDF_ENOMEM);
+            err = ESCDF_ENOMEM;
+        }
+        if (err == ESCDF_SUCCESS &&
+            (err = utils_hdf5_check_dtset(gid, "radial_grid", dims, 1, &dtset_id)) == ESCDF_SUCCESS) {
+            err = utils_hdf5_read_dataset(dtset_id, file_id->transfer_mode, grid,
+                                          H5T_NATIVE_DOUBLE, NULL, NULL, NULL);
+            H5Dclose(dtset_id);
+        }
+        if (err == ESCDF_SUCCESS &&
+            (err = utils_hdf5_check_dtset(gid, "radial_values", dims, 1, &dtset_id)) == ESCDF_SUCCESS) {
+            err = utils_hdf5_read_dataset(dtset_id, file_id->transfer_mode, values,
+                                          H5T_NATIVE_DOUBLE, NULL, NULL, NULL);
+            H5Dclose(dtset_id);
+        }
+    }
+    H5Gclose(gid);
+    utils_hdf5_unlock();
+    utils_stats_stop(file_id, &timer, ESCDF_STATS_READ_DATA);
+
+    /* The species not set on writing have no radial points. */
+    if (err == ESCDF_SUCCESS) {
+        err = escdf_radial_densities_set_number_of_species(radial, number_of_species.value);
+    }
+    total = 0;
+    for (s = 0; err == ESCDF_SUCCESS && s < number_of_species.value; s++) {
+        if (npoints[s] > 0) {
+            err = escdf_radial_densities_set_species(radial, s + 1, npoints[s], grid + total,
+                                                     values + total, cutoffs[s]);
+            total += npoints[s];
+        }
+    }
+    if (err != ESCDF_SUCCESS) {
+        _free_species(radial);
+    }
+
+    free(npoints);
+    free(cutoffs);
+    free(grid);
+    free(values);
+
+    return err;
+}
+
+escdf_errno_t escdf_radial_densities_write(const escdf_radial_densities_t *radial,
+                                           escdf_handle_t *file_id)
+{
+    utils_stats_timer_t timer;
+    const struct _radial_density_t *density;
+    unsigned int *npoints;
+    unsigned int s;
+    double *cutoffs, *grid, *values;
+    hsize_t dims[1], total;
+    hid_t gid, dtset_id;
+    escdf_errno_t err;
+
+    FULFILL_OR_RETURN(radial, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(file_id, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(radial->number_of_species.is_set, ESCDF_EUNINIT);
+
+    /* The species one after the other. */
+    total = 0;
+    for (s = 0; s < radial->number_of_species.value; s++) {
+        total += radial->species[s].number_of_radial_points;
+    }
+    npoints = malloc(sizeof(unsigned int) * radial->number_of_species.value);
+    cutoffs = malloc(sizeof(double) * radial->number_of_species.value);
+    grid = malloc(sizeof(double) * (total + 1));
+    values = malloc(sizeof(double) * (total + 1));
+    if (npoints == NULL || cutoffs == NULL || grid == NULL || values == NULL) {
+        free(npoints);
+        free(cutoffs);
+        free(grid);
+        free(values);
+        RETURN_WITH_ERROR(ESCDF_ENOMEM);
+    }
+    total = 0;
+    for (s = 0; s < radial->number_of_species.value; s++) {
+        density = radial->species + s;
+        npoints[s] = density->number_of_radial_points;
+        cutoffs[s] = density->cutoff_radius;
+        if (npoints[s] > 0) {
+            memcpy(grid + total, density->radial_grid, sizeof(double) * npoints[s]);
+            memcpy(values + total, density->radial_values, sizeof(double) * npoints[s]);
+        }
+        total += npoints[s];
+    }
+
+    utils_stats_start(file_id, &timer);
+    utils_hdf5_lock();
+    err = utils_hdf5_create_group(file_id->group_id, radial->path, &gid);
+    if (err == ESCDF_SUCCESS) {
+        err = utils_hdf5_write_attr(gid, "number_of_species", H5T_STD_U32LE, NULL, 0,
+                                    H5T_NATIVE_UINT, &radial->number_of_species.value);
+        dims[0] = radial->number_of_species.value;
+        if (err == ESCDF_SUCCESS &&
+            (err = utils_hdf5_create_dataset(gid, "number_of_radial_points", H5T_STD_U32LE,
+                                             dims, 1, H5P_DEFAULT, &dtset_id)) == ESCDF_SUCCESS) {
+            err = utils_hdf5_write_dataset(dtset_id, file_id->transfer_mode, npoints,
+                                           H5T_NATIVE_UINT, NULL, NULL, NULL);
+            H5Dclose(dtset_id);
+        }
+        if (err == ESCDF_SUCCESS &&
+            (err = utils_hdf5_create_dataset(gid, "cutoff_radii", H5T_IEEE_F64LE,
+                                             dims, 1, H5P_DEFAULT, &dtset_id)) == ESCDF_SUCCESS) {
+            err = utils_hdf5_write_dataset(dtset_id, file_id->transfer_mode, cutoffs,
+                                           H5T_NATIVE_DOUBLE, NULL, NULL, NULL);
+            H5Dclose(dtset_id);
+        }
+        dims[0] = total;
+        if (err == ESCDF_SUCCESS &&
+            (err = utils_hdf5_create_dataset(gid, "radial_grid", H5T_IEEE_F64LE,
+                                             dims, 1, H5P_DEFAULT, &dtset_id)) == ESCDF_SUCCESS) {
+            err = utils_hdf5_write_dataset(dtset_id, file_id->transfer_mode, grid,
+                                           H5T_NATIVE_DOUBLE, NULL, NULL, NULL);
+            H5Dclose(dtset_id);
+        }
+        if (err == ESCDF_SUCCESS &&
+            (err = utils_hdf5_create_dataset(gid, "radial_values", H5T_IEEE_F64LE,
+                                             dims, 1, H5P_DEFAULT, &dtset_id)) == ESCDF_SUCCESS) {
+            err = utils_hdf5_write_dataset(dtset_id, file_id->transfer_mode, values,
+                                           H5T_NATIVE_DOUBLE, NULL, NULL, NULL);
+            H5Dclose(dtset_id);
+        }
+        H5Gclose(gid);
+    }
+    utils_hdf5_unlock();
+    utils_stats_stop(file_id, &timer, ESCDF_STATS_WRITE_DATA);
+
+    free(npoints);
+    free(cutoffs);
+    free(grid);
+    free(values);
+
+    return err;
+}
+
+escdf_errno_t escdf_radial_densities_set_number_of_species(escdf_radial_densities_t *radial,
+                                                           const unsigned int number_of_species)
+{
+    FULFILL_OR_RETURN(radial, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(number_of_species > 0, ESCDF_ERANGE);
+
+    _free_species(radial);
+    radial->species = calloc(number_of_species, sizeof(struct _radial_density_t));
+    FULFILL_OR_RETURN(radial->species != NULL, ESCDF_ENOMEM);
+    radial->number_of_species = _uint_set(number_of_species);
+
+    return ESCDF_SUCCESS;
+}
+
+unsigned int escdf_radial_densities_get_number_of_species(const escdf_radial_densities_t *radial)
+{
+    FULFILL_OR_RETURN_VAL(radial, ESCDF_EOBJECT, 0);
+    FULFILL_OR_RETURN_VAL(radial->number_of_species.is_set, ESCDF_EUNINIT, 0);
+
+    return radial->number_of_species.value;
+}
+
+escdf_errno_t escdf_radial_densities_set_species(escdf_radial_densities_t *radial,
+                                                 const unsigned int species,
+                                                 const unsigned int number_of_radial_points,
+                                                 const double *radial_grid,
+                                                 const double *radial_values,
+                                                 const double cutoff_radius)
+{
+    struct _radial_density_t *density;
+    double *grid, *values;
+    unsigned int p;
+
+    if (_get_species(radial, species) == NULL) {
+        return ESCDF_ERANGE;
+    }
+    FULFILL_OR_RETURN(number_of_radial_points >= 2, ESCDF_ERANGE);
+    FULFILL_OR_RETURN(radial_grid != NULL && radial_values != NULL, ESCDF_EVALUE);
+    FULFILL_OR_RETURN(radial_grid[0] >= 0.0, ESCDF_EVALUE);
+    for (p = 1; p < number_of_radial_points; p++) {
+        FULFILL_OR_RETURN(radial_grid[p] > radial_grid[p - 1], ESCDF_EVALUE);
+    }
+    FULFILL_OR_RETURN(cutoff_radius >= 0.0, ESCDF_EVALUE);
+    FULFILL_OR_RETURN(cutoff_radius > 0.0 || radial_grid[number_of_radial_points - 1] > 0.0,
+                      ESCDF_EVALUE);
+
+    grid = malloc(sizeof(double) * number_of_radial_points);
+    values = malloc(sizeof(double) * number_of_radial_points);
+    if (grid == NULL || values == NULL) {
+        free(grid);
+        free(values);
+        RETURN_WITH_ERROR(ESCDF_ENOMEM);
+    }
+    memcpy(grid, radial_grid, sizeof(double) * number_of_radial_points);
+    memcpy(values, radial_values, sizeof(double) * number_of_radial_points);
+
+    density = radial->species + species - 1;
+    free(density->radial_grid);
+    free(density->radial_values);
+    density->number_of_radial_points = number_of_radial_points;
+    density->radial_grid = grid;
+    density->radial_values = values;
+    density->cutoff_radius = (cutoff_radius > 0.0) ? cutoff_radius
+        : radial_grid[number_of_radial_points - 1];
+
+    return ESCDF_SUCCESS;
+}
+
+unsigned int escdf_radial_densities_get_number_of_radial_points(const escdf_radial_densities_t *radial,
+                                                                const unsigned int species)
+{
+    const struct _radial_density_t *density;
+
+    if ((density = _get_species(radial, species)) == NULL) {
+        return 0;
+    }
+    return density->number_of_radial_points;
+}
+
+const double* escdf_radial_densities_ptr_radial_grid(const escdf_radial_densities_t *radial,
+                                                     const unsigned int species)
+{
+    const struct _radial_density_t *density;
+
+    if ((density = _get_species(radial, species)) == NULL) {
+        return NULL;
+    }
+    return density->radial_grid;
+}
+
+const double* escdf_radial_densities_ptr_radial_values(const escdf_radial_densities_t *radial,
+                                                       const unsigned int species)
+{
+    const struct _radial_density_t *density;
+
+    if ((density = _get_species(radial, species)) == NULL) {
+        return NULL;
+    }
+    return density->radial_values;
+}
+
+double escdf_radial_densities_get_cutoff_radius(const escdf_radial_densities_t *radial,
+                                                const unsigned int species)
+{
+    const struct _radial_density_t *density;
+
+    if ((density = _get_species(radial, species)) == NULL) {
+        return 0.0;
+    }
+    return density->cutoff_radius;
+}
+
+escdf_errno_t escdf_radial_densities_project(const escdf_radial_densities_t *radial,
+                                             const double *lattice_vectors,
+                                             const unsigned int *number_of_grid_points,
+                                             const unsigned int number_of_sites,
+                                             const double *site_positions,
+                                             const int *species_at_sites,
+                                             double *values)
+{
+    const struct _radial_density_t *density;
+    _site_range_t *sites;
+    double inverse[9], norm, fraction, *tables, *inv_dr, *rc2;
+    long long int k, n3;
+    size_t plane_size;
+    unsigned int i, s, nspecies;
+    int d, e;
+
+    FULFILL_OR_RETURN(radial, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(radial->number_of_species.is_set, ESCDF_EUNINIT);
+    FULFILL_OR_RETURN(lattice_vectors != NULL && number_of_grid_points != NULL, ESCDF_EVALUE);
+    FULFILL_OR_RETURN(number_of_sites == 0 || (site_positions != NULL && species_at_sites != NULL),
+                      ESCDF_EVALUE);
+    FULFILL_OR_RETURN(values != NULL, ESCDF_EVALUE);
+    for (d = 0; d < 3; d++) {
+        FULFILL_OR_RETURN(number_of_grid_points[d] > 0, ESCDF_ERANGE);
+    }
+    nspecies = radial->number_of_species.value;
+    for (i = 0; i < number_of_sites; i++) {
+        FULFILL_OR_RETURN(species_at_sites[i] >= 1 && (unsigned int)species_at_sites[i] <= nspecies,
+                          ESCDF_ERANGE);
+        FULFILL_OR_RETURN(radial->species[species_at_sites[i] - 1].number_of_radial_points > 0,
+                          ESCDF_EUNINIT);
+    }
+    if (_invert_lattice(lattice_vectors, inverse) != ESCDF_SUCCESS) {
+        return ESCDF_EVALUE;
+    }
+
+    sites = malloc(sizeof(_site_range_t) * (number_of_sites + 1));
+    tables = malloc(sizeof(double) * RADIAL_TABLE_STRIDE * nspecies);
+    inv_dr = malloc(sizeof(double) * nspecies);
+    rc2 = malloc(sizeof(double) * nspecies);
+    if (sites == NULL || tables == NULL || inv_dr == NULL || rc2 == NULL) {
+        free(sites);
+        free(tables);
+        free(inv_dr);
+        free(rc2);
+        RETURN_WITH_ERROR(ESCDF_ENOMEM);
+    }
+    for (s = 0; s < nspecies; s++) {
+        density = radial->species + s;
+        if (density->number_of_radial_points > 0) {
+            _tabulate(density, tables + s * RADIAL_TABLE_STRIDE);
+            inv_dr[s] = RADIAL_TABLE_SIZE / density->cutoff_radius;
+            rc2[s] = density->cutoff_radius * density->cutoff_radius;
+        }
+    }
+
+    /* The grid points within the cutoff radius of a site are within rc |b|
+       of it in fractional coordinates along each direction, b being the
+       columns of the inverse. */
+    for (i = 0; i < number_of_sites; i++) {
+        sites[i].species = (unsigned int)species_at_sites[i] - 1;
+        density = radial->species + sites[i].species;
+        for (d = 0; d < 3; d++) {
+            sites[i].position[d] = site_positions[3 * i + d];
+        }
+        for (d = 0; d < 3; d++) {
+            fraction = 0.0;
+            norm = 0.0;
+            for (e = 0; e < 3; e++) {
+                fraction += site_positions[3 * i + e] * inverse[3 * e + d];
+                norm += inverse[3 * e + d] * inverse[3 * e + d];
+            }
+            norm = density->cutoff_radius * sqrt(norm);
+            sites[i].lower[d] = (long long int)ceil((fraction - norm) * number_of_grid_points[d]);
+            sites[i].upper[d] = (long long int)floor((fraction + norm) * number_of_grid_points[d]);
+        }
+    }
+
+    /* Each thread owns whole planes of the grid, so that the sums need no
+       synchronisation. */
+    plane_size = (size_t)number_of_grid_points[0] * number_of_grid_points[1];
+    n3 = number_of_grid_points[2];
+#ifdef _OPENMP
+#pragma omp parallel for private(i, s) schedule(dynamic)
+#endif
+    for (k = 0; k < n3; k++) {
+        double *plane = values + k * plane_size;
+
+        memset(plane, 0, sizeof(double) * plane_size);
+        for (i = 0; i < number_of_sites; i++) {
+            s = sites[i].species;
+            _add_site_to_plane(sites + i, lattice_vectors, number_of_grid_points, k,
+                               rc2[s], inv_dr[s], tables + s * RADIAL_TABLE_STRIDE, plane);
+        }
+    }
+
+    free(sites);
+    free(tables);
+    free(inv_dr);
+    free(rc2);
+
+    return ESCDF_SUCCESS;
+}
+
+escdf_errno_t escdf_radial_densities_project_on_scalarfield(const escdf_radial_densities_t *radial,
+                                                            const escdf_grid_scalarfield_t *scalarfield,
+                                                            const unsigned int number_of_sites,
+                                                            const double *site_positions,
+                                                            const int *species_at_sites,
+                                                            double *values)
+{
+    const double *lattice_vectors;
+    const unsigned int *number_of_grid_points;
+
+    FULFILL_OR_RETURN(scalarfield, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(escdf_grid_scalarfield_get_number_of_physical_dimensions(scalarfield) == 3,
+                      ESCDF_EVALUE);
+
+    lattice_vectors = escdf_grid_scalarfield_ptr_lattice_vectors(scalarfield);
+    number_of_grid_points = escdf_grid_scalarfield_ptr_number_of_grid_points(scalarfield);
+    FULFILL_OR_RETURN(lattice_vectors != NULL && number_of_grid_points != NULL, ESCDF_EUNINIT);
+
+    return escdf_radial_densities_project(radial, lattice_vectors, number_of_grid_points,
+                                          number_of_sites, site_positions, species_at_sites,
+                                          values);
+}
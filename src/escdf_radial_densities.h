@@ -0,0 +1,135 @@
+/*
+  Copyright (C) 2016 D. Caliste, F. Corsetti, M. Oliveira, Y. Pouillon, and D. Strubbe
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#ifndef LIBESCDF_RADIAL_DENSITIES_H
+#define LIBESCDF_RADIAL_DENSITIES_H
+
+#include "escdf_error.h"
+#include "escdf_handle.h"
+#include "escdf_grid_scalarfields.h"
+
+/******************************************************************************
+ * Data structures                                                            *
+ ******************************************************************************/
+
+/**
+ * Atom-centred densities, e.g. the core densities: one radial density per
+ * species, given on its own radial grid and vanishing beyond a cutoff
+ * radius. They are stored in a group, by default
+ * "densities/atom_core_density", as:
+ *  - the number_of_species attribute;
+ *  - number_of_radial_points and cutoff_radii, one value per species;
+ *  - radial_grid and radial_values, the radial grids and values of all the
+ *    species one after the other.
+ */
+struct _escdf_radial_densities_t;
+typedef struct _escdf_radial_densities_t escdf_radial_densities_t;
+
+/******************************************************************************
+ * Global functions                                                           *
+ ******************************************************************************/
+
+escdf_radial_densities_t* escdf_radial_densities_new(const char *path);
+
+void escdf_radial_densities_free(escdf_radial_densities_t *radial);
+
+escdf_errno_t escdf_radial_densities_read(escdf_radial_densities_t *radial,
+                                          escdf_handle_t *file_id);
+
+escdf_errno_t escdf_radial_densities_write(const escdf_radial_densities_t *radial,
+                                           escdf_handle_t *file_id);
+
+/**
+ * Sets the number of species, which discards the radial densities set
+ * before.
+ */
+escdf_errno_t escdf_radial_densities_set_number_of_species(escdf_radial_densities_t *radial,
+                                                           const unsigned int number_of_species);
+unsigned int escdf_radial_densities_get_number_of_species(const escdf_radial_densities_t *radial);
+
+/**
+ * Sets the radial density of a species, the values being copied.
+ *
+ * @param[in,out] radial: the radial densities.
+ * @param[in] species: index of the species, from 1 to number_of_species,
+ * as in the species_at_sites of the geometry.
+ * @param[in] number_of_radial_points: number of points of the radial grid,
+ * at least 2.
+ * @param[in] radial_grid: the radii, strictly increasing.
+ * @param[in] radial_values: the density at each radius.
+ * @param[in] cutoff_radius: radius beyond which the density vanishes, 0 for
+ * the last radius of the grid.
+ * @return error code.
+ */
+escdf_errno_t escdf_radial_densities_set_species(escdf_radial_densities_t *radial,
+                                                 const unsigned int species,
+                                                 const unsigned int number_of_radial_points,
+                                                 const double *radial_grid,
+                                                 const double *radial_values,
+                                                 const double cutoff_radius);
+
+unsigned int escdf_radial_densities_get_number_of_radial_points(const escdf_radial_densities_t *radial,
+                                                                const unsigned int species);
+const double* escdf_radial_densities_ptr_radial_grid(const escdf_radial_densities_t *radial,
+                                                     const unsigned int species);
+const double* escdf_radial_densities_ptr_radial_values(const escdf_radial_densities_t *radial,
+                                                       const unsigned int species);
+double escdf_radial_densities_get_cutoff_radius(const escdf_radial_densities_t *radial,
+                                                const unsigned int species);
+
+/**
+ * Computes the superposition of the radial densities of the sites on a
+ * periodic 3D grid, including all the periodic images of the sites within
+ * the cutoff radii. The grid point (i, j, k) is at i / n[0] a1 + j / n[1] a2
+ * + k / n[2] a3, and its value is stored at values[i + n[0] * (j + n[1] *
+ * k)], the first dimension running fastest. The radial densities are
+ * linearly interpolated, from tables of uniformly spaced radii. The planes
+ * of the grid along a3 are computed in parallel with OpenMP.
+ *
+ * @param[in] radial: the radial densities, set for all the species used.
+ * @param[in] lattice_vectors: the 3 lattice vectors a1, a2, a3, one after
+ * the other.
+ * @param[in] number_of_grid_points: the 3 numbers of grid points.
+ * @param[in] number_of_sites: the number of sites.
+ * @param[in] site_positions: the cartesian positions of the sites,
+ * [number_of_sites][3].
+ * @param[in] species_at_sites: the species of each site, from 1.
+ * @param[out] values: the values on the grid, overwritten.
+ * @return error code.
+ */
+escdf_errno_t escdf_radial_densities_project(const escdf_radial_densities_t *radial,
+                                             const double *lattice_vectors,
+                                             const unsigned int *number_of_grid_points,
+                                             const unsigned int number_of_sites,
+                                             const double *site_positions,
+                                             const int *species_at_sites,
+                                             double *values);
+
+/**
+ * Same as escdf_radial_densities_project(), on the grid of a scalarfield of
+ * 3 physical dimensions, for one of its real components.
+ */
+escdf_errno_t escdf_radial_densities_project_on_scalarfield(const escdf_radial_densities_t *radial,
+                                                            const escdf_grid_scalarfield_t *scalarfield,
+                                                            const unsigned int number_of_sites,
+                                                            const double *site_positions,
+                                                            const int *species_at_sites,
+                                                            double *values);
+
+#endif
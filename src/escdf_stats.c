@@ -0,0 +1,213 @@
+/*
+  Copyright (C) 2016 D. Caliste, F. Corsetti, M. Oliveira, Y. Pouillon, and D. Strubbe
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "escdf_error.h"
+#include "escdf_handle.h"
+#include "escdf_stats.h"
+#include "utils_stats.h"
+
+static const char *escdf_stats_names[ESCDF_N_STATS_OPERATIONS] = {
+    "read metadata",
+    "write metadata",
+    "read data",
+    "write data"
+};
+
+
+/******************************************************************************
+ * Private functions                                                          *
+ ******************************************************************************/
+
+/* Flatten the statistics into doubles, for reductions. */
+#define ESCDF_STATS_NVALUES (3 * ESCDF_N_STATS_OPERATIONS + 2)
+
+static void _to_values(const escdf_stats_t *data, double *values)
+{
+    unsigned int i;
+
+    for (i = 0; i < ESCDF_N_STATS_OPERATIONS; i++) {
+        values[3 * i + 0] = (double)data->calls[i];
+        values[3 * i + 1] = (double)data->bytes[i];
+        values[3 * i + 2] = data->time[i];
+    }
+    values[3 * ESCDF_N_STATS_OPERATIONS + 0] = (double)data->selections;
+    values[3 * ESCDF_N_STATS_OPERATIONS + 1] = (double)data->opens;
+}
+
+
+/******************************************************************************
+ * Global functions                                                           *
+ ******************************************************************************/
+
+escdf_errno_t escdf_stats_enable(escdf_handle_t *handle, bool dump_at_close)
+{
+    bool ok;
+
+    FULFILL_OR_RETURN(handle != NULL, ESCDF_EOBJECT);
+
+    utils_stats_lock();
+    if (handle->stats == NULL) {
+        handle->stats = utils_stats_new(dump_at_close);
+    } else {
+        handle->stats->dump_at_close = dump_at_close;
+    }
+    ok = (handle->stats != NULL);
+    utils_stats_unlock();
+    FULFILL_OR_RETURN(ok, ESCDF_ENOMEM);
+
+    return ESCDF_SUCCESS;
+}
+
+escdf_errno_t escdf_stats_disable(escdf_handle_t *handle)
+{
+    struct utils_stats *stats;
+
+    FULFILL_OR_RETURN(handle != NULL, ESCDF_EOBJECT);
+
+    /* Detach the statistics under the lock, so that no call being
+       recorded on another thread still uses them when they are freed. */
+    utils_stats_lock();
+    stats = handle->stats;
+    handle->stats = NULL;
+    utils_stats_unlock();
+    utils_stats_free(stats);
+
+    return ESCDF_SUCCESS;
+}
+
+bool escdf_stats_is_enabled(const escdf_handle_t *handle)
+{
+    return handle != NULL && handle->stats != NULL;
+}
+
+escdf_errno_t escdf_stats_get(const escdf_handle_t *handle, escdf_stats_t *stats)
+{
+    FULFILL_OR_RETURN(handle != NULL, ESCDF_EOBJECT);
+    FULFILL_OR_RETURN(stats != NULL, ESCDF_EVALUE);
+
+    utils_stats_lock();
+    if (handle->stats == NULL) {
+        memset(stats, 0, sizeof(escdf_stats_t));
+    } else {
+        *stats = handle->stats->data;
+    }
+    utils_stats_unlock();
+
+    return ESCDF_SUCCESS;
+}
+
+escdf_errno_t escdf_stats_reset(escdf_handle_t *handle)
+{
+    FULFILL_OR_RETURN(handle != NULL, ESCDF_EOBJECT);
+
+    utils_stats_lock();
+    if (handle->stats != NULL) {
+        memset(&handle->stats->data, 0, sizeof(escdf_stats_t));
+    }
+    utils_stats_unlock();
+
+    return ESCDF_SUCCESS;
+}
+
+double escdf_stats_metadata_time(const escdf_stats_t *stats)
+{
+    return stats->time[ESCDF_STATS_READ_METADATA] +
+        stats->time[ESCDF_STATS_WRITE_METADATA];
+}
+
+double escdf_stats_raw_time(const escdf_stats_t *stats)
+{
+    return stats->time[ESCDF_STATS_READ_DATA] +
+        stats->time[ESCDF_STATS_WRITE_DATA];
+}
+
+escdf_errno_t escdf_stats_print(const escdf_handle_t *handle, FILE *f)
+{
+    escdf_errno_t err;
+    escdf_stats_t stats;
+    unsigned int i;
+
+    FULFILL_OR_RETURN(f != NULL, ESCDF_EVALUE);
+    if ((err = escdf_stats_get(handle, &stats)) != ESCDF_SUCCESS)
+        return err;
+
+    fprintf(f, "libescdf: I/O statistics (rank %d):\n", handle->mpi_rank);
+    fprintf(f, "  %-16s %10s %16s %12s\n", "operation", "calls", "bytes", "time (s)");
+    for (i = 0; i < ESCDF_N_STATS_OPERATIONS; i++) {
+        fprintf(f, "  %-16s %10lu %16llu %12.6f\n", escdf_stats_names[i],
+                stats.calls[i], stats.bytes[i], stats.time[i]);
+    }
+    fprintf(f, "  selections: %lu, opens: %lu\n", stats.selections, stats.opens);
+    fprintf(f, "  metadata time: %.6f s, raw data time: %.6f s\n",
+            escdf_stats_metadata_time(&stats), escdf_stats_raw_time(&stats));
+    fflush(f);
+
+    return ESCDF_SUCCESS;
+}
+
+escdf_errno_t escdf_stats_report(const escdf_handle_t *handle, FILE *f)
+{
+    escdf_errno_t err;
+    escdf_stats_t stats;
+    double values[ESCDF_STATS_NVALUES];
+    double vmin[ESCDF_STATS_NVALUES], vmax[ESCDF_STATS_NVALUES], vsum[ESCDF_STATS_NVALUES];
+    unsigned int i;
+
+    FULFILL_OR_RETURN(handle != NULL, ESCDF_EOBJECT);
+    if ((err = escdf_stats_get(handle, &stats)) != ESCDF_SUCCESS)
+        return err;
+
+    _to_values(&stats, values);
+#ifdef HAVE_MPI
+    if (handle->mpi_size > 1) {
+        MPI_Reduce(values, vmin, ESCDF_STATS_NVALUES, MPI_DOUBLE, MPI_MIN, 0, handle->comm);
+        MPI_Reduce(values, vmax, ESCDF_STATS_NVALUES, MPI_DOUBLE, MPI_MAX, 0, handle->comm);
+        MPI_Reduce(values, vsum, ESCDF_STATS_NVALUES, MPI_DOUBLE, MPI_SUM, 0, handle->comm);
+    } else
+#endif
+    {
+        memcpy(vmin, values, sizeof(values));
+        memcpy(vmax, values, sizeof(values));
+        memcpy(vsum, values, sizeof(values));
+    }
+
+    if (handle->mpi_rank != 0)
+        return ESCDF_SUCCESS;
+    FULFILL_OR_RETURN(f != NULL, ESCDF_EVALUE);
+
+    fprintf(f, "libescdf: I/O statistics (%d ranks, min / avg / max):\n", handle->mpi_size);
+    for (i = 0; i < ESCDF_N_STATS_OPERATIONS; i++) {
+        fprintf(f, "  %-16s calls %g / %g / %g, bytes %g / %g / %g, time (s) %.6f / %.6f / %.6f\n",
+                escdf_stats_names[i],
+                vmin[3 * i], vsum[3 * i] / handle->mpi_size, vmax[3 * i],
+                vmin[3 * i + 1], vsum[3 * i + 1] / handle->mpi_size, vmax[3 * i + 1],
+                vmin[3 * i + 2], vsum[3 * i + 2] / handle->mpi_size, vmax[3 * i + 2]);
+    }
+    i = 3 * ESCDF_N_STATS_OPERATIONS;
+    fprintf(f, "  %-16s %g / %g / %g\n", "selections",
+            vmin[i], vsum[i] / handle->mpi_size, vmax[i]);
+    fprintf(f, "  %-16s %g / %g / %g\n", "opens",
+            vmin[i + 1], vsum[i + 1] / handle->mpi_size, vmax[i + 1]);
+    fflush(f);
+
+    return ESCDF_SUCCESS;
+}
@@ -0,0 +1,135 @@
+/*
+  Copyright (C) 2016 D. Caliste, F. Corsetti, M. Oliveira, Y. Pouillon, and D. Strubbe
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#ifndef LIBESCDF_STATS_H
+#define LIBESCDF_STATS_H
+
+/**
+ * @file escdf_stats.h
+ * @brief I/O statistics
+ *
+ * Each handle can record, per type of operation, the number of calls, the
+ * number of bytes moved and the wall time spent in the library, together
+ * with the number of HDF5 selections and of HDF5 objects opened. Recording
+ * is off by default: it is switched on per handle with escdf_stats_enable(),
+ * or for all handles by setting the ESCDF_STATS environment variable, in
+ * which case a summary is also printed to stderr by escdf_close(). When off,
+ * the cost is a pointer check per call, under a library-wide statistics
+ * lock, so that recording can be switched on and off while other threads
+ * use the handle.
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "escdf_error.h"
+#include "escdf_handle.h"
+
+/******************************************************************************
+ * Data structures                                                            *
+ ******************************************************************************/
+
+typedef enum {
+    ESCDF_STATS_READ_METADATA = 0,
+    ESCDF_STATS_WRITE_METADATA,
+    ESCDF_STATS_READ_DATA,
+    ESCDF_STATS_WRITE_DATA,
+    ESCDF_N_STATS_OPERATIONS
+} escdf_stats_operation;
+
+/**
+ * Snapshot of the statistics recorded on a handle.
+ */
+typedef struct {
+    unsigned long calls[ESCDF_N_STATS_OPERATIONS]; /**< number of calls */
+    unsigned long long bytes[ESCDF_N_STATS_OPERATIONS]; /**< bytes moved */
+    double time[ESCDF_N_STATS_OPERATIONS]; /**< wall time, in seconds */
+    unsigned long selections; /**< number of HDF5 dataspace selections */
+    unsigned long opens; /**< number of HDF5 files, groups, datasets and attributes opened */
+} escdf_stats_t;
+
+
+/******************************************************************************
+ * Global functions                                                           *
+ ******************************************************************************/
+
+/**
+ * Start recording statistics on a handle. Already recorded values are kept.
+ *
+ * @param[in,out] handle: the handle.
+ * @param[in] dump_at_close: print a summary to stderr in escdf_close().
+ * @return error code.
+ */
+escdf_errno_t escdf_stats_enable(escdf_handle_t *handle, bool dump_at_close);
+
+/**
+ * Stop recording statistics on a handle and discard the recorded values.
+ *
+ * @param[in,out] handle: the handle.
+ * @return error code.
+ */
+escdf_errno_t escdf_stats_disable(escdf_handle_t *handle);
+
+bool escdf_stats_is_enabled(const escdf_handle_t *handle);
+
+/**
+ * Get a snapshot of the statistics recorded on a handle. All values are
+ * zero if recording is disabled.
+ *
+ * @param[in] handle: the handle.
+ * @param[out] stats: the statistics.
+ * @return error code.
+ */
+escdf_errno_t escdf_stats_get(const escdf_handle_t *handle, escdf_stats_t *stats);
+
+/**
+ * Reset to zero the statistics recorded on a handle.
+ *
+ * @param[in,out] handle: the handle.
+ * @return error code.
+ */
+escdf_errno_t escdf_stats_reset(escdf_handle_t *handle);
+
+/**
+ * Wall time spent in metadata and in raw data operations.
+ */
+double escdf_stats_metadata_time(const escdf_stats_t *stats);
+double escdf_stats_raw_time(const escdf_stats_t *stats);
+
+/**
+ * Print the statistics of the calling rank.
+ *
+ * @param[in] handle: the handle.
+ * @param[in] f: output stream.
+ * @return error code.
+ */
+escdf_errno_t escdf_stats_print(const escdf_handle_t *handle, FILE *f);
+
+/**
+ * Print the minimum, average and maximum of the statistics over all the
+ * ranks of the handle communicator, to spot stragglers. This is a collective
+ * call; only rank 0 prints.
+ *
+ * @param[in] handle: the handle.
+ * @param[in] f: output stream.
+ * @return error code.
+ */
+escdf_errno_t escdf_stats_report(const escdf_handle_t *handle, FILE *f);
+
+#endif
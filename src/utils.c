@@ -17,6 +17,8 @@
 
 */
 
+#include <stdint.h>
+
 #include "utils.h"
 
 
@@ -54,4 +56,124 @@ _double_set_t _double_set(const double value)
     result.value = value;
     result.is_set = true;
     return result;
-}
\ No newline at end of file
+}
+
+
+/******************************************************************************
+ * Byte order                                                                 *
+ ******************************************************************************/
+
+void utils_swap_bytes(void *buf, size_t n, size_t size)
+{
+    size_t i, j;
+    unsigned char *b, t;
+
+    switch (size) {
+    case 2: {
+        uint16_t *v = buf;
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+        for (i = 0; i < n; i++) {
+            v[i] = (uint16_t)((v[i] >> 8) | (v[i] << 8));
+        }
+        break;
+    }
+    case 4: {
+        uint32_t *v = buf;
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+        for (i = 0; i < n; i++) {
+            v[i] = ((v[i] >> 24) & 0x000000ffu) | ((v[i] >> 8) & 0x0000ff00u) |
+                   ((v[i] << 8) & 0x00ff0000u) | ((v[i] << 24) & 0xff000000u);
+        }
+        break;
+    }
+    case 8: {
+        uint64_t *v = buf;
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+        for (i = 0; i < n; i++) {
+            v[i] = ((v[i] >> 56) & 0x00000000000000ffull) |
+                   ((v[i] >> 40) & 0x000000000000ff00ull) |
+                   ((v[i] >> 24) & 0x0000000000ff0000ull) |
+                   ((v[i] >>  8) & 0x00000000ff000000ull) |
+                   ((v[i] <<  8) & 0x000000ff00000000ull) |
+                   ((v[i] << 24) & 0x0000ff0000000000ull) |
+                   ((v[i] << 40) & 0x00ff000000000000ull) |
+                   ((v[i] << 56) & 0xff00000000000000ull);
+        }
+        break;
+    }
+    default:
+        b = buf;
+        for (i = 0; i < n; i++, b += size) {
+            for (j = 0; j < size / 2; j++) {
+                t = b[j];
+                b[j] = b[size - 1 - j];
+                b[size - 1 - j] = t;
+            }
+        }
+    }
+}
+
+
+/******************************************************************************
+ * Range checks                                                               *
+ ******************************************************************************/
+
+void utils_minmax_int(const int *values, size_t n, int *min, int *max)
+{
+    size_t i;
+    int lo, hi;
+
+    lo = hi = values[0];
+#ifdef _OPENMP
+#pragma omp parallel for reduction(min:lo) reduction(max:hi)
+#endif
+    for (i = 1; i < n; i++) {
+        lo = (values[i] < lo) ? values[i] : lo;
+        hi = (values[i] > hi) ? values[i] : hi;
+    }
+    *min = lo;
+    *max = hi;
+}
+
+void utils_minmax_uint(const unsigned int *values, size_t n,
+                       unsigned int *min, unsigned int *max)
+{
+    size_t i;
+    unsigned int lo, hi;
+
+    lo = hi = values[0];
+#ifdef _OPENMP
+#pragma omp parallel for reduction(min:lo) reduction(max:hi)
+#endif
+    for (i = 1; i < n; i++) {
+        lo = (values[i] < lo) ? values[i] : lo;
+        hi = (values[i] > hi) ? values[i] : hi;
+    }
+    *min = lo;
+    *max = hi;
+}
+
+void utils_minmax_dbl(const double *values, size_t n, double *min, double *max)
+{
+    size_t i, first;
+    double lo, hi;
+
+    /* Start from the first number, NaN fails every comparison. */
+    for (first = 0; first < n - 1 && values[first] != values[first]; first++);
+    lo = hi = values[first];
+#ifdef _OPENMP
+#pragma omp parallel for reduction(min:lo) reduction(max:hi)
+#endif
+    for (i = first + 1; i < n; i++) {
+        lo = (values[i] < lo) ? values[i] : lo;
+        hi = (values[i] > hi) ? values[i] : hi;
+    }
+    *min = lo;
+    *max = hi;
+}
@@ -21,6 +21,7 @@
 #define LIBESCDF_UTILS_H
 
 #include <stdbool.h>
+#include <stddef.h>
 
 /******************************************************************************
  * Data structures                                                            *
@@ -73,4 +74,31 @@ _int_set_t _int_set(const int value);
 
 _double_set_t _double_set(const double value);
 
+
+/******************************************************************************
+ * Byte order                                                                 *
+ ******************************************************************************/
+
+/**
+ * Reverse in place the byte order of n values of size bytes each. Sizes of
+ * 2, 4 and 8 bytes are swapped by word, in loops the compiler can vectorise.
+ */
+void utils_swap_bytes(void *buf, size_t n, size_t size);
+
+
+/******************************************************************************
+ * Range checks                                                               *
+ ******************************************************************************/
+
+/**
+ * Find the minimum and maximum of n > 0 values in a single pass, with an
+ * OpenMP reduction over branch-free loops. NaN values are ignored.
+ */
+void utils_minmax_int(const int *values, size_t n, int *min, int *max);
+
+void utils_minmax_uint(const unsigned int *values, size_t n,
+                       unsigned int *min, unsigned int *max);
+
+void utils_minmax_dbl(const double *values, size_t n, double *min, double *max);
+
 #endif
\ No newline at end of file
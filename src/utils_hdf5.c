@@ -24,7 +24,62 @@
 
 #include "escdf_error.h"
 #include "utils_hdf5.h"
+#include "utils_stats.h"
 
+#if defined HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#if defined HAVE_SYS_MMAN_H && defined HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+
+static pthread_mutex_t utils_hdf5_mutex;
+static pthread_once_t utils_hdf5_mutex_once = PTHREAD_ONCE_INIT;
+
+static void _init_mutex(void)
+{
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&utils_hdf5_mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+#endif
+
+void utils_hdf5_lock(void)
+{
+#ifdef HAVE_PTHREAD
+    pthread_once(&utils_hdf5_mutex_once, _init_mutex);
+    pthread_mutex_lock(&utils_hdf5_mutex);
+#endif
+}
+
+void utils_hdf5_unlock(void)
+{
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&utils_hdf5_mutex);
+#endif
+}
+
+
+static hsize_t _dims_product(const hsize_t *dims, unsigned int ndims)
+{
+    hsize_t n = 1;
+    unsigned int i;
+
+    for (i = 0; dims != NULL && i < ndims; i++) {
+        n *= dims[i];
+    }
+    return n;
+}
 
 bool utils_hdf5_check_present(hid_t loc_id, const char *name)
 {
@@ -43,7 +98,7 @@ escdf_errno_t utils_hdf5_check_shape(hid_t dtspace_id, hsize_t *dims,
 {
     H5S_class_t type_id;
     int ndims_id;
-    hsize_t *dims_v, *maxdims_v;
+    hsize_t dims_v[H5S_MAX_RANK], maxdims_v[H5S_MAX_RANK];
     unsigned int i;
 
     if ((type_id = H5Sget_simple_extent_type(dtspace_id)) == H5S_NO_CLASS) {
@@ -56,36 +111,22 @@ escdf_errno_t utils_hdf5_check_shape(hid_t dtspace_id, hsize_t *dims,
         FULFILL_OR_RETURN(dims == NULL && ndims == 0, ESCDF_ERROR);
         break;
     case H5S_SIMPLE:
-        if ((ndims_id = H5Sget_simple_extent_ndims(dtspace_id)) < 0) {
-            RETURN_WITH_ERROR(ndims_id);
-        }
-        dims_v = malloc(sizeof(hsize_t) * ndims_id);
-        maxdims_v = malloc(sizeof(hsize_t) * ndims_id);
+        /* The rank is bounded by HDF5, the dimensions are kept on the stack. */
         if ((ndims_id = H5Sget_simple_extent_dims(dtspace_id, dims_v, maxdims_v)) < 0) {
-            DEFER_FUNC_ERROR(ndims_id);
-            goto cleanup_dims;
+            RETURN_WITH_ERROR(ndims_id);
         }
         FULFILL_OR_RETURN((unsigned int)ndims_id == ndims ||
                           (ndims == 0 && ndims_id == 1 &&
                            dims_v[0] == 1), ESCDF_ERROR_DIM);
         for (i = 0; i < ndims; i++) {
-            if (dims_v[i] != dims[i] || maxdims_v[i] < dims[i]) {
-                DEFER_FUNC_ERROR(ESCDF_ERROR_DIM);
-                goto cleanup_dims;
-            }
+            FULFILL_OR_RETURN(dims_v[i] == dims[i] && maxdims_v[i] >= dims[i],
+                              ESCDF_ERROR_DIM);
         }
-        free(dims_v);
-        free(maxdims_v);
         break;
     default:
         RETURN_WITH_ERROR(ESCDF_ERROR);
     }
     return ESCDF_SUCCESS;
-    
-    cleanup_dims:
-    free(dims_v);
-    free(maxdims_v);
-    return ESCDF_ERROR;
 }
 
 escdf_errno_t utils_hdf5_check_attr(hid_t loc_id, const char *name,
@@ -96,6 +137,7 @@ escdf_errno_t utils_hdf5_check_attr(hid_t loc_id, const char *name,
 
     if ((attr_id = H5Aopen(loc_id, name, H5P_DEFAULT)) < 0)
         RETURN_WITH_ERROR(attr_id);
+    utils_stats_count_open();
 
     /* Check space dimensions. */
     if ((dtspace_id = H5Aget_space(attr_id)) < 0) {
@@ -127,6 +169,7 @@ escdf_errno_t utils_hdf5_check_dtset(hid_t loc_id, const char *name,
 
     if ((dtset_id = H5Dopen(loc_id, name, H5P_DEFAULT)) < 0)
         RETURN_WITH_ERROR(dtset_id);
+    utils_stats_count_open();
 
     /* Check space dimensions. */
     if ((dtspace_id = H5Dget_space(dtset_id)) < 0) {
@@ -168,6 +211,8 @@ escdf_errno_t utils_hdf5_read_attr(hid_t loc_id, const char *name,
     if ((err_id = H5Aread(attr_id, mem_type_id, buf)) < 0) {
         DEFER_FUNC_ERROR(err_id);
         err = ESCDF_ERROR;
+    } else if (utils_stats_recording()) {
+        utils_stats_count_bytes(mem_type_id, _dims_product(dims, ndims));
     }
 
     H5Aclose(attr_id);
@@ -199,7 +244,7 @@ escdf_errno_t utils_hdf5_read_uint(hid_t loc_id, const char *name,
                                     NULL, 0, &value)) != ESCDF_SUCCESS) {
         return err;
     }
-    if (value < range[0] || value > range[1]) {
+    if (range && (value < range[0] || value > range[1])) {
         RETURN_WITH_ERROR(ESCDF_ERANGE);
     }
     *scalar = _uint_set(value);
@@ -217,7 +262,7 @@ escdf_errno_t utils_hdf5_read_int(hid_t loc_id, const char *name,
                                     NULL, 0, &value)) != ESCDF_SUCCESS) {
         return err;
     }
-    if (value < range[0] || value > range[1]) {
+    if (range && (value < range[0] || value > range[1])) {
         RETURN_WITH_ERROR(ESCDF_ERANGE);
     }
     *scalar = _int_set(value);
@@ -225,30 +270,60 @@ escdf_errno_t utils_hdf5_read_int(hid_t loc_id, const char *name,
     return ESCDF_SUCCESS;
 }
 
+escdf_errno_t utils_hdf5_read_uint_array_into(hid_t loc_id, const char *name,
+                                              unsigned int *array, hsize_t *dims,
+                                              unsigned int ndims, unsigned int range[2])
+{
+    escdf_errno_t err;
+    unsigned int min, max;
+    hsize_t len;
+
+    if ((err = utils_hdf5_read_attr(loc_id, name, H5T_NATIVE_UINT, dims, ndims,
+                                    (void*)array)) != ESCDF_SUCCESS) {
+        return err;
+    }
+    len = _dims_product(dims, ndims);
+    if (range && len > 0) {
+        utils_minmax_uint(array, len, &min, &max);
+        FULFILL_OR_RETURN(min >= range[0] && max <= range[1], ESCDF_ERANGE);
+    }
+    return ESCDF_SUCCESS;
+}
+
 escdf_errno_t utils_hdf5_read_uint_array(hid_t loc_id, const char *name,
                                          unsigned int **array, hsize_t *dims,
                                          unsigned int ndims, unsigned int range[2])
 {
     escdf_errno_t err;
-    unsigned int i;
-    hsize_t len;
 
-    len = 1;
-    for (i = 0; i < ndims; i++) {
-        len *= dims[i];
-    }
-    *array = malloc(sizeof(unsigned int) * len);
+    *array = malloc(sizeof(unsigned int) * _dims_product(dims, ndims));
+    FULFILL_OR_RETURN(*array != NULL, ESCDF_ENOMEM);
 
-    if ((err = utils_hdf5_read_attr(loc_id, name, H5T_NATIVE_UINT, dims, ndims,
-                                    (void*)*array)) != ESCDF_SUCCESS) {
+    if ((err = utils_hdf5_read_uint_array_into(loc_id, name, *array, dims,
+                                               ndims, range)) != ESCDF_SUCCESS) {
         free(*array);
+        *array = NULL;
         return err;
     }
-    for (i = 0; i < len; i++) {
-        if ((*array)[i] < range[0] || (*array)[i] > range[1]) {
-            free(*array);
-            RETURN_WITH_ERROR(ESCDF_ERANGE);
-        }
+    return ESCDF_SUCCESS;
+}
+
+escdf_errno_t utils_hdf5_read_int_array_into(hid_t loc_id, const char *name,
+                                             int *array, hsize_t *dims,
+                                             unsigned int ndims, int range[2])
+{
+    escdf_errno_t err;
+    int min, max;
+    hsize_t len;
+
+    if ((err = utils_hdf5_read_attr(loc_id, name, H5T_NATIVE_INT, dims, ndims,
+                                    (void*)array)) != ESCDF_SUCCESS) {
+        return err;
+    }
+    len = _dims_product(dims, ndims);
+    if (range && len > 0) {
+        utils_minmax_int(array, len, &min, &max);
+        FULFILL_OR_RETURN(min >= range[0] && max <= range[1], ESCDF_ERANGE);
     }
     return ESCDF_SUCCESS;
 }
@@ -258,25 +333,35 @@ escdf_errno_t utils_hdf5_read_int_array(hid_t loc_id, const char *name,
                                         unsigned int ndims, int range[2])
 {
     escdf_errno_t err;
-    unsigned int i;
-    hsize_t len;
 
-    len = 1;
-    for (i = 0; i < ndims; i++) {
-        len *= dims[i];
-    }
-    *array = malloc(sizeof(int) * len);
+    *array = malloc(sizeof(int) * _dims_product(dims, ndims));
+    FULFILL_OR_RETURN(*array != NULL, ESCDF_ENOMEM);
 
-    if ((err = utils_hdf5_read_attr(loc_id, name, H5T_NATIVE_INT, dims, ndims,
-                                    (void*)*array)) != ESCDF_SUCCESS) {
+    if ((err = utils_hdf5_read_int_array_into(loc_id, name, *array, dims,
+                                              ndims, range)) != ESCDF_SUCCESS) {
         free(*array);
+        *array = NULL;
         return err;
     }
-    for (i = 0; i < len; i++) {
-        if ((*array)[i] < range[0] || (*array)[i] > range[1]) {
-            free(*array);
-            RETURN_WITH_ERROR(ESCDF_ERANGE);
-        }
+    return ESCDF_SUCCESS;
+}
+
+escdf_errno_t utils_hdf5_read_dbl_array_into(hid_t loc_id, const char *name,
+                                             double *array, hsize_t *dims,
+                                             unsigned int ndims, double range[2])
+{
+    escdf_errno_t err;
+    double min, max;
+    hsize_t len;
+
+    if ((err = utils_hdf5_read_attr(loc_id, name, H5T_NATIVE_DOUBLE, dims, ndims,
+                                    (void*)array)) != ESCDF_SUCCESS) {
+        return err;
+    }
+    len = _dims_product(dims, ndims);
+    if (range && len > 0) {
+        utils_minmax_dbl(array, len, &min, &max);
+        FULFILL_OR_RETURN(min >= range[0] && max <= range[1], ESCDF_ERANGE);
     }
     return ESCDF_SUCCESS;
 }
@@ -286,43 +371,42 @@ escdf_errno_t utils_hdf5_read_dbl_array(hid_t loc_id, const char *name,
                                         unsigned int ndims, double range[2])
 {
     escdf_errno_t err;
-    unsigned int i;
-    hsize_t len;
 
-    len = 1;
-    for (i = 0; i < ndims; i++) {
-        len *= dims[i];
-    }
-    *array = malloc(sizeof(double) * len);
+    *array = malloc(sizeof(double) * _dims_product(dims, ndims));
+    FULFILL_OR_RETURN(*array != NULL, ESCDF_ENOMEM);
 
-    if ((err = utils_hdf5_read_attr(loc_id, name, H5T_NATIVE_DOUBLE, dims, ndims,
-                                    (void*)*array)) != ESCDF_SUCCESS) {
+    if ((err = utils_hdf5_read_dbl_array_into(loc_id, name, *array, dims,
+                                              ndims, range)) != ESCDF_SUCCESS) {
         free(*array);
+        *array = NULL;
         return err;
     }
-    for (i = 0; i < len; i++) {
-        if ((*array)[i] < range[0] || (*array)[i] > range[1]) {
-            free(*array);
-            RETURN_WITH_ERROR(ESCDF_ERANGE);
-        }
-    }
     return ESCDF_SUCCESS;
 }
 
 escdf_errno_t utils_hdf5_create_group(hid_t loc_id, const char *path, hid_t *group_pt)
 {
     char *token, *lpath;
-    hid_t group_id;
+    hid_t group_id, parent_id;
 
     group_id = loc_id;
     lpath = strdup(path);
     for (token = strtok(lpath, "/"); token != NULL; token = strtok(NULL, "/")) {
-        if (utils_hdf5_check_present(group_id, token)) {
-            group_id = H5Gopen(group_id, path, H5P_DEFAULT);
+        parent_id = group_id;
+        if (utils_hdf5_check_present(parent_id, token)) {
+            group_id = H5Gopen(parent_id, token, H5P_DEFAULT);
+            utils_stats_count_open();
         } else {
-            group_id = H5Gcreate(group_id, token, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+            group_id = H5Gcreate(parent_id, token, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        }
+        /* Intermediate groups are not needed anymore. */
+        if (parent_id != loc_id) {
+            H5Gclose(parent_id);
         }
         DEFER_TEST_ERROR(group_id >= 0, ESCDF_ERROR);
+        if (group_id < 0) {
+            break;
+        }
     }
     free(lpath);
 
@@ -336,16 +420,26 @@ escdf_errno_t utils_hdf5_create_group(hid_t loc_id, const char *path, hid_t *gro
 
 escdf_errno_t utils_hdf5_create_dataset(hid_t loc_id, const char *name,
                                         hid_t type_id, hsize_t *dims,
-                                        unsigned int ndims, hid_t *dtset_pt)
+                                        unsigned int ndims, hid_t dcpl_id,
+                                        hid_t *dtset_pt)
+{
+    return utils_hdf5_create_dataset_max(loc_id, name, type_id, dims, NULL,
+                                         ndims, dcpl_id, dtset_pt);
+}
+
+escdf_errno_t utils_hdf5_create_dataset_max(hid_t loc_id, const char *name,
+                                            hid_t type_id, hsize_t *dims,
+                                            hsize_t *maxdims, unsigned int ndims,
+                                            hid_t dcpl_id, hid_t *dtset_pt)
 {
     hid_t dtset_id, dtspace_id;
 
     /* Create space dimensions. */
-    if ((dtspace_id = H5Screate_simple(ndims, dims, NULL)) < 0) {
+    if ((dtspace_id = H5Screate_simple(ndims, dims, maxdims)) < 0) {
         RETURN_WITH_ERROR(dtspace_id);
     }
 
-    if ((dtset_id = H5Dcreate(loc_id, name, type_id, dtspace_id, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT)) < 0) {
+    if ((dtset_id = H5Dcreate(loc_id, name, type_id, dtspace_id, H5P_DEFAULT, dcpl_id, H5P_DEFAULT)) < 0) {
         DEFER_FUNC_ERROR(dtset_id);
         goto cleanup_dtspace;
     }
@@ -358,7 +452,7 @@ escdf_errno_t utils_hdf5_create_dataset(hid_t loc_id, const char *name,
     return ESCDF_SUCCESS;
 
     cleanup_dtspace:
-    H5Sclose(dtset_id);
+    H5Sclose(dtspace_id);
     return ESCDF_ERROR;
 }
 
@@ -416,64 +510,258 @@ escdf_errno_t utils_hdf5_write_attr(hid_t loc_id, const char *name,
     if ((err_id = H5Awrite(attr_id, mem_type_id, buf)) < 0) {
         DEFER_FUNC_ERROR(err_id);
         err = ESCDF_ERROR;
+    } else if (utils_stats_recording()) {
+        utils_stats_count_bytes(mem_type_id, _dims_product(dims, ndims));
     }
 
     H5Aclose(attr_id);
     return err;
 }
 
-escdf_errno_t utils_hdf5_select_slice(hid_t dtset_id,
-                                      hid_t *diskspace_id,
-                                      hid_t *memspace_id,
-                                      const hsize_t *start,
-                                      const hsize_t *count,
-                                      const hsize_t *stride)
+utils_hdf5_conv_t utils_hdf5_conversion(hid_t mem_type_id, hid_t disk_type_id)
+{
+    hid_t type_id;
+    H5T_order_t order;
+    htri_t same;
+
+    if (H5Tequal(mem_type_id, disk_type_id) > 0) {
+        return UTILS_HDF5_CONV_NONE;
+    }
+
+    /* Same type but for the byte order? */
+    if ((order = H5Tget_order(mem_type_id)) != H5T_ORDER_LE && order != H5T_ORDER_BE) {
+        return UTILS_HDF5_CONV_HDF5;
+    }
+    if (H5Tget_order(disk_type_id) == order ||
+        (type_id = H5Tcopy(disk_type_id)) < 0) {
+        return UTILS_HDF5_CONV_HDF5;
+    }
+    same = (H5Tset_order(type_id, order) >= 0) ? H5Tequal(type_id, mem_type_id) : 0;
+    H5Tclose(type_id);
+
+    return (same > 0) ? UTILS_HDF5_CONV_SWAP : UTILS_HDF5_CONV_HDF5;
+}
+
+escdf_errno_t utils_hdf5_selection_init(utils_hdf5_selection_t *sel,
+                                        hid_t dtset_id)
+{
+    if ((sel->diskspace_id = H5Dget_space(dtset_id)) < 0) {
+        RETURN_WITH_ERROR(sel->diskspace_id);
+    }
+    if ((sel->memspace_id = H5Screate(H5S_NULL)) < 0) {
+        H5Sclose(sel->diskspace_id);
+        RETURN_WITH_ERROR(sel->memspace_id);
+    }
+    if ((sel->type_id = H5Dget_type(dtset_id)) < 0) {
+        H5Sclose(sel->diskspace_id);
+        H5Sclose(sel->memspace_id);
+        RETURN_WITH_ERROR(sel->type_id);
+    }
+    sel->len = 0;
+
+    return ESCDF_SUCCESS;
+}
+
+void utils_hdf5_selection_free(utils_hdf5_selection_t *sel)
+{
+    H5Sclose(sel->diskspace_id);
+    H5Sclose(sel->memspace_id);
+    H5Tclose(sel->type_id);
+}
+
+/* Give the memory space the size of the disk selection, only if it changed. */
+static escdf_errno_t _selection_resize(utils_hdf5_selection_t *sel, hsize_t len)
 {
     herr_t err_id;
-    hssize_t len;
-    hsize_t len_;
 
-    /* disk use the start, count and stride. */
-    if ((*diskspace_id = H5Dget_space(dtset_id)) < 0) {
-        RETURN_WITH_ERROR(*diskspace_id);
+    if (len == sel->len) {
+        return ESCDF_SUCCESS;
     }
+    if (len > 0) {
+        /* memory is a flat array with the size on the slice. */
+        err_id = H5Sset_extent_simple(sel->memspace_id, 1, &len, NULL);
+    } else {
+        err_id = H5Sset_extent_none(sel->memspace_id);
+    }
+    if (err_id < 0) {
+        RETURN_WITH_ERROR(err_id);
+    }
+    sel->len = len;
+
+    return ESCDF_SUCCESS;
+}
 
-    /* create dataspace for memory and disk. */
+escdf_errno_t utils_hdf5_selection_set_slice(utils_hdf5_selection_t *sel,
+                                             const hsize_t *start,
+                                             const hsize_t *count,
+                                             const hsize_t *stride)
+{
+    herr_t err_id;
+    hssize_t len;
+
+    /* disk use the start, count and stride. */
     if (start && count) {
-        if ((err_id = H5Sselect_hyperslab(*diskspace_id, H5S_SELECT_SET,
-                                          start, stride, count, NULL)) < 0) {
-            H5Sclose(*diskspace_id);
-            RETURN_WITH_ERROR(err_id);
-        }
+        err_id = H5Sselect_hyperslab(sel->diskspace_id, H5S_SELECT_SET,
+                                     start, stride, count, NULL);
     } else {
-        if ((err_id = H5Sselect_all(*diskspace_id)) < 0) {
-            H5Sclose(*diskspace_id);
-            RETURN_WITH_ERROR(err_id);
-        }
+        err_id = H5Sselect_all(sel->diskspace_id);
     }
-    if ((len = H5Sget_select_npoints(*diskspace_id)) < 0) {
-        H5Sclose(*diskspace_id);
+    if (err_id < 0) {
+        RETURN_WITH_ERROR(err_id);
+    }
+    utils_stats_count_selection();
+    if ((len = H5Sget_select_npoints(sel->diskspace_id)) < 0) {
         RETURN_WITH_ERROR(len);
     }
     if (!len) {
-        if ((err_id = H5Sselect_none(*diskspace_id)) < 0) {
-            H5Sclose(*diskspace_id);
+        if ((err_id = H5Sselect_none(sel->diskspace_id)) < 0) {
             RETURN_WITH_ERROR(err_id);
         }
     }
 
-    if (len > 0) {
-        len_ = (hsize_t)len;
-        /* memory is a flat array with the size on the slice. */
-        *memspace_id = H5Screate_simple(1, &len_, NULL);
+    return _selection_resize(sel, (hsize_t)len);
+}
+
+escdf_errno_t utils_hdf5_selection_set_elements(utils_hdf5_selection_t *sel,
+                                                size_t num_points,
+                                                const hsize_t *coord)
+{
+    herr_t err_id;
+
+    if (num_points) {
+        err_id = H5Sselect_elements(sel->diskspace_id, H5S_SELECT_SET,
+                                    num_points, coord);
+        utils_stats_count_selection();
     } else {
-        *memspace_id = H5Screate(H5S_NULL);
+        err_id = H5Sselect_none(sel->diskspace_id);
     }
-    if (*memspace_id < 0) {
-        H5Sclose(*diskspace_id);
-        RETURN_WITH_ERROR(*memspace_id);
+    if (err_id < 0) {
+        RETURN_WITH_ERROR(err_id);
     }
 
+    return _selection_resize(sel, (hsize_t)num_points);
+}
+
+escdf_errno_t utils_hdf5_selection_set_rows(utils_hdf5_selection_t *sel,
+                                            size_t nranges,
+                                            const hsize_t *ranges)
+{
+    herr_t err_id;
+    hssize_t len;
+    hsize_t start[H5S_MAX_RANK], count[H5S_MAX_RANK];
+    size_t i;
+    int rank;
+
+    if ((rank = H5Sget_simple_extent_dims(sel->diskspace_id, count, NULL)) <= 0) {
+        RETURN_WITH_ERROR(ESCDF_ERROR_DIM);
+    }
+    memset(start, 0, sizeof(hsize_t) * rank);
+
+    err_id = H5Sselect_none(sel->diskspace_id);
+    for (i = 0; i < nranges && err_id >= 0; i++) {
+        if (ranges[2 * i + 1] == 0) {
+            continue;
+        }
+        start[0] = ranges[2 * i];
+        count[0] = ranges[2 * i + 1];
+        err_id = H5Sselect_hyperslab(sel->diskspace_id, H5S_SELECT_OR,
+                                     start, NULL, count, NULL);
+    }
+    if (err_id < 0) {
+        RETURN_WITH_ERROR(err_id);
+    }
+    utils_stats_count_selection();
+    if ((len = H5Sget_select_npoints(sel->diskspace_id)) < 0) {
+        RETURN_WITH_ERROR(len);
+    }
+
+    return _selection_resize(sel, (hsize_t)len);
+}
+
+escdf_errno_t utils_hdf5_selection_set_hyperslabs(utils_hdf5_selection_t *sel,
+                                                  size_t n,
+                                                  const hsize_t *starts,
+                                                  const hsize_t *strides,
+                                                  const hsize_t *counts,
+                                                  const hsize_t *blocks)
+{
+    herr_t err_id;
+    hssize_t len;
+    size_t i;
+    int rank;
+
+    if ((rank = H5Sget_simple_extent_ndims(sel->diskspace_id)) <= 0) {
+        RETURN_WITH_ERROR(ESCDF_ERROR_DIM);
+    }
+
+    err_id = H5Sselect_none(sel->diskspace_id);
+    for (i = 0; i < n && err_id >= 0; i++) {
+        err_id = H5Sselect_hyperslab(sel->diskspace_id, H5S_SELECT_OR, starts + i * rank,
+                                     (strides) ? strides + i * rank : NULL,
+                                     counts + i * rank, blocks + i * rank);
+    }
+    if (err_id < 0) {
+        RETURN_WITH_ERROR(err_id);
+    }
+    utils_stats_count_selection();
+    if ((len = H5Sget_select_npoints(sel->diskspace_id)) < 0) {
+        RETURN_WITH_ERROR(len);
+    }
+
+    return _selection_resize(sel, (hsize_t)len);
+}
+
+escdf_errno_t utils_hdf5_selection_write(const utils_hdf5_selection_t *sel,
+                                         hid_t dtset_id,
+                                         hid_t xfer_id,
+                                         hid_t mem_type_id,
+                                         const void *buf)
+{
+    herr_t err_id;
+    void *swapped;
+    size_t size;
+
+    swapped = NULL;
+    if (sel->len > 0 && utils_hdf5_conversion(mem_type_id, sel->type_id) == UTILS_HDF5_CONV_SWAP) {
+        /* The values are swapped in a copy, then written as they are on disk. */
+        size = H5Tget_size(mem_type_id);
+        swapped = malloc(size * sel->len);
+        FULFILL_OR_RETURN(swapped != NULL, ESCDF_ENOMEM);
+        memcpy(swapped, buf, size * sel->len);
+        utils_swap_bytes(swapped, sel->len, size);
+    }
+    err_id = H5Dwrite(dtset_id, swapped ? sel->type_id : mem_type_id, sel->memspace_id,
+                      sel->diskspace_id, xfer_id, swapped ? swapped : buf);
+    free(swapped);
+    if (err_id < 0) {
+        RETURN_WITH_ERROR(err_id);
+    }
+    utils_stats_count_bytes(mem_type_id, sel->len);
+
+    return ESCDF_SUCCESS;
+}
+
+escdf_errno_t utils_hdf5_selection_read(const utils_hdf5_selection_t *sel,
+                                        hid_t dtset_id,
+                                        hid_t xfer_id,
+                                        hid_t mem_type_id,
+                                        void *buf)
+{
+    herr_t err_id;
+    bool swap;
+
+    /* The values are read as they are on disk, then swapped in place. */
+    swap = sel->len > 0 &&
+        utils_hdf5_conversion(mem_type_id, sel->type_id) == UTILS_HDF5_CONV_SWAP;
+    if ((err_id = H5Dread(dtset_id, swap ? sel->type_id : mem_type_id, sel->memspace_id,
+                          sel->diskspace_id, xfer_id, buf)) < 0) {
+        RETURN_WITH_ERROR(err_id);
+    }
+    if (swap) {
+        utils_swap_bytes(buf, sel->len, H5Tget_size(mem_type_id));
+    }
+    utils_stats_count_bytes(mem_type_id, sel->len);
+
     return ESCDF_SUCCESS;
 }
 
@@ -486,25 +774,87 @@ escdf_errno_t utils_hdf5_write_dataset(hid_t dtset_id,
                                        const hsize_t *stride)
 {
     escdf_errno_t err;
-    hid_t memspace_id, diskspace_id;
-    herr_t err_id;
+    utils_hdf5_selection_t sel;
 
-    err = utils_hdf5_select_slice(dtset_id, &diskspace_id, &memspace_id,
-                                  start, count, stride);
+    err = utils_hdf5_selection_init(&sel, dtset_id);
     FULFILL_OR_RETURN(err == ESCDF_SUCCESS, err);
     
-    /* Write */
-    if ((err_id = H5Dwrite(dtset_id, mem_type_id, memspace_id,
-                           diskspace_id, xfer_id, buf)) < 0) {
-        H5Sclose(diskspace_id);
-        H5Sclose(memspace_id);
-        RETURN_WITH_ERROR(err_id);
+    err = utils_hdf5_selection_set_slice(&sel, start, count, stride);
+    if (err == ESCDF_SUCCESS) {
+        err = utils_hdf5_selection_write(&sel, dtset_id, xfer_id, mem_type_id, buf);
     }
 
-    H5Sclose(diskspace_id);
-    H5Sclose(memspace_id);
+    utils_hdf5_selection_free(&sel);
+    return err;
+}
+
+escdf_errno_t utils_hdf5_write_datasets(size_t n,
+                                        const hid_t *dtset_ids,
+                                        hid_t xfer_id,
+                                        const void **bufs,
+                                        const hid_t *mem_type_ids,
+                                        const hsize_t **starts,
+                                        const hsize_t **counts,
+                                        const hsize_t **strides)
+{
+    escdf_errno_t err;
+    utils_hdf5_selection_t *sels;
+#ifdef HAVE_H5DWRITE_MULTI
+    hid_t *spaces;
+    herr_t err_id;
+#endif
+    size_t i, nsel;
 
-    return ESCDF_SUCCESS;
+    sels = malloc(sizeof(utils_hdf5_selection_t) * n);
+    FULFILL_OR_RETURN(sels != NULL, ESCDF_ENOMEM);
+    err = ESCDF_SUCCESS;
+    for (nsel = 0; nsel < n; nsel++) {
+        if ((err = utils_hdf5_selection_init(sels + nsel, dtset_ids[nsel])) != ESCDF_SUCCESS) {
+            goto cleanup;
+        }
+        if ((err = utils_hdf5_selection_set_slice(sels + nsel, starts[nsel], counts[nsel],
+                                                  strides[nsel])) != ESCDF_SUCCESS) {
+            nsel += 1;
+            goto cleanup;
+        }
+    }
+
+#ifdef HAVE_H5DWRITE_MULTI
+    /* Disk spaces first, then memory spaces. */
+    spaces = malloc(sizeof(hid_t) * 2 * n);
+    if (spaces == NULL) {
+        DEFER_FUNC_ERROR(ESCDF_ENOMEM);
+        err = ESCDF_ENOMEM;
+        goto cleanup;
+    }
+    for (i = 0; i < n; i++) {
+        spaces[i] = sels[i].diskspace_id;
+        spaces[n + i] = sels[i].memspace_id;
+    }
+    err_id = H5Dwrite_multi(n, (hid_t*)dtset_ids, (hid_t*)mem_type_ids,
+                            spaces + n, spaces, xfer_id, bufs);
+    free(spaces);
+    if (err_id < 0) {
+        DEFER_FUNC_ERROR(err_id);
+        err = ESCDF_ERROR;
+        goto cleanup;
+    }
+    for (i = 0; i < n; i++) {
+        utils_stats_count_bytes(mem_type_ids[i], sels[i].len);
+    }
+#else
+    for (i = 0; i < n && err == ESCDF_SUCCESS; i++) {
+        err = utils_hdf5_selection_write(sels + i, dtset_ids[i], xfer_id,
+                                         mem_type_ids[i], bufs[i]);
+    }
+#endif
+
+    cleanup:
+    for (i = 0; i < nsel; i++) {
+        utils_hdf5_selection_free(sels + i);
+    }
+    free(sels);
+    return err;
 }
 
 escdf_errno_t utils_hdf5_read_dataset(hid_t dtset_id,
@@ -516,26 +866,18 @@ escdf_errno_t utils_hdf5_read_dataset(hid_t dtset_id,
                                       const hsize_t *stride)
 {
     escdf_errno_t err;
-    hid_t memspace_id, diskspace_id;
-    herr_t err_id;
+    utils_hdf5_selection_t sel;
 
-    if ((err = utils_hdf5_select_slice(dtset_id, &diskspace_id, &memspace_id,
-                                       start, count, stride)) != ESCDF_SUCCESS) {
-        return err;
-    }
+    err = utils_hdf5_selection_init(&sel, dtset_id);
+    FULFILL_OR_RETURN(err == ESCDF_SUCCESS, err);
     
-    /* Read */
-    if ((err_id = H5Dread(dtset_id, mem_type_id, memspace_id,
-                          diskspace_id, xfer_id, buf)) < 0) {
-        H5Sclose(diskspace_id);
-        H5Sclose(memspace_id);
-        RETURN_WITH_ERROR(err_id);
+    err = utils_hdf5_selection_set_slice(&sel, start, count, stride);
+    if (err == ESCDF_SUCCESS) {
+        err = utils_hdf5_selection_read(&sel, dtset_id, xfer_id, mem_type_id, buf);
     }
 
-    H5Sclose(diskspace_id);
-    H5Sclose(memspace_id);
-
-    return ESCDF_SUCCESS;
+    utils_hdf5_selection_free(&sel);
+    return err;
 }
 
 escdf_errno_t utils_hdf5_read_dataset_at(hid_t dtset_id,
@@ -545,48 +887,241 @@ escdf_errno_t utils_hdf5_read_dataset_at(hid_t dtset_id,
                                          size_t num_points,
                                          const hsize_t *coord)
 {
-    hid_t memspace_id, diskspace_id;
-    herr_t err_id;
-    hsize_t len;
+    escdf_errno_t err;
+    utils_hdf5_selection_t sel;
 
-    /* disk use the start, count and stride. */
-    if ((diskspace_id = H5Dget_space(dtset_id)) < 0) {
-        RETURN_WITH_ERROR(diskspace_id);
-    }
+    err = utils_hdf5_selection_init(&sel, dtset_id);
+    FULFILL_OR_RETURN(err == ESCDF_SUCCESS, err);
     
-    if (num_points) {
-        if ((err_id = H5Sselect_elements(diskspace_id, H5S_SELECT_SET,
-                                         num_points, coord)) < 0) {
-            H5Sclose(diskspace_id);
-            RETURN_WITH_ERROR(err_id);
-        }
-        /* memory is a flat array with the size on the slice. */
-        len = (hsize_t)num_points;
-        memspace_id = H5Screate_simple(1, &len, NULL);
-    } else {
-        if ((err_id = H5Sselect_none(diskspace_id)) < 0) {
-            H5Sclose(diskspace_id);
-            RETURN_WITH_ERROR(err_id);
+    err = utils_hdf5_selection_set_elements(&sel, num_points, coord);
+    if (err == ESCDF_SUCCESS) {
+        err = utils_hdf5_selection_read(&sel, dtset_id, xfer_id, mem_type_id, buf);
+    }
+
+    utils_hdf5_selection_free(&sel);
+    return err;
+}
+
+bool utils_hdf5_direct_chunks(hid_t dtset_id, hid_t mem_type_id,
+                              hsize_t *chunk, unsigned int ndims,
+                              unsigned int *deflate_level)
+{
+#if defined HAVE_H5DWRITE_CHUNK && defined HAVE_H5DREAD_CHUNK
+    hid_t dcpl_id, type_id, file_id, fapl_id;
+    unsigned int flags, cd_values[1];
+    size_t cd_nelmts;
+    bool direct;
+
+    if ((dcpl_id = H5Dget_create_plist(dtset_id)) < 0)
+        return false;
+    direct = (H5Pget_layout(dcpl_id) == H5D_CHUNKED &&
+              H5Pget_chunk(dcpl_id, (int)ndims, chunk) == (int)ndims);
+    *deflate_level = 0;
+    if (direct && H5Pget_nfilters(dcpl_id) > 0) {
+        cd_nelmts = 1;
+        cd_values[0] = 0;
+        direct = (H5Pget_nfilters(dcpl_id) == 1 &&
+                  H5Pget_filter2(dcpl_id, 0, &flags, &cd_nelmts, cd_values,
+                                 0, NULL, NULL) == H5Z_FILTER_DEFLATE);
+#ifdef HAVE_ZLIB
+        *deflate_level = (cd_values[0] > 0) ? cd_values[0] : 1;
+#else
+        direct = false;
+#endif
+    }
+    H5Pclose(dcpl_id);
+
+    /* The bytes of the chunks are stored as is. */
+    if (direct && (type_id = H5Dget_type(dtset_id)) >= 0) {
+        direct = (H5Tequal(type_id, mem_type_id) > 0);
+        H5Tclose(type_id);
+    }
+
+    /* Chunks are allocated collectively with MPI-IO. */
+    if (direct && (file_id = H5Iget_file_id(dtset_id)) >= 0) {
+        if ((fapl_id = H5Fget_access_plist(file_id)) >= 0) {
+#ifdef H5_HAVE_PARALLEL
+            direct = (H5Pget_driver(fapl_id) != H5FD_MPIO);
+#endif
+            H5Pclose(fapl_id);
         }
-        memspace_id = H5Screate(H5S_NULL);
+        H5Fclose(file_id);
     }
-    if (memspace_id < 0) {
-        H5Sclose(diskspace_id);
-        RETURN_WITH_ERROR(memspace_id);
+
+    return direct;
+#else
+    return false;
+#endif
+}
+
+escdf_errno_t utils_hdf5_write_chunk(hid_t dtset_id, hid_t xfer_id,
+                                     const hsize_t *offset,
+                                     const void *buf, size_t size)
+{
+#ifdef HAVE_H5DWRITE_CHUNK
+    herr_t err_id;
+
+    if ((err_id = H5Dwrite_chunk(dtset_id, xfer_id, 0, offset, size, buf)) < 0) {
+        RETURN_WITH_ERROR(err_id);
     }
 
-    /* Read */
-    if ((err_id = H5Dread(dtset_id, mem_type_id, memspace_id,
-                          diskspace_id, xfer_id, buf)) < 0) {
-        H5Sclose(diskspace_id);
-        H5Sclose(memspace_id);
+    return ESCDF_SUCCESS;
+#else
+    RETURN_WITH_ERROR(ESCDF_ENOSUPPORT);
+#endif
+}
+
+escdf_errno_t utils_hdf5_read_chunk(hid_t dtset_id, hid_t xfer_id,
+                                    const hsize_t *offset,
+                                    void **buf, size_t *size)
+{
+#ifdef HAVE_H5DREAD_CHUNK
+    hsize_t nbytes;
+    uint32_t filter_mask;
+    herr_t err_id;
+
+    *buf = NULL;
+    *size = 0;
+    if ((err_id = H5Dget_chunk_storage_size(dtset_id, offset, &nbytes)) < 0) {
         RETURN_WITH_ERROR(err_id);
     }
+    if (nbytes == 0)
+        return ESCDF_SUCCESS;
+
+    *buf = malloc(nbytes);
+    FULFILL_OR_RETURN(*buf != NULL, ESCDF_ENOMEM);
+    if ((err_id = H5Dread_chunk(dtset_id, xfer_id, offset, &filter_mask, *buf)) < 0) {
+        free(*buf);
+        *buf = NULL;
+        RETURN_WITH_ERROR(err_id);
+    }
+    /* A skipped filter would leave the bytes in an unknown state. */
+    if (filter_mask != 0) {
+        free(*buf);
+        *buf = NULL;
+        RETURN_WITH_ERROR(ESCDF_EFILE_FORMAT);
+    }
+    *size = (size_t)nbytes;
 
-    H5Sclose(diskspace_id);
-    H5Sclose(memspace_id);
+    return ESCDF_SUCCESS;
+#else
+    RETURN_WITH_ERROR(ESCDF_ENOSUPPORT);
+#endif
+}
+
+escdf_errno_t utils_hdf5_map_dataset(hid_t dtset_id, hid_t mem_type_id,
+                                     void **addr, size_t *len,
+                                     const void **buf)
+{
+#if defined HAVE_SYS_MMAN_H && defined HAVE_MMAP
+    hid_t dcpl_id, type_id, file_id, fapl_id;
+    haddr_t offset;
+    hsize_t nbytes;
+    ssize_t name_len;
+    unsigned int intent;
+    char *name;
+    off_t aligned;
+    long page;
+    int fd, *vfd;
+    struct stat vfd_stat, fd_stat;
+    bool mappable;
+    void *map;
+
+    *addr = NULL;
+    *len = 0;
+    *buf = NULL;
+
+    /* The bytes must be in one piece in the file, stored as in memory. */
+    if ((dcpl_id = H5Dget_create_plist(dtset_id)) < 0) {
+        RETURN_WITH_ERROR(dcpl_id);
+    }
+    mappable = (H5Pget_layout(dcpl_id) == H5D_CONTIGUOUS &&
+                H5Pget_nfilters(dcpl_id) == 0 &&
+                H5Pget_external_count(dcpl_id) == 0);
+    H5Pclose(dcpl_id);
+    if (mappable && (type_id = H5Dget_type(dtset_id)) >= 0) {
+        mappable = (H5Tequal(type_id, mem_type_id) > 0);
+        H5Tclose(type_id);
+    }
+    if (!mappable) {
+        RETURN_WITH_ERROR(ESCDF_ENOSUPPORT);
+    }
+    /* The offset includes the user block, if any. */
+    offset = H5Dget_offset(dtset_id);
+    nbytes = H5Dget_storage_size(dtset_id);
+    if (offset == HADDR_UNDEF || nbytes == 0) {
+        RETURN_WITH_ERROR(ESCDF_ENOSUPPORT);
+    }
+
+    /* Only the default driver keeps the file as is on disk. */
+    if ((file_id = H5Iget_file_id(dtset_id)) < 0) {
+        RETURN_WITH_ERROR(file_id);
+    }
+    if ((fapl_id = H5Fget_access_plist(file_id)) >= 0) {
+        mappable = (H5Pget_driver(fapl_id) == H5FD_SEC2);
+        H5Pclose(fapl_id);
+    } else {
+        mappable = false;
+    }
+    /* Pending raw data must reach the file before it is mapped. */
+    if (mappable && H5Fget_intent(file_id, &intent) >= 0 &&
+        (intent & H5F_ACC_RDWR))
+        mappable = (H5Fflush(file_id, H5F_SCOPE_LOCAL) >= 0);
+    /* The file of the driver, to check that the one reopened by name is
+       the same: a relative name may lead elsewhere after a change of
+       directory. The descriptor of the driver itself cannot be mapped, as
+       the mapping would keep the lock of HDF5 on the file after it is
+       closed. */
+    vfd = NULL;
+    if (mappable && (H5Fget_vfd_handle(file_id, H5P_DEFAULT, (void **)&vfd) < 0 ||
+                     vfd == NULL || fstat(*vfd, &vfd_stat) != 0))
+        mappable = false;
+    name = NULL;
+    if (mappable && (name_len = H5Fget_name(file_id, NULL, 0)) > 0 &&
+        (name = malloc(name_len + 1)) != NULL)
+        H5Fget_name(file_id, name, name_len + 1);
+    H5Fclose(file_id);
+    if (name == NULL) {
+        RETURN_WITH_ERROR(ESCDF_ENOSUPPORT);
+    }
+
+    fd = open(name, O_RDONLY);
+    free(name);
+    if (fd < 0) {
+        RETURN_WITH_ERROR(ESCDF_ENOSUPPORT);
+    }
+    if (fstat(fd, &fd_stat) != 0 || fd_stat.st_dev != vfd_stat.st_dev ||
+        fd_stat.st_ino != vfd_stat.st_ino) {
+        close(fd);
+        RETURN_WITH_ERROR(ESCDF_ENOSUPPORT);
+    }
+    page = sysconf(_SC_PAGESIZE);
+    aligned = (off_t)(offset - offset % (haddr_t)page);
+    *len = (size_t)(offset - aligned + nbytes);
+    map = mmap(NULL, *len, PROT_READ, MAP_SHARED, fd, aligned);
+    close(fd);
+    if (map == MAP_FAILED) {
+        *len = 0;
+        RETURN_WITH_ERROR(ESCDF_EIO);
+    }
+    *addr = map;
+    *buf = (const char *)map + (offset - aligned);
 
     return ESCDF_SUCCESS;
+#else
+    *addr = NULL;
+    *len = 0;
+    *buf = NULL;
+    RETURN_WITH_ERROR(ESCDF_ENOSUPPORT);
+#endif
+}
+
+void utils_hdf5_unmap(void *addr, size_t len)
+{
+#if defined HAVE_SYS_MMAN_H && defined HAVE_MMAP
+    if (addr != NULL)
+        munmap(addr, len);
+#endif
 }
 
 #if H5_VERS_MINOR < 8 || H5_VERS_RELEASE < 5
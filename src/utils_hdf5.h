@@ -23,6 +23,15 @@
 #include "utils.h"
 #include <hdf5.h>
 
+/**
+ * Serialise HDF5 calls among threads. The lock is recursive and shared by the
+ * whole library, since HDF5 keeps global state. CPU-side work should be done
+ * outside of it.
+ */
+void utils_hdf5_lock(void);
+
+void utils_hdf5_unlock(void);
+
 bool utils_hdf5_check_present(hid_t loc_id, const char *name);
 
 escdf_errno_t utils_hdf5_check_shape(hid_t dtspace_id, hsize_t *dims,
@@ -43,6 +52,13 @@ escdf_errno_t utils_hdf5_read_attr(hid_t loc_id, const char *name,
 escdf_errno_t utils_hdf5_read_bool(hid_t loc_id, const char *name,
                                    _bool_set_t *scalar);
 
+/**
+ * Read a scalar or an array attribute and check that its values are within
+ * range, unless range is NULL, e.g. for a trusted file or when the check is
+ * done later by the caller. The read_*_array() functions allocate the array,
+ * the read_*_array_into() ones fill the caller's array of product(dims)
+ * values.
+ */
 escdf_errno_t utils_hdf5_read_int(hid_t loc_id, const char *name,
                                   _int_set_t *scalar, int range[2]);
 
@@ -53,20 +69,46 @@ escdf_errno_t utils_hdf5_read_int_array(hid_t loc_id, const char *name,
                                         int **array, hsize_t *dims,
                                         unsigned int ndims, int range[2]);
 
+escdf_errno_t utils_hdf5_read_int_array_into(hid_t loc_id, const char *name,
+                                             int *array, hsize_t *dims,
+                                             unsigned int ndims, int range[2]);
+
 escdf_errno_t utils_hdf5_read_uint_array(hid_t loc_id, const char *name,
                                          unsigned int **array, hsize_t *dims,
                                          unsigned int ndims, unsigned int
                                          range[2]);
 
+escdf_errno_t utils_hdf5_read_uint_array_into(hid_t loc_id, const char *name,
+                                              unsigned int *array, hsize_t *dims,
+                                              unsigned int ndims, unsigned int
+                                              range[2]);
+
 escdf_errno_t utils_hdf5_read_dbl_array(hid_t loc_id, const char *name,
                                         double **array, hsize_t *dims,
                                         unsigned int ndims, double range[2]);
 
+escdf_errno_t utils_hdf5_read_dbl_array_into(hid_t loc_id, const char *name,
+                                             double *array, hsize_t *dims,
+                                             unsigned int ndims, double range[2]);
+
 escdf_errno_t utils_hdf5_create_group(hid_t loc_id, const char *path, hid_t *group_pt);
 
+/**
+ * Create a dataset, with the creation properties dcpl_id (e.g. chunking and
+ * filters) or H5P_DEFAULT for a contiguous layout.
+ */
 escdf_errno_t utils_hdf5_create_dataset(hid_t loc_id, const char *name,
                                         hid_t type_id, hsize_t *dims, unsigned
-                                        int ndims, hid_t *dtset_pt);
+                                        int ndims, hid_t dcpl_id, hid_t *dtset_pt);
+
+/**
+ * Same as utils_hdf5_create_dataset(), with maxdims the maximum dimensions,
+ * e.g. H5S_UNLIMITED for an appendable dimension of a chunked data set.
+ */
+escdf_errno_t utils_hdf5_create_dataset_max(hid_t loc_id, const char *name,
+                                            hid_t type_id, hsize_t *dims,
+                                            hsize_t *maxdims, unsigned int ndims,
+                                            hid_t dcpl_id, hid_t *dtset_pt);
 
 escdf_errno_t utils_hdf5_write_attr(hid_t loc_id, const char *name,
                                     hid_t disk_type_id, hsize_t *dims,
@@ -81,6 +123,99 @@ escdf_errno_t utils_hdf5_write_dataset(hid_t dtset_id,
                                        const hsize_t *count,
                                        const hsize_t *stride);
 
+/**
+ * Write n data sets in a single transfer, with H5Dwrite_multi when HDF5
+ * provides it, otherwise with one H5Dwrite per data set. The selections are
+ * given as in utils_hdf5_write_dataset(), per data set.
+ */
+escdf_errno_t utils_hdf5_write_datasets(size_t n,
+                                        const hid_t *dtset_ids,
+                                        hid_t xfer_id,
+                                        const void **bufs,
+                                        const hid_t *mem_type_ids,
+                                        const hsize_t **starts,
+                                        const hsize_t **counts,
+                                        const hsize_t **strides);
+
+/**
+ * How values of a memory type are converted to or from a disk type: not at
+ * all, by the library swapping their bytes when the types only differ by
+ * their byte order, or by HDF5 otherwise.
+ */
+typedef enum {
+    UTILS_HDF5_CONV_NONE,
+    UTILS_HDF5_CONV_SWAP,
+    UTILS_HDF5_CONV_HDF5
+} utils_hdf5_conv_t;
+
+utils_hdf5_conv_t utils_hdf5_conversion(hid_t mem_type_id, hid_t disk_type_id);
+
+/**
+ * A disk and memory dataspace pair, for a series of selections on the same
+ * data set: the dataspaces are created once by utils_hdf5_selection_init(),
+ * then re-targeted by each set_slice() or set_elements(), the memory one
+ * being only resized when the number of selected points changes. Reads and
+ * writes through a selection convert values whose memory type only differs
+ * from the data set type by its byte order with utils_swap_bytes().
+ */
+typedef struct {
+    hid_t diskspace_id;
+    hid_t memspace_id;
+    hid_t type_id;
+    hsize_t len;
+} utils_hdf5_selection_t;
+
+escdf_errno_t utils_hdf5_selection_init(utils_hdf5_selection_t *sel,
+                                        hid_t dtset_id);
+
+void utils_hdf5_selection_free(utils_hdf5_selection_t *sel);
+
+/**
+ * Select a hyperslab as in utils_hdf5_write_dataset(), or the whole data
+ * set when start or count is NULL.
+ */
+escdf_errno_t utils_hdf5_selection_set_slice(utils_hdf5_selection_t *sel,
+                                             const hsize_t *start,
+                                             const hsize_t *count,
+                                             const hsize_t *stride);
+
+escdf_errno_t utils_hdf5_selection_set_elements(utils_hdf5_selection_t *sel,
+                                                size_t num_points,
+                                                const hsize_t *coord);
+
+/**
+ * Select the union of nranges ranges of rows, given as (first, count)
+ * pairs, with all the values of each row. The values are transferred in
+ * the order of the rows in the data set, whatever the order of the ranges.
+ */
+escdf_errno_t utils_hdf5_selection_set_rows(utils_hdf5_selection_t *sel,
+                                            size_t nranges,
+                                            const hsize_t *ranges);
+
+/**
+ * Select the union of n regular hyperslabs, the i-th one given by the rank
+ * values from starts + i * rank, strides + i * rank, etc. as in
+ * H5Sselect_hyperslab(), strides being NULL for contiguous blocks.
+ */
+escdf_errno_t utils_hdf5_selection_set_hyperslabs(utils_hdf5_selection_t *sel,
+                                                  size_t n,
+                                                  const hsize_t *starts,
+                                                  const hsize_t *strides,
+                                                  const hsize_t *counts,
+                                                  const hsize_t *blocks);
+
+escdf_errno_t utils_hdf5_selection_write(const utils_hdf5_selection_t *sel,
+                                         hid_t dtset_id,
+                                         hid_t xfer_id,
+                                         hid_t mem_type_id,
+                                         const void *buf);
+
+escdf_errno_t utils_hdf5_selection_read(const utils_hdf5_selection_t *sel,
+                                        hid_t dtset_id,
+                                        hid_t xfer_id,
+                                        hid_t mem_type_id,
+                                        void *buf);
+
 escdf_errno_t utils_hdf5_read_dataset(hid_t dtset_id,
                                       hid_t xfer_id,
                                       void *buf,
@@ -95,6 +230,50 @@ escdf_errno_t utils_hdf5_read_dataset_at(hid_t dtset_id,
                                          size_t num_points,
                                          const hsize_t *coord);
 
+/**
+ * Check whether the chunks of a data set can be read and written directly,
+ * bypassing the HDF5 filter pipeline: the data set must be chunked, stored
+ * with the type mem_type_id, have no filter but deflate (and deflate only
+ * if zlib is available), and belong to a file not opened with MPI-IO. On
+ * success, chunk holds the ndims chunk dimensions and deflate_level the
+ * level of the deflate filter, 0 if there is none.
+ */
+bool utils_hdf5_direct_chunks(hid_t dtset_id, hid_t mem_type_id,
+                              hsize_t *chunk, unsigned int ndims,
+                              unsigned int *deflate_level);
+
+/**
+ * Write the already filtered bytes of the chunk starting at offset.
+ */
+escdf_errno_t utils_hdf5_write_chunk(hid_t dtset_id, hid_t xfer_id,
+                                     const hsize_t *offset,
+                                     const void *buf, size_t size);
+
+/**
+ * Read the still filtered bytes of the chunk starting at offset into a newly
+ * allocated buffer. If the chunk has never been written, buf is NULL and
+ * size is 0.
+ */
+escdf_errno_t utils_hdf5_read_chunk(hid_t dtset_id, hid_t xfer_id,
+                                    const hsize_t *offset,
+                                    void **buf, size_t *size);
+
+/**
+ * Map in memory, read-only, the bytes of a data set stored in one piece
+ * in its file: the data set must be contiguous, without filter nor
+ * external storage, stored with the type mem_type_id, already written, and
+ * belong to a file opened with the default (sec2) driver, which can still
+ * be reopened by its name, otherwise ESCDF_ENOSUPPORT is returned. The
+ * file is flushed first if it is writable. On success, buf points to the
+ * first value, and the mapping (addr, len) must be released with
+ * utils_hdf5_unmap(); it outlives the file handle.
+ */
+escdf_errno_t utils_hdf5_map_dataset(hid_t dtset_id, hid_t mem_type_id,
+                                     void **addr, size_t *len,
+                                     const void **buf);
+
+void utils_hdf5_unmap(void *addr, size_t len);
+
 #if H5_VERS_MINOR < 8 || H5_VERS_RELEASE < 5
 htri_t H5Oexists_by_name(hid_t loc_id, const char *name, hid_t lapl_id);
 #endif
@@ -0,0 +1,194 @@
+/*
+  Copyright (C) 2016 D. Caliste, F. Corsetti, M. Oliveira, Y. Pouillon, and D. Strubbe
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "escdf_error.h"
+#include "escdf_handle.h"
+#include "escdf_stats.h"
+#include "utils_stats.h"
+
+#ifndef ESCDF_THREAD_LOCAL
+#define ESCDF_THREAD_LOCAL
+#endif
+
+/* Counters of the call being recorded, one set per thread */
+static ESCDF_THREAD_LOCAL struct {
+    bool recording;
+    unsigned long selections;
+    unsigned long opens;
+    unsigned long long bytes;
+} utils_stats_thread;
+
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t utils_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/******************************************************************************
+ * Routines                                                                   *
+ ******************************************************************************/
+
+void utils_stats_lock(void)
+{
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&utils_stats_mutex);
+#endif
+}
+
+void utils_stats_unlock(void)
+{
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&utils_stats_mutex);
+#endif
+}
+
+double utils_stats_wtime(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + 1e-9 * (double)ts.tv_nsec;
+}
+
+struct utils_stats * utils_stats_new(bool dump_at_close)
+{
+    struct utils_stats *stats;
+
+    stats = (struct utils_stats *) calloc(1, sizeof(struct utils_stats));
+    FULFILL_OR_RETURN_VAL(stats != NULL, ESCDF_ENOMEM, NULL);
+
+    stats->dump_at_close = dump_at_close;
+
+    return stats;
+}
+
+void utils_stats_free(struct utils_stats *stats)
+{
+    if (stats == NULL)
+        return;
+
+    free(stats);
+}
+
+void utils_stats_init_handle(escdf_handle_t *handle)
+{
+    const char *env;
+
+    handle->stats = NULL;
+    env = getenv("ESCDF_STATS");
+    if (env != NULL && env[0] != '\0' && strcmp(env, "0") != 0) {
+        handle->stats = utils_stats_new(true);
+    }
+}
+
+void utils_stats_close_handle(escdf_handle_t *handle)
+{
+    struct utils_stats *stats;
+    bool dump;
+
+    utils_stats_lock();
+    dump = (handle->stats != NULL && handle->stats->dump_at_close);
+    utils_stats_unlock();
+    if (dump) {
+        escdf_stats_print(handle, stderr);
+    }
+
+    utils_stats_lock();
+    stats = handle->stats;
+    handle->stats = NULL;
+    utils_stats_unlock();
+    utils_stats_free(stats);
+}
+
+void utils_stats_start(const escdf_handle_t *handle, utils_stats_timer_t *timer)
+{
+    bool enabled;
+
+    timer->active = false;
+    if (handle == NULL || utils_stats_thread.recording)
+        return;
+
+    /* The pointer is cleared by escdf_stats_disable() under the lock. */
+    utils_stats_lock();
+    enabled = (handle->stats != NULL);
+    utils_stats_unlock();
+    if (!enabled)
+        return;
+
+    utils_stats_thread.recording = true;
+    utils_stats_thread.selections = 0;
+    utils_stats_thread.opens = 0;
+    utils_stats_thread.bytes = 0;
+    timer->active = true;
+    timer->t0 = utils_stats_wtime();
+}
+
+void utils_stats_stop(const escdf_handle_t *handle, utils_stats_timer_t *timer,
+                      escdf_stats_operation op)
+{
+    double elapsed;
+    struct utils_stats *stats;
+
+    if (!timer->active)
+        return;
+
+    elapsed = utils_stats_wtime() - timer->t0;
+    utils_stats_thread.recording = false;
+    timer->active = false;
+
+    /* Recording may have been disabled in the meantime. */
+    utils_stats_lock();
+    if ((stats = handle->stats) != NULL) {
+        stats->data.calls[op] += 1;
+        stats->data.bytes[op] += utils_stats_thread.bytes;
+        stats->data.time[op] += elapsed;
+        stats->data.selections += utils_stats_thread.selections;
+        stats->data.opens += utils_stats_thread.opens;
+    }
+    utils_stats_unlock();
+}
+
+bool utils_stats_recording(void)
+{
+    return utils_stats_thread.recording;
+}
+
+void utils_stats_count_selection(void)
+{
+    if (utils_stats_thread.recording)
+        utils_stats_thread.selections++;
+}
+
+void utils_stats_count_open(void)
+{
+    if (utils_stats_thread.recording)
+        utils_stats_thread.opens++;
+}
+
+void utils_stats_count_bytes(hid_t mem_type_id, hsize_t num_elements)
+{
+    if (utils_stats_thread.recording)
+        utils_stats_thread.bytes += (unsigned long long)H5Tget_size(mem_type_id) * num_elements;
+}
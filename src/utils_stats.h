@@ -0,0 +1,112 @@
+/*
+  Copyright (C) 2016 D. Caliste, F. Corsetti, M. Oliveira, Y. Pouillon, and D. Strubbe
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#ifndef LIBESCDF_UTILS_STATS_H
+#define LIBESCDF_UTILS_STATS_H
+
+#include <stdbool.h>
+
+#include <hdf5.h>
+
+#if defined HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#include "escdf_handle.h"
+#include "escdf_stats.h"
+
+/******************************************************************************
+ * Data structures                                                            *
+ ******************************************************************************/
+
+/**
+ * Statistics attached to a handle. Several threads can share a handle, so
+ * the accumulated values, and the stats pointer of the handles, are
+ * protected by the statistics lock.
+ */
+struct utils_stats {
+    escdf_stats_t data;
+    bool dump_at_close;
+};
+
+/**
+ * Timer for one public call. Only the outermost instrumented call of a
+ * thread is recorded, so that nested public calls are not counted twice.
+ */
+typedef struct {
+    double t0;
+    bool active;
+} utils_stats_timer_t;
+
+/******************************************************************************
+ * Routines                                                                   *
+ ******************************************************************************/
+
+/**
+ * Allocate and free the statistics attached to a handle.
+ */
+struct utils_stats * utils_stats_new(bool dump_at_close);
+void utils_stats_free(struct utils_stats *stats);
+
+/**
+ * Lock and unlock the statistics of all the handles. The stats pointer of
+ * a handle is only set, cleared or dereferenced with the lock held, so that
+ * disabling the statistics cannot free them under a call being recorded.
+ */
+void utils_stats_lock(void);
+void utils_stats_unlock(void);
+
+/**
+ * Enable recording on a new handle if the ESCDF_STATS environment variable
+ * is set.
+ */
+void utils_stats_init_handle(escdf_handle_t *handle);
+
+/**
+ * Print the summary if requested and free the statistics of a handle
+ * that is being closed.
+ */
+void utils_stats_close_handle(escdf_handle_t *handle);
+
+/**
+ * Start and stop recording a public call on a handle.
+ */
+void utils_stats_start(const escdf_handle_t *handle, utils_stats_timer_t *timer);
+void utils_stats_stop(const escdf_handle_t *handle, utils_stats_timer_t *timer,
+                      escdf_stats_operation op);
+
+/**
+ * Counters updated by the HDF5 helpers while a call is being recorded by
+ * the calling thread. They do nothing otherwise.
+ */
+bool utils_stats_recording(void);
+void utils_stats_count_selection(void);
+void utils_stats_count_open(void);
+void utils_stats_count_bytes(hid_t mem_type_id, hsize_t num_elements);
+
+/**
+ * Monotonic wall clock, in seconds.
+ */
+double utils_stats_wtime(void);
+
+#endif